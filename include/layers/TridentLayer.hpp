@@ -25,6 +25,7 @@
 
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
+#include <trident/kb/querierpool.h>
 #include <trident/model/table.h>
 #include <kognac/stringscol.h>
 #include <dblayer.hpp>
@@ -42,13 +43,32 @@ class TridentScan : public DBLayer::Scan {
         DBLayer::Hint *hint;
         size_t countHint;
 
+        //Pairs fetched with nextBatch(). Used only if the scan reads all
+        //columns. The hint is checked against the buffered pairs
+        bool batched;
+        size_t batchSize, batchPos;
+        std::unique_ptr<int64_t[]> batchValues1;
+        std::unique_ptr<int64_t[]> batchValues2;
+
+        void startBatch();
+
+        void applyHintToBatch();
+
+        //Release the iterator of the previous execution. It is still open
+        //if the scan was stopped before its end (e.g., at the end of a
+        //morsel)
+        void restart();
+
     public:
         TridentScan(const int perm, const DBLayer::Aggr_t a,
                 Querier *q, DBLayer::Hint *hint) : a(a), perm(perm),
         itr(NULL),
         q(q),
         hint(hint),
-        countHint(0) {
+        countHint(0),
+        batched(false),
+        batchSize(0),
+        batchPos(0) {
         }
 
         uint64_t getValue1();
@@ -69,6 +89,8 @@ class TridentScan : public DBLayer::Scan {
 
         bool first(uint64_t, bool, uint64_t, bool, uint64_t, bool);
 
+        bool skipTo(uint64_t value1, uint64_t value2);
+
         ~TridentScan();
 };
 
@@ -77,6 +99,8 @@ class TridentLayer : public DBLayer {
         KB &kb;
         DictMgmt *dict;
         std::unique_ptr<Querier> q;
+        //If set, q was taken from this pool and is returned to it
+        QuerierPool *pool;
         bool bifSampl;
         const int nindices;
 
@@ -164,10 +188,33 @@ class TridentLayer : public DBLayer {
                 const int64_t card1,
                 const int64_t card2);
 
+        //Selectivity computed with the statistics of the KB. Returns -1
+        //if the statistics do not cover the join
+        double statsJoinSelectivity(const CharacteristicSets *cs,
+                bool valueL1,
+                uint64_t value1CL,
+                bool value2L,
+                uint64_t value2CL,
+                bool value3L,
+                uint64_t value3CL,
+                bool value1R,
+                uint64_t value1CR,
+                bool value2R,
+                uint64_t value2CR,
+                bool value3R,
+                uint64_t value3CR);
+
     public:
         TridentLayer(KB &kb) : kb(kb), dict(kb.getDictMgmt()), q(kb.query()),
-        bifSampl(true), nindices(kb.getNIndices()), supportBuffer(new
-                char[MAX_TERM_SIZE]) { }
+        pool(NULL), bifSampl(true), nindices(kb.getNIndices()),
+        supportBuffer(new char[MAX_TERM_SIZE]) { }
+
+        //The layer uses a querier of the pool. Layers created this way can
+        //be used by different threads at the same time
+        TridentLayer(KB &kb, QuerierPool &pool) : kb(kb),
+        dict(kb.getDictMgmt()), q(pool.get()), pool(&pool),
+        bifSampl(true), nindices(kb.getNIndices()),
+        supportBuffer(new char[MAX_TERM_SIZE]) { }
 
 		DDLEXPORT bool lookup(const std::string& text,
                 ::Type::ID type,
@@ -190,6 +237,11 @@ class TridentLayer : public DBLayer {
                 ::Type::ID& type,
                 unsigned& subType);
 
+        DDLEXPORT void lookupByIds(const std::vector<uint64_t>& ids,
+                std::vector<std::string>& texts,
+                std::vector< ::Type::ID>& types,
+                std::vector<bool>& found);
+
         DDLEXPORT uint64_t getNextId();
 
         DDLEXPORT double getScanCost(DBLayer::DataOrder order,
@@ -229,6 +281,9 @@ class TridentLayer : public DBLayer {
 
         DDLEXPORT uint64_t getCardinality();
 
+        DDLEXPORT double getStarCardinality(
+                const std::vector<uint64_t> &predicates);
+
         uint64_t getNTerms() {
             return kb.getNTerms();
         }
@@ -244,6 +299,17 @@ class TridentLayer : public DBLayer {
         KB *getKB() {
             return &kb;
         }
+
+        //NULL if the layer has its own querier
+        QuerierPool *getPool() {
+            return pool;
+        }
+
+        ~TridentLayer() {
+            if (pool) {
+                pool->release(q.release());
+            }
+        }
 };
 
 #endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+#ifndef _FIXEDBYTES_H
+#define _FIXEDBYTES_H
+
+#include <trident/kb/consts.h>
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+//Decoding of the little-endian entries written with
+//Utils::encode_longNBytes. They replace Utils::decode_longFixedBytes in the
+//hot loops. Trident already requires a little-endian machine (see
+//main_params.cpp), so an entry can be read with one unaligned load and a mask.
+class FixedBytes {
+    private:
+        static const uint64_t masks[9];
+
+    public:
+        //The width is known at compile time: the compiler turns the memcpy
+        //into a couple of loads
+        template<int nbytes>
+            static uint64_t decode(const char *p) {
+                uint64_t v = 0;
+                memcpy(&v, p, nbytes);
+                return v;
+            }
+
+        //limit is the end of the readable memory. If there are at least 8
+        //bytes left, then the entry is read with a single load
+        static uint64_t decode(const char *p, const uint8_t nbytes,
+                const char *limit) {
+            if (p + 8 <= limit) {
+                uint64_t v;
+                memcpy(&v, p, 8);
+                return v & masks[nbytes];
+            }
+            uint64_t v = 0;
+            memcpy(&v, p, nbytes);
+            return v;
+        }
+
+        //Decode n entries of nbytes each (1 to 8). Consecutive entries start
+        //stride bytes apart. The entries are decoded with SSSE3/AVX2 shuffles
+        //if the CPU supports them and the entries are contiguous. The kernels
+        //never read beyond limit.
+        DDLEXPORT static void unpack(const char *in, const char *limit,
+                const uint8_t nbytes, const uint8_t stride,
+                const size_t n, uint64_t *out);
+
+        DDLEXPORT static void unpack_scalar(const char *in, const char *limit,
+                const uint8_t nbytes, const uint8_t stride,
+                const size_t n, uint64_t *out);
+
+        //Returns the index of the first of the n entries that is not smaller
+        //than key, or n if there is none. The search gallops from the first
+        //entry, and completes with a linear probe on the decoded entries of
+        //the last few cache lines.
+        DDLEXPORT static size_t lowerBound(const char *in, const char *limit,
+                const uint8_t nbytes, const uint8_t stride,
+                const size_t n, const uint64_t key);
+
+        //Returns the name of the kernel selected for this CPU
+        DDLEXPORT static const char *getKernelName();
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+#ifndef _GALLOPSEARCH_H
+#define _GALLOPSEARCH_H
+
+#include <stddef.h>
+
+//Below this number of entries the search becomes a linear scan
+#define GALLOP_LINEAR_ENTRIES 16
+
+class GallopSearch {
+    public:
+        //Returns the first entry in [s, e) for which less(entry) is false.
+        //Entries are stride bytes long and must be sorted. Merge joins
+        //mostly skip a few entries at the time, so the search first doubles
+        //the step from s and then does a binary search on the last interval.
+        template<typename Less>
+            static const char *lowerBound(const char *s, const char *e,
+                    const size_t stride, Less less) {
+                const size_t n = (e - s) / stride;
+                size_t lo = 0;
+                size_t hi = 1;
+                //All entries before lo are less than the key
+                while (hi <= n && less(s + (hi - 1) * stride)) {
+                    lo = hi;
+                    hi <<= 1;
+                }
+                if (hi > n) {
+                    hi = n;
+                }
+                while (hi - lo > GALLOP_LINEAR_ENTRIES) {
+                    const size_t middle = lo + ((hi - lo) >> 1);
+                    if (less(s + middle * stride)) {
+                        lo = middle + 1;
+                    } else {
+                        hi = middle;
+                    }
+                }
+                const char *p = s + lo * stride;
+                const char *pe = s + hi * stride;
+                while (p < pe && less(p)) {
+                    p += stride;
+                }
+                return p;
+            }
+};
+
+#endif
@@ -24,6 +24,7 @@
 #define _NEW_CLUSTERTABLE_H
 
 #include <trident/binarytables/newtable.h>
+#include <trident/binarytables/gallopsearch.h>
 #include <trident/kb/consts.h>
 
 #include <iostream>
@@ -154,6 +155,37 @@ class NewClusterTable: public AbsNewTable {
             return current < end;
         }
 
+        size_t nextBatch(int64_t *v1, int64_t *v2, size_t max) {
+            if (isSecondColumnIgnored) {
+                return PairItr::nextBatch(v1, v2, max);
+            }
+            size_t n = 0;
+            while (n < max && current < end) {
+                if (count == 0) {
+                    currentValue1 = Reader1::read(current);
+                    current += Reader1::size();
+                    count = countgroup = ReaderCount::read(current);
+                    current += ReaderCount::size();
+                }
+                //Copy the rest of the group
+                size_t toread = count;
+                if (toread > max - n) {
+                    toread = max - n;
+                }
+                for (size_t i = 0; i < toread; ++i) {
+                    v1[n + i] = currentValue1;
+                    v2[n + i] = Reader2::read(current);
+                    current += Reader2::size();
+                }
+                count -= toread;
+                n += toread;
+            }
+            if (n > 0) {
+                currentValue2 = v2[n - 1];
+            }
+            return n;
+        }
+
         bool hasNext() {
             return current < end;
         }
@@ -302,23 +334,12 @@ class NewClusterTable: public AbsNewTable {
                         current -= Reader2::size();
                     } else {
                         const char *e = current + count * Reader2::size();
-                        const char *orige = e;
-                        while (current < e) {
-                            const size_t diff = e - current;
-                            const size_t middlevalue = (diff / Reader2::size()) >> 1;
-                            const char *m = current + middlevalue * Reader2::size();
-                            int64_t vm = Reader2::read(m);
-                            if (vm < c2) {
-                                current = m + Reader2::size();
-                            } else if (vm > c2) {
-                                e = m;
-                            } else {
-                                current = m;
-                                break;
-                            }
-                        }
+                        current = GallopSearch::lowerBound(current, e,
+                                Reader2::size(), [c2](const char *p) {
+                                return (int64_t) Reader2::read(p) < c2;
+                                });
                         //update counter
-                        count = (orige - current) / Reader2::size();
+                        count = (e - current) / Reader2::size();
                     }
                 } else {
                     if (currentValue2 == -1) {
@@ -25,10 +25,12 @@
 
 //#include <trident/iterators/pairitr.h>
 #include <trident/binarytables/newtable.h>
+#include <trident/binarytables/fixedbytes.h>
 #include <trident/kb/consts.h>
 #include <kognac/utils.h>
 
 #include <assert.h>
+#include <algorithm>
 
 class SequenceWriter {
     public:
@@ -168,9 +170,9 @@ class NewColumnTable: public AbsNewTable {
             movetoAllowed = true;
 #endif
             if (isSecondColumnIgnored || scannedCounts == currentCount) {
-                currentValue1 = Utils::decode_longFixedBytes(currentpos1, bytesPerFirstEntry);
+                currentValue1 = FixedBytes::decode(currentpos1, bytesPerFirstEntry, end);
                 currentpos1 += bytesPerFirstEntry;
-                currentCount = Utils::decode_longFixedBytes(currentpos1, bytesPerCount);
+                currentCount = FixedBytes::decode(currentpos1, bytesPerCount, end);
                 currentpos1 += bytesPerCount + bytesPerStartingPoint;
                 scannedCounts = 0;
                 startblock2 = currentpos2;
@@ -178,7 +180,7 @@ class NewColumnTable: public AbsNewTable {
 
             if (!isSecondColumnIgnored) {
                 //Read second term
-                currentValue2 = Utils::decode_longFixedBytes(currentpos2, bytesPerSecondEntry);
+                currentValue2 = FixedBytes::decode(currentpos2, bytesPerSecondEntry, end);
                 currentpos2 += bytesPerSecondEntry;
                 scannedCounts++;
             }
@@ -191,6 +193,46 @@ class NewColumnTable: public AbsNewTable {
             return hasNext();
         }
 
+        size_t nextBatch(int64_t *v1, int64_t *v2, size_t max) {
+            if (isSecondColumnIgnored) {
+                return PairItr::nextBatch(v1, v2, max);
+            }
+            size_t n = 0;
+            while (n < max && hasNext()) {
+                if (scannedCounts == currentCount) {
+                    currentValue1 = FixedBytes::decode(currentpos1, bytesPerFirstEntry, end);
+                    currentpos1 += bytesPerFirstEntry;
+                    currentCount = FixedBytes::decode(currentpos1, bytesPerCount, end);
+                    currentpos1 += bytesPerCount + bytesPerStartingPoint;
+                    scannedCounts = 0;
+                    startblock2 = currentpos2;
+                }
+                //Decode the remaining part of the group in one go
+                size_t toread = std::min((uint64_t)(max - n),
+                        currentCount - scannedCounts);
+                toread = std::min(toread,
+                        (size_t)((end - currentpos2) / bytesPerSecondEntry));
+                if (toread == 0) {
+                    break;
+                }
+                for (size_t i = 0; i < toread; ++i) {
+                    v1[n + i] = currentValue1;
+                }
+                FixedBytes::unpack(currentpos2, end, bytesPerSecondEntry,
+                        bytesPerSecondEntry, toread, (uint64_t*) (v2 + n));
+                currentpos2 += toread * bytesPerSecondEntry;
+                scannedCounts += toread;
+                n += toread;
+            }
+            if (n > 0) {
+                currentValue2 = v2[n - 1];
+#if DEBUG
+                movetoAllowed = true;
+#endif
+            }
+            return n;
+        }
+
         void first() {
             next();
         }
@@ -218,48 +260,26 @@ class NewColumnTable: public AbsNewTable {
 
             bool searchsecondterm = c1 == currentValue1;
             if (c1 > currentValue1) {
-                //Binary search
-                const char *s = currentpos1;
-                const char *e = startpos2;
-                bool found = false;
-                uint64_t middleValue;
-                while (s < e) {
-                    const uint64_t middlePos = (e - s) / bytesFirstBlock / 2;
-                    const char *middle = s + middlePos * bytesFirstBlock;
-                    middleValue  = Utils::decode_longFixedBytes(middle, bytesPerFirstEntry);
-                    if (middleValue < c1) {
-                        s = middle + bytesFirstBlock;
-                    } else if (middleValue > c1) {
-                        e = middle;
-                    } else { //Found
-                        currentpos1 = middle;
-                        const uint64_t idx2 = Utils::decode_longFixedBytes(
-                                middle + bytesPerFirstEntry + bytesPerCount,
-                                bytesPerStartingPoint);
-                        currentpos2 = startpos2 + idx2 * bytesPerSecondEntry;
-                        startblock2 = currentpos2;
-                        currentCount = 0;
-                        found = true;
-                        break;
-                    }
-                }
-
-                if (!found) {
-                    if (s >= startpos2) {
-                        //No more entries
-                        currentpos1 = startpos2;
-                        currentpos2 = end;
-                    } else {
-                        currentpos1 = s;
-                        currentCount = 0;
-                        const uint64_t pos2 = Utils::decode_longFixedBytes(
-                                s + bytesPerFirstEntry + bytesPerCount,
-                                bytesPerStartingPoint);
-                        currentpos2 = startpos2 + pos2 * bytesPerSecondEntry;
-                        startblock2 = currentpos2;
-                    }
+                //Galloping search
+                const uint64_t nblocks = (startpos2 - currentpos1) / bytesFirstBlock;
+                const uint64_t idx = FixedBytes::lowerBound(currentpos1, end,
+                        bytesPerFirstEntry, bytesFirstBlock, nblocks, c1);
+                if (idx == nblocks) {
+                    //No more entries
+                    currentpos1 = startpos2;
+                    currentpos2 = end;
                 } else {
-                    searchsecondterm = true;
+                    const char *s = currentpos1 + idx * bytesFirstBlock;
+                    currentpos1 = s;
+                    currentCount = 0;
+                    const uint64_t pos2 = FixedBytes::decode(
+                            s + bytesPerFirstEntry + bytesPerCount,
+                            bytesPerStartingPoint, end);
+                    currentpos2 = startpos2 + pos2 * bytesPerSecondEntry;
+                    startblock2 = currentpos2;
+                    if (FixedBytes::decode(s, bytesPerFirstEntry, end) == c1) {
+                        searchsecondterm = true;
+                    }
                 }
                 scannedCounts = 0;
                 currentValue2 = -1;
@@ -273,43 +293,25 @@ class NewColumnTable: public AbsNewTable {
                     if (currentValue2 == -1) {
                         //In this case, I must read all the first term already,
                         //otherwise the following next() will screw it up
-                        currentValue1 = Utils::decode_longFixedBytes(currentpos1, bytesPerFirstEntry);
+                        currentValue1 = FixedBytes::decode(currentpos1, bytesPerFirstEntry, end);
                         currentpos1 += bytesPerFirstEntry;
-                        currentCount = Utils::decode_longFixedBytes(currentpos1, bytesPerCount);
+                        currentCount = FixedBytes::decode(currentpos1, bytesPerCount, end);
                         currentpos1 += bytesPerCount + bytesPerStartingPoint;
                     }
 
-                    const char *s = currentpos2;
                     const char *e = startblock2 + currentCount * bytesPerSecondEntry;
-                    bool found = false;
-                    while (s < e) {
-                        const uint64_t middlePos = (e - s) / bytesPerSecondEntry / 2;
-                        const char *middle = s + middlePos * bytesPerSecondEntry;
-                        const uint64_t middleValue = Utils::decode_longFixedBytes(
-                                middle,
-                                bytesPerSecondEntry);
-                        if (middleValue < c2) {
-                            s = middle + bytesPerSecondEntry;
-                        } else if (middleValue > c2) {
-                            e = middle;
-                        } else { //Found
-                            found = true;
-                            scannedCounts = (middle - startblock2) / bytesPerSecondEntry;
-                            currentpos2 = middle;
-                            break;
-                        }
-                    }
-                    if (!found) {
-                        if (s >= startblock2 + currentCount * bytesPerSecondEntry) {
-                            scannedCounts = currentCount;
-                            currentpos2 = startblock2 + currentCount * bytesPerSecondEntry;
-                        } else {
-                            currentpos2 = s;
-                            scannedCounts = (s - startblock2) / bytesPerSecondEntry;
-                        }
+                    const uint64_t idx = FixedBytes::lowerBound(currentpos2, end,
+                            bytesPerSecondEntry, bytesPerSecondEntry,
+                            (e - currentpos2) / bytesPerSecondEntry, c2);
+                    currentpos2 += idx * bytesPerSecondEntry;
+                    if (currentpos2 >= e) {
+                        scannedCounts = currentCount;
+                        currentpos2 = e;
                         if (currentpos2 == end) {
                             currentValue2 = 0;
                         }
+                    } else {
+                        scannedCounts = (currentpos2 - startblock2) / bytesPerSecondEntry;
                     }
                 } else if (currentValue2 != -1) {
                     //I do a step back so that hasNext() and next() will point to the same value
@@ -466,19 +468,19 @@ class NewColumnTable: public AbsNewTable {
 
         int64_t getValue1AtRow(int64_t rowid) {
             const char *pos = startpos1 + bytesFirstBlock * rowid;
-            return Utils::decode_longFixedBytes(pos, bytesPerFirstEntry);
+            return FixedBytes::decode(pos, bytesPerFirstEntry, end);
         }
 
         int64_t getValue2AtRow(int64_t rowid) {
             const char *pos = startblock2 + bytesPerSecondEntry * rowid;
-            return Utils::decode_longFixedBytes(pos, bytesPerSecondEntry);
+            return FixedBytes::decode(pos, bytesPerSecondEntry, end);
         }
 
         template<int nbytes, int nskip>
             static int64_t s_getValue1AtRow(const char *start,
                     const int64_t rowId) {
                 const char *currentpos1= start + (nbytes + nskip) * rowId;
-                const int64_t v = Utils::decode_longFixedBytes(currentpos1, nbytes);
+                const int64_t v = FixedBytes::decode<nbytes>(currentpos1);
                 return v;
             }
 
@@ -490,10 +492,10 @@ class NewColumnTable: public AbsNewTable {
                     uint64_t &v1,
                     uint64_t &v2) {
                 const char *currentpos1 = start + (nbytes1 + offset) * rowId;
-                v1 = Utils::decode_longFixedBytes(currentpos1, nbytes1);
+                v1 = FixedBytes::decode<nbytes1>(currentpos1);
                 const char *currentpos2 = start + (nbytes1 + offset) * sizetable +
                     rowId * nbytes2;
-                v2 = Utils::decode_longFixedBytes(currentpos2, nbytes2);
+                v2 = FixedBytes::decode<nbytes2>(currentpos2);
             }
 
 };
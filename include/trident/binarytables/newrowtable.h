@@ -24,6 +24,7 @@
 #define _NEW_ROWTABLE_H
 
 #include <trident/binarytables/newtable.h>
+#include <trident/binarytables/gallopsearch.h>
 #include <trident/kb/consts.h>
 
 #include <iostream>
@@ -147,6 +148,27 @@ class NewRowTable: public AbsNewTable {
             return current < end;
         }
 
+        size_t nextBatch(int64_t *v1, int64_t *v2, size_t max) {
+            if (isSecondColumnIgnored) {
+                return PairItr::nextBatch(v1, v2, max);
+            }
+            const uint8_t rowsize = Reader1::size() + Reader2::size();
+            size_t n = (end - current) / rowsize;
+            if (n > max) {
+                n = max;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                v1[i] = Reader1::read(current);
+                v2[i] = Reader2::read(current + Reader1::size());
+                current += rowsize;
+            }
+            if (n > 0) {
+                currentValue1 = v1[n - 1];
+                currentValue2 = v2[n - 1];
+            }
+            return n;
+        }
+
         bool hasNext() {
             assert(current <= end);
             return current < end;
@@ -264,22 +286,19 @@ class NewRowTable: public AbsNewTable {
 
             if (c1 > currentValue1 ||
                     (!isSecondColumnIgnored && c1 == currentValue1 && c2 > currentValue2)) {
-                // Read the first entry
-                int64_t currentvalue = -1;
-                while (current != end) {
-                    currentvalue = Reader1::read(current);
-                    if (currentvalue >= c1)
-                        break;
-                    current += Reader1::size() + Reader2::size();
-                }
+                const uint8_t rowsize = Reader1::size() + Reader2::size();
+                current = GallopSearch::lowerBound(current, end, rowsize,
+                        [c1](const char *p) {
+                        return (int64_t) Reader1::read(p) < c1;
+                        });
                 assert(current <= end);
 
-                if (c2 > 0 && current != end && currentvalue == c1) {
-                    int64_t currentC1 = Reader1::read(current);
-                    while (current != end && Reader1::read(current) == currentC1 &&
-                            Reader2::read(current + Reader1::size()) < c2) {
-                        current += Reader1::size() + Reader2::size();
-                    }
+                if (c2 > 0 && current != end && (int64_t) Reader1::read(current) == c1) {
+                    current = GallopSearch::lowerBound(current, end, rowsize,
+                            [c1, c2](const char *p) {
+                            return (int64_t) Reader1::read(p) == c1 &&
+                            (int64_t) Reader2::read(p + Reader1::size()) < c2;
+                            });
                 }
             } else {
                 current -= Reader1::size() + Reader2::size();
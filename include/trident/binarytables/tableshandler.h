@@ -36,6 +36,8 @@
 
 #define MAX_LENGTH_PATHFILE 1024
 #define MAX_N_SECTORS 10000
+//Scans of tables smaller than this do not ask the OS to read ahead
+#define MMAP_WILLNEED_MIN (1024 * 1024)
 using namespace std;
 
 class FileMarks {
@@ -95,6 +97,13 @@ class TableStorage {
 
         FileManager<FileDescriptor, FileDescriptor> *cache;
 
+        //If set, all the files are mapped once in the constructor and the
+        //tables point directly in the mappings. The cache is not used.
+        const bool mmapFiles;
+        std::vector<std::unique_ptr<MemoryMappedFile>> mappedFiles;
+
+        void mapAllFiles();
+
         short lastCreatedFile;
         int64_t sizeLastCreatedFile;
 
@@ -120,11 +129,13 @@ class TableStorage {
     public:
         TableStorage(bool readOnly, std::string pathDir, int64_t maxFileSize,
                 int maxNFiles, MemoryManager<FileDescriptor> *bytesTracker,
-                Stats &stats, int perm);
+                Stats &stats, int perm, bool mmapFiles = false);
 
         std::string getPath();
 
-        std::pair<const char*, const char*> getTable(short file, int64_t mark);
+        //If scan is set, the table is going to be read entirely
+        std::pair<const char*, const char*> getTable(short file, int64_t mark,
+                bool scan = false);
 
         int64_t startAppend(const int64_t key,
                 const char strat,
@@ -30,12 +30,13 @@
 #include <kognac/logs.h>
 #include <kognac/consts.h>
 
-#include <list>
 #include <string>
 #include <sstream>
 #include <vector>
 #include <iostream>
 #include <mutex>
+#include <atomic>
+#include <chrono>
 #include <assert.h>
 
 using namespace std;
@@ -52,7 +53,15 @@ class FileManager {
 
         MemoryManager<K> *bytesTracker;
         T *openedFiles[MAX_N_FILES];
-        list<int> trackerOpenedFiles;
+
+        //Eviction follows the CLOCK policy. The hand sweeps over the files
+        //opened by this manager (tracked). A file accessed since the last
+        //sweep has its reference bit set and gets a second chance. Hits
+        //only set the bit, so they never take the lock.
+        bool trackedFiles[MAX_N_FILES];
+        std::atomic<bool> referencedFiles[MAX_N_FILES];
+        int clockHand;
+        int highestTrackedFile;
 
         //Cache the uncompressed size of file used during the writing
         vector<uint64_t> cacheFileSize;
@@ -70,62 +79,92 @@ class FileManager {
             return openedFiles[id] != NULL;
         }
 
+        void markReferenced(const int id) {
+            //Avoid writing on the cache line if the bit is already set
+            if (!referencedFiles[id].load(std::memory_order_relaxed)) {
+                referencedFiles[id].store(true, std::memory_order_relaxed);
+            }
+            if (stats) {
+                stats->incrNFileHits();
+            }
+        }
+
+        //Close one file that is not used by the memory manager. If all
+        //files are used, then nothing is closed and the limit is exceeded.
+        void evictFile() {
+            const int nslots = highestTrackedFile + 1;
+            //After one round all reference bits are cleared, so two rounds
+            //are enough to find a victim if there is one
+            for (int i = 0; i < 2 * nslots && nOpenedFiles >= maxFiles; ++i) {
+                const int idx = clockHand;
+                clockHand = (clockHand + 1) % nslots;
+                if (!trackedFiles[idx]) {
+                    continue;
+                }
+                if (openedFiles[idx] == NULL) {
+                    //The memory manager has already closed it
+                    trackedFiles[idx] = false;
+                    nOpenedFiles--;
+                    continue;
+                }
+                if (referencedFiles[idx].load(std::memory_order_relaxed)) {
+                    referencedFiles[idx].store(false, std::memory_order_relaxed);
+                    continue;
+                }
+                if (openedFiles[idx]->isUsed()) {
+                    continue;
+                }
+                //LOG(DEBUGL) << "Deleting map for file " << idx;
+                delete openedFiles[idx];
+                openedFiles[idx] = NULL;
+                trackedFiles[idx] = false;
+                nOpenedFiles--;
+                if (stats) {
+                    stats->incrNFileEvictions();
+                }
+            }
+        }
+
         void load_file(const int id) {
-            if (!isFileLoaded(id)) {
-#ifdef MT
-                std::unique_lock<std::mutex> lock(mutex);
-                if (!isFileLoaded(id)) {
-#endif
-                    if (nOpenedFiles >= maxFiles) {
-                        //Take the last opened file
-                        int idxFileToRemove = trackerOpenedFiles.front();
-                        int firstFileRemoved = -1;
-                        trackerOpenedFiles.pop_front();
-                        bool rem = true;
-                        assert(!trackerOpenedFiles.empty());
-                        while (openedFiles[idxFileToRemove] == NULL ||
-                                openedFiles[idxFileToRemove]->isUsed()) {
-
-                            if (openedFiles[idxFileToRemove] != NULL) {
-                                //It means the file is still used
-                                trackerOpenedFiles.push_back(idxFileToRemove);
-                                if (firstFileRemoved == -1) {
-                                    firstFileRemoved = idxFileToRemove;
-                                }
-                            } else {
-                                nOpenedFiles--;
-                            }
-
-                            if (!trackerOpenedFiles.empty()) {
-                                idxFileToRemove = trackerOpenedFiles.front();
-                                trackerOpenedFiles.pop_front();
-                            } else {
-                                rem = false;
-                            }
-
-                            if (idxFileToRemove == firstFileRemoved) {
-                                rem = false;
-                                break;
-                            }
-                        }
-                        if (rem) {
-                            //LOG(DEBUGL) << "Deleting map for file " << idxFileToRemove;
-                            delete openedFiles[idxFileToRemove];
-                            openedFiles[idxFileToRemove] = NULL;
-                            nOpenedFiles--;
-                        }
-                    }
-                    std::stringstream filePath;
-                    filePath << cacheDir << DIR_SEP << id;
-                    T* f = new T(readOnly, id, filePath.str(), fileMaxSize,
-                            bytesTracker, openedFiles, stats);
-                    openedFiles[id] = f;
-                    trackerOpenedFiles.push_back(id);
-                    nOpenedFiles++;
+            if (isFileLoaded(id)) {
+                markReferenced(id);
+                return;
+            }
 #ifdef MT
+            std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+            if (!lock.try_lock()) {
+                auto start = std::chrono::steady_clock::now();
+                lock.lock();
+                if (stats) {
+                    stats->addFileWaitTime(std::chrono::duration_cast<
+                            std::chrono::microseconds>(
+                                std::chrono::steady_clock::now() - start).count());
                 }
-                lock.unlock();
+            }
+            if (isFileLoaded(id)) {
+                //Another thread opened it in the meantime
+                markReferenced(id);
+                return;
+            }
 #endif
+            if (stats) {
+                stats->incrNFileMisses();
+            }
+            if (nOpenedFiles >= maxFiles) {
+                evictFile();
+            }
+            std::stringstream filePath;
+            filePath << cacheDir << DIR_SEP << id;
+            T* f = new T(readOnly, id, filePath.str(), fileMaxSize,
+                    bytesTracker, openedFiles, stats);
+            openedFiles[id] = f;
+            if (!trackedFiles[id]) {
+                trackedFiles[id] = true;
+                nOpenedFiles++;
+            }
+            referencedFiles[id].store(true, std::memory_order_relaxed);
+            if (id > highestTrackedFile) {
+                highestTrackedFile = id;
             }
         }
     public:
@@ -137,7 +176,11 @@ class FileManager {
             stats(stats) {
                 for (int i = 0; i < MAX_N_FILES; ++i) {
                     openedFiles[i] = NULL;
+                    trackedFiles[i] = false;
+                    referencedFiles[i] = false;
                 }
+                clockHand = 0;
+                highestTrackedFile = 0;
 
                 lastSession = 0;
                 for (int i = 0; i < MAX_SESSIONS; ++i) {
@@ -309,7 +352,9 @@ class FileManager {
                     delete openedFiles[i];
                     openedFiles[i] = NULL;
                 }
+                trackedFiles[i] = false;
             }
+            nOpenedFiles = 0;
         }
 
         ~FileManager() {
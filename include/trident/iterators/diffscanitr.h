@@ -31,6 +31,7 @@
 
 class DiffIndex;
 class Querier;
+class StorageStrat;
 class DiffScanItr : public PairItr {
 private:
     int perm;
@@ -41,6 +42,7 @@ private:
     std::unique_ptr<TreeItr> root;
     DiffIndex *diff;
     Querier *q;
+    StorageStrat *strat;
 
     PairItr *currentItr;
 
@@ -90,7 +92,7 @@ public:
 
     void next();
 
-    void init(TreeItr *root, int perm, DiffIndex *diff);
+    void init(TreeItr *root, int perm, DiffIndex *diff, StorageStrat *strat);
 
     void setQuerier(Querier *q);
 
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _MEMDIFFITR_H
+#define _MEMDIFFITR_H
+
+#include <trident/iterators/pairitr.h>
+#include <trident/kb/consts.h>
+
+#include <inttypes.h>
+#include <vector>
+#include <memory>
+
+//Iterator over a sorted range of the in-memory delta (DiffIndexMem). The
+//rows are stored flat as (key, value1, value2). The iterator keeps a
+//reference to the table, so updates that replace it do not invalidate the
+//iterator
+class MemDiffItr : public PairItr {
+private:
+    std::shared_ptr<const std::vector<uint64_t>> table;
+    const uint64_t *rows;
+    size_t start, end;
+    size_t pos, current, markPos;
+    int64_t v1, v2;
+    int64_t count;
+    bool ignSecondColumn;
+
+    bool sameGroup(const size_t row1, const size_t row2) const {
+        return rows[row1 * 3] == rows[row2 * 3] &&
+            rows[row1 * 3 + 1] == rows[row2 * 3 + 1];
+    }
+
+public:
+    int getTypeItr() {
+        return MEMDIFF_ITR;
+    }
+
+    int64_t getValue1() {
+        return v1;
+    }
+
+    int64_t getValue2() {
+        return v2;
+    }
+
+    bool hasNext() {
+        return pos < end;
+    }
+
+    int64_t getCount() {
+        return count;
+    }
+
+    void next();
+
+    void ignoreSecondColumn();
+
+    uint64_t getCardinality();
+
+    uint64_t estCardinality();
+
+    void mark();
+
+    void reset(const char i);
+
+    void clear();
+
+    void moveto(const int64_t c1, const int64_t c2);
+
+    void init(std::shared_ptr<const std::vector<uint64_t>> table,
+            size_t start, size_t end);
+};
+
+#endif
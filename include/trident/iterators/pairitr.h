@@ -25,6 +25,7 @@
 
 
 #include <inttypes.h>
+#include <stddef.h>
 
 #define NO_CONSTRAINT -1
 
@@ -62,6 +63,24 @@ class PairItr {
             return hasNext();
         }
 
+        //Advance the iterator by at most max pairs and copy them in v1 and
+        //v2. All the pairs in a batch share the same key, and afterwards the
+        //iterator is positioned on the last pair, as if next() was called
+        //that many times. Batches are meant for scans that read both columns:
+        //if the second column is ignored, the content of v2 is unspecified.
+        //Returns the number of pairs that were copied.
+        virtual size_t nextBatch(int64_t *v1, int64_t *v2, size_t max) {
+            //Without any knowledge of the layout I cannot tell whether the
+            //key will change, so I return one pair at the time
+            if (max == 0 || !hasNext()) {
+                return 0;
+            }
+            next();
+            v1[0] = getValue1();
+            v2[0] = getValue2();
+            return 1;
+        }
+
         virtual void ignoreSecondColumn() = 0;
 
         virtual int64_t getCount() = 0;
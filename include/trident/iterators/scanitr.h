@@ -107,6 +107,8 @@ public:
 
     bool next(int64_t &v1, int64_t &v2, int64_t &v3);
 
+    size_t nextBatch(int64_t *v1, int64_t *v2, size_t max);
+
     void clear();
 
     uint64_t getCardinality();
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _CHARSETS_H
+#define _CHARSETS_H
+
+#include <trident/kb/consts.h>
+
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <inttypes.h>
+
+class Querier;
+
+//Maximum number of characteristic sets that are stored. The others are the
+//ones with the fewest subjects, and are merged in a single catch-all set
+#define CHARSETS_MAX 65536
+
+//Maximum number of pairs of predicates counted for every kind of join. Once
+//it is reached, only the pairs already seen are counted
+#define CHARSETS_MAX_PAIRS 1048576
+
+//Statistics computed when the KB is loaded, so that the optimizer does not
+//need to query (or sample) the KB to estimate cardinalities:
+//- the number of triples, distinct subjects and distinct objects of every
+//predicate;
+//- the characteristic sets, i.e., the sets of predicates that occur
+//together on the same subject, with the number of subjects and triples;
+//- the exact cardinality of the joins between any two predicates on
+//subject-subject, object-subject and object-object (up to
+//CHARSETS_MAX_PAIRS pairs).
+class CharacteristicSets {
+    public:
+        //Positions of the join variable in a triple pattern
+        enum Position { SUBJECT = 0, OBJECT = 2 };
+
+    private:
+        struct PredicateStats {
+            uint64_t triples;
+            uint64_t subjects;
+            uint64_t objects;
+            PredicateStats() : triples(0), subjects(0), objects(0) {}
+        };
+
+        struct CharSet {
+            uint64_t subjects;
+            //Sorted by predicate. The second field is the number of triples
+            std::vector<std::pair<uint64_t, uint64_t>> predicates;
+            CharSet() : subjects(0) {}
+        };
+
+        struct PairStats {
+            std::map<std::pair<uint64_t, uint64_t>, uint64_t> counts;
+            //Some pairs were not counted because the map was full
+            bool truncated;
+            PairStats() : truncated(false) {}
+
+            void add(const uint64_t p1, const uint64_t p2, const uint64_t v,
+                    const size_t maxPairs);
+        };
+
+        std::unordered_map<uint64_t, PredicateStats> predicates;
+        std::vector<CharSet> sets;
+        //The sets that were not stored, merged together
+        CharSet rest;
+        //Joins subject-subject and object-object (the first predicate is the
+        //smallest) and object-subject (the object of the first predicate is
+        //the subject of the second)
+        PairStats subjectSubject, objectSubject, objectObject;
+        //Were the objects counted? (it requires the OPS index)
+        bool hasObjects;
+
+        CharacteristicSets() : hasObjects(false) {}
+
+        static void writePairs(std::ostream &out, const PairStats &pairs);
+
+        static void readPairs(std::istream &in, PairStats &pairs);
+
+        static void writeSet(std::ostream &out, const CharSet &cs);
+
+        static void readSet(std::istream &in, CharSet &cs);
+
+        static double getSetCardinality(const CharSet &cs,
+                const std::vector<uint64_t> &preds);
+
+    public:
+        //Compute the statistics scanning the SPO (and OPS, if present)
+        //indices and store them in file
+        DDLEXPORT static void compute(Querier *q, std::string file,
+                size_t maxSets = CHARSETS_MAX,
+                size_t maxPairs = CHARSETS_MAX_PAIRS);
+
+        //NULL if the file does not exist
+        DDLEXPORT static std::unique_ptr<CharacteristicSets> load(
+                std::string file);
+
+        //Returns false if the predicate is unknown
+        DDLEXPORT bool getPredicateStats(const uint64_t p, uint64_t &triples,
+                uint64_t &subjects, uint64_t &objects) const;
+
+        //Number of results of the join between (?s1 p1 ?o1) and (?s2 p2 ?o2)
+        //on the given positions. Returns -1 if it cannot be estimated
+        DDLEXPORT double getJoinCardinality(const uint64_t p1,
+                const Position pos1,
+                const uint64_t p2,
+                const Position pos2) const;
+
+        //Number of results of a star of patterns (?s p ?o_i) with the given
+        //predicates. Returns -1 if it cannot be estimated
+        DDLEXPORT double getStarCardinality(
+                const std::vector<uint64_t> &preds) const;
+
+        size_t getNSets() const {
+            return sets.size();
+        }
+};
+
+#endif
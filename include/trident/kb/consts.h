@@ -69,6 +69,7 @@
 #define DIFF1_ITR 17
 #define RM_ITR 18
 #define RMCOMPOSITETERM_ITR 19
+#define MEMDIFF_ITR 20
 
 //Use for dynamic layout
 #define W_DIFFERENCE 0
@@ -88,12 +89,46 @@
 
 //StringBuffer block size
 #define SB_BLOCK_SIZE 65536
+//Number of shards of the cache of the uncompressed blocks
+#define SB_CACHE_SHARDS 16
+
+//Online updates
+//Number of triples kept in the in-memory delta before it is written as a diff
+#define UPDATES_MEM_MAXSIZE 1000000
+//Number of diffs of similar size that are compacted together
+#define UPDATES_COMPACTION_FANOUT 4
+//Microseconds the log waits for other writers before syncing a group commit
+#define UPDATES_WAL_GROUP_DELAY 200
+//Number of triples (or terms) the full merge reads between two checks of its rate
+#define UPDATES_MERGE_RATE_BATCH 10000
+
+//Streaming parser of the loader
+//Size of the blocks of complete lines passed from the readers to the parsers
+#define LOADER_STREAM_BLOCK_SIZE (8 * 1024 * 1024)
+//Plain files larger than this are split among several readers. Gzipped files
+//cannot be split, so each one is read by a single reader
+#define LOADER_STREAM_SPLIT_SIZE (256 * 1024 * 1024)
+//Number of blocks waiting to be parsed, per parsing thread
+#define LOADER_STREAM_QUEUED_BLOCKS 2
+//Number of shards of the table that assigns the IDs to the terms
+#define LOADER_STREAM_SHARDS 256
+//Fraction of the main memory the table of the terms can use. If the terms
+//need more, the loader stops and uses kognac instead
+#define LOADER_STREAM_TERMS_MEMORY 0.3
+//Estimated memory used by a term in the table, besides its characters
+#define LOADER_STREAM_TERM_OVERHEAD 64
+//Number of terms cached by every parsing thread
+#define LOADER_STREAM_CACHE_SIZE 65536
+//Number of triples a parsing thread encodes before it hands them off
+#define LOADER_STREAM_BATCH 65536
 
 //Generic options
 #define N_PARTITIONS 6
 #define THRESHOLD_KEEP_MEMORY 1000*1024
 
 #define MAX_N_FILES 4096
+//Number of slots (one per cache line) of the counters of the cache hits
+#define STATS_COUNTER_SHARDS 16
 
 //Used in the cache of the tree to serialize the nodes
 #define SIZE_SUPPORT_BUFFER 512 * 1024
@@ -103,6 +138,9 @@
 #define EMPTY_SESSION -2
 #define FREE_SESSION -3
 
+//Number of pairs copied at once by PairItr::nextBatch in the scans
+#define PAIRITR_BATCH_SIZE 1024
+
 //Size indices in the binary tables
 #define ADDITIONAL_SECOND_INDEX_SIZE 512
 #define FIRST_INDEX_SIZE 256
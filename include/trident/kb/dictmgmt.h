@@ -32,10 +32,13 @@
 
 #include <sparsehash/sparse_hash_map>
 #include <sparsehash/dense_hash_map>
+#include <vector>
+#include <string>
 
 class Root;
 class StringBuffer;
 class TreeItr;
+class StaticDict;
 
 #define DICTMGMT_INTEGER  UINT64_C(0x4000000000000000)
 #define DICTMGMT_FLOAT UINT64_C(0x8000000000000000)
@@ -89,6 +92,9 @@ class DictMgmt {
             std::shared_ptr<Root> dict;
             std::shared_ptr<Root> invdict;
             std::shared_ptr<StringBuffer> sb;
+            //Compact read-only copy of the dictionary. If it is set, it
+            //replaces dict, invdict and sb in the lookups
+            std::shared_ptr<StaticDict> sdict;
             int64_t size;
             int64_t nextid;
 
@@ -104,6 +110,7 @@ class DictMgmt {
                 invdict = std::shared_ptr<Root>();
                 LOG(DEBUGL) << "Deallocating sb ...";
                 sb = std::shared_ptr<StringBuffer>();
+                sdict = std::shared_ptr<StaticDict>();
                 LOG(DEBUGL) << "Deallocating stats ...";
                 stats = std::shared_ptr<Stats>();
             }
@@ -138,6 +145,8 @@ class DictMgmt {
         uint64_t gud_largestID;
         string gudLocation;
 
+        bool getTextFromDict(const int idx, nTerm key, char *value, int &size);
+
     public:
 
         DictMgmt(Dict mainDict, string dirToStoreGUD, bool hash, string e2r,
@@ -147,6 +156,9 @@ class DictMgmt {
 
         void putInUpdateDict(const uint64_t id, const char *term, const size_t len);
 
+        //Write the global update dictionary on disk, if it was modified
+        void saveUpdateDict();
+
         uint64_t getGUDSize() {
             return gud_idtext.size();
         }
@@ -181,6 +193,15 @@ class DictMgmt {
 
         LIBEXP bool getText(nTerm key, char *value, int &size);
 
+        //Translate many IDs at once. The keys do not need to be sorted and
+        //can contain duplicates. Every distinct key is searched only once,
+        //in ID order, and the strings are read in the order of their
+        //position in the string buffer, so that every block is
+        //decompressed at most once. values[i] and found[i] refer to keys[i]
+        LIBEXP void getTexts(const std::vector<nTerm> &keys,
+                std::vector<std::string> &values,
+                std::vector<bool> &found);
+
         void getTextFromCoordinates(int64_t coordinates, char *output,
                 int &sizeOutput);
 
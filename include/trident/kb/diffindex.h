@@ -35,6 +35,9 @@
 #include <kognac/factory.h>
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
 
 #define THRESHOLD_USEGLOBALFILES 1000000
 
@@ -42,6 +45,7 @@ class Querier;
 class Root;
 class StorageStrat;
 class DiffScanItr;
+class MemDiffItr;
 
 class RWMappedFile {
 private:
@@ -82,10 +86,18 @@ public:
 };
 
 
+//The pools of the iterators of a querier. The diffs are shared by all the
+//queriers, so every querier passes its own pools when it reads them
+struct DiffItrFactories {
+    StorageStrat *strat;
+    Factory<Diff1Itr> *diff1;
+    Factory<MemDiffItr> *mem;
+};
+
 class DiffIndex {
 public:
     enum TypeUpdate {ADDITION_df, DELETE_df };
-    enum ClassUpdate { DIFF1, DIFF3 };
+    enum ClassUpdate { DIFF1, DIFF3, MEM };
 
 private:
     const TypeUpdate type;
@@ -104,7 +116,8 @@ public:
     }
 
     virtual PairItr *getIterator(int idx, int64_t first, int64_t second, int64_t third,
-                                 int64_t &nfirstterms) = 0;
+                                 int64_t &nfirstterms,
+                                 const DiffItrFactories &factories) = 0;
 
     virtual int64_t getSize() const = 0;
 
@@ -124,6 +137,7 @@ public:
 
 class DiffIndex1 : public DiffIndex {
 private:
+    std::string dir;
     int64_t size;
     uint8_t nbytes;
     int64_t nkeys[3];
@@ -136,7 +150,6 @@ private:
     std::unique_ptr<ROMappedFile> values;
     std::unique_ptr<ROMappedFile> newpairs1;
     std::unique_ptr<ROMappedFile> newpairs2;
-    Factory<Diff1Itr> *factory;
 
     static int64_t outerJoin(PairItr *itr, std::vector<uint64_t> &values, string filenewkeys);
 
@@ -151,7 +164,8 @@ public:
     DiffIndex1(string dir, DiffIndex::TypeUpdate type);
 
     PairItr *getIterator(int idx, int64_t first, int64_t second, int64_t third,
-                         int64_t &nfirstterms);
+                         int64_t &nfirstterms,
+                         const DiffItrFactories &factories);
 
     int64_t getSize() const;
 
@@ -165,7 +179,9 @@ public:
 
     int64_t getNFirstTables(int idx);
 
-    void setFactoryIterators(Factory<Diff1Itr> *f);
+    std::string getDir() const {
+        return dir;
+    }
 
     static void createDiffIndex(string outputdir,
                                 bool dumpRawFormat,
@@ -205,7 +221,7 @@ private:
     std::unique_ptr<ROMappedFile> osp_f;
     Root *roots[6];
     const char *buffers[6];
-    StorageStrat *strat;
+    std::once_flag buffersLoaded[6];
     int64_t size;
 
     //Data structures to contain the unique keys. At the moment they are not used
@@ -276,6 +292,9 @@ private:
                             UpdateStats *stats,
                             const bool sort);
 
+    //The files of the tables are mapped the first time that they are read.
+    //Thread-safe, since the diff is shared by all the queriers
+    const char *getBuffer(int idx);
 
 public:
 
@@ -283,11 +302,13 @@ public:
                TypeUpdate type);
 
     PairItr *getIterator(int idx, int64_t first, int64_t second, int64_t third,
-                         int64_t &nfirstterms);
+                         int64_t &nfirstterms,
+                         const DiffItrFactories &factories);
 
-    PairItr *getIterator(int idx, int64_t key, TermCoordinates &coord);
+    PairItr *getIterator(int idx, int64_t key, TermCoordinates &coord,
+                         StorageStrat *strat);
 
-    PairItr *getScan(int idx, DiffScanItr *itr);
+    PairItr *getScan(int idx, DiffScanItr *itr, StorageStrat *strat);
 
     int64_t getSize() const;
 
@@ -301,8 +322,8 @@ public:
 
     int64_t getNFirstTables(int idx);
 
-    void setStorageStrat(StorageStrat *strat) {
-        this->strat = strat;
+    std::string getDir() const {
+        return dir;
     }
 
     DDLEXPORT static void createDiffIndex(DiffIndex::TypeUpdate type,
@@ -318,4 +339,69 @@ public:
     ~DiffIndex3();
 };
 
+//In-memory delta of the online updates. Every permutation is a sorted
+//array of rows (key, value1, value2). The arrays are never changed in place:
+//every update creates a new version, so the iterators returned before the
+//update keep reading the old one
+class DiffIndexMem : public DiffIndex {
+private:
+    struct Tables {
+        std::shared_ptr<const std::vector<uint64_t>> rows[6];
+        //The distinct keys of s, p and o, encoded with 8 bytes each
+        std::vector<char> keys[3];
+        int64_t nkeys[3];
+        int64_t nfirstterms[6];
+    };
+
+    std::shared_ptr<const Tables> tables;
+
+    static void rebuildStats(Tables &t);
+
+public:
+    DiffIndexMem(DiffIndex::TypeUpdate type);
+
+    //The copy shares the tables with the original. add() and remove() give
+    //new tables to the object they are called on, so the KB changes a copy
+    //and the queriers that use the original are not affected
+    DiffIndexMem(const DiffIndexMem &d) = default;
+
+    //The input is a sorted list of triples (s, p, o), stored flat
+    void add(const std::vector<uint64_t> &spo);
+
+    void remove(const std::vector<uint64_t> &spo);
+
+    bool contains(const uint64_t s, const uint64_t p, const uint64_t o) const;
+
+    void getTriples(std::vector<uint64_t> &all_s,
+                    std::vector<uint64_t> &all_p,
+                    std::vector<uint64_t> &all_o) const;
+
+    PairItr *getIterator(int idx, int64_t first, int64_t second, int64_t third,
+                         int64_t &nfirstterms,
+                         const DiffItrFactories &factories);
+
+    int64_t getSize() const;
+
+    int64_t getCard(int idx, int64_t first) const;
+
+    int64_t getNUniqueKeys(int idx);
+
+    void getTermListItr(int idx, DiffTermItr *itr);
+
+    int64_t getUniqueNFirstTerms(int idx);
+
+    int64_t getNFirstTables(int idx);
+};
+
+//A version of the stack of diffs of a KB. A version is never changed: the
+//updates publish a new one, and the diffs that are no longer in the stack
+//are deleted when the last querier that pinned them is gone
+struct DiffSnapshot {
+    uint64_t version;
+    std::vector<std::shared_ptr<DiffIndex>> diffs;
+
+    DiffSnapshot() : version(0) {
+    }
+};
+
 #endif
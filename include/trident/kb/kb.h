@@ -29,11 +29,17 @@
 #include <trident/kb/kbconfig.h>
 #include <trident/kb/cacheidx.h>
 #include <trident/kb/diffindex.h>
+#include <trident/kb/charsets.h>
+#include <trident/kb/updatelog.h>
 #include <trident/utils/memorymgr.h>
 
 #include <kognac/factory.h>
 
 #include <string>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 class Leaf;
 class Querier;
@@ -93,17 +99,114 @@ class KB {
         KB *sampleKB;
         KBConfig config;
 
-        //The data structures below handle updates
-        std::vector<std::unique_ptr<DiffIndex>> diffIndices;
+        //Statistics used by the SPARQL optimizer. NULL if not computed
+        std::unique_ptr<CharacteristicSets> charsets;
+
+        //The data structures below handle updates. diffIndices is the
+        //stack of diffs changed by the updates. The queriers use the last
+        //published copy (diffSnapshot), so the updates do not change the
+        //diffs under a running query
+        std::vector<std::shared_ptr<DiffIndex>> diffIndices;
+        std::shared_ptr<const DiffSnapshot> diffSnapshot;
+        //Diffs removed from the stack whose directory is deleted once no
+        //snapshot uses them
+        std::vector<std::pair<std::weak_ptr<DiffIndex>, string>> retiredDiffs;
         std::unique_ptr<ROMappedFile> spo_f;
         std::unique_ptr<ROMappedFile> sop_f;
         std::unique_ptr<ROMappedFile> pos_f;
         std::unique_ptr<ROMappedFile> pso_f;
         std::unique_ptr<ROMappedFile> ops_f;
         std::unique_ptr<ROMappedFile> osp_f;
+        std::vector<const char*> globalBuffers;
+
+        //In-memory delta of the online updates. When they are not NULL,
+        //they are also the last two elements of diffIndices. Every update
+        //replaces them with changed copies
+        DiffIndexMem *memAdd;
+        DiffIndexMem *memDel;
+
+        //Background compaction of the diffs. The thread only writes new
+        //diffs in _diff/compaction; they replace the compacted ones when the
+        //next update (or close) installs them. The thread reads the tree,
+        //the tables and the dictionary of the KB together with the queriers,
+        //so it runs in the background only if the build has MT. Otherwise
+        //the update that requests it waits for it
+        std::thread compactionThread;
+        std::atomic<bool> compactionDone;
+        bool compactionFailed;
+        std::vector<string> compactionTier;
+
+        //Log of the in-memory delta. It is opened at the first update and
+        //replayed when the KB is opened. The updates hold updateMutex while
+        //they change the delta, but wait for the log outside of it, so that
+        //concurrent updates share the same sync
+        std::unique_ptr<UpdateLog> updateLog;
+        std::mutex updateMutex;
+        bool replayingLog;
+
+        //Set while the diffs are merged into a new KB. The compaction of the
+        //diffs is suspended, so that the merged diffs stay as they are
+        std::atomic<bool> mergingBase;
+
+        //Shared lock on the file LOCK of the KB, held while the KB is open.
+        //The merged KB is installed only if no process holds it
+        int dirLock;
+
+        //Returns the descriptor of the locked file, -1 if the file cannot be
+        //created (e.g., the directory is read-only) and -2 if the lock is
+        //held by someone else
+        static int lockDirectory(string kbdir, const bool exclusive);
+
+        static void unlockDirectory(const int fd);
 
         void loadDict(KBConfig *config);
 
+        //Querier on a given version of the diffs
+        Querier *query(std::shared_ptr<const DiffSnapshot> diffs);
+
+        //Copy of diffIndices, which is not published
+        std::shared_ptr<const DiffSnapshot> getWorkingDiffs();
+
+        void publishDiffs();
+
+        void retireDiff(std::shared_ptr<DiffIndex> &diff);
+
+        void reclaimDiffs();
+
+        DiffIndex *openDiffIndex(string inputdir, const char **globalbuffers);
+
+        void updateTriples(DiffIndex::TypeUpdate type,
+                std::vector<uint64_t> &all_s,
+                std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o);
+
+        void applyUpdate(DiffIndex::TypeUpdate type,
+                std::vector<uint64_t> &all_s,
+                std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o);
+
+        void putNewTerms(const std::vector<std::pair<uint64_t, std::string>> &terms);
+
+        string getUpdateLogPath();
+
+        UpdateLog *getUpdateLog();
+
+        void replayUpdateLog();
+
+        void clearUpdateLog();
+
+        void writeMemUpdates();
+
+        void writeMemUpdate(DiffIndexMem *diff);
+
+        void requestCompaction();
+
+        void compact(std::vector<string> tier,
+                std::vector<DiffIndex::TypeUpdate> types,
+                std::vector<string> below);
+
+        void installCompaction(const bool wait);
+
         void createNewDict(std::string dir);
 
         void createSingleUpdate(DiffIndex::TypeUpdate type, PairItr *itr,
@@ -120,8 +223,17 @@ class KB {
         DDLEXPORT KB(const char *path, bool readOnly, bool reasoning,
                 bool dictEnabled, KBConfig &config, std::vector<string> locationUpdates);
 
+        //The querier pins the current version of the diffs
         DDLEXPORT Querier *query();
 
+        std::shared_ptr<const DiffSnapshot> getDiffSnapshot() {
+            return std::atomic_load(&diffSnapshot);
+        }
+
+        uint64_t getDiffVersion() {
+            return getDiffSnapshot()->version;
+        }
+
         DDLEXPORT Inserter *insert();
 
         DictMgmt *getDictMgmt() {
@@ -134,6 +246,55 @@ class KB {
 
         DDLEXPORT void mergeUpdates();
 
+        //Create a new KB in outputdir with the triples of this KB and of the
+        //diffs on disk (the "full merge"). It reads the KB with its own
+        //querier, so the queries and the online updates can continue in the
+        //meantime. The reads are limited to UPDATES_MERGE_RATE triples per
+        //second
+        DDLEXPORT void mergeIntoBase(std::string outputdir);
+
+        //Replace the KB in kbdir with the one created by mergeIntoBase. The
+        //updates that were not merged (the log and the diffs written in the
+        //meantime) are moved to the new KB. kbdir becomes a link to the
+        //directory of the current version (<kbdir>.v<N>), so that the new
+        //version replaces the old one with a single rename. No KB must be
+        //open on kbdir, also in other processes: the open KBs keep using the
+        //old version, so the method fails if it is in use. If the process
+        //stops during the swap, calling it again completes it
+        DDLEXPORT static void installMergedKB(std::string kbdir,
+                std::string mergeddir);
+
+        //True if the KB in kbdir is open, also by another process (e.g., a
+        //server)
+        DDLEXPORT static bool isInUse(std::string kbdir);
+
+        //Online updates. The triples are stored in memory and become
+        //visible to the queriers immediately. Once the memory delta is large
+        //enough (UPDATES_MEMSIZE) it is written as a diff on disk. If
+        //UPDATES_WAL is set, the methods return once the update is in the
+        //log. These methods cannot run concurrently with the queries
+        DDLEXPORT void addTriples(std::vector<uint64_t> &all_s,
+                std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o);
+
+        DDLEXPORT void removeTriples(std::vector<uint64_t> &all_s,
+                std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o);
+
+        //Write the in-memory delta on disk
+        DDLEXPORT void flushUpdates();
+
+        //Lock out the other updates. An update that gives IDs to new terms
+        //must hold the lock from the moment it reads the dictionary and
+        //getNextID() until it calls addNewTerms()
+        std::unique_lock<std::mutex> lockUpdates() {
+            return std::unique_lock<std::mutex>(updateMutex);
+        }
+
+        //Add terms (ID, text) to the dictionary of the updates and log them.
+        //The caller holds the lock returned by lockUpdates()
+        void addNewTerms(const std::vector<std::pair<uint64_t, std::string>> &terms);
+
         void closeMainDict();
 
         void close();
@@ -184,6 +345,13 @@ class KB {
             return sampleRate;
         }
 
+        //The statistics describe the KB as it was loaded, so they are not
+        //returned once there are updates
+        const CharacteristicSets *getCharacteristicSets() const {
+            return std::atomic_load(&diffSnapshot)->diffs.empty() ?
+                charsets.get() : NULL;
+        }
+
         int64_t getSize() {
             return totalNumberTriples;
         }
@@ -198,7 +366,7 @@ class KB {
 
         std::vector<const char*> openAllFiles(int perm);
 
-        void addDiffIndex(string inputdir, const char **globalbuffers, Querier *q);
+        void addDiffIndex(string inputdir, const char **globalbuffers);
 
         DDLEXPORT ~KB();
 };
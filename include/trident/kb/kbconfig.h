@@ -91,11 +91,21 @@ typedef enum {
     STORAGE_CACHE_SIZE,
     STORAGE_MAX_FILE_SIZE,
     STORAGE_MAX_N_FILES,
+    STORAGE_MMAP, //Map all the files once and read them directly (read-only KBs)
 
 //Parameters about the string buffer
     SB_COMPRESSDOMAINS,
     SB_PREALLBUFFERS,
-    SB_CACHESIZE
+    SB_CACHESIZE, //Size in bytes of the cache of the uncompressed blocks
+    SB_CACHESHARDS, //The cache is split in shards that can be accessed concurrently
+
+//Parameters about the online updates
+    UPDATES_MEMSIZE, //Max number of triples in the in-memory delta
+    UPDATES_COMPACTION, //Compact the diffs in background
+    UPDATES_WAL, //Log the in-memory delta so that it survives a restart
+    UPDATES_WAL_GROUPDELAY, //Microseconds to wait for other commits
+    UPDATES_MERGE_RATE, //Max triples per second read by the full merge (0 = no limit)
+    UPDATES_MERGE_THREADS //Threads used to build the merged KB
 
 } KBParam;
 
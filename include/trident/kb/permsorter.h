@@ -29,14 +29,16 @@
 #include <string>
 #include <vector>
 
+//Algorithms to sort the in-memory arrays of triples
+#define PERMSORTER_MERGESORT 0
+#define PERMSORTER_RADIXSORT 1
+
 class PermSorter {
     private:
-        static void writeTermInBuffer(char *buffer, const int64_t n);
+        static int sortEngine;
 
         static void write8TermInBuffer(char *buffer, const int64_t n);
 
-        static int64_t readTermFromBuffer(char *buffer);
-
         static int64_t read8TermFromBuffer(char *buffer);
 
         static void sortChunks_seq(const int idReader,
@@ -91,7 +93,42 @@ class PermSorter {
                 int currentPerm,
                 int nextPerm);
 
+        //Sort the loaded array and write a sorted chunk for every
+        //permutation. rawTriples2 is used to build the other permutations
+        static void sortChunks2_dump(
+                std::vector<std::pair<string, char>> &permutations,
+                char *rawTriples,
+                char *rawTriples2,
+                const size_t nloadedtriples,
+                const size_t nbytes,
+                const int round,
+                const int threadsToUse,
+                const int ioThreadsToUse,
+                const bool includeCount);
+
+        static void sortChunks2_permuteCopy(
+                char *start,
+                char *end,
+                char *output,
+                const size_t sizeTriple,
+                int currentPerm,
+                int nextPerm,
+                int nthreads);
+
     public:
+        //A triple in the in-memory arrays takes 15 bytes: every term is
+        //written with 5 bytes
+        static void writeTermInBuffer(char *buffer, const int64_t n);
+
+        static int64_t readTermFromBuffer(char *buffer);
+
+        //engine is either "merge" (parallel merge sort) or "radix"
+        static void setSortEngine(std::string engine);
+
+        //Sorts the same random arrays of ntriples with both engines and
+        //prints the time
+        static void benchmarkSort(int64_t ntriples, int nthreads);
+
         /*static void sortChunks(string inputdir,
                 int maxReadingThreads,
                 int parallelProcesses,
@@ -116,6 +153,15 @@ class PermSorter {
                 int64_t estimatedSize,
                 bool includeCount);
 
+        //Same as sortChunks2, but the (unsorted) triples are already in
+        //memory, so there are no input files to read. The array is changed
+        static void sortTriples(
+                std::vector<std::pair<string, char>> &permutations,
+                char *rawTriples,
+                const int64_t ntriples,
+                int maxReadingThreads,
+                int parallelProcesses);
+
         static void sortChunks2(
                 std::string input,
                 int permutation,
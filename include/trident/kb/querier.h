@@ -36,6 +36,7 @@
 #include <trident/iterators/compositescanitr.h>
 #include <trident/iterators/rmitr.h>
 #include <trident/iterators/rmcompositetermitr.h>
+#include <trident/iterators/memdiffitr.h>
 
 #include <trident/tree/coordinates.h>
 #include <trident/binarytables/storagestrat.h>
@@ -71,7 +72,10 @@ class Querier {
 
         // const int nindices;
 
-        std::vector<std::unique_ptr<DiffIndex>> &diffIndices;
+        //The diffs of the snapshot pinned by the querier. They are not
+        //deleted while the querier uses them
+        std::vector<std::shared_ptr<DiffIndex>> diffIndices;
+        uint64_t diffVersion;
         std::unique_ptr<Querier> sampler;
 
         TermCoordinates currentValue;
@@ -90,12 +94,14 @@ class Querier {
         Factory<Diff1Itr> factory13;
         Factory<RmItr> factory14;
         Factory<RmCompositeTermItr> factory15;
+        Factory<MemDiffItr> factory16;
 
         Factory<NewColumnTable> ncFactory;
         FactoryNewRowTable nrFactory;
         FactoryNewClusterTable ncluFactory;
 
         StorageStrat strat;
+        DiffItrFactories diffFactories;
 
         bool *present;
 
@@ -113,6 +119,8 @@ class Querier {
 
         PairItr *summaryDiff(const int perm, DiffIndex::TypeUpdate tp);
 
+        PairItr *getDiffScan(DiffIndex *diff, const int perm);
+
         PairItr *getIterator(const int idx, const int64_t s, const int64_t p,
                 const int64_t o, const bool cons);
 
@@ -138,9 +146,15 @@ class Querier {
                 const int64_t* nTablesPerPartition,
                 const int64_t* nFirstTablesPerPartition,
                 KB *sampleKB,
-                std::vector<std::unique_ptr<DiffIndex>> &diffIndices, bool *present);
+                std::shared_ptr<const DiffSnapshot> diffs, bool *present);
+
+        //Pin another version of the diffs. The querier must not have open
+        //iterators
+        void setDiffSnapshot(std::shared_ptr<const DiffSnapshot> diffs);
 
-        void initDiffIndex(DiffIndex *diff);
+        uint64_t getDiffVersion() const {
+            return diffVersion;
+        }
 
         TermItr *getKBTermList(const int perm, const bool enforcePerm);
 
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _QUERIER_POOL_H
+#define _QUERIER_POOL_H
+
+#include <trident/kb/consts.h>
+
+#include <vector>
+#include <mutex>
+
+class KB;
+class Querier;
+
+//A Querier keeps the state of the last lookup and the factories of its
+//iterators, so it cannot be shared among threads. The tree, the tables and
+//the dictionary it reads are shared by all the queriers of a KB. The pool
+//gives every thread its own querier and keeps the released ones (with their
+//factories already filled) for the next requests.
+class QuerierPool {
+    private:
+        KB &kb;
+        std::mutex mutex;
+        std::vector<Querier*> queriers;
+        size_t nCreated;
+
+    public:
+        DDLEXPORT QuerierPool(KB &kb);
+
+        //Returns a querier that no other thread is using
+        DDLEXPORT Querier *get();
+
+        //The querier must not be used afterwards. All its iterators must be
+        //already released
+        DDLEXPORT void release(Querier *q);
+
+        //Number of queriers created so far
+        size_t getNCreated() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return nCreated;
+        }
+
+        DDLEXPORT ~QuerierPool();
+};
+
+#endif
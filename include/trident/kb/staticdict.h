@@ -0,0 +1,198 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#ifndef _STATICDICT_H
+#define _STATICDICT_H
+
+#include <trident/kb/consts.h>
+
+#include <kognac/consts.h>
+
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <iostream>
+#include <inttypes.h>
+
+class DictMgmt;
+
+//Number of terms in a front-coded bucket
+#define STATICDICT_BUCKET 16
+
+//Compression of short strings with a table of at most 255 symbols of up to
+//8 bytes (FSST). The code 255 is followed by a byte that is not in the table
+class SymbolTable {
+    private:
+        uint64_t symbols[255];
+        uint8_t lengths[255];
+        int nsymbols;
+        //The codes of the symbols of every length. Used to compress
+        std::unordered_map<uint64_t, uint8_t> codes[9];
+
+        void index();
+
+        //Length of the longest symbol at the beginning of text (-1 if
+        //there is none)
+        int match(const char *text, int size, uint8_t &code) const;
+
+    public:
+        SymbolTable() : nsymbols(0) {}
+
+        //Build the table from a sample of the strings
+        void build(const std::vector<std::string> &sample);
+
+        void compress(const char *text, int size, std::string &out) const;
+
+        //Returns the number of bytes written in out
+        int decompress(const char *data, int size, char *out) const;
+
+        void write(std::ostream &out) const;
+
+        void read(std::istream &in);
+};
+
+//Minimal perfect hash function on 64-bit keys (BBHash). Every key of the set
+//is mapped to a distinct number in [0, n). Other keys are mapped to an
+//arbitrary number, so the caller must check the result
+class MinimalPerfectHash {
+    private:
+        //The bits of all levels, and the number of bits set before every
+        //block of 512 bits
+        std::vector<uint64_t> bits;
+        std::vector<uint64_t> ranks;
+        //Position in bits and size of every level
+        std::vector<std::pair<uint64_t, uint64_t>> levels;
+        //Keys that were not placed in any level, with their number
+        std::vector<std::pair<uint64_t, uint64_t>> leftovers;
+
+        static uint64_t hash(uint64_t key, size_t level);
+
+        uint64_t rank(uint64_t bit) const;
+
+    public:
+        //The keys must be distinct
+        void build(std::vector<uint64_t> &keys);
+
+        //Returns false if the key is certainly not in the set
+        bool lookup(uint64_t key, uint64_t &idx) const;
+
+        void write(std::ostream &out) const;
+
+        void read(std::istream &in);
+
+        size_t getMemoryUsage() const;
+};
+
+//Array of numbers stored with the minimum number of bytes
+class PackedArray {
+    private:
+        std::vector<char> data;
+        uint8_t width;
+
+    public:
+        PackedArray() : width(1) {}
+
+        void init(uint64_t size, uint64_t maxValue);
+
+        void set(uint64_t idx, uint64_t value);
+
+        uint64_t get(uint64_t idx) const;
+
+        uint64_t size() const {
+            return data.size() / width;
+        }
+
+        void write(std::ostream &out) const;
+
+        void read(std::istream &in);
+
+        size_t getMemoryUsage() const {
+            return data.size();
+        }
+};
+
+//Immutable dictionary for read-only KBs, built by the loader from the B+tree
+//dictionary. The terms are sorted and stored in front-coded buckets, whose
+//suffixes are compressed with a symbol table. A minimal perfect hash maps a
+//text to its position in the sorted order and a direct array maps every ID
+//to its position, so that no lookup needs to traverse a tree. It can be
+//used by several threads at the same time
+class StaticDict {
+    private:
+        uint64_t nterms;
+        SymbolTable symbols;
+        //The buckets
+        std::vector<char> data;
+        PackedArray bucketOffsets;
+        //ID of the term at every position
+        PackedArray posToId;
+        //Position of every ID. If the IDs are not dense, the sorted IDs are
+        //stored in ids and the positions refer to them
+        bool denseIds;
+        PackedArray ids;
+        PackedArray idToPos;
+        //Position of the terms in the order of the perfect hash
+        MinimalPerfectHash mphf;
+        PackedArray slotToPos;
+        //Terms whose hash is the same as the one of another term
+        std::unordered_map<std::string, uint64_t> collisions;
+
+        StaticDict() : nterms(0), denseIds(true) {}
+
+        static uint64_t hash(const char *text, int size);
+
+        //Returns the size of the term at position pos
+        int decode(uint64_t pos, char *text) const;
+
+        bool getPosition(nTerm id, uint64_t &pos) const;
+
+    public:
+        //Build the dictionary of all the terms of dict and store it in file.
+        //All the terms are first loaded in main memory as (text, ID) pairs,
+        //so this needs about the size of the uncompressed dictionary plus
+        //~40 bytes per term
+        DDLEXPORT static void build(DictMgmt *dict, std::string file);
+
+        //Build the dictionary of the given (text, ID) pairs. The pairs are
+        //sorted by text
+        DDLEXPORT static void build(
+                std::vector<std::pair<std::string, nTerm>> &terms,
+                std::string file);
+
+        //NULL if the file does not exist
+        DDLEXPORT static std::unique_ptr<StaticDict> load(std::string file);
+
+        //text must have room for MAX_TERM_SIZE bytes
+        DDLEXPORT bool getText(nTerm id, char *text, int &size) const;
+
+        DDLEXPORT bool getNumber(const char *text, int size, nTerm &id) const;
+
+        uint64_t getNTerms() const {
+            return nterms;
+        }
+
+        size_t getMemoryUsage() const;
+};
+
+#endif
@@ -23,14 +23,103 @@
 #ifndef _STATS_H
 #define _STATS_H
 
+#include <trident/kb/consts.h>
+
+#include <atomic>
+#include <inttypes.h>
+
+//Counter incremented by many threads on every access. Every thread
+//increments its own slot, which is on a separate cache line, and the slots
+//are summed when the counter is read
+class ShardedCounter {
+private:
+    struct Slot {
+        std::atomic<int64_t> value;
+        char padding[64 - sizeof(std::atomic<int64_t>)];
+    };
+    Slot slots[STATS_COUNTER_SHARDS];
+
+    static int getSlot() {
+        static std::atomic<int> nextSlot(0);
+        static thread_local int slot = nextSlot++ % STATS_COUNTER_SHARDS;
+        return slot;
+    }
+
+public:
+    ShardedCounter() {
+        set(0);
+    }
+
+    ShardedCounter(const ShardedCounter &o) {
+        set(o.get());
+    }
+
+    ShardedCounter &operator=(const ShardedCounter &o) {
+        set(o.get());
+        return *this;
+    }
+
+    void incr() {
+        slots[getSlot()].value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int64_t get() const {
+        int64_t sum = 0;
+        for (int i = 0; i < STATS_COUNTER_SHARDS; ++i) {
+            sum += slots[i].value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    void set(const int64_t value) {
+        slots[0].value.store(value, std::memory_order_relaxed);
+        for (int i = 1; i < STATS_COUNTER_SHARDS; ++i) {
+            slots[i].value.store(0, std::memory_order_relaxed);
+        }
+    }
+};
 
 class Stats {
 private:
     int64_t readIndexBlocks;
     int64_t readIndexBytes;
+
+    //Counters of the FileManager caches. They are updated by concurrent
+    //readers, so they are atomic. The hits happen on every access, so they
+    //are sharded
+    ShardedCounter fileHits;
+    std::atomic<int64_t> fileMisses;
+    std::atomic<int64_t> fileEvictions;
+    std::atomic<int64_t> fileWaitTime; //microseconds
+
+    //Counters of the cache of the uncompressed blocks of the string buffer
+    ShardedCounter blockHits;
+    std::atomic<int64_t> blockMisses;
+
 public:
 
-    Stats() : readIndexBlocks(0), readIndexBytes(0) {}
+    Stats() : readIndexBlocks(0), readIndexBytes(0), fileMisses(0),
+    fileEvictions(0), fileWaitTime(0), blockMisses(0) {}
+
+    Stats(const Stats &o) : readIndexBlocks(o.readIndexBlocks),
+    readIndexBytes(o.readIndexBytes), fileHits(o.fileHits),
+    fileMisses(o.fileMisses.load()),
+    fileEvictions(o.fileEvictions.load()),
+    fileWaitTime(o.fileWaitTime.load()),
+    blockHits(o.blockHits),
+    blockMisses(o.blockMisses.load()) {}
+
+    Stats &operator=(const Stats &o) {
+        readIndexBlocks = o.readIndexBlocks;
+        readIndexBytes = o.readIndexBytes;
+        fileHits = o.fileHits;
+        fileMisses = o.fileMisses.load();
+        fileEvictions = o.fileEvictions.load();
+        fileWaitTime = o.fileWaitTime.load();
+        blockHits = o.blockHits;
+        blockMisses = o.blockMisses.load();
+        return *this;
+    }
 
     void incrNReadIndexBlocks() {
         readIndexBlocks++;
@@ -47,6 +136,60 @@ public:
     uint64_t getNReadIndexBytes() const {
         return readIndexBytes;
     }
+
+    void incrNFileHits() {
+        fileHits.incr();
+    }
+
+    void incrNFileMisses() {
+        fileMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void incrNFileEvictions() {
+        fileEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void addFileWaitTime(const uint64_t micros) {
+        fileWaitTime.fetch_add(micros, std::memory_order_relaxed);
+    }
+
+    void incrNBlockHits() {
+        blockHits.incr();
+    }
+
+    void incrNBlockMisses() {
+        blockMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //Number of accesses to a file that was already opened
+    uint64_t getNFileHits() const {
+        return fileHits.get();
+    }
+
+    //Number of accesses that had to open the file
+    uint64_t getNFileMisses() const {
+        return fileMisses.load(std::memory_order_relaxed);
+    }
+
+    //Number of files closed to respect the maximum number of opened files
+    uint64_t getNFileEvictions() const {
+        return fileEvictions.load(std::memory_order_relaxed);
+    }
+
+    //Time (in microseconds) spent waiting for the lock of the file cache
+    uint64_t getFileWaitTime() const {
+        return fileWaitTime.load(std::memory_order_relaxed);
+    }
+
+    //Number of string buffer blocks found uncompressed in the cache
+    uint64_t getNBlockHits() const {
+        return blockHits.get();
+    }
+
+    //Number of string buffer blocks that had to be read and uncompressed
+    uint64_t getNBlockMisses() const {
+        return blockMisses.load(std::memory_order_relaxed);
+    }
 };
 
 #endif
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+#ifndef _UPDATE_LOG_H
+#define _UPDATE_LOG_H
+
+#include <trident/kb/consts.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+//Append-only log of the online updates that are still in memory. Every
+//record is a list of dictionary-encoded triples that are added or removed,
+//or a list of new terms of the global update dictionary. A record is
+//durable once commit() returns. Concurrent commits are grouped: one thread
+//writes and syncs the records of all the waiting threads at once. The log
+//is truncated when the in-memory delta is written as a diff on disk.
+class UpdateLog {
+    public:
+        typedef enum { ADD = 0, DEL = 1, TERMS = 2 } RecordType;
+
+        struct Record {
+            RecordType type;
+            //Flat list of (s, p, o) for ADD and DEL
+            std::vector<uint64_t> triples;
+            //New terms (ID, text) for TERMS
+            std::vector<std::pair<uint64_t, std::string>> terms;
+        };
+
+    private:
+        const std::string file;
+        const int64_t groupDelay; //Microseconds
+        int fd;
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::vector<char> pending;
+        uint64_t lastLSN; //Last appended record
+        uint64_t durableLSN; //Last record that is on disk
+        bool flushing;
+        //Set if a write or a sync failed. The end of the file is unknown,
+        //so no record can be made durable after that
+        bool failed;
+
+        uint64_t appendRecord(std::vector<char> &record);
+
+        static uint64_t checksum(const char *data, const size_t size);
+
+        static bool syncFile(const int fd);
+
+    public:
+        //Open the log for appending. Any incomplete record at the end of the
+        //file (e.g., after a crash) is removed
+        DDLEXPORT UpdateLog(std::string file, int64_t groupDelay);
+
+        DDLEXPORT uint64_t append(RecordType type,
+                const std::vector<uint64_t> &triples);
+
+        DDLEXPORT uint64_t appendTerms(
+                const std::vector<std::pair<uint64_t, std::string>> &terms);
+
+        //Wait until the record with the given sequence number is on disk.
+        //Throws if the log failed, now or in a previous commit
+        DDLEXPORT void commit(uint64_t lsn);
+
+        //Wait until all the appended records are on disk
+        DDLEXPORT void sync();
+
+        DDLEXPORT bool hasFailed();
+
+        //Remove all records. The changes they describe must be durable
+        //somewhere else
+        DDLEXPORT void truncate();
+
+        //Read all the valid records of the log in order. Returns the size of
+        //the valid part of the file
+        DDLEXPORT static int64_t replay(std::string file,
+                std::function<void(const Record&)> callback);
+
+        //Sync a file, or a directory with all its files and subdirectories.
+        //The directory that contains the path is not synced
+        DDLEXPORT static void syncPath(std::string path);
+
+        //Sync the entries of a directory, e.g., after a file in it was
+        //created or renamed. Its files are not synced
+        DDLEXPORT static void syncDirectory(std::string path);
+
+        DDLEXPORT ~UpdateLog();
+};
+
+#endif
@@ -75,6 +75,24 @@ class Updater {
             int leno;
         };
 
+        //Parse an update and convert its terms into IDs. The terms that are
+        //not in the dictionary of the KB get new IDs and are put in tmpdict
+        void encodeUpdate(DiffIndex::TypeUpdate type,
+                string updatedir,
+                KB *kb,
+                ByteArrayToNumberMap &tmpdict,
+                StringCollection &tmpdictsupport,
+                std::vector<Triple> &parsedtriples);
+
+        //Keep the triples that are not in the KB (ADD) or that are in the
+        //KB (DEL)
+        static void filterUpdate(DiffIndex::TypeUpdate type,
+                std::vector<Triple> &parsedtriples,
+                std::vector<uint64_t> &all_s,
+                std::vector<uint64_t> &all_p,
+                std::vector<uint64_t> &all_o,
+                Querier *q);
+
         void compressUpdate(DiffIndex::TypeUpdate type,
                 string updatedir,
                 std::vector<uint64_t> &all_s,
@@ -127,6 +145,17 @@ class Updater {
     public:
         LIBEXP void creatediffupdate(DiffIndex::TypeUpdate type, std::string kbdir, std::string updatedir);
 
+        //Apply the update to the in-memory delta of an open KB. The new
+        //terms are stored in the global dictionary of the updates. The
+        //update is durable once it is in the log of the KB
+        LIBEXP void update(DiffIndex::TypeUpdate type, KB &kb, std::string updatedir);
+
         LIBEXP static std::string getPathForUpdate(std::string kbdir);
+
+        //The diffs are stored in _diff/<seq>, or in _diff/<seq>-<gen> when
+        //a compaction replaced the diff <seq>. Returns false if the name is
+        //not the one of a diff
+        LIBEXP static bool parseDiffName(std::string name, int64_t &seq,
+                int64_t &gen);
 };
 #endif
@@ -37,6 +37,8 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <exception>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -201,9 +203,11 @@ class BufferCoordinates {
 };
 
 struct ParamsMergeDiskFragments {
-    ParamsMergeDiskFragments() {}
-    ParamsMergeDiskFragments(string i) : inputDir(i) {}
+    ParamsMergeDiskFragments() : nthreads(1) {}
+    ParamsMergeDiskFragments(string i, int n = 1) : inputDir(i), nthreads(n) {}
     string inputDir;
+    //Number of groups of files that are merged at the same time
+    int nthreads;
 };
 
 class SimpleTripleWriter;
@@ -405,6 +409,10 @@ struct ParamsLoad {
     bool storeDicts;
     bool relsOwnIDs;
     bool flatTree;
+    string sortEngine;
+    bool charsets;
+    bool staticDict;
+    string parser;
 
     ParamsLoad() {
         /**** DEFAULT VALUES ****/
@@ -437,6 +445,10 @@ struct ParamsLoad {
         storeDicts = true;
         relsOwnIDs = false;
         flatTree = false;
+        sortEngine = "radix";
+        charsets = true;
+        staticDict = false;
+        parser = "kognac";
     }
 
     std::string tostring() {
@@ -470,6 +482,10 @@ struct ParamsLoad {
         output += ";storeDicts=" + to_string(storeDicts);
         output += ";relsOwnIDs=" + to_string(relsOwnIDs);
         output += ";flatTree=" + to_string(flatTree);
+        output += ";sortEngine=" + sortEngine;
+        output += ";charsets=" + to_string(charsets);
+        output += ";staticDict=" + to_string(staticDict);
+        output += ";parser=" + parser;
         return output;
     }
 };
@@ -477,6 +493,10 @@ struct ParamsLoad {
 class Loader {
     private:
         bool printStats;
+        //Sorts the triples that the stream parser kept in memory
+        std::thread presorter;
+        //Error of the presorter, thrown again when it is joined
+        std::exception_ptr presorterError;
 
     public:
         static void generateNewPermutation(string outputdir,
@@ -514,8 +534,15 @@ class Loader {
                     string out,
                     char sorter);
 
+        static void mergeDiskFragments_seq(std::vector<string> filesToMerge,
+                string outputFile);
+
         static void mergeDiskFragments(ParamsMergeDiskFragments params);
 
+        static void mergeDiskFragments(
+                std::vector<std::pair<string, char>> &permutations,
+                int nthreads);
+
         static void insert(ParamInsert params);
 
         static void insertDictionary(const int part, DictMgmt *dict,
@@ -684,6 +711,33 @@ class Loader {
                 int maxReadingThreads,
                 int parallelProcesses);
 
+        //Parse the N-Triples files (also gzipped) with a pipeline of
+        //readers and parsers, which assign the IDs with a shared table.
+        //If the encoded triples fit in main memory, they are returned in
+        //inmemoryTriples. Otherwise, they are written in permDir. Returns
+        //-1 if the terms do not fit in LOADER_STREAM_TERMS_MEMORY
+        static int64_t parseAndEncode(
+                string inputtriples,
+                string permDir,
+                string fileNameDictionary,
+                int maxReadingThreads,
+                int parallelProcesses,
+                std::unique_ptr<char[]> &inmemoryTriples);
+
+        static std::vector<std::pair<string, char>> getPermutationsToSort(
+                string *permDirs,
+                const bool createIndicesInBlocks,
+                const bool aggrIndices,
+                const int nindices);
+
+        static void sortInMemory(
+                std::vector<std::pair<string, char>> permutations,
+                char *triples,
+                int64_t ntriples,
+                int maxReadingThreads,
+                int parallelProcesses,
+                std::exception_ptr *error);
+
         static int64_t parseSnapFile(
                 string inputtriples,
                 string inputdict,
@@ -709,6 +763,12 @@ class Loader {
             printStats = true;
         }
 
+        ~Loader() {
+            if (presorter.joinable()) {
+                presorter.join();
+            }
+        }
+
         LIBEXP void load(ParamsLoad p);
 
         void testLoadingTree(string inputdir, Inserter *ins, int nindices);
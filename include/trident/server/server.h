@@ -12,21 +12,52 @@
 #include <cts/parser/SPARQLParser.hpp>
 #include <rts/runtime/QueryDict.hpp>
 
+#include <trident/kb/querierpool.h>
+#include <trident/sparql/resultswriter.h>
+#include <cts/plangen/PlanCache.hpp>
+
 #include <map>
+#include <mutex>
+#include <atomic>
 
 using namespace std;
 
 class TridentServer {
     protected:
-        TridentLayer kb;
+        KB &kb;
+        //Every request gets its own TridentLayer with a querier of the
+        //pool, so that the threads of the webserver can answer queries in
+        //parallel
+        QuerierPool queriers;
+        //Plans of the queries answered so far, shared by all requests. The
+        //queries to the server are typically instances of a few templates
+        PlanCache plancache;
 
     private:
         string dirhtmlfiles;
         map<string, string> cachehtml;
+        std::mutex cachehtmlMutex;
         std::thread t;
         string cmdArgs;
 
-        bool isActive;
+        //Number of requests being processed
+        std::atomic<int> activeRequests;
+
+        //Counts a request as active while it is in scope, also if the
+        //request throws. Otherwise stop() would wait forever
+        class ActiveRequest {
+            private:
+                TridentServer &server;
+
+            public:
+                ActiveRequest(TridentServer &server) : server(server) {
+                    server.setActive();
+                }
+
+                ~ActiveRequest() {
+                    server.setInactive();
+                }
+        };
         int webport;
         std::shared_ptr<HttpServer> server;
         int nthreads;
@@ -35,6 +66,11 @@ class TridentServer {
 
         void processRequest(std::string req, std::string &resp);
 
+        //Streams the answers of the SPARQL queries. Returns false if the
+        //request should be answered by processRequest
+        bool processStreamRequest(const std::string &req,
+                HttpChunkedWriter &out);
+
     public:
         //OK
         TridentServer(KB &kb, string htmlfiles, int nthreads = 1);
@@ -56,12 +92,12 @@ class TridentServer {
 
         //OK
         void setActive() {
-            isActive = true;
+            activeRequests++;
         }
 
         //OK
         void setInactive() {
-            isActive = false;
+            activeRequests--;
         }
 
         //OK
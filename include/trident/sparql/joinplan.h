@@ -169,6 +169,49 @@ public:
     }
 };
 
+//A triple pattern as it is read by the Leapfrog Triejoin: the permutation
+//has first the constants and then the variables in the global order
+struct LeapfrogAtom {
+    int idx;
+    int64_t s, p, o;
+    int nconsts;
+    //Value of the second element of the permutation if it is a constant
+    int64_t secondConst;
+    int nvars;
+    //Position in the global order of the variables, in the order in which
+    //they appear in the permutation
+    int levels[2];
+};
+
+class LeapfrogJoinPlan {
+private:
+    static bool isKeyAvailable(Querier *q, int pos);
+
+    static int findPermutation(Querier *q, std::vector<int> &consts,
+                               std::vector<int> &vars);
+
+public:
+    //Global order of the variables
+    std::vector<string> vars;
+    std::vector<LeapfrogAtom> atoms;
+    //For every variable, the atoms that contain it
+    std::vector<std::vector<int>> atomsPerLevel;
+    std::vector<int> posVarsToReturn;
+
+    //True if the variables and the patterns with more than one variable
+    //form a cycle (triangles, cliques, or two patterns on the same pair of
+    //variables). These are the queries where the pairwise joins produce
+    //large intermediate results
+    static bool isCyclic(const std::vector<Pattern *> &patterns);
+
+    //Every pattern must have one or two distinct variables, and must be
+    //readable from a permutation that starts with one of its constants
+    static bool isApplicable(Querier *q, const std::vector<Pattern *> &patterns);
+
+    void prepare(Querier *q, std::vector<Pattern *> patterns,
+                 std::vector<string> projections);
+};
+
 class SPARQLOperator;
 class JoinPlan {
 private:
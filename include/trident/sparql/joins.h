@@ -172,4 +172,98 @@ class HashJoinItr : public TupleIterator {
 
         ~HashJoinItr();
 };
+
+//Trie on the values of one pattern, read from the permutation of the
+//LeapfrogAtom. Every level is a sorted column and seek() is a call to
+//PairItr::moveto. The keys must be sought in increasing order.
+class LeapfrogTrieItr {
+    private:
+        struct Level {
+            PairItr *itr;
+            //Last pair read from itr
+            int64_t v1, v2;
+            bool itrEnd;
+            int64_t key;
+            bool atEnd;
+        };
+
+        Querier *q;
+        const LeapfrogAtom *atom;
+        int depth;
+        Level levels[2];
+
+        bool fetch(Level &l);
+
+        void seekPair(Level &l, const int64_t c1, const int64_t c2);
+
+        //Position in the permutation of the current level
+        int getPos() const {
+            return atom->nconsts + depth;
+        }
+
+        //Value of the first element of the pairs on the last level
+        int64_t getGroup() const {
+            return atom->nconsts == 2 ? atom->secondConst : levels[0].key;
+        }
+
+    public:
+        LeapfrogTrieItr(Querier *q, const LeapfrogAtom *atom) : q(q),
+        atom(atom), depth(-1) {
+            levels[0].itr = levels[1].itr = NULL;
+        }
+
+        //Go one level down. On the last level, the pairs are read from a
+        //new iterator where the first variable is bound
+        void open();
+
+        void up();
+
+        void next();
+
+        void seek(const int64_t key);
+
+        int64_t key() const {
+            return levels[depth].key;
+        }
+
+        bool isAtEnd() const {
+            return levels[depth].atEnd;
+        }
+
+        ~LeapfrogTrieItr();
+};
+
+//Worst-case optimal join (Leapfrog Triejoin). The variables are bound one
+//at the time, following the global order of the plan, by intersecting the
+//tries of all the patterns that contain the variable.
+class LeapfrogJoinItr : public TupleIterator {
+    private:
+        std::shared_ptr<LeapfrogJoinPlan> plan;
+        std::vector<std::unique_ptr<LeapfrogTrieItr>> tries;
+        std::vector<std::vector<LeapfrogTrieItr*>> levels;
+        std::vector<size_t> p;
+        std::vector<int64_t> row;
+        int depth;
+        bool started, finished;
+        bool computed, hasMore;
+
+        bool leapfrogInit(const int level);
+
+        bool leapfrogSearch(const int level);
+
+        bool leapfrogNext(const int level);
+
+        bool computeNext();
+
+    public:
+        LeapfrogJoinItr(Querier *q, std::shared_ptr<LeapfrogJoinPlan> plan);
+
+        bool hasNext();
+
+        void next();
+
+        size_t getTupleSize();
+
+        uint64_t getElementAt(const int pos);
+};
 #endif
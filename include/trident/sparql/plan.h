@@ -32,6 +32,9 @@
 #define SIMPLE 0
 //#define BOTTOMUP 1
 #define NONE 2
+//Use the Leapfrog Triejoin whenever the patterns allow it. With SIMPLE it
+//is used only for cyclic queries
+#define LEAPFROG 3
 
 class Querier;
 //class Plan;
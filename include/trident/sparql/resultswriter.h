@@ -0,0 +1,100 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+#ifndef _RESULTS_WRITER_H
+#define _RESULTS_WRITER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <inttypes.h>
+
+//The text is passed to the sink every time the buffer exceeds this size
+#define RESULTSWRITER_BUFFER (64 * 1024)
+
+//Formats the answers of a SPARQL query one row at the time, using one of
+//the result formats of the SPARQL protocol (JSON, TSV or CSV). The text is
+//handed to a sink (e.g., a HTTP connection) as it is produced, so the
+//memory used does not depend on the number of answers.
+class ResultsWriter {
+    public:
+        typedef enum { JSONFORMAT, TSVFORMAT, CSVFORMAT } Format;
+
+    private:
+        const Format format;
+        //Returns false if the output can no longer be written
+        std::function<bool(const char*, size_t)> sink;
+        std::vector<std::string> vars;
+        std::vector<std::pair<std::string, std::string>> stats;
+        std::string buffer;
+        size_t currentColumn;
+        bool emptyRow;
+        uint64_t nrows;
+        bool failed;
+
+        void flush();
+
+        void appendJSONString(const std::string &s);
+
+        void appendCSVField(const std::string &s);
+
+    public:
+        ResultsWriter(Format format,
+                std::function<bool(const char*, size_t)> sink);
+
+        //Accepts "json", "tsv", "csv" or the corresponding MIME types
+        static Format getFormat(std::string name);
+
+        static std::string getContentType(Format format);
+
+        void begin(const std::vector<std::string> &vars);
+
+        //The term is written as in N-Triples, i.e., URIs are between angle
+        //brackets
+        void addTerm(const std::string &term);
+
+        void addUnbound();
+
+        void endRow();
+
+        //Add a field to the stats of the document. Only JSON has them
+        void addStat(const std::string &name, const std::string &value);
+
+        //Close the document. runtime is in seconds
+        void end(double runtime);
+
+        //Stop the document after an error. The text written so far is
+        //followed by a line with the error, and the document is not closed,
+        //so it cannot be mistaken for a complete answer
+        void fail(const std::string &message);
+
+        //True if the sink has refused the output (e.g., the client has
+        //closed the connection). The query can be stopped.
+        bool isFailed() const {
+            return failed;
+        }
+
+        uint64_t getNRows() const {
+            return nrows;
+        }
+};
+
+#endif
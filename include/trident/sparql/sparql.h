@@ -2,11 +2,13 @@
 #define _SPARQL_H
 
 #include <trident/utils/json.h>
+#include <trident/sparql/resultswriter.h>
 
 #include <layers/TridentLayer.hpp>
 #include <cts/infra/QueryGraph.hpp>
 #include <cts/parser/SPARQLParser.hpp>
 #include <rts/runtime/QueryDict.hpp>
+#include <cts/plangen/PlanCache.hpp>
 
 class SPARQLUtils {
     public:
@@ -24,7 +26,9 @@ class SPARQLUtils {
                 bool jsonoutput,
                 JSON *jsonvars,
                 JSON *jsonresults,
-                JSON *jsonstats);
+                JSON *jsonstats,
+                ResultsWriter *writer = NULL,
+                PlanCache *plancache = NULL);
 };
 
 #endif
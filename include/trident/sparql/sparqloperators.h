@@ -35,7 +35,7 @@
 #include <inttypes.h>
 #include <vector>
 
-typedef enum { SCAN, NESTEDMERGEJOIN, HASHJOIN } Op;
+typedef enum { SCAN, NESTEDMERGEJOIN, HASHJOIN, LEAPFROGJOIN } Op;
 class SPARQLOperator {
 public:
 
@@ -140,6 +140,27 @@ public:
     void print(int indent);
 };
 
+class LeapfrogJoin : public Join {
+private:
+    Querier *q;
+    std::shared_ptr<LeapfrogJoinPlan> leapfrogPlan;
+
+public:
+    LeapfrogJoin(Querier *q,
+                 std::vector<std::shared_ptr<SPARQLOperator>> children,
+                 std::vector<string> &projections);
+
+    Op getType() {
+        return LEAPFROGJOIN;
+    }
+
+    TupleIterator *getIterator();
+
+    void releaseIterator(TupleIterator *itr);
+
+    void print(int indent);
+};
+
 class Scan : public SPARQLOperator {
 private:
     std::vector<string> fields;
@@ -181,6 +202,15 @@ public:
 
     TupleIterator *getIterator();
 
+    //The scan skips the values that cannot join with the values of the
+    //other side of the join
+    bool doesSupportsSideways() {
+        return true;
+    }
+
+    TupleIterator *getIterator(std::vector<uint8_t> &positions,
+                               std::vector<uint64_t> &values);
+
     int64_t estimateCost();
 
     TupleIterator *getSampleIterator();
@@ -25,7 +25,9 @@
 
 #include <trident/iterators/tupleiterators.h>
 #include <trident/iterators/pairitr.h>
+#include <rts/runtime/JoinFilter.hpp>
 #include <vector>
+#include <memory>
 
 class Tuple;
 class Querier;
@@ -46,8 +48,23 @@ private:
     bool nextOutcome;
     size_t processedValues;
 
+    //Pairs fetched from the physical iterator with nextBatch()
+    std::unique_ptr<int64_t[]> batchValues1;
+    std::unique_ptr<int64_t[]> batchValues2;
+    size_t batchSize, batchPos;
+
+    //Filter of the values that can join (sideways information passing)
+    std::unique_ptr<JoinFilter> joinFilter;
+    uint8_t joinFilterPos; //Position in the physical iterator
+    bool constantKey;
+
     bool checkFields();
 
+    //Move to the first pair that passes the join filter
+    bool skipFiltered();
+
+    bool advance();
+
 public:
     TupleKBItr();
 
@@ -67,6 +84,10 @@ public:
     void init(Querier *querier, const Tuple *literal,
               const std::vector<uint8_t> *fieldsToSort, bool onlyVars);
 
+    //Return only the tuples whose value at the position of the pattern
+    //passes the filter. It must be called after init()
+    void setJoinFilter(std::unique_ptr<JoinFilter> filter, const uint8_t pos);
+
     bool hasNext();
 
     void next();
@@ -79,6 +79,10 @@ public:
             int64_t &c,
             int64_t &junk);
 
+    //Measures the cost of moveto() when the target is 1, 4, ..., 4096
+    //pairs ahead of the current position, on the queries with two variables
+    LIBEXP void launchMovetoTests(string filequeries);
+
     ~TridentTimings() {
         if (q != NULL)
             delete q;
@@ -29,6 +29,7 @@
 #include <trident/utils/propertymap.h>
 
 #include <string>
+#include <vector>
 
 class Node;
 class TreeContext;
@@ -109,6 +110,12 @@ class Root {
 
         bool get(nTerm key, int64_t &coordinates);
 
+        //Lookup of many keys at once. The keys must be sorted: the leaf of
+        //the previous key is reused as long as it contains the next one.
+        //Returns the number of keys that were found
+        size_t get(const std::vector<nTerm> &keys,
+                std::vector<int64_t> &coordinates, std::vector<bool> &found);
+
 };
 
 #endif /* ROOT_H_ */
@@ -36,6 +36,10 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
 #include <condition_variable>
 
 struct eqint {
@@ -57,7 +61,6 @@ private:
     Stats *stats;
     std::string dir;
 
-    char uncompressSupportBuffer[SB_BLOCK_SIZE * 2];
     char termSupportBuffer[MAX_TERM_SIZE];
 
     PreallocatedStratArraysFactory<char> factory;
@@ -94,32 +97,53 @@ private:
     int entriesSinceBaseEntry;
     int nMatchedChars;
 
-    //Cache
+    //Cache used while the buffer is written
     std::vector<std::pair<int, int>> cacheVector;
     int firstBlockInCache, lastBlockInCache;
 
     int elementsInCache;
     const int maxElementsInCache;
 
+    //Cache used if the buffer is read-only. The blocks are distributed over
+    //several shards, each with its own lock and LRU list, so that
+    //concurrent readers do not wait for each other. A reader keeps a
+    //reference to the blocks it is using, so that they can be evicted while
+    //they are read
+    typedef std::shared_ptr<char> BlockPtr;
+    struct CacheShard {
+        std::mutex lock;
+        //The most recently used blocks are at the front
+        std::list<int> lru;
+        std::unordered_map<int, std::pair<BlockPtr,
+            std::list<int>::iterator>> blocks;
+        size_t capacity;
+    };
+    std::unique_ptr<CacheShard[]> shards;
+    const int nshards;
+
     void addCache(int idx);
     void compressBlocks();
     void compressLastBlock();
-    void uncompressBlock(int b);
+    void uncompressBlock(int b, char *output);
+
+    //Return the block. If the buffer is read-only, pin keeps the block in
+    //memory as long as it is used
+    char *getBlock(int idxBlock, BlockPtr &pin);
 
-    char *getBlock(int idxBlock);
+    char *getSharedBlock(int idxBlock, BlockPtr &pin);
 
-    int getFlag(int &blockId, char *&block, int &offset) {
+    int getFlag(int &blockId, char *&block, BlockPtr &pin, int &offset) {
         if (offset < SB_BLOCK_SIZE) {
             return block[offset++];
         } else {
             blockId++;
-            block = getBlock(blockId);
+            block = getBlock(blockId, pin);
             offset = 1;
             return block[0];
         }
     }
 
-    int getVInt(int &blockId, char *&block, int &offset);
+    int getVInt(int &blockId, char *&block, BlockPtr &pin, int &offset);
 
     void writeVInt(int n);
 
@@ -129,14 +153,19 @@ private:
 
 public:
     StringBuffer(string dir, bool readOnly, int factorySize, int64_t cacheSize,
-                 Stats *stats);
+                 Stats *stats, int cacheShards = SB_CACHE_SHARDS);
 
     int64_t getSize();
 
     void append(char *string, int size);
 
+    //Copy the string in outputBuffer, which must have room for
+    //MAX_TERM_SIZE bytes. If the buffer is read-only, it can be called by
+    //several threads at the same time
     void get(int64_t pos, char* outputBuffer, int &size);
 
+    //Return the string in an internal buffer, which is overwritten by the
+    //next call. Not thread-safe
     char* get(int64_t pos, int &size);
 
     int cmp(int64_t pos, char *string, int sizeString);
@@ -5,6 +5,8 @@
 
 #include <string>
 #include <thread>
+#include <functional>
+#include <atomic>
 #include <inttypes.h>
 
 #if defined(__unix__) || defined(__unix) || defined(unix) || (defined(__APPLE__) && defined(__MACH__))
@@ -16,64 +18,113 @@
 #include <fcntl.h>
 #include <strings.h>
 
-class HttpServer {
+//Size of the chunks sent by HttpChunkedWriter
+#define HTTP_CHUNK_SIZE (64 * 1024)
+
+//Sends a response with the chunked transfer encoding, so that its length
+//does not need to be known in advance. The data is buffered and sent every
+//HTTP_CHUNK_SIZE bytes.
+class HttpChunkedWriter {
     private:
-        class Socket {
-            private:
-                int connFd;
-                bool eof;
-                bool toBeClosed;
+        const int connFd;
+        std::string buffer;
+        bool failed;
+
+        bool sendAll(const char *data, size_t len);
 
-            public:
-                Socket(int connFd) : connFd(connFd), eof(false), toBeClosed(false) {
-                }
+        void sendChunk();
 
-                Socket() : connFd(-1), eof(true) {}
+    public:
+        HttpChunkedWriter(int connFd) : connFd(connFd), failed(false) {
+        }
 
-                int getFD() const {
-                    return connFd;
-                }
+        //Send the status line and the headers
+        void begin(std::string contentType);
 
-                bool shouldBeClosed() const {
-                    return toBeClosed;
-                }
+        //Returns false if the client is no longer reachable
+        bool write(const char *data, size_t len);
 
-                void close() {
-                    toBeClosed = true;
-                }
+        //Send the last chunk
+        void end();
+
+        //Send the data written so far but not the last chunk, so that the
+        //client sees an incomplete response. The connection must be closed
+        void abort();
+
+        bool isFailed() const {
+            return failed;
+        }
+};
 
-                bool isEOF() const {
-                    return eof;
-                }
+class HttpServer {
+    private:
+        //A client connection. It belongs to the event loop, except while a
+        //worker is answering its requests (busy)
+        struct Connection {
+            int fd;
+            //Data received but not yet processed. It can contain several
+            //pipelined requests
+            std::string input;
+            uint64_t lastActive;
+            bool busy;
+            bool toBeClosed;
+
+            Connection(int fd, uint64_t time) : fd(fd), lastActive(time),
+            busy(false), toBeClosed(false) {
+            }
         };
 
         uint32_t port;
-        bool launched;
+        std::atomic<bool> launched;
+        std::atomic<bool> stopRequested;
         uint64_t maxLifeConn;
 
         int listenFd;
+        //The workers write on this pipe to wake up the event loop
+        int wakeFds[2];
         struct sockaddr_in svrAdd, clntAdd;
-        ConcurrentQueue<Socket> queueReady;
+
+        //Connections with complete requests, waiting for a worker. A
+        //connection is queued at most once, so the queue is bounded by the
+        //number of connections
+        ConcurrentQueue<Connection*> queueReady;
+        //Connections whose requests have been answered
+        ConcurrentQueue<Connection*> queueDone;
         std::vector<std::thread> threads;
         std::function<void(const std::string&, std::string&)> handlerFunction;
-
-        ConcurrentQueue<Socket> queueWait;
-        std::thread threadWait;
+        //If set, it is tried first (except for HTTP/1.0 requests). It returns
+        //true if it has written the response itself
+        std::function<bool(const std::string&, HttpChunkedWriter&)> streamHandler;
 
         bool listn();
 
-        void processSocket();
+        //Accept the connections, read the requests and pass the
+        //connections to the workers
+        void eventLoop();
 
-        void waitForData();
+        //Body of the worker threads
+        void processConnections();
 
-        uint64_t getMessageBodyLength(std::string& request);
+        void processRequest(Connection *c, const std::string &request);
+
+        //Move the first complete request of input in request. Returns
+        //false if input does not contain a complete request
+        static bool nextRequest(std::string &input, std::string &request);
+
+        static uint64_t getMessageBodyLength(const std::string& request);
 
     public:
         HttpServer(uint32_t port,
                 std::function<void(const std::string&, std::string&)> handler,
                 uint32_t nthreads = 1,
-                uint64_t maxLifeConn = 7000); //after one second, connections are closed
+                uint64_t maxLifeConn = 7000); //after seven seconds idle connections are closed
+
+        void setStreamHandler(std::function<bool(const std::string&,
+                    HttpChunkedWriter&)> handler) {
+            streamHandler = handler;
+        }
 
+        //Blocks until stop() is called
         void start();
 
         void stop();
@@ -19,6 +19,12 @@
 #include <sys/stat.h>
 #endif
 
+//Access patterns that can be passed to MemoryMappedFile::advise
+#define MMAP_ADVICE_NORMAL 0
+#define MMAP_ADVICE_RANDOM 1
+#define MMAP_ADVICE_SEQUENTIAL 2
+#define MMAP_ADVICE_WILLNEED 3
+
 class MemoryMappedFile {
     private: 
 #if defined(_WIN32)
@@ -134,6 +140,36 @@ class MemoryMappedFile {
 #endif
         }
 
+        //Tell the OS how the range [begin, begin + len) will be read.
+        //It is only a hint: it is ignored on Windows and errors are only
+        //logged.
+        void advise(size_t begin, size_t len, int advice) {
+#if defined(__unix__) || defined(__unix) || defined(unix) || (defined(__APPLE__) && defined(__MACH__))
+            //madvise wants an address aligned to the page
+            const size_t offset = begin % alignment();
+            begin -= offset;
+            len += offset;
+            if (begin + len > length) {
+                len = length - begin;
+            }
+            int a = MADV_NORMAL;
+            switch (advice) {
+                case MMAP_ADVICE_RANDOM:
+                    a = MADV_RANDOM;
+                    break;
+                case MMAP_ADVICE_SEQUENTIAL:
+                    a = MADV_SEQUENTIAL;
+                    break;
+                case MMAP_ADVICE_WILLNEED:
+                    a = MADV_WILLNEED;
+                    break;
+            }
+            if (madvise(data + begin, len, a) != 0) {
+                LOG(DEBUGL) << "madvise failed on a mapped file";
+            }
+#endif
+        }
+
         void flush(off_t begin, size_t len) {
 #if defined(_WIN32)
 			if (!FlushViewOfFile(data + begin, len)) {
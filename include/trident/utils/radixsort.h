@@ -0,0 +1,216 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+#ifndef _RADIXSORT_H
+#define _RADIXSORT_H
+
+#include <trident/kb/consts.h>
+
+#include <array>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+
+//Below this number of records a bucket is sorted with std::sort
+#define RADIXSORT_SMALL 64
+//Below this number of records a range is sorted by a single thread
+#define RADIXSORT_PARALLEL_MIN 65536
+
+//MSD radix sort on fixed-width records, compared byte by byte like the
+//operator< of std::array. The permutations store every term in big-endian
+//order, so this is the same order given by the comparison sort. Each range
+//is partitioned in place on the first byte where its records differ
+//(American flag sort), so no extra memory is needed.
+class RadixSort {
+    private:
+        //Fill counts with the histogram of the first byte (from byte on)
+        //on which the records differ. Returns that byte, or N if all the
+        //records are equal
+        template<size_t N>
+            static size_t findByte(const std::array<unsigned char, N> *begin,
+                    const std::array<unsigned char, N> *end,
+                    size_t byte,
+                    size_t *counts) {
+                const size_t n = end - begin;
+                for(; byte < N; ++byte) {
+                    memset(counts, 0, sizeof(size_t) * 256);
+                    for(const std::array<unsigned char, N> *r = begin; r < end; ++r) {
+                        counts[(*r)[byte]]++;
+                    }
+                    if (counts[begin[0][byte]] != n) {
+                        break;
+                    }
+                }
+                return byte;
+            }
+
+        template<size_t N>
+            static size_t findByte_par(const std::array<unsigned char, N> *begin,
+                    const std::array<unsigned char, N> *end,
+                    size_t byte,
+                    size_t *counts,
+                    const int nthreads) {
+                const size_t n = end - begin;
+                const size_t chunk = (n + nthreads - 1) / nthreads;
+                std::vector<std::array<size_t, 256>> partialCounts(nthreads);
+                std::vector<std::thread> threads(nthreads);
+                for(; byte < N; ++byte) {
+                    for(int i = 0; i < nthreads; ++i) {
+                        const std::array<unsigned char, N> *s = begin + std::min(n, i * chunk);
+                        const std::array<unsigned char, N> *e = begin + std::min(n, (i + 1) * chunk);
+                        size_t *c = partialCounts[i].data();
+                        threads[i] = std::thread([s, e, c, byte]() {
+                                memset(c, 0, sizeof(size_t) * 256);
+                                for(const std::array<unsigned char, N> *r = s; r < e; ++r) {
+                                c[(*r)[byte]]++;
+                                }
+                                });
+                    }
+                    for(int i = 0; i < nthreads; ++i) {
+                        threads[i].join();
+                    }
+                    memset(counts, 0, sizeof(size_t) * 256);
+                    for(int i = 0; i < nthreads; ++i) {
+                        for(int j = 0; j < 256; ++j) {
+                            counts[j] += partialCounts[i][j];
+                        }
+                    }
+                    if (counts[begin[0][byte]] != n) {
+                        break;
+                    }
+                }
+                return byte;
+            }
+
+        //Move every record to the bucket of its byte
+        template<size_t N>
+            static void partition(std::array<unsigned char, N> *begin,
+                    const size_t byte,
+                    const size_t *counts) {
+                size_t heads[256];
+                size_t tails[256];
+                size_t s = 0;
+                for(int i = 0; i < 256; ++i) {
+                    heads[i] = s;
+                    s += counts[i];
+                    tails[i] = s;
+                }
+                for(int i = 0; i < 256; ++i) {
+                    while (heads[i] < tails[i]) {
+                        const unsigned char d = begin[heads[i]][byte];
+                        if (d == i) {
+                            heads[i]++;
+                        } else {
+                            std::swap(begin[heads[i]], begin[heads[d]++]);
+                        }
+                    }
+                }
+            }
+
+        template<size_t N>
+            static void sort_seq(std::array<unsigned char, N> *begin,
+                    std::array<unsigned char, N> *end,
+                    size_t byte) {
+                if (end - begin <= RADIXSORT_SMALL) {
+                    std::sort(begin, end);
+                    return;
+                }
+                size_t counts[256];
+                byte = findByte(begin, end, byte, counts);
+                if (byte == N) {
+                    return;
+                }
+                partition(begin, byte, counts);
+                std::array<unsigned char, N> *b = begin;
+                for(int i = 0; i < 256; ++i) {
+                    if (counts[i] > 1) {
+                        sort_seq(b, b + counts[i], byte + 1);
+                    }
+                    b += counts[i];
+                }
+            }
+
+        template<size_t N>
+            static void sort_par(std::array<unsigned char, N> *begin,
+                    std::array<unsigned char, N> *end,
+                    size_t byte,
+                    const int nthreads) {
+                const size_t n = end - begin;
+                if (nthreads < 2 || n <= RADIXSORT_PARALLEL_MIN) {
+                    sort_seq(begin, end, byte);
+                    return;
+                }
+                size_t counts[256];
+                byte = findByte_par(begin, end, byte, counts, nthreads);
+                if (byte == N) {
+                    return;
+                }
+                partition(begin, byte, counts);
+
+                //Buckets larger than a thread's share are split again with
+                //all the threads. The others are taken by the threads
+                //starting from the largest one
+                std::vector<std::pair<size_t, size_t>> buckets;
+                size_t s = 0;
+                for(int i = 0; i < 256; ++i) {
+                    if (counts[i] > n / nthreads) {
+                        sort_par(begin + s, begin + s + counts[i], byte + 1,
+                                nthreads);
+                    } else if (counts[i] > 1) {
+                        buckets.push_back(std::make_pair(s, counts[i]));
+                    }
+                    s += counts[i];
+                }
+                std::sort(buckets.begin(), buckets.end(),
+                        [](const std::pair<size_t, size_t> &a,
+                            const std::pair<size_t, size_t> &b) {
+                        return a.second > b.second;
+                        });
+                std::atomic<size_t> next(0);
+                auto worker = [&]() {
+                    size_t idx;
+                    while ((idx = next++) < buckets.size()) {
+                        std::array<unsigned char, N> *b = begin + buckets[idx].first;
+                        sort_seq(b, b + buckets[idx].second, byte + 1);
+                    }
+                };
+                std::vector<std::thread> threads;
+                for(int i = 1; i < nthreads; ++i) {
+                    threads.push_back(std::thread(worker));
+                }
+                worker();
+                for(auto &t : threads) {
+                    t.join();
+                }
+            }
+
+    public:
+        template<size_t N>
+            static void sort(std::array<unsigned char, N> *begin,
+                    std::array<unsigned char, N> *end,
+                    int nthreads) {
+                sort_par(begin, end, 0, nthreads);
+            }
+};
+
+#endif
@@ -33,10 +33,15 @@ class CodeGen
 
         /// Collect all variables contained in a plan
         static void collectVariables(std::set<unsigned>& variables,Plan* plan);
-        /// Translate an execution plan into an operator tree without output generation
-        static Operator* translateIntern(Runtime& runtime, const QueryGraph& query, Plan* plan, std::vector<Register*>& output, const std::map<const QueryGraph::Node*, unsigned> &registers);
+        /// Translate an execution plan into an operator tree without output generation.
+        /// If workers are given, the main pipeline is executed in parallel (one
+        /// thread per layer) when its driving scans can be split in morsels
+        static Operator* translateIntern(Runtime& runtime, const QueryGraph& query, Plan* plan, std::vector<Register*>& output, const std::map<const QueryGraph::Node*, unsigned> &registers, const std::vector<DBLayer*>* workers = 0);
         /// Translate an execution plan into an operator tree
         SLIBEXP static Operator* translate(Runtime& runtime,const QueryGraph& query,Plan* plan, bool silent=false);
+        /// Translate an execution plan into an operator tree that can use the
+        /// layers of the workers. Every layer is used by a single thread
+        SLIBEXP static Operator* translate(Runtime& runtime,const QueryGraph& query,Plan* plan, const std::vector<DBLayer*>& workers, bool silent=false);
 };
 //---------------------------------------------------------------------------
 #endif
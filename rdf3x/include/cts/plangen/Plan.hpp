@@ -42,6 +42,8 @@ struct Plan
     unsigned ordering;
     // is optional
     bool optional;
+    /// Is the scan split in morsels? (parallel execution only)
+    bool morsel;
     /// QueryGraph associated (used for minus)
     std::shared_ptr<QueryGraph> subquery;
 
@@ -53,6 +55,7 @@ struct Plan
 
     void init() {
         optional = false;
+        morsel = false;
         subquery = NULL;
     }
 
@@ -0,0 +1,92 @@
+#ifndef H_cts_plangen_PlanCache
+#define H_cts_plangen_PlanCache
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <cts/plangen/Plan.hpp>
+#include <cts/plangen/PlanGen.hpp>
+#include <cts/infra/QueryGraph.hpp>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+//---------------------------------------------------------------------------
+/// Default number of plans kept by the cache
+#define PLANCACHE_SIZE 1024
+//---------------------------------------------------------------------------
+/// A cache of the plans of the queries with the same shape, i.e., the queries
+/// that differ only in the constants in the subjects and the objects of
+/// their patterns and in their filters. A cached plan is copied and bound to
+/// the nodes and filters of the new query, so the constants are taken from
+/// the new query when the plan is translated into an operator tree.
+/// Only the basic graph patterns with filters are cached.
+class PlanCache {
+    private:
+        /// A cached plan
+        struct Entry {
+            /// The shape
+            std::string key;
+            /// The query the plan was generated for
+            std::unique_ptr<QueryGraph> query;
+            /// The plan generator. It owns the plans
+            std::unique_ptr<PlanGen> plangen;
+            /// The plan
+            Plan* plan;
+        };
+
+        /// Protects the entries
+        std::mutex entriesMutex;
+        /// The entries, the most recently used first
+        std::list<std::shared_ptr<Entry> > entries;
+        /// The entries by key
+        std::unordered_map<std::string, std::list<std::shared_ptr<Entry> >::iterator> index;
+        /// The maximum number of entries
+        const size_t capacity;
+        /// Statistics
+        std::atomic<uint64_t> hits, misses;
+
+        /// Copy a plan, replacing the nodes and filters of a query with the ones of another query
+        static Plan* copyPlan(const Plan* plan, const QueryGraph::SubQuery& from, const QueryGraph::SubQuery& to, PlanContainer& plans);
+
+        PlanCache(const PlanCache&);
+        void operator=(const PlanCache&);
+
+    public:
+        /// Constructor
+        SLIBEXP PlanCache(size_t capacity = PLANCACHE_SIZE);
+        /// Destructor
+        SLIBEXP ~PlanCache();
+
+        /// The shape of a query. Empty if the plan of the query cannot be cached
+        SLIBEXP static std::string getKey(const QueryGraph& query);
+        /// Can the plan be cached?
+        SLIBEXP static bool isCacheable(const Plan* plan);
+
+        /// Look up the plan of a query with the given shape. The plan is
+        /// allocated in plans. Returns 0 if the shape is not cached
+        SLIBEXP Plan* lookup(const std::string& key, const QueryGraph& query, PlanContainer& plans);
+        /// Store the plan of a query. The cache takes the query and the plan generator
+        SLIBEXP void insert(const std::string& key, std::unique_ptr<QueryGraph>& query, PlanGen*& plangen, Plan* plan);
+        /// Remove all plans (e.g., after the statistics of the database changed)
+        SLIBEXP void clear();
+
+        /// Number of queries whose plan was found in the cache
+        uint64_t getHits() const {
+            return hits;
+        }
+        /// Number of cacheable queries whose plan was not found in the cache
+        uint64_t getMisses() const {
+            return misses;
+        }
+};
+//---------------------------------------------------------------------------
+#endif
@@ -26,6 +26,8 @@ class PlanGen {
             Plan* plans;
             /// The relations involved in the problem
             BitSet relations;
+            /// The cardinality estimated from the statistics of the stars. -1 if unknown
+            double starCardinality;
         };
         /// A join description
         struct JoinDescription;
@@ -56,6 +58,8 @@ class PlanGen {
                 QueryGraph::ValuesNode& node, uint64_t id); Problem*
             buildScan(const QueryGraph::SubQuery& query, const
                     QueryGraph::Node& node, uint64_t id);
+        /// Estimate the cardinality of a star of patterns on the same subject. -1 if it is not a star
+        double estimateStar(const QueryGraph::SubQuery& query, BitSet relations);
         /// Build the informaion about a join
         JoinDescription buildJoinInfo(const QueryGraph::SubQuery& query, const
                 QueryGraph::Edge& edge);
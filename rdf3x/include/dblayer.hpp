@@ -51,6 +51,19 @@ class DBLayer {
 
                 virtual bool first(uint64_t, bool, uint64_t, bool, uint64_t, bool) = 0;
 
+                //Move forward to the first triple whose first two values
+                //are not smaller than (value1, value2). The scan must be
+                //positioned on a triple (i.e., after first()). Returns false
+                //if there is no such triple
+                virtual bool skipTo(uint64_t value1, uint64_t value2) {
+                    while (getValue1() < value1 ||
+                            (getValue1() == value1 && getValue2() < value2)) {
+                        if (!next())
+                            return false;
+                    }
+                    return true;
+                }
+
                 virtual ~Scan() {}
         };
 
@@ -122,6 +135,25 @@ class DBLayer {
                 ::Type::ID& type,
                 unsigned& subType) = 0;
 
+        //Translate many IDs at once. texts[i], types[i] and found[i] refer
+        //to ids[i]. The default version looks up the IDs one by one
+        virtual void lookupByIds(const std::vector<uint64_t>& ids,
+                std::vector<std::string>& texts,
+                std::vector< ::Type::ID>& types,
+                std::vector<bool>& found) {
+            texts.resize(ids.size());
+            types.resize(ids.size());
+            found.resize(ids.size());
+            for (size_t i = 0; i < ids.size(); ++i) {
+                const char *start, *stop;
+                unsigned subType;
+                found[i] = lookupById(ids[i], start, stop, types[i], subType);
+                if (found[i]) {
+                    texts[i].assign(start, stop);
+                }
+            }
+        }
+
         virtual uint64_t getNextId() = 0;
 
         virtual double getScanCost(DBLayer::DataOrder order,
@@ -161,6 +193,13 @@ class DBLayer {
 
         virtual uint64_t getCardinality() = 0;
 
+        //Number of results of a star of patterns (?s p ?o) that share the
+        //subject, one for every predicate. Returns -1 if it is unknown
+        virtual double getStarCardinality(
+                const std::vector<uint64_t>& predicates) {
+            return -1;
+        }
+
         virtual std::unique_ptr<DBLayer::Scan> getScan(const DataOrder order,
                 const Aggr_t aggr,
                 Hint *hint) = 0;
@@ -47,6 +47,9 @@ class Filter : public Operator
    void addMergeHint(Register* reg1,Register* reg2);
    /// Register parts of the tree that can be executed asynchronous
    void getAsyncInputCandidates(Scheduler& scheduler);
+   /// Prune the values of a domain that do not pass a join filter
+   void setJoinFilter(const JoinFilter* filter,const PotentialDomainDescription* domain) { input->setJoinFilter(filter,domain); }
+   void excludeValues(Register* reg,uint64_t from,uint64_t to) { input->excludeValues(reg,from,to); }
 };
 //---------------------------------------------------------------------------
 #endif
@@ -12,26 +12,36 @@
 //---------------------------------------------------------------------------
 #include <rts/operator/Operator.hpp>
 #include <rts/operator/Scheduler.hpp>
-#include <infra/util/VarPool.hpp>
+#include <rts/runtime/JoinFilter.hpp>
 #include <vector>
 #include <set>
 //---------------------------------------------------------------------------
 class Register;
 //---------------------------------------------------------------------------
-/// A memory based hash join
+/// Target number of entries of a partition of the hash table (a partition should fit in the cache)
+#define HASHJOIN_PARTITION_SIZE 4096
+/// Maximum number of partitions
+#define HASHJOIN_MAX_PARTITIONS 4096
+/// Below this number of entries the hash table is built by a single thread
+#define HASHJOIN_PARALLEL_MIN 65536
+/// Number of tuples read at once from the probe side
+#define HASHJOIN_PROBE_BATCH 256
+//---------------------------------------------------------------------------
+/// A memory based hash join. The hash table is radix-partitioned on the
+/// hash of the key, so that every partition fits in the cache, and the
+/// partitions are built in parallel. The probe side is read in batches, so
+/// that the buckets of a whole batch are fetched before they are used.
 class HashJoin : public Operator {
 private:
-    /// A hash table entry
-    struct Entry {
-        /// The next entry
-        Entry* next;
-        /// The key
-        uint64_t key;
-        /// The count
-        uint64_t count;
-        /// Further values
-        uint64_t values[];
+    /// A partition of the hash table
+    struct Partition {
+        /// The number of buckets - 1
+        uint64_t mask;
+        /// The first entry of every bucket
+        std::vector<uint32_t> buckets;
     };
+    /// End of a chain
+    static const uint32_t noEntry = ~0u;
     /// Hash table task
     class BuildHashTable : public Scheduler::AsyncPoint {
     private:
@@ -73,17 +83,33 @@ private:
     Register* leftValue, *rightValue;
     /// The non-join attributes
     std::vector<Register*> leftTail, rightTail;
-    /// The pool of hash entry
-    VarPool<Entry> entryPool;
-    /// The hash table
-    std::vector<Entry*> hashTable;
-    /// The current iter
-    Entry* hashTableIter;
+    /// The entries of the hash table, grouped by partition. Every entry is
+    /// the key, the count and the non-join values. Entries merged into
+    /// another one have count 0
+    std::vector<uint64_t> entries;
+    /// The next entry in the chain of every entry
+    std::vector<uint32_t> chain;
+    /// The partitions
+    std::vector<Partition> partitions;
+    /// Number of bits of the hash that select the partition
+    unsigned partitionBits;
+    /// The current entry
+    uint32_t hashTableIter;
     /// The tuple count from the right side
     uint64_t rightCount;
     // If the right is a scan, bitset indicates the position(s) of the joins.
     // 1 - subject, 2 - predicate, 4 - object.
     int bitset;
+    /// The number of threads that can build the hash table
+    unsigned threads;
+    /// The batch of probe tuples. Every tuple is the count, the key and the non-join values
+    std::vector<uint64_t> probeBatch;
+    /// The first candidate entry of every probe tuple
+    std::vector<uint32_t> probeHeads;
+    /// The size of the batch and the next tuple to read from it
+    size_t probeSize, probePos;
+    /// Can the right side produce more tuples?
+    bool probeMore;
     /// Task
     BuildHashTable buildHashTableTask;
     /// Task
@@ -91,21 +117,31 @@ private:
     /// Task priorities
     double hashPriority, probePriority;
 
-    /// Insert into the hash table
-    void insert(Entry* e);
-    /// Lookup an entry
-    inline Entry* lookup(uint64_t key);
+    /// Partition the materialized left side and build the chains of every partition
+    void build(std::vector<uint64_t>& input);
+    /// Build the chains of a partition
+    void buildPartition(uint64_t partition, uint64_t begin, uint64_t end, std::vector<uint64_t>& partitionKeys);
+    /// The partition of a hash
+    inline uint64_t getPartition(uint64_t hash) const;
+    /// Skip the entries of a chain with a different key
+    inline uint32_t findKey(uint32_t entry, uint64_t key) const;
+    /// Read a batch of tuples from the probe side, starting with the current one
+    bool fillProbeBatch(uint64_t count);
+    /// Move to the next tuple of the probe side
+    bool nextProbeTuple();
 
     //Optional?
     bool leftOptional, rightOptional, joinSuccedeed;
     std::set<uint64_t> collectedRightValues;
     size_t currentIdx;
     std::vector<uint64_t> keys;
+    /// The filter of the keys, passed to the probe side
+    JoinFilter filter;
 
 public:
     /// Constructor
     HashJoin(Operator* left, Register* leftValue, const std::vector<Register*>& leftTail, Operator* right, Register* rightValue, const std::vector<Register*>& rightTail,
-             double hashPriority, double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset);
+             double hashPriority, double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset, unsigned threads = 1);
     /// Destructor
     ~HashJoin();
 
@@ -124,6 +160,15 @@ public:
     void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
         left->setHashKeys(keys, bitset);
    }
+    /// Prune the values of a domain that do not pass a join filter
+    void setJoinFilter(const JoinFilter* filter, const PotentialDomainDescription* domain) {
+        if (!leftOptional) left->setJoinFilter(filter, domain);
+        if (!rightOptional) right->setJoinFilter(filter, domain);
+    }
+    void excludeValues(Register* reg, uint64_t from, uint64_t to) {
+        if (!leftOptional) left->excludeValues(reg, from, to);
+        if (!rightOptional) right->excludeValues(reg, from, to);
+    }
 
 };
 //---------------------------------------------------------------------------
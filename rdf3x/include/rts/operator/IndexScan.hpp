@@ -53,6 +53,14 @@ private:
     std::vector<Register*> merge1, merge2, merge3;
     /// The scan
     std::unique_ptr<DBLayer::Scan> scan;
+    /// The scan restricted to a morsel. Owned by scan
+    class MorselScan;
+    MorselScan* morsel;
+    /// The scan that skips the values rejected by the join filters and the excluded values. Owned by scan
+    class FilteredScan;
+    FilteredScan* filtered;
+    /// Get the filtered scan
+    FilteredScan* getFilteredScan();
 
     /// Constructor
     IndexScan(DBLayer& db, DBLayer::DataOrder order, Register* value1,
@@ -86,10 +94,20 @@ public:
    void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
        hint.setKeys(keys, bitset);
    }
+    /// Skip the values of a domain that do not pass a join filter
+    void setJoinFilter(const JoinFilter* filter, const PotentialDomainDescription* domain);
+    /// Skip the values of a register in [from,to]
+    void excludeValues(Register* reg, uint64_t from, uint64_t to);
 
     /// Register parts of the tree that can be executed asynchronous
     void getAsyncInputCandidates(Scheduler& scheduler);
 
+    /// The value that is split in morsels: 1 if the first value is unbound,
+    /// 2 if only the first value is bound, 0 if the scan cannot be split
+    unsigned getMorselColumn() const;
+    /// Restrict the next executions to the triples whose morsel value is in [from,to)
+    void setMorsel(uint64_t from, uint64_t to);
+
     /// Create a suitable operator
     static IndexScan* create(DBLayer& db, DBLayer::DataOrder order, Register* subjectRegister, bool subjectBound, Register* predicateRegister, bool predicateBound, Register* objectRegister, bool objectBound, double expectedOutputCardinality);
 };
@@ -92,6 +92,15 @@ class MergeJoin : public Operator
    void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
        left->setHashKeys(keys, bitset);
    }
+   /// Prune the values of a domain that do not pass a join filter
+   void setJoinFilter(const JoinFilter* filter,const PotentialDomainDescription* domain) {
+       if (!leftOptional) left->setJoinFilter(filter, domain);
+       if (!rightOptional) right->setJoinFilter(filter, domain);
+   }
+   void excludeValues(Register* reg,uint64_t from,uint64_t to) {
+       if (!leftOptional) left->excludeValues(reg, from, to);
+       if (!rightOptional) right->excludeValues(reg, from, to);
+   }
 
 };
 //---------------------------------------------------------------------------
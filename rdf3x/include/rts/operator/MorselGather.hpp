@@ -0,0 +1,109 @@
+#ifndef H_rts_operator_MorselGather
+#define H_rts_operator_MorselGather
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include "rts/operator/Operator.hpp"
+#include "rts/runtime/Runtime.hpp"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+//---------------------------------------------------------------------------
+/// Below this estimated cardinality of the driving scans a single thread is used
+#define MORSEL_MIN_CARDINALITY 100000
+/// Number of morsels per worker. More morsels balance better the skewed ranges
+#define MORSELS_PER_WORKER 64
+/// Number of tuples handed over at once by a worker
+#define MORSEL_CHUNK 1024
+/// Number of chunks that can wait to be consumed, per worker
+#define MORSEL_QUEUE 4
+//---------------------------------------------------------------------------
+/// Morsel-driven parallel execution of a pipeline. Every worker runs its own
+/// copy of the pipeline (with its own runtime and database layer) and
+/// restricts the driving index scans to one morsel at the time, i.e., to a
+/// range of the values of their first unbound column. The workers take the
+/// morsels from a shared counter, so the fast workers take over the work of
+/// the slow ones. The tuples are gathered in the output registers in no
+/// particular order.
+class MorselGather : public Operator
+{
+   public:
+   /// The pipeline of a worker
+   struct Pipeline {
+      /// The runtime. It contains the scans split in morsels
+      std::unique_ptr<Runtime> runtime;
+      /// The operator tree. Destroyed before the runtime
+      std::unique_ptr<Operator> tree;
+      /// The registers copied in the output registers (in the same order)
+      std::vector<Register*> output;
+   };
+
+   private:
+   /// The output registers
+   std::vector<Register*> output;
+   /// The pipelines
+   std::vector<std::unique_ptr<Pipeline> > pipelines;
+   /// The number of morsels and the number of values in each of them
+   uint64_t morsels,morselSize;
+   /// The next morsel to process
+   std::atomic<uint64_t> nextMorsel;
+   /// Set if the consumer does not want more tuples
+   std::atomic<bool> stopped;
+   /// The threads
+   std::vector<std::thread> threads;
+
+   /// Protects the fields below
+   std::mutex mutex;
+   /// Signals
+   std::condition_variable chunkReady,chunkTaken;
+   /// The chunks produced by the workers. Every tuple is its count followed by the output values
+   std::deque<std::vector<uint64_t> > chunks;
+   /// The number of running workers
+   unsigned running;
+   /// The first error raised by a worker
+   std::exception_ptr error;
+
+   /// The chunk that is being read
+   std::vector<uint64_t> current;
+   /// The position in the chunk
+   size_t currentPos;
+
+   /// Run a pipeline on the morsels
+   void work(Pipeline* pipeline);
+   /// Hand over a chunk. Returns false if the worker must stop
+   bool push(std::vector<uint64_t>& chunk);
+   /// Stop the workers and wait for them
+   void stop();
+
+   public:
+   /// Constructor. The morsels cover the values in [0,domainSize)
+   MorselGather(const std::vector<Register*>& output,std::vector<std::unique_ptr<Pipeline> >& pipelines,uint64_t domainSize,double expectedOutputCardinality);
+   /// Destructor
+   ~MorselGather();
+
+   /// Produce the first tuple
+   uint64_t first();
+   /// Produce the next tuple
+   uint64_t next();
+
+   /// Print the operator tree. Debugging only.
+   void print(PlanPrinter& out);
+   /// Add a merge join hint
+   void addMergeHint(Register* reg1,Register* reg2);
+   /// Register parts of the tree that can be executed asynchronous
+   void getAsyncInputCandidates(Scheduler& scheduler);
+};
+//---------------------------------------------------------------------------
+#endif
@@ -17,6 +17,8 @@ class Register;
 class DictionarySegment;
 class Scheduler;
 class PlanPrinter;
+class JoinFilter;
+class PotentialDomainDescription;
 //---------------------------------------------------------------------------
 /// Base class for all operators of the runtime system
 class Operator
@@ -53,6 +55,16 @@ class Operator
    virtual void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
        // Default version is empty.
    }
+   /// Prune the values of a domain that do not pass a join filter. Must be called before the execution.
+   /// The operators forward it only to the inputs whose tuples must all join
+   virtual void setJoinFilter(const JoinFilter* /*filter*/,const PotentialDomainDescription* /*domain*/) {
+       // Default version is empty.
+   }
+   /// Skip the values of a register in [from,to], a filter above rejects them. Must be called before the execution.
+   /// The operators forward it like setJoinFilter
+   virtual void excludeValues(Register* /*reg*/,uint64_t /*from*/,uint64_t /*to*/) {
+       // Default version is empty.
+   }
 
    /// Disable scan skipping. Debugging only, this is a global property!
    static bool disableSkipping;
@@ -25,6 +25,10 @@
 class DictionarySegment;
 class Register;
 class Runtime;
+class ResultsWriter;
+//---------------------------------------------------------------------------
+/// Number of rows decoded at once when the results are streamed
+#define RESULTSPRINTER_STREAM_BATCH 4096
 //---------------------------------------------------------------------------
 /// A wrapper to avoid duplicating the strings in memory
 namespace {
@@ -84,6 +88,12 @@ class ResultsPrinter : public Operator {
         //Used for set output
         std::unordered_set<uint64_t> *outputset;
         unsigned prjId;
+        //Used for streaming output
+        ResultsWriter *streamoutput;
+
+        /// Pass the rows to streamoutput as they are produced. The strings
+        /// are translated in batches of rows
+        void streamRows(uint64_t count, uint64_t offset);
 
         void formatJSON(const std::vector<std::string> &columns,
                 std::vector<uint64_t> &results,
@@ -116,6 +126,12 @@ class ResultsPrinter : public Operator {
             this->jsonvars = jsonvars;
         }
 
+        /// Write the rows to the writer as soon as they are produced,
+        /// without materializing them
+        void setStreamOutput(ResultsWriter *writer) {
+            streamoutput = writer;
+        }
+
         void setSetOutput(std::unordered_set<uint64_t> *results, unsigned prjId) {
             outputset = results;
             this->prjId = prjId;
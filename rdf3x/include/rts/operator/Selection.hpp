@@ -641,6 +641,14 @@ class Selection : public Operator {
         void setHashKeys(std::vector<uint64_t> *keys, int bitset) {
             input->setHashKeys(keys, bitset);
         }
+
+        void setJoinFilter(const JoinFilter* filter, const PotentialDomainDescription* domain) {
+            input->setJoinFilter(filter, domain);
+        }
+
+        void excludeValues(Register* reg, uint64_t from, uint64_t to) {
+            input->excludeValues(reg, from, to);
+        }
 };
 //---------------------------------------------------------------------------
 #endif
@@ -0,0 +1,145 @@
+#ifndef H_rts_operator_VectorSelection
+#define H_rts_operator_VectorSelection
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include "rts/operator/Operator.hpp"
+#include <vector>
+#include <string>
+#include <unordered_map>
+//---------------------------------------------------------------------------
+class Register;
+class Runtime;
+//---------------------------------------------------------------------------
+/// Number of tuples evaluated at once
+#define VECTORSELECTION_BATCH 1024
+/// Number of terms that are kept between the batches
+#define VECTORSELECTION_MAXTERMS 65536
+//---------------------------------------------------------------------------
+/// Applies simple conditions (numeric comparisons with a constant, isIRI,
+/// isBlank, isLiteral and lang tests) on batches of tuples. The conditions
+/// are evaluated on the ids: the numbers inlined in the ids are decoded
+/// directly and the other terms are looked up only once, in sorted batches
+/// of the new ids
+class VectorSelection : public Operator
+{
+   public:
+   /// A condition on a register
+   struct Condition {
+      /// Possible conditions
+      enum Kind { Less, LessOrEqual, Greater, GreaterOrEqual, IsIRI, IsBlank, IsLiteral, LangEqual, LangMatches };
+
+      /// The kind
+      Kind kind;
+      /// Negated? Only for the conditions that cannot raise an error
+      bool negated;
+      /// The register
+      Register* reg;
+      /// The constant of the numeric comparisons
+      bool intConstant;
+      int64_t intValue;
+      double doubleValue;
+      /// The constant of the language tests
+      std::string lang;
+
+      /// Constructor
+      Condition(Kind kind,Register* reg) : kind(kind),negated(false),reg(reg),intConstant(false),intValue(0),doubleValue(0) {}
+
+      /// Set the constant of a numeric comparison. Returns false if the text is not a number
+      bool setNumber(const std::string& text);
+      /// The range of ids with inlined integers that fail the condition. Returns false if there is none
+      bool getExcludedIds(uint64_t& from,uint64_t& to) const;
+   };
+
+   private:
+   /// What is known about a term
+   struct Term {
+      /// Possible kinds
+      enum Kind { IRI, Blank, Literal, Unbound };
+      /// Possible numeric types
+      enum NumType { None, Int, Double };
+
+      /// The kind
+      unsigned char kind;
+      /// The numeric type
+      unsigned char numType;
+      /// The language tag (an index in langs, 0 if none)
+      unsigned lang;
+      /// The numeric value
+      int64_t intValue;
+      double doubleValue;
+   };
+
+   /// The input
+   Operator* input;
+   /// The runtime
+   Runtime& runtime;
+   /// The conditions
+   std::vector<Condition> conditions;
+   /// The registers saved for every tuple of the batch
+   std::vector<Register*> registers;
+   /// The column of the register of every condition
+   std::vector<unsigned> conditionColumns;
+
+   /// The terms seen so far, at most VECTORSELECTION_MAXTERMS
+   std::unordered_map<uint64_t,Term> terms;
+   /// The language tags
+   std::vector<std::string> langs;
+   std::unordered_map<std::string,unsigned> langIds;
+
+   /// The batch. The values are stored by column
+   std::vector<uint64_t> values;
+   std::vector<uint64_t> counts;
+   /// The qualifying tuples of the batch
+   std::vector<unsigned> selected;
+   /// The position in selected
+   unsigned selectedPos;
+   /// Is the input exhausted? Is the next call the first one?
+   bool inputDone,inputFirst;
+   /// The ids looked up for a batch
+   std::vector<uint64_t> missing;
+
+   /// Read the next batch
+   void readBatch();
+   /// Look up the new terms of a column, for the selected tuples of the batch
+   void classify(const uint64_t* column);
+   /// Describe a term
+   Term describe(uint64_t id);
+   /// The term of an id of the batch
+   const Term& getTerm(uint64_t id,Term& inlined);
+   /// Check a condition
+   bool check(const Condition& condition,const Term& term) const;
+   /// Intern a language tag
+   unsigned internLang(const std::string& lang);
+
+   public:
+   /// Constructor. The registers are the ones visible to the parent operators
+   VectorSelection(Operator* input,Runtime& runtime,const std::vector<Condition>& conditions,const std::vector<Register*>& registers,double expectedOutputCardinality);
+   /// Destructor
+   ~VectorSelection();
+
+   /// Produce the first tuple
+   uint64_t first();
+   /// Produce the next tuple
+   uint64_t next();
+
+   /// Print the operator tree. Debugging only.
+   void print(PlanPrinter& out);
+   /// Add a merge join hint
+   void addMergeHint(Register* reg1,Register* reg2);
+   /// Register parts of the tree that can be executed asynchronous
+   void getAsyncInputCandidates(Scheduler& scheduler);
+
+   void setHashKeys(std::vector<uint64_t> *keys, int bitset) { input->setHashKeys(keys,bitset); }
+   void setJoinFilter(const JoinFilter* filter,const PotentialDomainDescription* domain) { input->setJoinFilter(filter,domain); }
+   void excludeValues(Register* reg,uint64_t from,uint64_t to) { input->excludeValues(reg,from,to); }
+};
+//---------------------------------------------------------------------------
+#endif
@@ -0,0 +1,61 @@
+#ifndef H_rts_runtime_JoinFilter
+#define H_rts_runtime_JoinFilter
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+#include <inttypes.h>
+#include <vector>
+//---------------------------------------------------------------------------
+/// Maximum number of ranges in which the domain of the keys is split
+#define JOINFILTER_RANGES 65536
+/// Bits of the bloom filter per key
+#define JOINFILTER_BITS_PER_KEY 8
+//---------------------------------------------------------------------------
+/** Runtime join filter.
+  * Summary of the keys of the build side of a join, used to prune the scans
+  * of the other side. It contains the bounds of the keys, the set of the
+  * non-empty ranges of their domain (to skip the ranges without keys) and a
+  * bloom filter (to drop the values that do not join).
+  */
+class JoinFilter
+{
+   private:
+   /// Value bounds
+   uint64_t min,max;
+   /// The ranges are the values with the same (value-min)>>rangeShift
+   unsigned rangeShift;
+   /// Bitmap of the non-empty ranges
+   std::vector<uint64_t> ranges;
+   /// Blocked bloom filter. Every key sets bits in one word
+   std::vector<uint64_t> bloom;
+   /// The mask of the bloom filter words
+   uint64_t bloomMask;
+
+   /// The bits of a key in its bloom filter word
+   static inline uint64_t bloomBits(uint64_t hash);
+
+   public:
+   /// Constructor. The filter rejects everything
+   JoinFilter();
+
+   /// Build the filter from the distinct keys
+   void build(const std::vector<uint64_t>& keys);
+   /// Could this value qualify?
+   bool couldQualify(uint64_t value) const;
+   /// Return the next value >= value that could qualify (or ~0ull)
+   uint64_t nextCandidate(uint64_t value) const;
+
+   /// The smallest value >= value that could qualify for all filters (or ~0ull)
+   static uint64_t nextCandidate(const std::vector<const JoinFilter*>& filters,uint64_t value);
+   /// Could this value qualify for all filters?
+   static bool couldQualify(const std::vector<const JoinFilter*>& filters,uint64_t value);
+};
+//---------------------------------------------------------------------------
+#endif
@@ -20,6 +20,7 @@
 //class DifferentialIndex;
 class TemporaryDictionary;
 class QueryDict;
+class IndexScan;
 //---------------------------------------------------------------------------
 /// A runtime register storing a single value
 class Register {
@@ -57,6 +58,10 @@ private:
     std::vector<Register> registers;
     /// The domain descriptions
     std::vector<PotentialDomainDescription> domainDescriptions;
+    /// The scans split in morsels (parallel execution only)
+    std::vector<IndexScan*> morselScans;
+    /// The number of threads an operator can use
+    unsigned threads;
 public:
 
     std::unordered_map<uint64_t, IdValue> valueMap;
@@ -108,6 +113,26 @@ public:
     PotentialDomainDescription* getDomainDescription(unsigned slot) {
         return &(domainDescriptions[slot]);
     }
+    /// Get the slot of a register
+    unsigned getRegisterSlot(const Register* reg) const {
+        return reg - registers.data();
+    }
+    /// Register a scan that is split in morsels
+    void addMorselScan(IndexScan* scan) {
+        morselScans.push_back(scan);
+    }
+    /// The scans split in morsels
+    const std::vector<IndexScan*>& getMorselScans() const {
+        return morselScans;
+    }
+    /// Set the number of threads an operator can use (e.g., to build a hash table)
+    void setThreads(unsigned count) {
+        threads = count ? count : 1;
+    }
+    /// The number of threads an operator can use
+    unsigned getThreads() const {
+        return threads;
+    }
 };
 //---------------------------------------------------------------------------
 #endif
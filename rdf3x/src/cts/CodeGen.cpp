@@ -15,6 +15,7 @@
 #include <rts/operator/IndexScan.hpp>
 #include <rts/operator/MergeJoin.hpp>
 #include <rts/operator/MergeUnion.hpp>
+#include <rts/operator/MorselGather.hpp>
 #include <rts/operator/NestedLoopFilter.hpp>
 #include <rts/operator/NestedLoopJoin.hpp>
 #include <rts/operator/ResultsPrinter.hpp>
@@ -26,12 +27,14 @@
 #include <rts/operator/Assignment.hpp>
 #include <rts/operator/TableFunction.hpp>
 #include <rts/operator/Union.hpp>
+#include <rts/operator/VectorSelection.hpp>
 #include <rts/operator/DuplLimit.hpp>
 #include <rts/operator/GroupBy.hpp>
 #include <rts/operator/AggrFunctions.hpp>
 
 #include <trident/sparql/aggrhandler.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <map>
 #include <set>
@@ -103,11 +106,14 @@ static Operator* translateIndexScan(Runtime& runtime, const map<unsigned, Regist
     //if (runtime.hasDifferentialIndex())
     //    return runtime.getDifferentialIndex().createScan(static_cast<Database::DataOrder>(plan->opArg), subject, constSubject, predicate, constPredicate, object, constObject, plan->cardinality);
 
-    return IndexScan::create(runtime.getDatabase(), static_cast<DBLayer::DataOrder>(plan->opArg),
+    IndexScan* scan = IndexScan::create(runtime.getDatabase(), static_cast<DBLayer::DataOrder>(plan->opArg),
             subject, constSubject,
             predicate, constPredicate,
             object, constObject,
             plan->cardinality);
+    if (plan->morsel)
+        runtime.addMorselScan(scan);
+    return scan;
 }
 //---------------------------------------------------------------------------
 static Operator* translateAggregatedIndexScan(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan)
@@ -398,7 +404,7 @@ static Operator* translateHashJoin(Runtime& runtime, const map<unsigned, Registe
             rightTail.push_back((*iter).second);
 
     // Build the operator
-    Operator* result = new HashJoin(leftTree, leftBindings[joinOn], leftTail, rightTree, rightBindings[joinOn], rightTail, -plan->left->costs, plan->right->costs, plan->cardinality, plan->left->optional, plan->right->optional, bitset);
+    Operator* result = new HashJoin(leftTree, leftBindings[joinOn], leftTail, rightTree, rightBindings[joinOn], rightTail, -plan->left->costs, plan->right->costs, plan->cardinality, plan->left->optional, plan->right->optional, bitset, runtime.getThreads());
 
     // And apply additional selections if necessary
     result = addAdditionalSelections(runtime, result, joinVariables, leftBindings, rightBindings, joinOn);
@@ -623,6 +629,136 @@ static Selection::Predicate* buildSelection(Runtime &runtime, const map<unsigned
     throw; // Cannot happen
 }
 //---------------------------------------------------------------------------
+static void collectConjuncts(const QueryGraph::Filter& filter, vector<const QueryGraph::Filter*>& conjuncts)
+    // Split a filter in its conjuncts
+{
+    if (filter.type == QueryGraph::Filter::And) {
+        collectConjuncts(*filter.arg1, conjuncts);
+        collectConjuncts(*filter.arg2, conjuncts);
+    } else {
+        conjuncts.push_back(&filter);
+    }
+}
+//---------------------------------------------------------------------------
+static Register* getConditionRegister(const map<unsigned, Register*>& bindings, const QueryGraph::Filter* filter)
+    // The register of a variable or an aggregate used by a condition
+{
+    if ((filter->type != QueryGraph::Filter::Variable) && (filter->type != QueryGraph::Filter::Builtin_aggr))
+        return 0;
+    map<unsigned, Register*>::const_iterator iter = bindings.find(filter->id);
+    return (iter == bindings.end()) ? 0 : iter->second;
+}
+//---------------------------------------------------------------------------
+static string getConditionLang(const QueryGraph::Filter* filter)
+    // The language tag of a constant
+{
+    string lang = filter->value;
+    if ((lang.size() >= 2) && (lang[0] == '"'))
+        lang = lang.substr(1, lang.find_last_of('"') - 1);
+    return lang;
+}
+//---------------------------------------------------------------------------
+static bool buildVectorCondition(const map<unsigned, Register*>& bindings, const QueryGraph::Filter& filter, vector<VectorSelection::Condition>& conditions)
+    // Translate a simple filter into a condition on the ids
+{
+    const QueryGraph::Filter* f = &filter;
+    bool negated = false;
+    if (f->type == QueryGraph::Filter::Not) {
+        negated = true;
+        f = f->arg1;
+    }
+
+    switch (f->type) {
+        case QueryGraph::Filter::Less:
+        case QueryGraph::Filter::LessOrEqual:
+        case QueryGraph::Filter::Greater:
+        case QueryGraph::Filter::GreaterOrEqual: {
+            // A negated comparison holds also for the non-numeric values
+            if (negated)
+                return false;
+            VectorSelection::Condition::Kind kinds[] = { VectorSelection::Condition::Less, VectorSelection::Condition::LessOrEqual, VectorSelection::Condition::Greater, VectorSelection::Condition::GreaterOrEqual };
+            VectorSelection::Condition::Kind flipped[] = { VectorSelection::Condition::Greater, VectorSelection::Condition::GreaterOrEqual, VectorSelection::Condition::Less, VectorSelection::Condition::LessOrEqual };
+            unsigned index = f->type - QueryGraph::Filter::Less;
+            Register* reg;
+            const QueryGraph::Filter* constant;
+            VectorSelection::Condition::Kind kind;
+            if ((reg = getConditionRegister(bindings, f->arg1)) != 0) {
+                constant = f->arg2;
+                kind = kinds[index];
+            } else if ((reg = getConditionRegister(bindings, f->arg2)) != 0) {
+                constant = f->arg1;
+                kind = flipped[index];
+            } else {
+                return false;
+            }
+            if (constant->type != QueryGraph::Filter::Literal)
+                return false;
+            VectorSelection::Condition condition(kind, reg);
+            if (!condition.setNumber(constant->value))
+                return false;
+            conditions.push_back(condition);
+            return true;
+        }
+        case QueryGraph::Filter::Builtin_isiri:
+        case QueryGraph::Filter::Builtin_isblank:
+        case QueryGraph::Filter::Builtin_isliteral: {
+            Register* reg = getConditionRegister(bindings, f->arg1);
+            if (!reg)
+                return false;
+            VectorSelection::Condition condition((f->type == QueryGraph::Filter::Builtin_isiri) ? VectorSelection::Condition::IsIRI : ((f->type == QueryGraph::Filter::Builtin_isblank) ? VectorSelection::Condition::IsBlank : VectorSelection::Condition::IsLiteral), reg);
+            condition.negated = negated;
+            conditions.push_back(condition);
+            return true;
+        }
+        case QueryGraph::Filter::Equal:
+        case QueryGraph::Filter::NotEqual:
+        case QueryGraph::Filter::Builtin_langmatches: {
+            // lang(?x) compared with a constant
+            const QueryGraph::Filter* lang = f->arg1, *constant = f->arg2;
+            if ((f->type != QueryGraph::Filter::Builtin_langmatches) && (lang->type != QueryGraph::Filter::Builtin_lang))
+                std::swap(lang, constant);
+            if ((lang->type != QueryGraph::Filter::Builtin_lang) || (constant->type != QueryGraph::Filter::Literal))
+                return false;
+            Register* reg = getConditionRegister(bindings, lang->arg1);
+            if (!reg)
+                return false;
+            VectorSelection::Condition condition((f->type == QueryGraph::Filter::Builtin_langmatches) ? VectorSelection::Condition::LangMatches : VectorSelection::Condition::LangEqual, reg);
+            condition.negated = negated != (f->type == QueryGraph::Filter::NotEqual);
+            condition.lang = getConditionLang(constant);
+            conditions.push_back(condition);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+static Operator* translateSelection(Runtime& runtime, const map<unsigned, Register*>& bindings, const QueryGraph::Filter& filter, Plan* filterPlan, const map<const QueryGraph::Node*, unsigned>& registers, Operator* tree, double cardinality)
+    // Translate a complex filter. The simple conjuncts are evaluated on batches of ids
+{
+    vector<const QueryGraph::Filter*> conjuncts, residual;
+    collectConjuncts(filter, conjuncts);
+    vector<VectorSelection::Condition> conditions;
+    for (vector<const QueryGraph::Filter*>::const_iterator iter = conjuncts.begin(), limit = conjuncts.end(); iter != limit; ++iter)
+        if (!buildVectorCondition(bindings, **iter, conditions))
+            residual.push_back(*iter);
+
+    if (!conditions.empty()) {
+        vector<Register*> visible;
+        for (map<unsigned, Register*>::const_iterator iter = bindings.begin(), limit = bindings.end(); iter != limit; ++iter)
+            if (find(visible.begin(), visible.end(), iter->second) == visible.end())
+                visible.push_back(iter->second);
+        tree = new VectorSelection(tree, runtime, conditions, visible, cardinality);
+    }
+    if (residual.empty())
+        return tree;
+
+    Selection::Predicate* predicate = buildSelection(runtime, bindings, *residual[0], filterPlan, registers);
+    for (unsigned index = 1; index < residual.size(); index++)
+        predicate = new Selection::And(predicate, buildSelection(runtime, bindings, *residual[index], filterPlan, registers));
+    return new Selection(tree, runtime, predicate, cardinality);
+}
+//---------------------------------------------------------------------------
 static Operator* translateGroupBy(Runtime& runtime, const map<unsigned, Register*>& context, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const map<const QueryGraph::Node*, unsigned>& registers, Plan* plan) {
     Operator* tree = translatePlan(runtime, context, projection, bindings,
             registers, plan->left);
@@ -704,9 +840,8 @@ static Operator* translateHaving(Runtime& runtime, const map<unsigned, Register*
             bindings, registers, plan->left);
     Operator* result = 0;
     if (!result) {
-        result = new Selection(tree, runtime,
-                buildSelection(runtime, bindings, filter, filterArgs.plan,
-                    registers), plan->cardinality);
+        result = translateSelection(runtime, bindings, filter,
+                filterArgs.plan, registers, tree, plan->cardinality);
     }
 
     // Cleanup the binding
@@ -770,7 +905,7 @@ static Operator* translateFilter(Runtime& runtime, const map<unsigned, Register*
         }
     }
     if (!result) {
-        result = new Selection(tree, runtime, buildSelection(runtime, bindings, filter, filterArgs.plan, registers), plan->cardinality);
+        result = translateSelection(runtime, bindings, filter, filterArgs.plan, registers, tree, plan->cardinality);
     }
 
     // Cleanup the binding
@@ -1158,7 +1293,141 @@ static unsigned allocateRegisters(map<const QueryGraph::Node*, unsigned>& regist
     return id;
 }
 //---------------------------------------------------------------------------
-Operator* CodeGen::translateIntern(Runtime& runtime, const QueryGraph& query, Plan* plan, vector<Register*>& output, const map<const QueryGraph::Node*, unsigned> &registers)
+static bool findMorselVariable(Plan* plan, unsigned& variable)
+    // Find the variable on which an index scan is split in morsels
+{
+    const QueryGraph::Node& node = *reinterpret_cast<QueryGraph::Node*>(plan->right);
+    // The first two slots in the order of the scan
+    unsigned slots[2];
+    switch (static_cast<DBLayer::DataOrder>(plan->opArg)) {
+        case DBLayer::Order_No_Order_SPO:
+        case DBLayer::Order_Subject_Predicate_Object:
+            slots[0] = 0; slots[1] = 1;
+            break;
+        case DBLayer::Order_No_Order_SOP:
+        case DBLayer::Order_Subject_Object_Predicate:
+            slots[0] = 0; slots[1] = 2;
+            break;
+        case DBLayer::Order_No_Order_OPS:
+        case DBLayer::Order_Object_Predicate_Subject:
+            slots[0] = 2; slots[1] = 1;
+            break;
+        case DBLayer::Order_No_Order_OSP:
+        case DBLayer::Order_Object_Subject_Predicate:
+            slots[0] = 2; slots[1] = 0;
+            break;
+        case DBLayer::Order_No_Order_PSO:
+        case DBLayer::Order_Predicate_Subject_Object:
+            slots[0] = 1; slots[1] = 0;
+            break;
+        default:
+            slots[0] = 1; slots[1] = 2;
+            break;
+    }
+    // Same choice of IndexScan::getMorselColumn
+    for (unsigned index = 0; index < 2; index++) {
+        unsigned slot = slots[index];
+        bool constant = (slot == 0) ? node.constSubject : ((slot == 1) ? node.constPredicate : node.constObject);
+        if (!constant) {
+            variable = (slot == 0) ? node.subject : ((slot == 1) ? node.predicate : node.object);
+            return true;
+        }
+    }
+    return false;
+}
+//---------------------------------------------------------------------------
+static bool findMorselScans(Plan* plan, unsigned& variable, vector<Plan*>& scans)
+    // Find the scans that drive a pipeline. All of them are split on the same variable
+{
+    switch (plan->op) {
+        case Plan::IndexScan:
+            if (!findMorselVariable(plan, variable))
+                return false;
+            scans.push_back(plan);
+            return true;
+        case Plan::Filter:
+        case Plan::NestedLoopJoin:
+            // The right side of a nested loop join is executed for every tuple of the left side
+            return findMorselScans(plan->left, variable, scans);
+        case Plan::HashJoin:
+            // The left side is the hash table, the right side is probed. If
+            // the right side is optional, the entries of the hash table that
+            // were never probed are produced at the end, so the probe side
+            // cannot be split
+            if (plan->right->optional)
+                return false;
+            return findMorselScans(plan->right, variable, scans);
+        case Plan::MergeJoin: {
+            // Both sides must be split on the join variable
+            unsigned leftVariable, rightVariable;
+            if ((!findMorselScans(plan->left, leftVariable, scans)) || (!findMorselScans(plan->right, rightVariable, scans)))
+                return false;
+            if ((leftVariable != plan->opArg) || (rightVariable != plan->opArg))
+                return false;
+            variable = plan->opArg;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+static Operator* translateParallel(Runtime& runtime, const QueryGraph& query, const set<unsigned>& projection, map<unsigned, Register*>& bindings, const vector<DBLayer*>& workers, Plan* plan)
+    // Translate the main pipeline of a plan into an operator tree executed by the workers. Returns 0 if the plan cannot be split in morsels
+{
+    // The duplicates are eliminated after gathering the tuples
+    if (plan->op == Plan::HashGroupify) {
+        Operator* tree = translateParallel(runtime, query, projection, bindings, workers, plan->left);
+        if (!tree)
+            return 0;
+        vector<Register*> output;
+        for (map<unsigned, Register*>::const_iterator iter = bindings.begin(), limit = bindings.end(); iter != limit; ++iter)
+            output.push_back((*iter).second);
+        return new HashGroupify(tree, output, plan->cardinality);
+    }
+
+    // Find the scans to split
+    unsigned variable;
+    vector<Plan*> scans;
+    if (!findMorselScans(plan, variable, scans))
+        return 0;
+    Plan::card_t cardinality = 0;
+    for (vector<Plan*>::const_iterator iter = scans.begin(), limit = scans.end(); iter != limit; ++iter)
+        cardinality += (*iter)->cardinality;
+    if (cardinality < MORSEL_MIN_CARDINALITY)
+        return 0;
+
+    // Build a copy of the pipeline for every worker
+    for (vector<Plan*>::const_iterator iter = scans.begin(), limit = scans.end(); iter != limit; ++iter)
+        (*iter)->morsel = true;
+    vector<unique_ptr<MorselGather::Pipeline> > pipelines;
+    map<unsigned, Register*> workerBindings;
+    for (vector<DBLayer*>::const_iterator iter = workers.begin(), limit = workers.end(); iter != limit; ++iter) {
+        unique_ptr<MorselGather::Pipeline> pipeline(new MorselGather::Pipeline());
+        pipeline->runtime.reset(new Runtime(**iter, 0, runtime.getQueryDict()));
+        map<const QueryGraph::Node*, unsigned> registers;
+        CodeGen::prepareRuntime(*pipeline->runtime, query, registers);
+        map<unsigned, Register*> context;
+        workerBindings.clear();
+        pipeline->tree.reset(translatePlan(*pipeline->runtime, context, projection, workerBindings, registers, plan));
+        for (map<unsigned, Register*>::const_iterator iter2 = workerBindings.begin(), limit2 = workerBindings.end(); iter2 != limit2; ++iter2)
+            pipeline->output.push_back((*iter2).second);
+        pipelines.push_back(std::move(pipeline));
+    }
+    for (vector<Plan*>::const_iterator iter = scans.begin(), limit = scans.end(); iter != limit; ++iter)
+        (*iter)->morsel = false;
+
+    // The registers of the workers have the same slots of the registers of the main runtime
+    vector<Register*> output;
+    for (map<unsigned, Register*>::const_iterator iter = workerBindings.begin(), limit = workerBindings.end(); iter != limit; ++iter) {
+        Register* reg = runtime.getRegister(pipelines.back()->runtime->getRegisterSlot((*iter).second));
+        bindings[(*iter).first] = reg;
+        output.push_back(reg);
+    }
+    return new MorselGather(output, pipelines, runtime.getDatabase().getNextId(), plan->cardinality);
+}
+//---------------------------------------------------------------------------
+Operator* CodeGen::translateIntern(Runtime& runtime, const QueryGraph& query, Plan* plan, vector<Register*>& output, const map<const QueryGraph::Node*, unsigned> &registers, const vector<DBLayer*>* workers)
     // Perform a naive translation of a query into an operator tree without output generation
 {
     // Build the operator tree
@@ -1180,7 +1449,11 @@ Operator* CodeGen::translateIntern(Runtime& runtime, const QueryGraph& query, Pl
 
         // And build the tree
         map<unsigned, Register*> context, bindings;
-        tree = translatePlan(runtime, context, projection, bindings, registers, plan);
+        tree = 0;
+        if (workers && (workers->size() > 1))
+            tree = translateParallel(runtime, query, projection, bindings, *workers, plan);
+        if (!tree)
+            tree = translatePlan(runtime, context, projection, bindings, registers, plan);
 
         // Sort if necessary
         if (query.orderBegin() != query.orderEnd()) {
@@ -1244,13 +1517,19 @@ void CodeGen::prepareRuntime(Runtime &runtime,
 //---------------------------------------------------------------------------
 Operator* CodeGen::translate(Runtime& runtime, const QueryGraph& query, Plan* plan, bool silent)
     // Perform a naive translation of a query into an operator tree
+{
+    return translate(runtime, query, plan, vector<DBLayer*>(), silent);
+}
+//---------------------------------------------------------------------------
+Operator* CodeGen::translate(Runtime& runtime, const QueryGraph& query, Plan* plan, const vector<DBLayer*>& workers, bool silent)
+    // Perform a naive translation of a query into an operator tree
 {
     std::map<const QueryGraph::Node*, unsigned> registers;
     prepareRuntime(runtime, query, registers);
 
     // Build the tree itself
     vector<Register*> output;
-    Operator* tree = translateIntern(runtime, query, plan, output, registers);
+    Operator* tree = translateIntern(runtime, query, plan, output, registers, &workers);
     if (!tree) return 0;
 
     // And add the output generation
@@ -0,0 +1,207 @@
+#include "cts/plangen/PlanCache.hpp"
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+static bool addFilterKey(string& key, const QueryGraph::Filter* filter)
+    // Add the shape of a filter to the key. Returns false if the filter cannot be cached
+{
+    if (!filter) {
+        key += '-';
+        return true;
+    }
+    if (filter->subquery || filter->subpattern)
+        return false;
+    key += '(';
+    key += to_string(filter->type);
+    switch (filter->type) {
+        case QueryGraph::Filter::Variable:
+            key += 'v';
+            key += to_string(filter->id);
+            break;
+        case QueryGraph::Filter::Literal:
+        case QueryGraph::Filter::IRI:
+            // The constants are abstracted
+            break;
+        default:
+            // The name of the function, the aggregate, etc.
+            if (!filter->value.empty()) {
+                key += '"';
+                key += to_string(filter->value.size());
+                key += ':';
+                key += filter->value;
+            }
+            break;
+    }
+    if (!addFilterKey(key, filter->arg1) || !addFilterKey(key, filter->arg2) ||
+            !addFilterKey(key, filter->arg3) || !addFilterKey(key, filter->arg4))
+        return false;
+    key += ')';
+    return true;
+}
+//---------------------------------------------------------------------------
+PlanCache::PlanCache(size_t capacity)
+    : capacity(capacity ? capacity : 1), hits(0), misses(0)
+    // Constructor
+{
+}
+//---------------------------------------------------------------------------
+PlanCache::~PlanCache()
+    // Destructor
+{
+}
+//---------------------------------------------------------------------------
+string PlanCache::getKey(const QueryGraph& query)
+    // The shape of a query
+{
+    // Only the basic graph patterns with filters
+    const QueryGraph::SubQuery& q = query.getQuery();
+    if (q.nodes.empty() || !q.optional.empty() || !q.unions.empty() ||
+            !q.tableFunctions.empty() || !q.subqueries.empty() ||
+            !q.minuses.empty() || !q.valueNodes.empty() ||
+            !query.c_getGlobalAssignments().empty() ||
+            !query.getGroupBy().empty() || !query.getHavings().empty() ||
+            !query.c_getAggredateHandler().empty())
+        return string();
+
+    string key = "d";
+    key += to_string(query.getDuplicateHandling());
+    key += 'p';
+    for (QueryGraph::projection_iterator iter = query.projectionBegin(), limit = query.projectionEnd(); iter != limit; ++iter) {
+        key += to_string(*iter);
+        key += ',';
+    }
+    // The predicates are part of the shape, the subjects and the objects are abstracted
+    for (vector<QueryGraph::Node>::const_iterator iter = q.nodes.begin(), limit = q.nodes.end(); iter != limit; ++iter) {
+        key += iter->constSubject ? "[c" : "[v";
+        if (!iter->constSubject)
+            key += to_string(iter->subject);
+        key += iter->constPredicate ? " c" : " v";
+        key += to_string(iter->predicate);
+        key += iter->constObject ? " c" : " v";
+        if (!iter->constObject)
+            key += to_string(iter->object);
+        key += ']';
+    }
+    for (vector<QueryGraph::Filter>::const_iterator iter = q.filters.begin(), limit = q.filters.end(); iter != limit; ++iter)
+        if (!addFilterKey(key, &*iter))
+            return string();
+    return key;
+}
+//---------------------------------------------------------------------------
+bool PlanCache::isCacheable(const Plan* plan)
+    // Can the plan be cached?
+{
+    switch (plan->op) {
+        case Plan::IndexScan:
+        case Plan::AggregatedIndexScan:
+        case Plan::FullyAggregatedIndexScan:
+            return true;
+        case Plan::Filter:
+            return (!reinterpret_cast<const FilterArgs*>(plan->right)->plan) && isCacheable(plan->left);
+        case Plan::NestedLoopJoin:
+        case Plan::MergeJoin:
+        case Plan::HashJoin:
+        case Plan::CartProd:
+            return isCacheable(plan->left) && isCacheable(plan->right);
+        case Plan::HashGroupify:
+            return isCacheable(plan->left);
+        default:
+            return false;
+    }
+}
+//---------------------------------------------------------------------------
+Plan* PlanCache::copyPlan(const Plan* plan, const QueryGraph::SubQuery& from, const QueryGraph::SubQuery& to, PlanContainer& plans)
+    // Copy a plan, replacing the nodes and filters of a query with the ones of another query
+{
+    Plan* result = plans.alloc();
+    *result = *plan;
+    result->next = 0;
+    result->morsel = false;
+    switch (plan->op) {
+        case Plan::IndexScan:
+        case Plan::AggregatedIndexScan:
+        case Plan::FullyAggregatedIndexScan: {
+            const QueryGraph::Node* node = reinterpret_cast<const QueryGraph::Node*>(plan->right);
+            result->right = reinterpret_cast<Plan*>(const_cast<QueryGraph::Node*>(&to.nodes[node - from.nodes.data()]));
+            break;
+        }
+        case Plan::Filter: {
+            const FilterArgs* args = reinterpret_cast<const FilterArgs*>(plan->right);
+            FilterArgs* fa = plans.allocFilterArgs();
+            fa->filter = &to.filters[args->filter - from.filters.data()];
+            fa->plan = 0;
+            result->left = copyPlan(plan->left, from, to, plans);
+            result->right = reinterpret_cast<Plan*>(fa);
+            break;
+        }
+        case Plan::NestedLoopJoin:
+        case Plan::MergeJoin:
+        case Plan::HashJoin:
+        case Plan::CartProd:
+            result->left = copyPlan(plan->left, from, to, plans);
+            result->right = copyPlan(plan->right, from, to, plans);
+            break;
+        default:
+            result->left = copyPlan(plan->left, from, to, plans);
+            break;
+    }
+    return result;
+}
+//---------------------------------------------------------------------------
+Plan* PlanCache::lookup(const string& key, const QueryGraph& query, PlanContainer& plans)
+    // Look up the plan of a query with the given shape
+{
+    shared_ptr<Entry> entry;
+    {
+        lock_guard<std::mutex> lock(entriesMutex);
+        unordered_map<string, list<shared_ptr<Entry> >::iterator>::iterator iter = index.find(key);
+        if (iter == index.end()) {
+            misses++;
+            return 0;
+        }
+        entry = *iter->second;
+        entries.splice(entries.begin(), entries, iter->second);
+    }
+    hits++;
+    // The cached plan is not modified, so it can be copied without the lock
+    return copyPlan(entry->plan, entry->query->getQuery(), query.getQuery(), plans);
+}
+//---------------------------------------------------------------------------
+void PlanCache::insert(const string& key, unique_ptr<QueryGraph>& query, PlanGen*& plangen, Plan* plan)
+    // Store the plan of a query
+{
+    shared_ptr<Entry> entry(new Entry());
+    entry->key = key;
+    entry->query = std::move(query);
+    entry->plangen.reset(plangen);
+    entry->plan = plan;
+    plangen = 0;
+
+    lock_guard<std::mutex> lock(entriesMutex);
+    if (index.count(key))
+        return;
+    entries.push_front(entry);
+    index[key] = entries.begin();
+    if (entries.size() > capacity) {
+        index.erase(entries.back()->key);
+        entries.pop_back();
+    }
+}
+//---------------------------------------------------------------------------
+void PlanCache::clear()
+    // Remove all plans
+{
+    lock_guard<std::mutex> lock(entriesMutex);
+    index.clear();
+    entries.clear();
+}
+//---------------------------------------------------------------------------
@@ -618,6 +618,34 @@ PlanGen::Problem* PlanGen::buildScan(const QueryGraph::SubQuery& query, const Qu
     return result;
 }
 //---------------------------------------------------------------------------
+double PlanGen::estimateStar(const QueryGraph::SubQuery& query, BitSet relations)
+    // Estimate the cardinality of a star of patterns on the same subject
+{
+    // Only patterns (?s p ?o) with a common subject and distinct objects
+    vector<uint64_t> predicates, objects;
+    uint64_t subject = 0;
+    for (unsigned index = 0; index < BitSet::maxWidth; index++) {
+        if (!relations.test(index))
+            continue;
+        if (index >= query.nodes.size())
+            return -1;
+        const QueryGraph::Node& node = query.nodes[index];
+        if (node.constSubject || (!node.constPredicate) || node.constObject)
+            return -1;
+        if (predicates.empty())
+            subject = node.subject;
+        else if (node.subject != subject)
+            return -1;
+        if ((node.object == subject) || (find(objects.begin(), objects.end(), node.object) != objects.end()))
+            return -1;
+        predicates.push_back(node.predicate);
+        objects.push_back(node.object);
+    }
+    if (predicates.size() < 2)
+        return -1;
+    return db->getStarCardinality(predicates);
+}
+//---------------------------------------------------------------------------
 PlanGen::JoinDescription PlanGen::buildJoinInfo(const QueryGraph::SubQuery& query, const QueryGraph::Edge& edge)
     // Build the informaion about a join
 {
@@ -1086,6 +1114,7 @@ Plan* PlanGen::translate_int(const QueryGraph::SubQuery& query,
                                 lookup[relations] = problem = problems.alloc();
                                 problem->relations = relations;
                                 problem->plans = 0;
+                                problem->starCardinality = estimateStar(query, relations);
                                 problem->next = dpTable[index];
                                 dpTable[index] = problem;
                             }
@@ -1140,7 +1169,7 @@ Plan* PlanGen::translate_int(const QueryGraph::SubQuery& query,
                                         p->left = leftPlan;
                                         p->right = rightPlan;
                                         p->next = 0;
-                                        if ((p->cardinality = leftPlan->cardinality * rightPlan->cardinality * selectivity) < 1) p->cardinality = 1;
+                                        if ((p->cardinality = (problem->starCardinality >= 0) ? problem->starCardinality : (leftPlan->cardinality * rightPlan->cardinality * selectivity)) < 1) p->cardinality = 1;
                                         p->costs = leftPlan->costs + rightPlan->costs + Costs::mergeJoin(leftPlan->cardinality, rightPlan->cardinality);
                                         p->ordering = leftPlan->ordering;
                                         addPlan(problem, p);
@@ -1156,7 +1185,7 @@ Plan* PlanGen::translate_int(const QueryGraph::SubQuery& query,
                                 p->left = leftPlan;
                                 p->right = rightPlan;
                                 p->next = 0;
-                                if ((p->cardinality = leftPlan->cardinality * rightPlan->cardinality * selectivity) < 1) p->cardinality = 1;
+                                if ((p->cardinality = (problem->starCardinality >= 0) ? problem->starCardinality : (leftPlan->cardinality * rightPlan->cardinality * selectivity)) < 1) p->cardinality = 1;
                                 p->costs = leftPlan->costs + rightPlan->costs + Costs::hashJoin(leftPlan->cardinality, rightPlan->cardinality);
                                 p->ordering = ~0u;
                                 addPlan(problem, p);
@@ -1167,7 +1196,7 @@ Plan* PlanGen::translate_int(const QueryGraph::SubQuery& query,
                                 p->left = rightPlan;
                                 p->right = leftPlan;
                                 p->next = 0;
-                                if ((p->cardinality = leftPlan->cardinality * rightPlan->cardinality * selectivity) < 1) p->cardinality = 1;
+                                if ((p->cardinality = (problem->starCardinality >= 0) ? problem->starCardinality : (leftPlan->cardinality * rightPlan->cardinality * selectivity)) < 1) p->cardinality = 1;
                                 p->costs = leftPlan->costs + rightPlan->costs + Costs::hashJoin(rightPlan->cardinality, leftPlan->cardinality);
                                 p->ordering = ~0u;
                                 addPlan(problem, p);
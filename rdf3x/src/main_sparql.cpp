@@ -212,7 +212,8 @@ void execNativeQuery(ProgramArgs &vm, Querier *q, KB &kb, bool silent) {
     std::unique_ptr<Query> query  = createQueryFromRF3XQueryGraph(parser,
             *queryGraph.get());
     TridentQueryPlan plan(q);
-    plan.create(*query.get(), SIMPLE);
+    plan.create(*query.get(), vm["planner"].as<string>() == "leapfrog" ?
+            LEAPFROG : SIMPLE);
     std::chrono::duration<double> durationO = std::chrono::system_clock::now() - start;
 
     //Output plan
@@ -5,6 +5,11 @@
 #include <kognac/logs.h>
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <chrono>
 //---------------------------------------------------------------------------
 // RDF-3X
 // (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
@@ -17,14 +22,28 @@
 //---------------------------------------------------------------------------
 using namespace std;
 //---------------------------------------------------------------------------
-static inline uint64_t hash1(uint64_t key, uint64_t hashTableSize) {
-    return key & (hashTableSize - 1);
+const uint32_t HashJoin::noEntry;
+//---------------------------------------------------------------------------
+static inline uint64_t hashKey(uint64_t key)
+    // Hash a key. The partition is taken from the high bits, the bucket from the low ones
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
 }
-static inline uint64_t hash2(uint64_t key, uint64_t hashTableSize) {
-    return hashTableSize + ((key ^ (key >> 3)) & (hashTableSize - 1));
+//---------------------------------------------------------------------------
+static inline uint64_t nextPow2(uint64_t value)
+    // The smallest power of two not smaller than value
+{
+    uint64_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
 }
 //---------------------------------------------------------------------------
-//
 void HashJoin::BuildHashTable::run()
     // Build the hash table
 {
@@ -42,11 +61,8 @@ void HashJoin::BuildHashTable::run()
     vector<ObservedDomainDescription> observedDomains;
     observedDomains.resize(domainRegs.size());
 
-    // Build the hash table from the left side
-    uint64_t hashTableSize = 1024;
-    uint64_t tailLength = join.leftTail.size();
-    join.hashTable.clear();
-    join.hashTable.resize(2 * hashTableSize);
+    // Materialize the left side
+    vector<uint64_t> input;
     for (uint64_t leftCount = join.left->first(); leftCount; leftCount = join.left->next()) {
         // Check the domain first
         bool joinCandidate = true;
@@ -59,67 +75,26 @@ void HashJoin::BuildHashTable::run()
         }
         if (!joinCandidate)
             continue;
-        // Compute the slots
-        uint64_t leftKey = leftValue->value;
-        uint64_t slot1 = hash1(leftKey, hashTableSize), slot2 = hash2(leftKey, hashTableSize);
-        // LOG(DEBUGL) << "leftKey = " << leftKey;
-
-        // Scan if the entry already exists
-        Entry* e = join.hashTable[slot1];
-        if ((!e) || (e->key != leftKey))
-            e = join.hashTable[slot2];
-        if (e && (e->key == leftKey)) {
-            uint64_t ofs = (e == join.hashTable[slot1]) ? slot1 : slot2;
-            bool match = false;
-            for (Entry* iter = e; iter; iter = iter->next)
-                if (leftKey == iter->key) {
-                    // Tuple already in the table?
-                    match = true;
-                    for (uint64_t index2 = 0; index2 < tailLength; index2++)
-                        if (join.leftTail[index2]->value != iter->values[index2]) {
-                            match = false;
-                            break;
-                        }
-                    // Then aggregate
-                    if (match) {
-                        iter->count += leftCount;
-                        break;
-                    }
-                }
-            if (match)
-                continue;
-
-            // Append to the current bucket
-            e = join.entryPool.alloc();
-            e->next = join.hashTable[ofs];
-            join.hashTable[ofs] = e;
-            e->key = leftKey;
-            e->count = leftCount;
-            for (uint64_t index2 = 0; index2 < tailLength; index2++)
-                e->values[index2] = join.leftTail[index2]->value;
-            continue;
-        }
-
-        // Create a new tuple
-        join.keys.push_back(leftKey);
-        e = join.entryPool.alloc();
-        e->next = 0;
-        e->key = leftKey;
-        e->count = leftCount;
-        for (uint64_t index2 = 0; index2 < tailLength; index2++)
-            e->values[index2] = join.leftTail[index2]->value;
-
-        // And insert it
-        join.insert(e);
-        hashTableSize = join.hashTable.size() / 2;
+        input.push_back(leftValue->value);
+        input.push_back(leftCount);
+        for (vector<Register*>::const_iterator iter = join.leftTail.begin(), limit = join.leftTail.end(); iter != limit; ++iter)
+            input.push_back((*iter)->value);
     }
 
+    // Build the hash table
+    join.build(input);
+
     // Update the domains
     for (uint64_t index = 0, limit = domainRegs.size(); index < limit; ++index)
         domainRegs[index]->domain->restrictTo(observedDomains[index]);
     if (join.bitset != 0) {
         join.right->setHashKeys(&join.keys, join.bitset);
     }
+    // Sideways information passing: the probe side skips the keys that cannot join
+    if ((!join.leftOptional) && leftValue->domain) {
+        join.filter.build(join.keys);
+        join.right->setJoinFilter(&join.filter, leftValue->domain);
+    }
 
     done = true;
 }
@@ -135,11 +110,12 @@ void HashJoin::ProbePeek::run()
 }
 //---------------------------------------------------------------------------
 HashJoin::HashJoin(Operator* left, Register* leftValue, const vector<Register*>& leftTail, Operator* right, Register* rightValue, const vector<Register*>& rightTail, double hashPriority,
-        double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset)
+        double probePriority, double expectedOutputCardinality, bool leftOptional, bool rightOptional, int bitset, unsigned threads)
     : Operator(expectedOutputCardinality), left(left), right(right), leftValue(leftValue), rightValue(rightValue),
-    leftTail(leftTail), rightTail(rightTail), entryPool(leftTail.size() * sizeof(uint64_t)),
-    bitset(bitset), buildHashTableTask(*this), probePeekTask(*this), hashPriority(hashPriority), probePriority(probePriority),
-    leftOptional(leftOptional), rightOptional(rightOptional)
+    leftTail(leftTail), rightTail(rightTail), partitionBits(0), hashTableIter(noEntry), rightCount(0),
+    bitset(bitset), threads(threads ? threads : 1), probeSize(0), probePos(0), probeMore(false),
+    buildHashTableTask(*this), probePeekTask(*this), hashPriority(hashPriority), probePriority(probePriority),
+    leftOptional(leftOptional), rightOptional(rightOptional), joinSuccedeed(false), currentIdx(0)
       // Constructor
 {
 }
@@ -151,41 +127,231 @@ HashJoin::~HashJoin()
     delete right;
 }
 //---------------------------------------------------------------------------
-void HashJoin::insert(Entry* e)
-    // Insert into the hash table
+uint64_t HashJoin::getPartition(uint64_t hash) const
+    // The partition of a hash
 {
-    uint64_t hashTableSize = hashTable.size() / 2;
-    // Try to insert
-    bool firstTable = true;
-    for (uint64_t index = 0; index < hashTableSize; index++) {
-        uint64_t slot = firstTable ? hash1(e->key, hashTableSize) : hash2(e->key, hashTableSize);
-        swap(e, hashTable[slot]);
-        if (!e)
+    return partitionBits ? (hash >> (64 - partitionBits)) : 0;
+}
+//---------------------------------------------------------------------------
+uint32_t HashJoin::findKey(uint32_t entry, uint64_t key) const
+    // Skip the entries of a chain with a different key
+{
+    const uint64_t stride = 2 + leftTail.size();
+    while ((entry != noEntry) && (entries[entry * stride] != key))
+        entry = chain[entry];
+    return entry;
+}
+//---------------------------------------------------------------------------
+void HashJoin::build(vector<uint64_t>& input)
+    // Partition the materialized left side and build the chains of every partition
+{
+    const uint64_t stride = 2 + leftTail.size();
+    const uint64_t n = input.size() / stride;
+    if (n >= noEntry) {
+        LOG(ERRORL) << "The hash table cannot contain " << n << " entries";
+        throw 10;
+    }
+
+    // Choose the number of partitions and threads
+    uint64_t partitionCount = nextPow2((n + HASHJOIN_PARTITION_SIZE - 1) / HASHJOIN_PARTITION_SIZE);
+    if (partitionCount > HASHJOIN_MAX_PARTITIONS)
+        partitionCount = HASHJOIN_MAX_PARTITIONS;
+    partitionBits = 0;
+    while ((1ull << partitionBits) < partitionCount)
+        partitionBits++;
+    unsigned nthreads = (n >= HASHJOIN_PARALLEL_MIN) ? threads : 1;
+    const uint64_t chunk = (n + nthreads - 1) / nthreads;
+
+    // Count the entries of every partition in every range of the input
+    vector<vector<uint64_t> > histograms(nthreads, vector<uint64_t>(partitionCount + 1));
+    auto count = [&](unsigned t) {
+        vector<uint64_t>& histogram = histograms[t];
+        for (uint64_t index = t * chunk, limit = min(n, (t + 1) * chunk); index < limit; ++index)
+            histogram[getPartition(hashKey(input[index * stride]))]++;
+    };
+    // Copy the entries of a range to their partition
+    auto scatter = [&](unsigned t) {
+        vector<uint64_t>& offsets = histograms[t];
+        for (uint64_t index = t * chunk, limit = min(n, (t + 1) * chunk); index < limit; ++index) {
+            const uint64_t* tuple = &input[index * stride];
+            uint64_t* target = &entries[(offsets[getPartition(hashKey(tuple[0]))]++) * stride];
+            for (uint64_t index2 = 0; index2 < stride; index2++)
+                target[index2] = tuple[index2];
+        }
+    };
+    // Build the partitions, taking them from a shared counter
+    atomic<uint64_t> nextPartition(0);
+    vector<uint64_t> partitionBegin(partitionCount + 1);
+    vector<vector<uint64_t> > partialKeys(nthreads);
+    auto buildPartitions = [&](unsigned t) {
+        for (uint64_t partition = nextPartition++; partition < partitionCount; partition = nextPartition++)
+            buildPartition(partition, partitionBegin[partition], partitionBegin[partition + 1], partialKeys[t]);
+    };
+    auto runAll = [&](const function<void(unsigned)>& task) {
+        if (nthreads == 1) {
+            task(0);
             return;
-        firstTable = !firstTable;
+        }
+        vector<thread> workers;
+        for (unsigned t = 0; t < nthreads; t++)
+            workers.push_back(thread(task, t));
+        for (vector<thread>::iterator iter = workers.begin(), limit = workers.end(); iter != limit; ++iter)
+            iter->join();
+    };
+
+    runAll(count);
+    // Compute where every range writes in every partition
+    uint64_t offset = 0;
+    for (uint64_t partition = 0; partition < partitionCount; partition++) {
+        partitionBegin[partition] = offset;
+        for (unsigned t = 0; t < nthreads; t++) {
+            uint64_t size = histograms[t][partition];
+            histograms[t][partition] = offset;
+            offset += size;
+        }
+    }
+    partitionBegin[partitionCount] = offset;
+    entries.resize(n * stride);
+    runAll(scatter);
+    vector<uint64_t>().swap(input);
+
+    chain.assign(n, noEntry);
+    partitions.clear();
+    partitions.resize(partitionCount);
+    runAll(buildPartitions);
+    keys.clear();
+    for (vector<vector<uint64_t> >::const_iterator iter = partialKeys.begin(), limit = partialKeys.end(); iter != limit; ++iter)
+        keys.insert(keys.end(), iter->begin(), iter->end());
+}
+//---------------------------------------------------------------------------
+void HashJoin::buildPartition(uint64_t partition, uint64_t begin, uint64_t end, vector<uint64_t>& partitionKeys)
+    // Build the chains of a partition
+{
+    const uint64_t stride = 2 + leftTail.size();
+    Partition& p = partitions[partition];
+    uint64_t bucketCount = nextPow2(end - begin);
+    p.mask = bucketCount - 1;
+    p.buckets.assign(bucketCount, noEntry);
+
+    for (uint64_t index = begin; index < end; index++) {
+        uint64_t* e = &entries[index * stride];
+        uint32_t& bucket = p.buckets[hashKey(e[0]) & p.mask];
+
+        // Aggregate the tuples that are already in the table
+        bool newKey = true, match = false;
+        for (uint32_t iter = findKey(bucket, e[0]); iter != noEntry; iter = findKey(chain[iter], e[0])) {
+            newKey = false;
+            uint64_t* other = &entries[static_cast<uint64_t>(iter) * stride];
+            match = true;
+            for (uint64_t index2 = 2; index2 < stride; index2++)
+                if (e[index2] != other[index2]) {
+                    match = false;
+                    break;
+                }
+            if (match) {
+                other[1] += e[1];
+                e[1] = 0;
+                break;
+            }
+        }
+        if (match)
+            continue;
+        if (newKey)
+            partitionKeys.push_back(e[0]);
+
+        // Prepend to the chain of the bucket
+        chain[index] = bucket;
+        bucket = index;
+    }
+}
+//---------------------------------------------------------------------------
+bool HashJoin::fillProbeBatch(uint64_t count)
+    // Read a batch of tuples from the probe side, starting with the current one
+{
+    const uint64_t width = 2 + rightTail.size();
+    if (probeBatch.size() < HASHJOIN_PROBE_BATCH * width) {
+        probeBatch.resize(HASHJOIN_PROBE_BATCH * width);
+        probeHeads.resize(HASHJOIN_PROBE_BATCH);
+    }
+
+    // Collect the tuples
+    probeSize = 0;
+    probePos = 0;
+    probeMore = true;
+    while (true) {
+        uint64_t* tuple = &probeBatch[probeSize * width];
+        tuple[0] = count;
+        tuple[1] = rightValue->value;
+        for (uint64_t index = 0, limit = rightTail.size(); index < limit; ++index)
+            tuple[2 + index] = rightTail[index]->value;
+        if (++probeSize == HASHJOIN_PROBE_BATCH)
+            break;
+        if ((count = right->next()) == 0) {
+            probeMore = false;
+            break;
+        }
     }
 
-    // No place found, rehash
-    vector<Entry*> oldTable;
-    oldTable.resize(4 * hashTableSize);
-    swap(hashTable, oldTable);
-    for (vector<Entry*>::const_iterator iter = oldTable.begin(), limit = oldTable.end(); iter != limit; ++iter)
-        if (*iter)
-            insert(*iter);
-    insert(e);
+    // Find the buckets, fetching them for the whole batch before they are read
+    if (partitions.empty()) {
+        for (size_t index = 0; index < probeSize; index++)
+            probeHeads[index] = noEntry;
+        return true;
+    }
+    for (size_t index = 0; index < probeSize; index++) {
+        uint64_t hash = hashKey(probeBatch[index * width + 1]);
+        const Partition& p = partitions[getPartition(hash)];
+        const uint32_t* bucket = &p.buckets[hash & p.mask];
+        probeHeads[index] = static_cast<uint32_t>(hash & p.mask);
+#if defined(__GNUC__)
+        __builtin_prefetch(bucket);
+#else
+        (void) bucket;
+#endif
+    }
+    const uint64_t stride = 2 + leftTail.size();
+    for (size_t index = 0; index < probeSize; index++) {
+        const Partition& p = partitions[getPartition(hashKey(probeBatch[index * width + 1]))];
+        uint32_t entry = p.buckets[probeHeads[index]];
+        probeHeads[index] = entry;
+#if defined(__GNUC__)
+        if (entry != noEntry)
+            __builtin_prefetch(&entries[static_cast<uint64_t>(entry) * stride]);
+#endif
+    }
+    for (size_t index = 0; index < probeSize; index++)
+        probeHeads[index] = findKey(probeHeads[index], probeBatch[index * width + 1]);
+    return true;
 }
 //---------------------------------------------------------------------------
-HashJoin::Entry* HashJoin::lookup(uint64_t key)
-    // Search an entry in the hash table
+bool HashJoin::nextProbeTuple()
+    // Move to the next tuple of the probe side
 {
-    uint64_t hashTableSize = hashTable.size() / 2;
-    Entry* e = hashTable[hash1(key, hashTableSize)];
-    if (e && (e->key == key))
-        return e;
-    e = hashTable[hash2(key, hashTableSize)];
-    if (e && (e->key == key))
-        return e;
-    return 0;
+    if (probePos == probeSize) {
+        if (!probeMore)
+            return false;
+        uint64_t count = right->next();
+        if (count == 0) {
+            probeMore = false;
+            return false;
+        }
+        fillProbeBatch(count);
+    }
+
+    // Restore the registers of the probe side
+    const uint64_t width = 2 + rightTail.size();
+    const uint64_t* tuple = &probeBatch[probePos * width];
+    rightCount = tuple[0];
+    rightValue->value = tuple[1];
+    for (uint64_t index = 0, limit = rightTail.size(); index < limit; ++index)
+        rightTail[index]->value = tuple[2 + index];
+    hashTableIter = probeHeads[probePos++];
+
+    joinSuccedeed = hashTableIter != noEntry;
+    if (rightOptional && joinSuccedeed) {
+        collectedRightValues.insert(rightValue->value);
+    }
+    return true;
 }
 //---------------------------------------------------------------------------
 uint64_t HashJoin::first()
@@ -193,41 +359,45 @@ uint64_t HashJoin::first()
 {
     currentIdx = (size_t) -1;
     observedOutputCardinality = 0;
+    collectedRightValues.clear();
     // Build the hash table if not already done
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     buildHashTableTask.run();
     std::chrono::duration<double> sec = std::chrono::system_clock::now()
         - start;
-    LOG(INFOL) << "Runtime building hashtable = " << sec.count() * 1000 << " milliseconds";
+    LOG(DEBUGL) << "Runtime building hashtable = " << sec.count() * 1000 << " milliseconds";
 
-    // Read the first tuple from the right side
+    // Read the first batch from the right side
     probePeekTask.run();
-    if (((rightCount = probePeekTask.count) == 0) && !leftOptional) {
+    probeSize = probePos = 0;
+    probeMore = false;
+    hashTableIter = noEntry;
+    joinSuccedeed = true;
+    if ((rightCount = probePeekTask.count) != 0) {
+        fillProbeBatch(rightCount);
+        nextProbeTuple();
+    } else if (!rightOptional) {
         return false;
     }
 
-    // Setup the lookup
-    hashTableIter = lookup(rightValue->value);
-    joinSuccedeed = hashTableIter != NULL;
-    if (rightOptional && joinSuccedeed) {
-        collectedRightValues.insert(rightValue->value);
-    }
-
     return next();
 }
 //---------------------------------------------------------------------------
 uint64_t HashJoin::next()
     // Produce the next tuple
 {
+    const uint64_t stride = 2 + leftTail.size();
     if (currentIdx != (size_t) -1) {
-        Entry *e;
-        while (currentIdx < hashTable.size()) {
-            if ((e = hashTable[currentIdx++])
-                    && !collectedRightValues.count(e->key)) {
-                for (uint64_t index = 0, limit = leftTail.size();
-                        index < limit; ++index)
-                    leftTail[index]->value = e->values[index];
-                return e->count;
+        // Return the entries that did not join
+        while (currentIdx < chain.size()) {
+            const uint64_t* e = &entries[(currentIdx++) * stride];
+            if (e[1] && !collectedRightValues.count(e[0])) {
+                leftValue->value = e[0];
+                rightValue->value = e[0];
+                for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
+                    leftTail[index]->value = e[2 + index];
+                observedOutputCardinality += e[1];
+                return e[1];
             }
         }
         return false;
@@ -236,14 +406,13 @@ uint64_t HashJoin::next()
     // Repeat until a match is found
     while (true) {
         // Still scanning the hash table?
-        bool elementToProcess = false;
-        for (; hashTableIter; hashTableIter = hashTableIter->next) {
-            elementToProcess = true;
-            uint64_t leftCount = hashTableIter->count;
-            leftValue->value = hashTableIter->key;
+        if (hashTableIter != noEntry) {
+            const uint64_t* e = &entries[static_cast<uint64_t>(hashTableIter) * stride];
+            uint64_t leftCount = e[1];
+            leftValue->value = e[0];
             for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
-                leftTail[index]->value = hashTableIter->values[index];
-            hashTableIter = hashTableIter->next;
+                leftTail[index]->value = e[2 + index];
+            hashTableIter = findKey(chain[hashTableIter], e[0]);
 
             uint64_t count = leftCount * rightCount;
             observedOutputCardinality += count;
@@ -251,21 +420,17 @@ uint64_t HashJoin::next()
         }
 
         //First we finish all joins
-        if (!elementToProcess && !joinSuccedeed && leftOptional) {
+        if (!joinSuccedeed && leftOptional) {
             joinSuccedeed = true;
             //Set the hash values to NULL
             for (uint64_t index = 0, limit = leftTail.size(); index < limit; ++index)
                 leftTail[index]->value = ~0u;
+            observedOutputCardinality += rightCount;
             return rightCount;
         }
 
         // Read the next tuple from the right
-	// But only if rightCount != 0
-	if (rightCount == 0) {
-	    return false;
-	}
-	rightCount = right->next();
-        if (rightCount == 0) {
+        if (!nextProbeTuple()) {
             if (!rightOptional) {
                 return false;
             } else {
@@ -277,12 +442,6 @@ uint64_t HashJoin::next()
                 return next();
             }
         }
-
-        hashTableIter = lookup(rightValue->value);
-        joinSuccedeed = hashTableIter != NULL;
-        if (rightOptional && joinSuccedeed) {
-            collectedRightValues.insert(rightValue->value);
-        }
     }
 }
 //---------------------------------------------------------------------------
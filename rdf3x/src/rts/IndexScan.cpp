@@ -1,6 +1,9 @@
 #include "rts/operator/IndexScan.hpp"
 #include "rts/operator/PlanPrinter.hpp"
 #include "rts/runtime/Runtime.hpp"
+#include "rts/runtime/JoinFilter.hpp"
+#include <algorithm>
+#include <cassert>
 //---------------------------------------------------------------------------
 // RDF-3X
 // (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
@@ -137,6 +140,183 @@ public:
     uint64_t next();
 };
 //---------------------------------------------------------------------------
+/// A scan that stops at the end of a morsel
+class IndexScan::MorselScan : public DBLayer::Scan {
+private:
+    /// The scan
+    std::unique_ptr<DBLayer::Scan> scan;
+    /// The value that is split in morsels
+    unsigned column;
+    /// The morsel
+    uint64_t from, to;
+
+    /// Move to the beginning of the morsel
+    bool start(bool found);
+    /// Check the end of the morsel
+    bool check() { return ((column == 1) ? scan->getValue1() : scan->getValue2()) < to; }
+
+public:
+    /// Constructor
+    MorselScan(std::unique_ptr<DBLayer::Scan> scan, unsigned column) : scan(std::move(scan)), column(column), from(0), to(~0ull) {}
+
+    /// Set the morsel
+    void setMorsel(uint64_t from, uint64_t to) { this->from = from; this->to = to; }
+
+    uint64_t getValue1() { return scan->getValue1(); }
+    uint64_t getValue2() { return scan->getValue2(); }
+    uint64_t getValue3() { return scan->getValue3(); }
+    uint64_t getCount() { return scan->getCount(); }
+    bool next() { return scan->next() && check(); }
+    bool first() { return start(scan->first()); }
+    bool first(uint64_t v1, bool c1) { return start(scan->first(v1, c1)); }
+    bool first(uint64_t v1, bool c1, uint64_t v2, bool c2) { return start(scan->first(v1, c1, v2, c2)); }
+    bool first(uint64_t v1, bool c1, uint64_t v2, bool c2, uint64_t v3, bool c3) { return start(scan->first(v1, c1, v2, c2, v3, c3)); }
+    bool skipTo(uint64_t value1, uint64_t value2) { return scan->skipTo(value1, value2) && check(); }
+};
+//---------------------------------------------------------------------------
+bool IndexScan::MorselScan::start(bool found)
+    // Move to the beginning of the morsel
+{
+    if (!found)
+        return false;
+    if (column == 1) {
+        if (!scan->skipTo(from, 0))
+            return false;
+    } else {
+        if (!scan->skipTo(scan->getValue1(), from))
+            return false;
+    }
+    return check();
+}
+//---------------------------------------------------------------------------
+/// A scan that skips the values rejected by the join filters or excluded by the filters above
+class IndexScan::FilteredScan : public DBLayer::Scan {
+private:
+    /// The scan
+    std::unique_ptr<DBLayer::Scan> scan;
+    /// The filters of every value
+    std::vector<const JoinFilter*> filters[3];
+    /// The excluded ranges of every value
+    std::vector<std::pair<uint64_t, uint64_t> > excluded[3];
+    /// Is the first value bound? Then the scan ends with the first value
+    bool bound1;
+
+    /// Move to the first triple that passes the filters
+    bool skip(bool found);
+
+public:
+    /// Constructor
+    FilteredScan(std::unique_ptr<DBLayer::Scan> scan, bool bound1) : scan(std::move(scan)), bound1(bound1) {}
+
+    /// Add a filter
+    void addFilter(unsigned column, const JoinFilter* filter);
+    /// Add an excluded range
+    void addExclusion(unsigned column, uint64_t from, uint64_t to) { excluded[column].push_back(std::make_pair(from, to)); }
+
+    uint64_t getValue1() { return scan->getValue1(); }
+    uint64_t getValue2() { return scan->getValue2(); }
+    uint64_t getValue3() { return scan->getValue3(); }
+    uint64_t getCount() { return scan->getCount(); }
+    bool next() { return skip(scan->next()); }
+    bool first() { return skip(scan->first()); }
+    bool first(uint64_t v1, bool c1) { return skip(scan->first(v1, c1)); }
+    bool first(uint64_t v1, bool c1, uint64_t v2, bool c2) { return skip(scan->first(v1, c1, v2, c2)); }
+    bool first(uint64_t v1, bool c1, uint64_t v2, bool c2, uint64_t v3, bool c3) { return skip(scan->first(v1, c1, v2, c2, v3, c3)); }
+    bool skipTo(uint64_t value1, uint64_t value2) { return skip(scan->skipTo(value1, value2)); }
+};
+//---------------------------------------------------------------------------
+void IndexScan::FilteredScan::addFilter(unsigned column, const JoinFilter* filter)
+    // Add a filter
+{
+    std::vector<const JoinFilter*>& f = filters[column];
+    if (std::find(f.begin(), f.end(), filter) == f.end())
+        f.push_back(filter);
+}
+//---------------------------------------------------------------------------
+static const std::pair<uint64_t, uint64_t>* findExclusion(const std::vector<std::pair<uint64_t, uint64_t> >& excluded, uint64_t value)
+    // Find the excluded range that contains a value
+{
+    for (std::vector<std::pair<uint64_t, uint64_t> >::const_iterator iter = excluded.begin(), limit = excluded.end(); iter != limit; ++iter)
+        if ((value >= iter->first) && (value <= iter->second))
+            return &(*iter);
+    return 0;
+}
+//---------------------------------------------------------------------------
+bool IndexScan::FilteredScan::skip(bool found)
+    // Move to the first triple that passes the filters
+{
+    while (found) {
+        // The first value is sorted, jump to the next candidate
+        if (!filters[0].empty()) {
+            uint64_t v1 = scan->getValue1();
+            uint64_t c = JoinFilter::nextCandidate(filters[0], v1);
+            if (!(~c))
+                return false;
+            if (c > v1) {
+                found = scan->skipTo(c, 0);
+                continue;
+            }
+            if (!JoinFilter::couldQualify(filters[0], v1)) {
+                found = scan->skipTo(v1 + 1, 0);
+                continue;
+            }
+        }
+        if (!excluded[0].empty()) {
+            const std::pair<uint64_t, uint64_t>* range = findExclusion(excluded[0], scan->getValue1());
+            if (range) {
+                if (!~(range->second))
+                    return false;
+                found = scan->skipTo(range->second + 1, 0);
+                continue;
+            }
+        }
+        // The second value is sorted for every first value
+        if (!filters[1].empty()) {
+            uint64_t v1 = scan->getValue1(), v2 = scan->getValue2();
+            uint64_t c = JoinFilter::nextCandidate(filters[1], v2);
+            if (!(~c)) {
+                if (bound1)
+                    return false;
+                found = scan->skipTo(v1 + 1, 0);
+                continue;
+            }
+            if (c > v2) {
+                found = scan->skipTo(v1, c);
+                continue;
+            }
+            if (!JoinFilter::couldQualify(filters[1], v2)) {
+                found = scan->skipTo(v1, v2 + 1);
+                continue;
+            }
+        }
+        if (!excluded[1].empty()) {
+            uint64_t v1 = scan->getValue1();
+            const std::pair<uint64_t, uint64_t>* range = findExclusion(excluded[1], scan->getValue2());
+            if (range) {
+                if (~(range->second)) {
+                    found = scan->skipTo(v1, range->second + 1);
+                } else if (bound1 || (!~v1)) {
+                    return false;
+                } else {
+                    found = scan->skipTo(v1 + 1, 0);
+                }
+                continue;
+            }
+        }
+        // The third value can only be checked
+        if ((!filters[2].empty()) && (!JoinFilter::couldQualify(filters[2], scan->getValue3()))) {
+            found = scan->next();
+            continue;
+        }
+        if ((!excluded[2].empty()) && findExclusion(excluded[2], scan->getValue3())) {
+            found = scan->next();
+            continue;
+        }
+        return true;
+    }
+    return false;
+}
+//---------------------------------------------------------------------------
 IndexScan::IndexScanHint::IndexScanHint(IndexScan& scan)
     : scan(scan)
       // Constructor
@@ -223,7 +403,7 @@ void IndexScan::IndexScanHint::next(uint64_t& value1, uint64_t& value2, uint64_t
 //---------------------------------------------------------------------------
 IndexScan::IndexScan(DBLayer& db, DBLayer::DataOrder order, Register* value1, bool bound1, Register* value2, bool bound2, Register* value3, bool bound3, double expectedOutputCardinality)
     : Operator(expectedOutputCardinality), value1(value1), value2(value2), value3(value3), bound1(bound1), bound2(bound2), bound3(bound3)/*,facts(db.getFacts(order))*/, order(order),
-      hint(*this), scan(db.getScan(order, DBLayer::AGGR_NO, &hint))
+      hint(*this), scan(db.getScan(order, DBLayer::AGGR_NO, &hint)), morsel(0), filtered(0)
       //,scan(disableSkipping?0:&hint),hint(*this)
       // Constructor
 {
@@ -312,6 +492,61 @@ void IndexScan::getAsyncInputCandidates(Scheduler& /*scheduler*/)
 {
 }
 //---------------------------------------------------------------------------
+unsigned IndexScan::getMorselColumn() const
+    // The value that is split in morsels
+{
+    if (!bound1)
+        return 1;
+    if (!bound2)
+        return 2;
+    return 0;
+}
+//---------------------------------------------------------------------------
+void IndexScan::setMorsel(uint64_t from, uint64_t to)
+    // Restrict the next executions to a morsel
+{
+    if (!morsel) {
+        assert(getMorselColumn());
+        morsel = new MorselScan(std::move(scan), getMorselColumn());
+        scan.reset(morsel);
+    }
+    morsel->setMorsel(from, to);
+}
+//---------------------------------------------------------------------------
+void IndexScan::setJoinFilter(const JoinFilter* filter, const PotentialDomainDescription* domain)
+    // Skip the values of a domain that do not pass a join filter
+{
+    Register* values[3] = {value1, value2, value3};
+    bool bounds[3] = {bound1, bound2, bound3};
+    for (unsigned column = 0; column < 3; column++) {
+        if (bounds[column] || (values[column]->domain != domain))
+            continue;
+        getFilteredScan()->addFilter(column, filter);
+    }
+}
+//---------------------------------------------------------------------------
+void IndexScan::excludeValues(Register* reg, uint64_t from, uint64_t to)
+    // Skip the values of a register in [from,to]
+{
+    Register* values[3] = {value1, value2, value3};
+    bool bounds[3] = {bound1, bound2, bound3};
+    for (unsigned column = 0; column < 3; column++) {
+        if (bounds[column] || (values[column] != reg))
+            continue;
+        getFilteredScan()->addExclusion(column, from, to);
+    }
+}
+//---------------------------------------------------------------------------
+IndexScan::FilteredScan* IndexScan::getFilteredScan()
+    // Get the filtered scan
+{
+    if (!filtered) {
+        filtered = new FilteredScan(std::move(scan), bound1);
+        scan.reset(filtered);
+    }
+    return filtered;
+}
+//---------------------------------------------------------------------------
 IndexScan* IndexScan::create(DBLayer& db, DBLayer::DataOrder order, Register* subject, bool subjectBound, Register* predicate, bool predicateBound, Register* object, bool objectBound, double expectedOutputCardinality)
 // Constructor
 {
@@ -0,0 +1,139 @@
+#include "rts/runtime/JoinFilter.hpp"
+#include <algorithm>
+//---------------------------------------------------------------------------
+// Protect against messy system headers under Windows
+#undef min
+#undef max
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+static inline uint64_t hashValue(uint64_t value)
+   // Hash a value (the finalizer of MurmurHash3)
+{
+   value^=value>>33;
+   value*=0xff51afd7ed558ccdull;
+   value^=value>>33;
+   value*=0xc4ceb9fe1a85ec53ull;
+   value^=value>>33;
+   return value;
+}
+//---------------------------------------------------------------------------
+inline uint64_t JoinFilter::bloomBits(uint64_t hash)
+   // The bits of a key in its bloom filter word
+{
+   return (1ull<<((hash>>40)&63))|(1ull<<((hash>>46)&63))|(1ull<<((hash>>52)&63));
+}
+//---------------------------------------------------------------------------
+JoinFilter::JoinFilter()
+   : min(~0ull),max(0),rangeShift(0),bloomMask(0)
+   // Constructor
+{
+}
+//---------------------------------------------------------------------------
+void JoinFilter::build(const vector<uint64_t>& keys)
+   // Build the filter from the distinct keys
+{
+   ranges.clear();
+   bloom.clear();
+   min=~0ull; max=0;
+   if (keys.empty())
+      return;
+   for (vector<uint64_t>::const_iterator iter=keys.begin(),limit=keys.end();iter!=limit;++iter) {
+      if ((*iter)<min) min=*iter;
+      if ((*iter)>max) max=*iter;
+   }
+
+   // The ranges
+   rangeShift=0;
+   while (((max-min)>>rangeShift)>=JOINFILTER_RANGES)
+      rangeShift++;
+   ranges.assign((((max-min)>>rangeShift)>>6)+1,0);
+   for (vector<uint64_t>::const_iterator iter=keys.begin(),limit=keys.end();iter!=limit;++iter) {
+      uint64_t range=((*iter)-min)>>rangeShift;
+      ranges[range>>6]|=1ull<<(range&63);
+   }
+
+   // The bloom filter
+   uint64_t words=1;
+   while ((words<<6)<keys.size()*JOINFILTER_BITS_PER_KEY)
+      words<<=1;
+   bloom.assign(words,0);
+   bloomMask=words-1;
+   for (vector<uint64_t>::const_iterator iter=keys.begin(),limit=keys.end();iter!=limit;++iter) {
+      uint64_t hash=hashValue(*iter);
+      bloom[hash&bloomMask]|=bloomBits(hash);
+   }
+}
+//---------------------------------------------------------------------------
+bool JoinFilter::couldQualify(uint64_t value) const
+   // Could this value qualify?
+{
+   if ((value<min)||(value>max))
+      return false;
+   uint64_t range=(value-min)>>rangeShift;
+   if (!(ranges[range>>6]&(1ull<<(range&63))))
+      return false;
+   uint64_t hash=hashValue(value),bits=bloomBits(hash);
+   return (bloom[hash&bloomMask]&bits)==bits;
+}
+//---------------------------------------------------------------------------
+uint64_t JoinFilter::nextCandidate(uint64_t value) const
+   // Return the next value >= value that could qualify (or ~0ull)
+{
+   if (value<min) value=min;
+   if (value>max) return ~0ull;
+
+   // Find the next non-empty range
+   uint64_t range=(value-min)>>rangeShift;
+   uint64_t slot=range>>6,entry=ranges[slot]&((~0ull)<<(range&63));
+   while (!entry) {
+      if (++slot==ranges.size())
+         return ~0ull;
+      entry=ranges[slot];
+   }
+   uint64_t next=slot<<6;
+   while (!(entry&1)) {
+      entry>>=1;
+      next++;
+   }
+   if (next==range)
+      return value;
+   return min+(next<<rangeShift);
+}
+//---------------------------------------------------------------------------
+uint64_t JoinFilter::nextCandidate(const vector<const JoinFilter*>& filters,uint64_t value)
+   // The smallest value >= value that could qualify for all filters (or ~0ull)
+{
+   // Move forward until all filters agree
+   bool changed=true;
+   while (changed&&(~value)) {
+      changed=false;
+      for (vector<const JoinFilter*>::const_iterator iter=filters.begin(),limit=filters.end();iter!=limit;++iter) {
+         uint64_t next=(*iter)->nextCandidate(value);
+         if (next!=value) {
+            value=next;
+            changed=true;
+         }
+      }
+   }
+   return value;
+}
+//---------------------------------------------------------------------------
+bool JoinFilter::couldQualify(const vector<const JoinFilter*>& filters,uint64_t value)
+   // Could this value qualify for all filters?
+{
+   for (vector<const JoinFilter*>::const_iterator iter=filters.begin(),limit=filters.end();iter!=limit;++iter)
+      if (!(*iter)->couldQualify(value))
+         return false;
+   return true;
+}
+//---------------------------------------------------------------------------
@@ -0,0 +1,170 @@
+#include "rts/operator/MorselGather.hpp"
+#include "rts/operator/IndexScan.hpp"
+#include "rts/operator/PlanPrinter.hpp"
+#include <string>
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+MorselGather::MorselGather(const std::vector<Register*>& output,std::vector<std::unique_ptr<Pipeline> >& pipelines,uint64_t domainSize,double expectedOutputCardinality)
+   : Operator(expectedOutputCardinality),output(output),nextMorsel(0),stopped(true),running(0),currentPos(0)
+   // Constructor
+{
+   for (std::vector<std::unique_ptr<Pipeline> >::iterator iter=pipelines.begin(),limit=pipelines.end();iter!=limit;++iter)
+      this->pipelines.push_back(std::move(*iter));
+   pipelines.clear();
+   morsels=this->pipelines.size()*MORSELS_PER_WORKER;
+   morselSize=domainSize/morsels+1;
+}
+//---------------------------------------------------------------------------
+MorselGather::~MorselGather()
+   // Destructor
+{
+   stop();
+}
+//---------------------------------------------------------------------------
+bool MorselGather::push(std::vector<uint64_t>& chunk)
+   // Hand over a chunk
+{
+   std::unique_lock<std::mutex> lock(mutex);
+   while ((!stopped)&&(chunks.size()>=MORSEL_QUEUE*pipelines.size()))
+      chunkTaken.wait(lock);
+   if (stopped)
+      return false;
+   chunks.push_back(std::vector<uint64_t>());
+   chunks.back().swap(chunk);
+   chunkReady.notify_one();
+   return true;
+}
+//---------------------------------------------------------------------------
+void MorselGather::work(Pipeline* pipeline)
+   // Run a pipeline on the morsels
+{
+   const std::vector<IndexScan*>& scans=pipeline->runtime->getMorselScans();
+   const std::vector<Register*>& regs=pipeline->output;
+   const size_t chunkSize=MORSEL_CHUNK*(regs.size()+1);
+   std::vector<uint64_t> chunk;
+   chunk.reserve(chunkSize);
+   try {
+      bool more=true;
+      for (uint64_t morsel=nextMorsel++;more&&(!stopped)&&(morsel<morsels);morsel=nextMorsel++) {
+         // Restrict the scans to the morsel. The last one is open-ended
+         uint64_t from=morsel*morselSize,to=(morsel+1==morsels)?~0ull:(from+morselSize);
+         for (std::vector<IndexScan*>::const_iterator iter=scans.begin(),limit=scans.end();iter!=limit;++iter)
+            (*iter)->setMorsel(from,to);
+
+         for (uint64_t count=pipeline->tree->first();count;count=pipeline->tree->next()) {
+            chunk.push_back(count);
+            for (std::vector<Register*>::const_iterator iter=regs.begin(),limit=regs.end();iter!=limit;++iter)
+               chunk.push_back((*iter)->value);
+            if (chunk.size()>=chunkSize) {
+               if (!(more=push(chunk)))
+                  break;
+               chunk.reserve(chunkSize);
+            }
+         }
+      }
+      if (more&&(!chunk.empty()))
+         push(chunk);
+   } catch (...) {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!error)
+         error=std::current_exception();
+   }
+
+   std::unique_lock<std::mutex> lock(mutex);
+   running--;
+   chunkReady.notify_all();
+}
+//---------------------------------------------------------------------------
+void MorselGather::stop()
+   // Stop the workers and wait for them
+{
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      stopped=true;
+      chunkTaken.notify_all();
+   }
+   for (std::vector<std::thread>::iterator iter=threads.begin(),limit=threads.end();iter!=limit;++iter)
+      iter->join();
+   threads.clear();
+}
+//---------------------------------------------------------------------------
+uint64_t MorselGather::first()
+   // Produce the first tuple
+{
+   stop();
+   observedOutputCardinality=0;
+   chunks.clear();
+   current.clear();
+   currentPos=0;
+   error=nullptr;
+   nextMorsel=0;
+   stopped=false;
+   running=pipelines.size();
+   for (std::vector<std::unique_ptr<Pipeline> >::iterator iter=pipelines.begin(),limit=pipelines.end();iter!=limit;++iter)
+      threads.push_back(std::thread(&MorselGather::work,this,iter->get()));
+   return next();
+}
+//---------------------------------------------------------------------------
+uint64_t MorselGather::next()
+   // Produce the next tuple
+{
+   if (currentPos>=current.size()) {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (chunks.empty()&&running&&(!error))
+         chunkReady.wait(lock);
+      if (error) {
+         std::exception_ptr e=error;
+         lock.unlock();
+         stop();
+         std::rethrow_exception(e);
+      }
+      if (chunks.empty()) {
+         lock.unlock();
+         stop();
+         return false;
+      }
+      current.swap(chunks.front());
+      chunks.pop_front();
+      currentPos=0;
+      chunkTaken.notify_one();
+   }
+
+   uint64_t count=current[currentPos++];
+   for (std::vector<Register*>::const_iterator iter=output.begin(),limit=output.end();iter!=limit;++iter)
+      (*iter)->value=current[currentPos++];
+   observedOutputCardinality+=count;
+   return count;
+}
+//---------------------------------------------------------------------------
+void MorselGather::print(PlanPrinter& out)
+   // Print the operator tree. Debugging only.
+{
+   out.beginOperator("MorselGather",expectedOutputCardinality,observedOutputCardinality);
+   out.addGenericAnnotation(std::to_string(pipelines.size())+" workers, "+std::to_string(morsels)+" morsels");
+   out.addMaterializationAnnotation(output);
+   // The pipelines are all the same, but their registers belong to another runtime
+   if (!pipelines.empty())
+      pipelines.front()->tree->print(out);
+   out.endOperator();
+}
+//---------------------------------------------------------------------------
+void MorselGather::addMergeHint(Register* /*reg1*/,Register* /*reg2*/)
+   // Add a merge join hint
+{
+   // The registers of the pipelines belong to other runtimes
+}
+//---------------------------------------------------------------------------
+void MorselGather::getAsyncInputCandidates(Scheduler& /*scheduler*/)
+   // Register parts of the tree that can be executed asynchronous
+{
+   // The pipelines are already executed by their own threads
+}
+//---------------------------------------------------------------------------
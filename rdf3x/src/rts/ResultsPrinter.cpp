@@ -6,6 +6,7 @@
 #include "infra/util/Type.hpp"
 
 #include <trident/kb/dictmgmt.h>
+#include <trident/sparql/resultswriter.h>
 
 #include <iostream>
 #include <map>
@@ -25,7 +26,7 @@
 using namespace std;
 //---------------------------------------------------------------------------
 ResultsPrinter::ResultsPrinter(Runtime& runtime, Operator* input, const vector<Register*>& output, DuplicateHandling duplicateHandling, uint64_t limit, uint64_t offset, bool silent)
-    : Operator(1), output(output), input(input), runtime(runtime), dictionary(runtime.getDatabase()), duplicateHandling(duplicateHandling), outputMode(DefaultOutput), limit(limit), offset(offset), silent(silent), nrows(0), jsonoutput(NULL), outputset(NULL)
+    : Operator(1), output(output), input(input), runtime(runtime), dictionary(runtime.getDatabase()), duplicateHandling(duplicateHandling), outputMode(DefaultOutput), limit(limit), offset(offset), silent(silent), nrows(0), jsonoutput(NULL), outputset(NULL), streamoutput(NULL)
       // Constructor
 {
 }
@@ -131,6 +132,43 @@ namespace {
         return os.str();
     }
     //---------------------------------------------------------------------------
+    static void lookupStrings(DBLayer& dictionary, TemporaryDictionary* tempDict, QueryDict* dictQuery, map<uint64_t, CacheEntry>& stringCache, vector<string>& texts)
+        // Look up the strings of the cache. The ids of the database are translated all at once, the strings are kept in texts
+    {
+        vector<uint64_t> ids;
+        vector<CacheEntry*> entries;
+        for (map<uint64_t, CacheEntry>::iterator iter = stringCache.begin(),
+                limit = stringCache.end(); iter != limit; ++iter) {
+            CacheEntry& c = (*iter).second;
+            if (dictQuery && dictQuery->hasID(iter->first)) {
+                std::pair<char*, char*> pair = dictQuery->getStringBoundaries(iter->first);
+                c.start = pair.first;
+                c.stop = pair.second;
+                c.type = Type::Literal;
+            } else if (tempDict && tempDict->isTemporary(iter->first)) {
+                tempDict->lookupById((*iter).first, c.start, c.stop, c.type, c.subType);
+            } else {
+                ids.push_back(iter->first);
+                entries.push_back(&c);
+            }
+        }
+        if (ids.empty())
+            return;
+
+        vector<Type::ID> types;
+        vector<bool> found;
+        dictionary.lookupByIds(ids, texts, types, found);
+        for (size_t i = 0; i < ids.size(); ++i) {
+            CacheEntry& c = *entries[i];
+            if (!found[i])
+                texts[i].clear();
+            c.start = texts[i].data();
+            c.stop = c.start + texts[i].size();
+            c.type = found[i] ? types[i] : Type::Literal;
+            c.subType = 0;
+        }
+    }
+    //---------------------------------------------------------------------------
     static void printResult(map<uint64_t, CacheEntry>& stringCache, vector<uint64_t>::const_iterator start, vector<uint64_t>::const_iterator stop, bool escape)
         // Print a result row
     {
@@ -266,6 +304,11 @@ uint64_t ResultsPrinter::first()
         return 1;
     }
 
+    if (streamoutput) {
+        streamRows(count, o);
+        return 1;
+    }
+
     if (silent && !jsonoutput) {
         //Count the rows and output a single line
         do {
@@ -368,48 +411,26 @@ uint64_t ResultsPrinter::first()
         if ((++entryCount) >= this->limit) break;
     } while ((count = input->next()) != 0);
 
-    //Data structures to maintain a permanent copy of the strings
-    std::vector<std::unique_ptr<char[]>> buf_all;
-    const size_t buf_max = 10 * 1024 * 1024;
-    std::unique_ptr<char[]> buf_current(new char[buf_max]);
-    size_t buf_size = 0;
-
     // Lookup the strings
+    vector<string> texts;
+    lookupStrings(dictionary, tempDict, dictQuery, stringCache, texts);
     set<unsigned> subTypes;
     for (map<uint64_t, CacheEntry>::iterator iter = stringCache.begin(),
             limit = stringCache.end(); iter != limit; ++iter) {
         CacheEntry& c = (*iter).second;
-
-        if (dictQuery && dictQuery->hasID(iter->first)) {
-            //I need to set c.start and c.stop
-            std::pair<char*, char*> pair = dictQuery->getStringBoundaries(iter->first);
-            c.start = pair.first;
-            c.stop = pair.second;
-            c.type = Type::Literal;
-        } else {
-            if (tempDict)
-                tempDict->lookupById((*iter).first, c.start, c.stop, c.type, c.subType);
-            else
-                dictionary.lookupById((*iter).first, c.start, c.stop, c.type, c.subType);
-
-            //Copy the text in a permanent data structure
-            const size_t len = c.stop - c.start;
-            if (len > buf_max - buf_size) {
-                buf_all.push_back(std::move(buf_current));
-                buf_current = std::unique_ptr<char[]>(new char[buf_max]);
-                buf_size = 0;
-            }
-            memcpy(buf_current.get() + buf_size, c.start, len);
-            c.start = buf_current.get() + buf_size;
-            c.stop = c.start + len;
-            buf_size += len;
-            //Copying done
-        }
-
         if (Type::hasSubType(c.type))
             subTypes.insert(c.subType);
     }
 
+    //Data structures to maintain a permanent copy of the strings of the
+    //subtypes
+    std::vector<std::unique_ptr<char[]>> buf_all;
+    const size_t buf_max = 10 * 1024 * 1024;
+    std::unique_ptr<char[]> buf_current;
+    if (!subTypes.empty())
+        buf_current.reset(new char[buf_max]);
+    size_t buf_size = 0;
+
     for (set<unsigned>::const_iterator iter = subTypes.begin(),
             limit = subTypes.end(); iter != limit; ++iter) {
         CacheEntry& c = stringCache[*iter];
@@ -472,6 +493,86 @@ uint64_t ResultsPrinter::first()
     return 1;
 }
 //---------------------------------------------------------------------------
+void ResultsPrinter::streamRows(uint64_t count, uint64_t o)
+    // Pass the rows to streamoutput as they are produced
+{
+    TemporaryDictionary* tempDict = runtime.hasTemporaryDictionary() ?
+        (&runtime.getTemporaryDictionary()) : 0;
+    QueryDict *dictQuery = runtime.getQueryDict();
+    if (dictQuery && dictQuery->isEmpty()) dictQuery = NULL;
+    uint64_t minCount = (duplicateHandling == ShowDuplicates) ? 2 : 1;
+    const size_t columns = output.size();
+    //The count of every row of the batch, followed by its values
+    vector<uint64_t> rows;
+    map<uint64_t, CacheEntry> stringCache;
+    vector<string> texts;
+    std::string term;
+    std::ostringstream ss;
+    bool done = false;
+    while (!done) {
+        //Collect a batch of rows
+        rows.clear();
+        stringCache.clear();
+        uint64_t buffered = 0, nbatch = 0;
+        while (true) {
+            if (count >= minCount) {
+                if (o >= count) {
+                    o -= count;
+                } else {
+                    count -= o;
+                    o = 0;
+                    //Only expanded duplicates are repeated
+                    if (duplicateHandling != ExpandDuplicates)
+                        count = 1;
+                    rows.push_back(count);
+                    for (size_t i = 0; i < columns; ++i) {
+                        uint64_t id = output[i]->value;
+                        rows.push_back(id);
+                        if (~id && !DictMgmt::isnumeric(id)) stringCache[id];
+                    }
+                    buffered += count;
+                    nbatch++;
+                }
+            }
+            if (nrows + buffered >= limit || (count = input->next()) == 0) {
+                done = true;
+                break;
+            }
+            if (nbatch >= RESULTSPRINTER_STREAM_BATCH)
+                break;
+        }
+
+        //Translate all the strings of the batch at once
+        texts.clear();
+        lookupStrings(dictionary, tempDict, dictQuery, stringCache, texts);
+
+        for (vector<uint64_t>::const_iterator iter = rows.begin(),
+                limit = rows.end(); iter != limit; iter += columns + 1) {
+            uint64_t rowCount = *iter;
+            for (; rowCount > 0 && nrows < this->limit; --rowCount) {
+                for (size_t i = 0; i < columns; ++i) {
+                    uint64_t id = iter[i + 1];
+                    if (!~id) {
+                        streamoutput->addUnbound();
+                    } else if (DictMgmt::isnumeric(id)) {
+                        streamoutput->addTerm(DictMgmt::tostr(id));
+                    } else {
+                        ss.str("");
+                        stringCache[id].print(ss, false);
+                        term = ss.str();
+                        streamoutput->addTerm(term);
+                    }
+                }
+                streamoutput->endRow();
+                nrows++;
+            }
+            //Stop if the client is gone
+            if (streamoutput->isFailed())
+                return;
+        }
+    }
+}
+//---------------------------------------------------------------------------
 uint64_t ResultsPrinter::next()
     // Produce the next tuple
 {
@@ -17,7 +17,7 @@ void Register::reset()
 }
 //---------------------------------------------------------------------------
 Runtime::Runtime(DBLayer& db,/*DifferentialIndex* diff,*/TemporaryDictionary* temporaryDictionary, QueryDict *queryDict)
-   : db(db),/*diff(diff),*/temporaryDictionary(temporaryDictionary), queryDict(queryDict)
+   : db(db),/*diff(diff),*/temporaryDictionary(temporaryDictionary), queryDict(queryDict), threads(1)
    // Constructor
 {
 }
@@ -0,0 +1,472 @@
+#include "rts/operator/VectorSelection.hpp"
+#include "rts/operator/PlanPrinter.hpp"
+#include "rts/runtime/Runtime.hpp"
+
+#include <trident/kb/dictmgmt.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+//---------------------------------------------------------------------------
+// RDF-3X
+// (c) 2008 Thomas Neumann. Web site: http://www.mpi-inf.mpg.de/~neumann/rdf3x
+//
+// This work is licensed under the Creative Commons
+// Attribution-Noncommercial-Share Alike 3.0 Unported License. To view a copy
+// of this license, visit http://creativecommons.org/licenses/by-nc-sa/3.0/
+// or send a letter to Creative Commons, 171 Second Street, Suite 300,
+// San Francisco, California, 94105, USA.
+//---------------------------------------------------------------------------
+using namespace std;
+//---------------------------------------------------------------------------
+/// The largest integer that can be inlined in an id
+static const uint64_t maxInlinedInt = UINT64_C(0x3FFFFFFFFFFFFFFF);
+//---------------------------------------------------------------------------
+static bool parseInt(const string& text, int64_t& value)
+    // Parse an integer. The whole text must be consumed
+{
+    if (text.empty())
+        return false;
+    char* end;
+    errno = 0;
+    value = strtoll(text.c_str(), &end, 10);
+    return (!errno) && (!*end);
+}
+//---------------------------------------------------------------------------
+static bool parseDouble(const string& text, double& value)
+    // Parse a floating point number. The whole text must be consumed
+{
+    if (text.empty())
+        return false;
+    char* end;
+    value = strtod(text.c_str(), &end);
+    return !*end;
+}
+//---------------------------------------------------------------------------
+static bool parseLeadingInt(const string& text, int64_t& value)
+    // Parse the integer at the start of a text, like the numeric comparisons of Selection do
+{
+    char* end;
+    errno = 0;
+    value = strtoll(text.c_str(), &end, 10);
+    return (!errno) && (end != text.c_str());
+}
+//---------------------------------------------------------------------------
+static bool endsWith(const string& s, const char* suffix)
+    // Check the end of a string
+{
+    size_t len = char_traits<char>::length(suffix);
+    return (s.size() >= len) && (s.compare(s.size() - len, len, suffix) == 0);
+}
+//---------------------------------------------------------------------------
+bool VectorSelection::Condition::setNumber(const string& text)
+    // Set the constant of a numeric comparison
+{
+    string lex = text;
+    if ((lex.size() >= 2) && (lex[0] == '"'))
+        lex = lex.substr(1, lex.find_last_of('"') - 1);
+    if (parseInt(lex, intValue)) {
+        intConstant = true;
+        doubleValue = static_cast<double>(intValue);
+        return true;
+    }
+    intConstant = false;
+    return parseDouble(lex, doubleValue) && (!std::isnan(doubleValue));
+}
+//---------------------------------------------------------------------------
+bool VectorSelection::Condition::getExcludedIds(uint64_t& from, uint64_t& to) const
+    // The range of ids with inlined integers that fail the condition
+{
+    // The inlined numbers are literals
+    if (((kind == IsIRI) || (kind == IsBlank)) && (!negated)) {
+        from = DICTMGMT_INTEGER;
+        to = ~UINT64_C(0) - 1;
+        return true;
+    }
+    if ((kind == IsLiteral) && negated) {
+        from = DICTMGMT_INTEGER;
+        to = ~UINT64_C(0) - 1;
+        return true;
+    }
+    if ((kind != Less) && (kind != LessOrEqual) && (kind != Greater) && (kind != GreaterOrEqual))
+        return false;
+
+    // The integers that fail are either [0,bound] or [bound,max]
+    bool upTo = (kind == Greater) || (kind == GreaterOrEqual);
+    if (intConstant) {
+        const int64_t maxInt = static_cast<int64_t>(maxInlinedInt);
+        if (upTo) {
+            int64_t bound = (kind == Greater) ? intValue : (intValue - 1);
+            if (bound < 0)
+                return false;
+            from = 0;
+            to = static_cast<uint64_t>(min(bound, maxInt));
+        } else {
+            if (intValue >= maxInt)
+                return false;
+            int64_t bound = (kind == Less) ? intValue : (intValue + 1);
+            from = static_cast<uint64_t>(max<int64_t>(bound, 0));
+            to = maxInlinedInt;
+        }
+    } else {
+        const double maxDouble = static_cast<double>(maxInlinedInt);
+        if (upTo) {
+            double bound = (kind == Greater) ? floor(doubleValue) : (ceil(doubleValue) - 1);
+            if (bound < 0)
+                return false;
+            from = 0;
+            to = (bound >= maxDouble) ? maxInlinedInt : static_cast<uint64_t>(bound);
+        } else {
+            double bound = (kind == Less) ? ceil(doubleValue) : (floor(doubleValue) + 1);
+            if (bound >= maxDouble)
+                return false;
+            from = (bound < 0) ? 0 : static_cast<uint64_t>(bound);
+            to = maxInlinedInt;
+        }
+    }
+    from |= DICTMGMT_INTEGER;
+    to |= DICTMGMT_INTEGER;
+    return true;
+}
+//---------------------------------------------------------------------------
+VectorSelection::VectorSelection(Operator* input, Runtime& runtime, const vector<Condition>& conditions, const vector<Register*>& registers, double expectedOutputCardinality)
+    : Operator(expectedOutputCardinality), input(input), runtime(runtime), conditions(conditions), registers(registers), selectedPos(0), inputDone(true), inputFirst(false)
+      // Constructor
+{
+    // The registers of the conditions must be in the batch
+    for (vector<Condition>::const_iterator iter = conditions.begin(), limit = conditions.end(); iter != limit; ++iter) {
+        vector<Register*>::iterator pos = find(this->registers.begin(), this->registers.end(), iter->reg);
+        if (pos == this->registers.end()) {
+            conditionColumns.push_back(this->registers.size());
+            this->registers.push_back(iter->reg);
+        } else {
+            conditionColumns.push_back(pos - this->registers.begin());
+        }
+    }
+    values.resize(this->registers.size() * VECTORSELECTION_BATCH);
+    counts.reserve(VECTORSELECTION_BATCH);
+    selected.reserve(VECTORSELECTION_BATCH);
+    internLang("");
+
+    // Let the scans skip the inlined numbers that cannot qualify
+    for (vector<Condition>::const_iterator iter = conditions.begin(), limit = conditions.end(); iter != limit; ++iter) {
+        uint64_t from, to;
+        if (iter->getExcludedIds(from, to))
+            input->excludeValues(iter->reg, from, to);
+    }
+}
+//---------------------------------------------------------------------------
+VectorSelection::~VectorSelection()
+    // Destructor
+{
+    delete input;
+}
+//---------------------------------------------------------------------------
+unsigned VectorSelection::internLang(const string& lang)
+    // Intern a language tag
+{
+    unordered_map<string, unsigned>::const_iterator iter = langIds.find(lang);
+    if (iter != langIds.end())
+        return iter->second;
+    unsigned id = langs.size();
+    langs.push_back(lang);
+    langIds[lang] = id;
+    return id;
+}
+//---------------------------------------------------------------------------
+VectorSelection::Term VectorSelection::describe(uint64_t id)
+    // Describe a term
+{
+    Term term;
+    term.kind = Term::Literal;
+    term.numType = Term::None;
+    term.lang = 0;
+    term.intValue = 0;
+    term.doubleValue = 0;
+
+    const char* start, *stop;
+    Type::ID type;
+    unsigned subType;
+    if (!runtime.getDatabase().lookupById(id, start, stop, type, subType)) {
+        term.kind = Term::Unbound;
+        return term;
+    }
+    string text(start, stop);
+    if ((text.size() >= 2) && (text[0] == '_') && (text[1] == ':')) {
+        term.kind = Term::Blank;
+        return term;
+    }
+    if (type == Type::URI) {
+        term.kind = Term::IRI;
+        return term;
+    }
+
+    // Typed values without the lexical form
+    if ((type == Type::Integer) || (type == Type::Decimal) || (type == Type::Double)) {
+        if (parseInt(text, term.intValue)) {
+            term.numType = Term::Int;
+        } else if (parseDouble(text, term.doubleValue)) {
+            term.numType = Term::Double;
+        }
+        return term;
+    }
+    if (type == Type::CustomLanguage) {
+        Type::ID t;
+        unsigned st;
+        if (runtime.getDatabase().lookupById(subType, start, stop, t, st))
+            term.lang = internLang(string(start, stop));
+        if (parseLeadingInt(text, term.intValue))
+            term.numType = Term::Int;
+        return term;
+    }
+
+    // N-Triples form: "lexical"@lang or "lexical"^^<datatype>
+    size_t quote = text.find_last_of('"');
+    bool numericType = false;
+    string lex = text;
+    if ((!text.empty()) && (text[0] == '"') && (quote != 0) && (quote != string::npos)) {
+        lex = text.substr(1, quote - 1);
+        if ((quote + 1 < text.size()) && (text[quote + 1] == '@')) {
+            term.lang = internLang(text.substr(quote + 2));
+        } else if ((quote + 2 < text.size()) && (text[quote + 1] == '^') && (text[quote + 2] == '^')) {
+            string datatype = text.substr(quote + 3);
+            if ((!datatype.empty()) && (datatype[datatype.size() - 1] == '>'))
+                datatype.resize(datatype.size() - 1);
+            if (endsWith(datatype, "#integer") || endsWith(datatype, "#int") || endsWith(datatype, "#long") ||
+                    endsWith(datatype, "#short") || endsWith(datatype, "#byte") || endsWith(datatype, "Integer")) {
+                numericType = true;
+                if (parseInt(lex, term.intValue)) {
+                    term.numType = Term::Int;
+                } else if (parseDouble(lex, term.doubleValue)) {
+                    term.numType = Term::Double;
+                }
+            } else if (endsWith(datatype, "#decimal") || endsWith(datatype, "#double") || endsWith(datatype, "#float")) {
+                numericType = true;
+                if (parseDouble(lex, term.doubleValue))
+                    term.numType = Term::Double;
+            }
+        }
+    }
+    // The other literals (e.g., the plain literal "42") are compared with
+    // the integer at the start of their lexical form, as in Selection
+    if ((!numericType) && parseLeadingInt(lex, term.intValue))
+        term.numType = Term::Int;
+    return term;
+}
+//---------------------------------------------------------------------------
+void VectorSelection::classify(const uint64_t* column)
+    // Look up the new terms of a column, for the selected tuples of the batch
+{
+    // The ids of the previous batches are forgotten once there are too many
+    if (terms.size() > VECTORSELECTION_MAXTERMS)
+        terms.clear();
+    missing.clear();
+    for (vector<unsigned>::const_iterator iter = selected.begin(), limit = selected.end(); iter != limit; ++iter) {
+        uint64_t id = column[*iter];
+        if ((~id) && (!DictMgmt::isnumeric(id)) && (!terms.count(id)))
+            missing.push_back(id);
+    }
+    if (missing.empty())
+        return;
+
+    // Sorted lookups touch the dictionary in order
+    sort(missing.begin(), missing.end());
+    missing.erase(unique(missing.begin(), missing.end()), missing.end());
+    for (vector<uint64_t>::const_iterator iter = missing.begin(), limit = missing.end(); iter != limit; ++iter)
+        terms[*iter] = describe(*iter);
+}
+//---------------------------------------------------------------------------
+const VectorSelection::Term& VectorSelection::getTerm(uint64_t id, Term& inlined)
+    // The term of an id of the batch
+{
+    if (!~id) {
+        inlined.kind = Term::Unbound;
+        return inlined;
+    }
+    if (DictMgmt::isnumeric(id)) {
+        inlined.kind = Term::Literal;
+        inlined.lang = 0;
+        if (DictMgmt::getType(id) == DICTMGMT_INTEGER) {
+            inlined.numType = Term::Int;
+            inlined.intValue = DictMgmt::getIntValue(id);
+        } else {
+            inlined.numType = Term::Double;
+            inlined.doubleValue = DictMgmt::getFloatValue(id);
+        }
+        return inlined;
+    }
+    return terms[id];
+}
+//---------------------------------------------------------------------------
+static bool langMatches(const string& tag, const string& range)
+    // Check a language range
+{
+    if (range == "*")
+        return !tag.empty();
+    if ((tag.size() < range.size()) || ((tag.size() > range.size()) && (tag[range.size()] != '-')))
+        return false;
+    for (size_t index = 0; index < range.size(); index++)
+        if (tolower(static_cast<unsigned char>(tag[index])) != tolower(static_cast<unsigned char>(range[index])))
+            return false;
+    return true;
+}
+//---------------------------------------------------------------------------
+bool VectorSelection::check(const Condition& condition, const Term& term) const
+    // Check a condition
+{
+    // Unbound values raise an error, the condition fails also if negated
+    if (term.kind == Term::Unbound)
+        return false;
+
+    bool result;
+    switch (condition.kind) {
+        case Condition::Less:
+        case Condition::LessOrEqual:
+        case Condition::Greater:
+        case Condition::GreaterOrEqual: {
+            if (term.numType == Term::None)
+                return false;
+            int cmp;
+            if ((term.numType == Term::Int) && condition.intConstant) {
+                cmp = (term.intValue < condition.intValue) ? -1 : ((term.intValue > condition.intValue) ? 1 : 0);
+            } else {
+                double v = (term.numType == Term::Int) ? static_cast<double>(term.intValue) : term.doubleValue;
+                if (std::isnan(v))
+                    return false;
+                cmp = (v < condition.doubleValue) ? -1 : ((v > condition.doubleValue) ? 1 : 0);
+            }
+            switch (condition.kind) {
+                case Condition::Less: result = cmp < 0; break;
+                case Condition::LessOrEqual: result = cmp <= 0; break;
+                case Condition::Greater: result = cmp > 0; break;
+                default: result = cmp >= 0; break;
+            }
+            break;
+        }
+        case Condition::IsIRI:
+            result = term.kind == Term::IRI;
+            break;
+        case Condition::IsBlank:
+            result = term.kind == Term::Blank;
+            break;
+        case Condition::IsLiteral:
+            result = term.kind == Term::Literal;
+            break;
+        case Condition::LangEqual:
+            if (term.kind != Term::Literal)
+                return false;
+            result = langs[term.lang] == condition.lang;
+            break;
+        case Condition::LangMatches:
+            if (term.kind != Term::Literal)
+                return false;
+            result = langMatches(langs[term.lang], condition.lang);
+            break;
+        default:
+            return false;
+    }
+    return condition.negated ? (!result) : result;
+}
+//---------------------------------------------------------------------------
+void VectorSelection::readBatch()
+    // Read the next batch
+{
+    // Collect the tuples
+    counts.clear();
+    unsigned rows = 0;
+    const unsigned regs = registers.size();
+    while (rows < VECTORSELECTION_BATCH) {
+        uint64_t count = inputFirst ? input->first() : input->next();
+        inputFirst = false;
+        if (!count) {
+            inputDone = true;
+            break;
+        }
+        counts.push_back(count);
+        for (unsigned reg = 0; reg < regs; reg++)
+            values[reg * VECTORSELECTION_BATCH + rows] = registers[reg]->value;
+        rows++;
+    }
+
+    // Apply the conditions one after the other on the qualifying tuples
+    selected.resize(rows);
+    for (unsigned index = 0; index < rows; index++)
+        selected[index] = index;
+    selectedPos = 0;
+    Term inlined;
+    for (unsigned cond = 0; (cond < conditions.size()) && (!selected.empty()); cond++) {
+        const Condition& condition = conditions[cond];
+        const uint64_t* column = &values[conditionColumns[cond] * VECTORSELECTION_BATCH];
+        classify(column);
+        unsigned out = 0;
+        for (vector<unsigned>::const_iterator iter = selected.begin(), limit = selected.end(); iter != limit; ++iter)
+            if (check(condition, getTerm(column[*iter], inlined)))
+                selected[out++] = *iter;
+        selected.resize(out);
+    }
+}
+//---------------------------------------------------------------------------
+uint64_t VectorSelection::first()
+    // Produce the first tuple
+{
+    observedOutputCardinality = 0;
+    selected.clear();
+    selectedPos = 0;
+    inputDone = false;
+    inputFirst = true;
+    return next();
+}
+//---------------------------------------------------------------------------
+uint64_t VectorSelection::next()
+    // Produce the next tuple
+{
+    while (selectedPos >= selected.size()) {
+        if (inputDone)
+            return 0;
+        readBatch();
+    }
+
+    unsigned row = selected[selectedPos++];
+    for (unsigned reg = 0, regs = registers.size(); reg < regs; reg++)
+        registers[reg]->value = values[reg * VECTORSELECTION_BATCH + row];
+    observedOutputCardinality += counts[row];
+    return counts[row];
+}
+//---------------------------------------------------------------------------
+void VectorSelection::print(PlanPrinter& out)
+    // Print the operator tree. Debugging only.
+{
+    static const char* names[] = { "<", "<=", ">", ">=", "isIRI", "isBlank", "isLiteral", "lang ==", "langMatches" };
+    out.beginOperator("VectorSelection", expectedOutputCardinality, observedOutputCardinality);
+    string text;
+    for (vector<Condition>::const_iterator iter = conditions.begin(), limit = conditions.end(); iter != limit; ++iter) {
+        if (!text.empty())
+            text += " && ";
+        if (iter->negated)
+            text += "!";
+        text += string(names[iter->kind]) + "(" + out.formatRegister(iter->reg);
+        if (iter->kind <= Condition::GreaterOrEqual)
+            text += "," + (iter->intConstant ? to_string(iter->intValue) : to_string(iter->doubleValue));
+        else if (iter->kind >= Condition::LangEqual)
+            text += ",\"" + iter->lang + "\"";
+        text += ")";
+    }
+    out.addGenericAnnotation(text);
+    input->print(out);
+    out.endOperator();
+}
+//---------------------------------------------------------------------------
+void VectorSelection::addMergeHint(Register* reg1, Register* reg2)
+    // Add a merge join hint
+{
+    input->addMergeHint(reg1, reg2);
+}
+//---------------------------------------------------------------------------
+void VectorSelection::getAsyncInputCandidates(Scheduler& scheduler)
+    // Register parts of the tree that can be executed asynchronous
+{
+    input->getAsyncInputCandidates(scheduler);
+}
+//---------------------------------------------------------------------------
@@ -27,6 +27,7 @@
 #include <trident/kb/updater.h>
 #include <trident/kb/kbconfig.h>
 #include <trident/kb/querier.h>
+#include <trident/kb/permsorter.h>
 #include <trident/mining/miner.h>
 #include <trident/tests/common.h>
 
@@ -206,11 +207,9 @@ void testkb(string kbDir, ProgramArgs &vm) {
         std::vector<string> childrenupdates;
         for (int i = 0; i < ups.size(); ++i) {
             string f = ups[i];
-            string fn = Utils::filename(f);
-            if (!fn.empty() && std::find_if(fn.begin(),  fn.end(),
-                        [](char c) {
-                        return !isdigit(c);
-                        }) == fn.end()) {
+            int64_t seq, gen;
+            if (Updater::parseDiffName(Utils::filename(f), seq, gen) &&
+                    !Utils::exists(f + DIR_SEP + "RETIRED")) {
                 childrenupdates.push_back(f);
             }
         }
@@ -257,18 +256,29 @@ void printStats(KB &kb, Querier *q) {
     LOG(DEBUGL) << "Max mem (MB) " << Utils::get_max_mem();
     LOG(DEBUGL) << "# Read Index Blocks = " << kb.getStats().getNReadIndexBlocks();
     LOG(DEBUGL) << " Read Index Bytes from disk = " << kb.getStats().getNReadIndexBytes();
+    Stats s = kb.getStats();
+    LOG(DEBUGL) << "Index files: hits " << s.getNFileHits() << " misses " <<
+        s.getNFileMisses() << " evictions " << s.getNFileEvictions() <<
+        " wait (us) " << s.getFileWaitTime();
     Querier::Counters c = q->getCounters();
     LOG(DEBUGL) << "RowLayouts: " << c.statsRow << " ClusterLayouts: " << c.statsCluster << " ColumnLayouts: " << c.statsColumn;
     LOG(DEBUGL) << "AggrIndices: " << c.aggrIndices << " NotAggrIndices: " << c.notAggrIndices << " CacheIndices: " << c.cacheIndices;
     LOG(DEBUGL) << "Permutations: spo " << c.spo << " ops " << c.ops << " pos " << c.pos << " sop " << c.sop << " osp " << c.osp << " pso " << c.pso;
     int64_t nblocks = 0;
     int64_t nbytes = 0;
+    int64_t nhits = 0;
+    int64_t nmisses = 0;
     for (int i = 0; i < kb.getNDictionaries(); ++i) {
         nblocks = kb.getStatsDict()[i].getNReadIndexBlocks();
         nbytes = kb.getStatsDict()[i].getNReadIndexBytes();
+        nhits += kb.getStatsDict()[i].getNBlockHits();
+        nmisses += kb.getStatsDict()[i].getNBlockMisses();
     }
     LOG(DEBUGL) << "# Read Dictionary Blocks = " << nblocks;
     LOG(DEBUGL) << "# Read Dictionary Bytes from disk = " << nbytes;
+    LOG(DEBUGL) << "Dictionary block cache: hits " << nhits << " misses " <<
+        nmisses << " hit rate " << (nhits + nmisses > 0 ?
+                (double) nhits / (nhits + nmisses) : 0);
     LOG(DEBUGL) << "Process IO Read bytes = " << Utils::getIOReadBytes();
     LOG(DEBUGL) << "Process IO Read char = " << Utils::getIOReadChars();
 }
@@ -335,6 +345,7 @@ int main(int argc, const char** argv) {
     if (cmd == "query") {
 #ifdef SPARQL
         KBConfig config;
+        config.setParamBool(STORAGE_MMAP, vm["mmap"].as<bool>());
         std::vector<string> locUpdates;
         KB kb(kbDir.c_str(), true, false, true, config, locUpdates);
         TridentLayer layer(kb);
@@ -359,6 +370,7 @@ int main(int argc, const char** argv) {
     } else if (cmd == "query_native") {
 #ifdef SPARQL
         KBConfig config;
+        config.setParamBool(STORAGE_MMAP, vm["mmap"].as<bool>());
         KB kb(kbDir.c_str(), true, false, true, config);
         Querier *q = kb.query();
         execNativeQuery(vm, q, kb, ! vm["decodeoutput"].as<bool>());
@@ -387,9 +399,16 @@ int main(int argc, const char** argv) {
     } else if (cmd == "testcq") {
         string inputFile = kbDir + DIR_SEP + string("p0") + DIR_SEP + string("raw");
         _test_createqueries(inputFile, vm["testqueryfile"].as<string>());
+    } else if (cmd == "testsort") {
+        PermSorter::benchmarkSort(vm["testsortsize"].as<int64_t>(),
+                vm["maxThreads"].as<int>());
     } else if (cmd == "testti") {
         TridentTimings ti(kbDir, vm["testqueryfile"].as<string>());
-        ti.launchTests();
+        if (vm["testmoveto"].as<bool>()) {
+            ti.launchMovetoTests(vm["testqueryfile"].as<string>());
+        } else {
+            ti.launchTests();
+        }
     } else if (cmd == "load" || cmd == "compress") {
         Loader loader;
         int sampleMethod;
@@ -450,6 +469,10 @@ int main(int argc, const char** argv) {
         p.storeDicts = vm["storedicts"].as<bool>();
         p.relsOwnIDs = vm["relsOwnIDs"].as<bool>();
         p.flatTree = vm["flatTree"].as<bool>();
+        p.sortEngine = vm["sortEngine"].as<string>();
+        p.charsets = vm["charsets"].as<bool>();
+        p.staticDict = vm["staticDict"].as<bool>();
+        p.parser = vm["parser"].as<string>();
 
         loader.load(p);
 
@@ -457,18 +480,39 @@ int main(int argc, const char** argv) {
         KBConfig config;
         KB kb(kbDir.c_str(), true, false, true, config);
         printInfo(kb);
-    } else if (cmd == "add") {
-        string updatedir = vm["update"].as<string>();
-        Updater up;
-        up.creatediffupdate(DiffIndex::TypeUpdate::ADDITION_df, kbDir, updatedir);
-    } else if (cmd == "rm") {
+    } else if (cmd == "add" || cmd == "rm") {
+        //The update goes in the log of the KB. It is written as a diff once
+        //enough updates are collected (or with <merge>)
         string updatedir = vm["update"].as<string>();
+        KBConfig config;
+        KB kb(kbDir.c_str(), true, false, true, config);
         Updater up;
-        up.creatediffupdate(DiffIndex::TypeUpdate::DELETE_df, kbDir, updatedir);
+        up.update(cmd == "add" ? DiffIndex::TypeUpdate::ADDITION_df :
+                DiffIndex::TypeUpdate::DELETE_df, kb, updatedir);
     } else if (cmd == "merge") {
         KBConfig config;
-        KB kb(kbDir.c_str(), true, false, true, config);
-        kb.mergeUpdates();
+        if (vm["full"].as<bool>()) {
+            string dir = kbDir;
+            while (dir.size() > 1 && dir.back() == DIR_SEP[0]) {
+                dir.pop_back();
+            }
+            string mergedDir = dir + "_merged";
+            config.setParamLong(UPDATES_MERGE_RATE, vm["mergerate"].as<int64_t>());
+            if (KB::isInUse(dir)) {
+                //The merged KB would be visible only after a restart
+                LOG(ERRORL) << "The KB is open in another process (e.g., a "
+                    "server). Stop it before the full merge";
+                return EXIT_FAILURE;
+            }
+            {
+                KB kb(kbDir.c_str(), true, false, true, config);
+                kb.mergeIntoBase(mergedDir);
+            }
+            KB::installMergedKB(dir, mergedDir);
+        } else {
+            KB kb(kbDir.c_str(), true, false, true, config);
+            kb.mergeUpdates();
+        }
     } else if (cmd == "analytics") {
 #ifdef ANALYTICS
         KBConfig config;
@@ -496,6 +540,7 @@ int main(int argc, const char** argv) {
     } else if (cmd == "server") {
 #ifdef SERVER
         KBConfig config;
+        config.setParamBool(STORAGE_MMAP, vm["mmap"].as<bool>());
         KB kb(kbDir.c_str(), true, false, true, config);
         startServer(kb, vm["port"].as<int>(), vm["webthreads"].as<int>());
 #else
@@ -78,6 +78,7 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv,
 
     if (cmd != "help" && cmd != "query" && cmd != "lookup" && cmd != "load"
             && cmd != "testkb" && cmd != "testcq" && cmd != "testti"
+            && cmd != "testsort"
             && cmd != "query_native"
             && cmd != "info"
             && cmd != "add"
@@ -108,7 +109,7 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv,
         return false;
     } else {
         /*** Check common parameters ***/
-        if (!vm.count("input")) {
+        if (!vm.count("input") && cmd != "testsort") {
             printErrorMsg("The parameter -i (the knowledge base) is not set.");
             return false;
         }
@@ -131,6 +132,13 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv,
             }
         }
         /*** Check specific parameters ***/
+        if (cmd == "query_native") {
+            string planner = vm["planner"].as<string>();
+            if (planner != "simple" && planner != "leapfrog") {
+                printErrorMsg("The parameter planner can be either 'simple' or 'leapfrog'");
+                return false;
+            }
+        }
         if (cmd == "query") {
             string queryFile = vm["query"].as<string>();
             if (queryFile != "" && !Utils::exists(queryFile)) {
@@ -173,6 +181,18 @@ bool checkParams(ProgramArgs &vm, int argc, const char** argv,
                 return false;
             }
 
+            string sortEngine = vm["sortEngine"].as<string>();
+            if (sortEngine != "radix" && sortEngine != "merge") {
+                printErrorMsg("The parameter sortEngine can be either 'radix' or 'merge'");
+                return false;
+            }
+
+            string parser = vm["parser"].as<string>();
+            if (parser != "kognac" && parser != "stream") {
+                printErrorMsg("The parameter parser can be either 'kognac' or 'stream'");
+                return false;
+            }
+
             string sampleMethod = vm["popMethod"].as<string>();
             if (sampleMethod != "sample" && sampleMethod != "hash") {
                 printErrorMsg(
@@ -268,6 +288,10 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
             "Retrieve the original values of the results of query. Default is true", false);
     query_options.add<bool>("", "disbifsampl", false,
             "Disable bifocal sampling (accurate but expensive). Default is false", false);
+    query_options.add<bool>("", "mmap", false,
+            "Map all the files of the indices at startup and read the tables directly from the mappings (also for <query_native> and <server>). Default is false", false);
+    query_options.add<string>("", "planner", "simple",
+            "Planner of <query_native>. 'simple' uses the Leapfrog Triejoin only for the cyclic queries, 'leapfrog' uses it whenever the patterns allow it. Default is 'simple'", false);
 
     /***** LOAD *****/
     ParamsLoad p;
@@ -318,6 +342,10 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     load_options.add<string>("","gf", p.graphTransformation, "Possible graph transformations. 'unlabeled' removes the edge labels (but keeps it directed), 'undirected' makes the graph undirected and without edge labels", false);
     load_options.add<bool>("","relsOwnIDs", p.relsOwnIDs, "Should I give independent IDs to the terms that appear as predicates? (Useful for ML learning models). Default is DISABLED", false);
     load_options.add<bool>("","flatTree", p.flatTree, "Create a flat representation of the nodes' tree. This parameter is forced to tree if the graph is unlabeled. Default is DISABLED", false);
+    load_options.add<string>("","sortEngine", p.sortEngine, "Algorithm to sort the triples in main memory. Can be either 'radix' or 'merge'. Default is 'radix'", false);
+    load_options.add<bool>("","charsets", p.charsets, "Compute the characteristic sets and the statistics of the joins between predicates, used by the SPARQL optimizer. Default is ENABLED", false);
+    load_options.add<string>("","parser", p.parser, "Parser of the RDF input. 'kognac' assigns small IDs to the popular terms. 'stream' parses and encodes the input in parallel in a single pass, and sorts the triples in main memory when they fit. It keeps all the terms in main memory and switches to kognac if they need more than 30% of it. Large plain files are split among the readers, while every gzipped file is read by a single reader. Default is 'kognac'", false);
+    load_options.add<bool>("","staticDict", p.staticDict, "Build a compact read-only copy of the dictionary (front-coded and compressed strings, perfect hash on the strings), used instead of the dictionary trees when the KB is opened read-only. The build loads all the terms in main memory, so it needs about the size of the uncompressed dictionary plus ~40 bytes per term. Default is DISABLED", false);
 
     /***** LOOKUP *****/
     ProgramArgs::GroupArgs& lookup_options = *vm.newGroup("Options for <lookup>");
@@ -329,10 +357,15 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     test_options.add<string>("", "testqueryfile", "", "Path file to store/load test queries", false);
     test_options.add<string>("", "testperms", "0;1;2;3;4;5", "Permutations to test", false);
     test_options.add<int>("", "testsystem", 0, "Test system. 0=Trident 1=RDF3X", false);
+    test_options.add<int64_t>("", "testsortsize", 10000000, "Number of triples sorted by <testsort>", false);
+    test_options.add<bool>("", "testmoveto", false, "Time moveto() on the test queries instead of the scans (<testti> only)", false);
 
     /***** UPDATES *****/
     ProgramArgs::GroupArgs& update_options = *vm.newGroup("Options for <add> or <rm>");
     update_options.add<string>("", "update", "", "Path to the file/dir that contains the triples to update", false);
+    ProgramArgs::GroupArgs& merge_options = *vm.newGroup("Options for <merge>");
+    merge_options.add<bool>("", "full", false, "Rewrite the permutations of the KB with all the updates instead of merging only the updates. Default is 'false'", false);
+    merge_options.add<int64_t>("", "mergerate", 0, "Max number of triples per second read from the KB during a full merge (0 = no limit)", false);
 
     /***** SERVER *****/
     ProgramArgs::GroupArgs& server_options = *vm.newGroup("Options for <server>");
@@ -413,6 +446,7 @@ bool initParams(int argc, const char** argv, ProgramArgs &vm) {
     sections.insert(make_pair("test",&test_options));
     sections.insert(make_pair("add",&update_options));
     sections.insert(make_pair("rm",&update_options));
+    sections.insert(make_pair("merge",&merge_options));
 #ifdef ANALYTICS
     sections.insert(make_pair("analytics",&ana_options));
 #endif
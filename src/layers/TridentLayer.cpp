@@ -130,6 +130,23 @@ bool TridentLayer::lookupById(uint64_t id,
     return resp;
 }
 
+void TridentLayer::lookupByIds(const std::vector<uint64_t>& ids,
+        std::vector<std::string>& texts,
+        std::vector< ::Type::ID>& types,
+        std::vector<bool>& found) {
+    std::vector<nTerm> keys(ids.begin(), ids.end());
+    dict->getTexts(keys, texts, found);
+    types.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (found[i] && !texts[i].empty() && texts[i][0] == '<') {
+            texts[i] = texts[i].substr(1, texts[i].size() - 2);
+            types[i] = ::Type::ID::URI;
+        } else {
+            types[i] = ::Type::ID::Literal;
+        }
+    }
+}
+
 uint64_t TridentLayer::getNextId() {
     return kb.getNextID();
 }
@@ -595,6 +612,56 @@ double TridentLayer::bifocalSampling(bool valueL1,
     return output / (card1 * card2);
 }
 
+double TridentLayer::statsJoinSelectivity(const CharacteristicSets *cs,
+        bool valueL1,
+        uint64_t value1CL,
+        bool value2L,
+        uint64_t value2CL,
+        bool value3L,
+        uint64_t value3CL,
+        bool value1R,
+        uint64_t value1CR,
+        bool value2R,
+        uint64_t value2CR,
+        bool value3R,
+        uint64_t value3CR) {
+    //The statistics cover only patterns like (?s p ?o) joined on a single
+    //variable
+    if (!value2L || !value2R || valueL1 || value3L || value1R || value3R)
+        return -1;
+    if (value1CL == value3CL || value1CR == value3CR)
+        return -1;
+    const uint64_t varsL[2] = { value1CL, value3CL };
+    const uint64_t varsR[2] = { value1CR, value3CR };
+    const CharacteristicSets::Position positions[2] = {
+        CharacteristicSets::SUBJECT, CharacteristicSets::OBJECT };
+    int nmatches = 0;
+    CharacteristicSets::Position posL = CharacteristicSets::SUBJECT;
+    CharacteristicSets::Position posR = CharacteristicSets::SUBJECT;
+    for (int i = 0; i < 2; ++i) {
+        for (int j = 0; j < 2; ++j) {
+            if (varsL[i] == varsR[j]) {
+                nmatches++;
+                posL = positions[i];
+                posR = positions[j];
+            }
+        }
+    }
+    if (nmatches != 1)
+        return -1;
+
+    uint64_t triplesL, triplesR, subjects, objects;
+    if (!cs->getPredicateStats(value2CL, triplesL, subjects, objects) ||
+            !cs->getPredicateStats(value2CR, triplesR, subjects, objects))
+        return -1;
+    const double card = cs->getJoinCardinality(value2CL, posL, value2CR, posR);
+    if (card < 0)
+        return -1;
+    if (triplesL == 0 || triplesR == 0)
+        return 0;
+    return card / ((double) triplesL * triplesR);
+}
+
 double TridentLayer::getJoinSelectivity(bool valueL1,
         uint64_t value1CL,
         bool value2L,
@@ -611,6 +678,19 @@ double TridentLayer::getJoinSelectivity(bool valueL1,
     LOG(DEBUGL) << "Exec join selectivity: " << valueL1 << " " << value1CL << " " << value2L << " " << value2CL << " " << value3L << " " <<
         value3CL << "-" << value1R << " " <<  value1CR << " " << value2R << " " << value2CR << " " << value3R << " " << value3CR;
 
+    //First try with the statistics computed by the loader, which do not
+    //require any I/O
+    const CharacteristicSets *cs = kb.getCharacteristicSets();
+    if (cs != NULL) {
+        const double sel = statsJoinSelectivity(cs, valueL1, value1CL,
+                value2L, value2CL, value3L, value3CL, value1R, value1CR,
+                value2R, value2CR, value3R, value3CR);
+        if (sel >= 0) {
+            LOG(DEBUGL) << "Join selectivity from the statistics: " << sel;
+            return sel;
+        }
+    }
+
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 
     std::shared_ptr<TupleTable> t1;
@@ -713,6 +793,15 @@ double TridentLayer::getJoinSelectivity(bool valueL1,
 uint64_t TridentLayer::getCardinality(uint64_t c1,
         uint64_t c2,
         uint64_t c3) {
+    //Patterns with only the predicate are answered by the statistics
+    const CharacteristicSets *cs = kb.getCharacteristicSets();
+    if (cs != NULL && c1 == UINT64_MAX && c2 != UINT64_MAX &&
+            c3 == UINT64_MAX) {
+        uint64_t triples, subjects, objects;
+        if (cs->getPredicateStats(c2, triples, subjects, objects)) {
+            return triples;
+        }
+    }
     int64_t v1 = -1;
     if (c1 != UINT64_MAX) {
         v1 = c1;
@@ -733,6 +822,14 @@ uint64_t TridentLayer::getCardinality() {
     return kb.getSize();
 }
 
+double TridentLayer::getStarCardinality(
+        const std::vector<uint64_t> &predicates) {
+    const CharacteristicSets *cs = kb.getCharacteristicSets();
+    if (cs == NULL)
+        return -1;
+    return cs->getStarCardinality(predicates);
+}
+
 std::unique_ptr<DBLayer::Scan> TridentLayer::getScan(
         const DBLayer::DataOrder order,
         const DBLayer::Aggr_t a,
@@ -975,11 +1072,17 @@ uint64_t TridentScan::getValue1() {
 
 uint64_t TridentScan::getValue2() {
     assert(a != DBLayer::Aggr_t::AGGR_SKIP_2LAST);
+    if (batched) {
+        return batchValues1[batchPos];
+    }
     return itr->getValue1();
 }
 
 uint64_t TridentScan::getValue3() {
     assert(a == DBLayer::Aggr_t::AGGR_NO);
+    if (batched) {
+        return batchValues2[batchPos];
+    }
     return itr->getValue2();
 }
 
@@ -987,7 +1090,69 @@ uint64_t TridentScan::getCount() {
     return itr->getCount();
 }
 
+void TridentScan::startBatch() {
+    //Aggregated scans need the counts, which are not part of a batch
+    if (a != DBLayer::AGGR_NO) {
+        return;
+    }
+    if (!batchValues1) {
+        batchValues1 = std::unique_ptr<int64_t[]>(
+                new int64_t[PAIRITR_BATCH_SIZE]);
+        batchValues2 = std::unique_ptr<int64_t[]>(
+                new int64_t[PAIRITR_BATCH_SIZE]);
+    }
+    //The first pair was already read with next()
+    batchValues1[0] = itr->getValue1();
+    batchValues2[0] = itr->getValue2();
+    batchSize = 1;
+    batchPos = 0;
+    batched = true;
+}
+
+void TridentScan::applyHintToBatch() {
+    uint64_t s = 0, p = 0, o = 0;
+    hint->next(s, p, o);
+    const int64_t v1 = p, v2 = o;
+    if (v1 <= batchValues1[batchPos]) {
+        return;
+    }
+    //Skip the buffered pairs that are lower than the hint
+    size_t i = batchPos + 1;
+    while (i < batchSize && (batchValues1[i] < v1 ||
+                (batchValues1[i] == v1 && batchValues2[i] < v2))) {
+        i++;
+    }
+    if (i < batchSize) {
+        batchPos = i - 1;
+        return;
+    }
+    //The hint is beyond the batch. The iterator is on the last pair of the
+    //batch, so it can jump from there and the batch is refilled
+    itr->moveto(p, o);
+    batchPos = batchSize - 1;
+}
+
 bool TridentScan::next() {
+    if (batched) {
+        if (hint && countHint == 0) {
+            applyHintToBatch();
+        }
+        if (countHint++ > COUNTHINT_MAX)
+            countHint = 0;
+        if (++batchPos < batchSize) {
+            return true;
+        }
+        batchPos = 0;
+        batchSize = itr->nextBatch(batchValues1.get(), batchValues2.get(),
+                PAIRITR_BATCH_SIZE);
+        if (batchSize > 0) {
+            return true;
+        }
+        batched = false;
+        q->releaseItr(itr);
+        itr = NULL;
+        return false;
+    }
 
     if (hint && countHint == 0) {
         uint64_t s = 0, p = 0, o = 0;
@@ -1024,7 +1189,16 @@ bool TridentScan::next() {
     }
 }
 
+void TridentScan::restart() {
+    if (itr != NULL) {
+        q->releaseItr(itr);
+        itr = NULL;
+    }
+    batched = false;
+}
+
 bool TridentScan::first() {
+    restart();
     if (a == DBLayer::AGGR_SKIP_2LAST) {
         itr = q->getTermList(perm);
         bool resp = itr->hasNext();
@@ -1036,13 +1210,16 @@ bool TridentScan::first() {
         if (a == DBLayer::AGGR_SKIP_LAST)
             itr->ignoreSecondColumn();
         bool resp = itr->hasNext();
-        if (resp)
+        if (resp) {
             itr->next();
+            startBatch();
+        }
         return resp;
     }
 }
 
 bool TridentScan::first(uint64_t el, bool constrained) {
+    restart();
     if (a != DBLayer::Aggr_t::AGGR_NO)
         throw 10; //Not supported
 
@@ -1053,6 +1230,7 @@ bool TridentScan::first(uint64_t el, bool constrained) {
 
     if (itr->hasNext()) {
         itr->next();
+        startBatch();
         return true;
     } else {
         q->releaseItr(itr);
@@ -1062,6 +1240,7 @@ bool TridentScan::first(uint64_t el, bool constrained) {
 }
 
 bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2, bool constrained2) {
+    restart();
     if (a == DBLayer::Aggr_t::AGGR_SKIP_2LAST)
         throw 10; //Not supported. Should also never occur
 
@@ -1080,6 +1259,7 @@ bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2, bool cons
     }
     if (itr->hasNext()) {
         itr->next();
+        startBatch();
         return true;
     } else {
         q->releaseItr(itr);
@@ -1090,6 +1270,7 @@ bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2, bool cons
 
 bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2,
         bool constrained2, uint64_t el3, bool constrained3) {
+    restart();
 
     if (a != DBLayer::Aggr_t::AGGR_NO)
         throw 10; //Not supported. Should also never occur
@@ -1111,6 +1292,7 @@ bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2,
     bool resp = itr->hasNext();
     if (resp) {
         itr->next();
+        startBatch();
     } else {
         q->releaseItr(itr);
         itr = NULL;
@@ -1118,6 +1300,43 @@ bool TridentScan::first(uint64_t el1, bool constrained1, uint64_t el2,
     return resp;
 }
 
+bool TridentScan::skipTo(uint64_t value1, uint64_t value2) {
+    assert(itr != NULL);
+    const uint64_t key = itr->getKey();
+    if (key > value1 || (key == value1 && getValue2() >= value2)) {
+        return true;
+    }
+    if (batched) {
+        //All the pairs of a batch share the key
+        if (key == value1) {
+            while (++batchPos < batchSize) {
+                if (batchValues1[batchPos] >= value2) {
+                    return true;
+                }
+            }
+        }
+        //The iterator is on the last pair of the batch
+        batched = false;
+    }
+
+    //Only the scan iterators can jump to another key
+    const int type = itr->getTypeItr();
+    if (key < value1 && (type == SCAN_ITR || type == COMPOSITESCAN_ITR ||
+                type == DIFFSCAN_ITR)) {
+        itr->gotoKey(value1);
+    } else if (key == value1) {
+        itr->moveto(value2, 0);
+    }
+    if (!itr->hasNext()) {
+        q->releaseItr(itr);
+        itr = NULL;
+        return false;
+    }
+    itr->next();
+    startBatch();
+    return DBLayer::Scan::skipTo(value1, value2);
+}
+
 TridentScan::~TridentScan() {
     if (itr != NULL) {
         q->releaseItr(itr);
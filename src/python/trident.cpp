@@ -750,10 +750,41 @@ static PyObject * db_lookup_relid(PyObject *self, PyObject *args) {
 }
 
 static PyObject * db_lookup_str(PyObject *self, PyObject *args) {
-    int64_t id;
-    if (!PyArg_ParseTuple(args, "l", &id))
+    PyObject *ids;
+    if (!PyArg_ParseTuple(args, "O", &ids))
         return NULL;
     KB *kb = ((trident_Db*)self)->kb;
+
+    if (PyList_Check(ids)) {
+        //Translate all the IDs at once. Returns a list with the strings
+        //(None for the unknown IDs)
+        const Py_ssize_t n = PyList_Size(ids);
+        std::vector<nTerm> keys(n);
+        for (Py_ssize_t i = 0; i < n; ++i) {
+            keys[i] = PyLong_AsLongLong(PyList_GetItem(ids, i));
+        }
+        if (PyErr_Occurred())
+            return NULL;
+        std::vector<std::string> values;
+        std::vector<bool> found;
+        kb->getDictMgmt()->getTexts(keys, values, found);
+        PyObject *obj = PyList_New(0);
+        for (Py_ssize_t i = 0; i < n; ++i) {
+            if (found[i]) {
+                PyObject *value = PyUnicode_FromStringAndSize(
+                        values[i].c_str(), values[i].size());
+                PyList_Append(obj, value);
+                Py_DECREF(value);
+            } else {
+                PyList_Append(obj, Py_None);
+            }
+        }
+        return obj;
+    }
+
+    int64_t id = PyLong_AsLongLong(ids);
+    if (PyErr_Occurred())
+        return NULL;
     char term[MAX_TERM_SIZE];
     int len;
     bool resp = kb->getDictMgmt()->getText(id, term, len);
@@ -790,17 +821,18 @@ static PyObject * db_search_id(PyObject *self, PyObject *args) {
     TreeItr *itr = mgmt->getInvDictIterator();
     StringBuffer *sb = mgmt->getStringBuffer();
     string sTermToSearch(term);
+    std::unique_ptr<char[]> text(new char[MAX_TERM_SIZE]);
     PyObject *obj = PyList_New(0);
     while (itr->hasNext()) {
         int64_t value;
         int64_t key = itr->next(value);
         int size;
-        const char *text = sb->get(value, size);
-        string sTerm(text, size);
+        sb->get(value, text.get(), size);
+        string sTerm(text.get(), size);
         if (sTerm.find(sTermToSearch) != string::npos) {
             PyObject *t = PyTuple_New(2);
             PyTuple_SetItem(t, 0, PyLong_FromLong(key));
-            PyTuple_SetItem(t, 1, PyUnicode_FromStringAndSize(text, size));
+            PyTuple_SetItem(t, 1, PyUnicode_FromStringAndSize(text.get(), size));
             PyList_Append(obj, t);
             Py_DECREF(t);
         }
@@ -933,7 +965,7 @@ static PyMethodDef Db_methods[] = {
     {"outdegree", db_outdegree, METH_VARARGS, "Get the list of all nodes with their outdegrees" },
     {"lookup_id", db_lookup_id, METH_VARARGS, "Lookup for the ID of an input term" },
     {"lookup_relid", db_lookup_relid, METH_VARARGS, "Lookup for the ID of an input relation term" },
-    {"lookup_str", db_lookup_str, METH_VARARGS, "Lookup for the textual version of an entity ID" },
+    {"lookup_str", db_lookup_str, METH_VARARGS, "Lookup for the textual version of an entity ID, or of a list of IDs" },
     {"lookup_relstr", db_lookup_relstr, METH_VARARGS, "Lookup for the textual version of a relation ID" },
     {"search_id", db_search_id, METH_VARARGS, "Search for the IDs of terms" },
     {"join_e2e", db_join_e2e, METH_VARARGS, "Return the subset of entities of a pattern like <?x p1 o1> is also in another patter <?x p2 o2>. The first three argumenta are the index to use for the first pattern, the key, and second value. Then, the last three arguments refer to the second pattern." },
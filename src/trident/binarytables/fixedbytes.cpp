@@ -0,0 +1,234 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+#include <trident/binarytables/fixedbytes.h>
+
+//Number of entries decoded for the final linear probe of lowerBound()
+#define PROBE_ENTRIES 32
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIXEDBYTES_X86 1
+#include <immintrin.h>
+#endif
+
+const uint64_t FixedBytes::masks[9] = {
+    0x0ull,
+    0xFFull,
+    0xFFFFull,
+    0xFFFFFFull,
+    0xFFFFFFFFull,
+    0xFFFFFFFFFFull,
+    0xFFFFFFFFFFFFull,
+    0xFFFFFFFFFFFFFFull,
+    0xFFFFFFFFFFFFFFFFull
+};
+
+typedef size_t (*UnpackKernel)(const char *in, const char *limit,
+        const uint8_t nbytes, const size_t n, uint64_t *out);
+
+typedef size_t (*CountKernel)(const uint64_t *values, const size_t n,
+        const uint64_t key);
+
+static size_t countSmaller_scalar(const uint64_t *values, const size_t n,
+        const uint64_t key) {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        count += values[i] < key;
+    }
+    return count;
+}
+
+void FixedBytes::unpack_scalar(const char *in, const char *limit,
+        const uint8_t nbytes, const uint8_t stride,
+        const size_t n, uint64_t *out) {
+    const uint64_t mask = masks[nbytes];
+    size_t i = 0;
+    //Entries followed by at least 8 bytes are read with a single load
+    for (; i < n && in + 8 <= limit; ++i) {
+        uint64_t v;
+        memcpy(&v, in, 8);
+        out[i] = v & mask;
+        in += stride;
+    }
+    for (; i < n; ++i) {
+        uint64_t v = 0;
+        memcpy(&v, in, nbytes);
+        out[i] = v;
+        in += stride;
+    }
+}
+
+#if FIXEDBYTES_X86
+//The shuffle mask copies the nbytes of two consecutive entries in two
+//64-bit lanes, and sets the remaining bytes to zero
+static void getShuffleMask(const uint8_t nbytes, char *mask) {
+    for (int lane = 0; lane < 2; ++lane) {
+        for (int b = 0; b < 8; ++b) {
+            mask[lane * 8 + b] = b < nbytes ? (char)(lane * nbytes + b) :
+                (char)0x80;
+        }
+    }
+}
+
+//Both kernels return the number of entries they decoded. The caller
+//decodes the rest with the scalar code.
+__attribute__((target("ssse3")))
+static size_t unpack_ssse3(const char *in, const char *limit,
+        const uint8_t nbytes, const size_t n, uint64_t *out) {
+    char m[16];
+    getShuffleMask(nbytes, m);
+    const __m128i mask = _mm_loadu_si128((const __m128i*) m);
+    const size_t step = 2 * nbytes;
+    size_t i = 0;
+    while (i + 2 <= n && in + 16 <= limit) {
+        const __m128i v = _mm_loadu_si128((const __m128i*) in);
+        _mm_storeu_si128((__m128i*) (out + i), _mm_shuffle_epi8(v, mask));
+        in += step;
+        i += 2;
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t unpack_avx2(const char *in, const char *limit,
+        const uint8_t nbytes, const size_t n, uint64_t *out) {
+    char m[16];
+    getShuffleMask(nbytes, m);
+    //vpshufb works within each 128-bit lane. Each lane receives two entries
+    const __m128i m128 = _mm_loadu_si128((const __m128i*) m);
+    const __m256i mask = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(m128), m128, 1);
+    const size_t step = 2 * nbytes;
+    size_t i = 0;
+    while (i + 4 <= n && in + step + 16 <= limit) {
+        const __m128i lo = _mm_loadu_si128((const __m128i*) in);
+        const __m128i hi = _mm_loadu_si128((const __m128i*) (in + step));
+        const __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256((__m256i*) (out + i),
+                _mm256_shuffle_epi8(v, mask));
+        in += 2 * step;
+        i += 4;
+    }
+    //Two more entries might fit in a 128-bit load
+    if (i + 2 <= n && in + 16 <= limit) {
+        const __m128i v = _mm_loadu_si128((const __m128i*) in);
+        _mm_storeu_si128((__m128i*) (out + i), _mm_shuffle_epi8(v, m128));
+        i += 2;
+    }
+    return i;
+}
+
+//AVX2 has only a signed 64-bit comparison. Flipping the sign bit of both
+//sides gives the unsigned order
+__attribute__((target("avx2")))
+static size_t countSmaller_avx2(const uint64_t *values, const size_t n,
+        const uint64_t key) {
+    const __m256i sign = _mm256_set1_epi64x((int64_t) 0x8000000000000000ull);
+    const __m256i k = _mm256_xor_si256(_mm256_set1_epi64x((int64_t) key), sign);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i v = _mm256_xor_si256(
+                _mm256_loadu_si256((const __m256i*) (values + i)), sign);
+        const int mask = _mm256_movemask_pd(
+                _mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+        count += __builtin_popcount(mask);
+    }
+    return count + countSmaller_scalar(values + i, n - i, key);
+}
+#endif
+
+static UnpackKernel selectKernel(const char **name) {
+#if FIXEDBYTES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return &unpack_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        *name = "ssse3";
+        return &unpack_ssse3;
+    }
+#endif
+    *name = "scalar";
+    return NULL;
+}
+
+static CountKernel selectCountKernel() {
+#if FIXEDBYTES_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &countSmaller_avx2;
+    }
+#endif
+    return &countSmaller_scalar;
+}
+
+static const char *kernelName = NULL;
+static const UnpackKernel kernel = selectKernel(&kernelName);
+static const CountKernel countKernel = selectCountKernel();
+
+void FixedBytes::unpack(const char *in, const char *limit,
+        const uint8_t nbytes, const uint8_t stride,
+        const size_t n, uint64_t *out) {
+    size_t i = 0;
+    //The shuffles only apply to contiguous entries
+    if (kernel && stride == nbytes && n >= 4) {
+        i = kernel(in, limit, nbytes, n, out);
+    }
+    if (i < n) {
+        unpack_scalar(in + i * stride, limit, nbytes, stride, n - i, out + i);
+    }
+}
+
+size_t FixedBytes::lowerBound(const char *in, const char *limit,
+        const uint8_t nbytes, const uint8_t stride,
+        const size_t n, const uint64_t key) {
+    size_t lo = 0;
+    size_t hi = 1;
+    //Gallop. All entries before lo are smaller than key
+    while (hi <= n && decode(in + (hi - 1) * stride, nbytes, limit) < key) {
+        lo = hi;
+        hi <<= 1;
+    }
+    if (hi > n) {
+        hi = n;
+    }
+    while (hi - lo > PROBE_ENTRIES) {
+        const size_t middle = lo + ((hi - lo) >> 1);
+        if (decode(in + middle * stride, nbytes, limit) < key) {
+            lo = middle + 1;
+        } else {
+            hi = middle;
+        }
+    }
+    //The entries are sorted, so the position is lo plus the number of
+    //entries in [lo, hi) that are smaller than key
+    uint64_t values[PROBE_ENTRIES];
+    unpack(in + lo * stride, limit, nbytes, stride, hi - lo, values);
+    return lo + countKernel(values, hi - lo, key);
+}
+
+const char *FixedBytes::getKernelName() {
+    return kernelName;
+}
@@ -55,8 +55,9 @@ void FileMarks::parse(string path) {
 TableStorage::TableStorage(bool readOnly, string pathDir, int64_t maxFileSize,
         int maxNFiles,
         MemoryManager<FileDescriptor> *bytesTracker,
-        Stats &stats, int perm) :
-    readOnly(readOnly), marks(), marksLoaded(), stats(stats), perm(perm) {
+        Stats &stats, int perm, bool mmapFiles) :
+    readOnly(readOnly), marks(), marksLoaded(), cache(NULL),
+    mmapFiles(readOnly && mmapFiles), stats(stats), perm(perm) {
         strcpy(this->pathDir, pathDir.c_str());
         this->sizePathDir = strlen(this->pathDir);
         this->pathDir[sizePathDir++] = CDIR_SEP;
@@ -72,11 +73,18 @@ TableStorage::TableStorage(bool readOnly, string pathDir, int64_t maxFileSize,
                     lastCreatedFile = (short) idx;
             }
 
-            cache = new FileManager<FileDescriptor, FileDescriptor>(pathDir,
-                    readOnly, maxFileSize, maxNFiles, lastCreatedFile,
-                    bytesTracker, &stats);
-
-            sizeLastCreatedFile = cache->sizeFile(lastCreatedFile);
+            if (this->mmapFiles) {
+                mapAllFiles();
+                if (mappedFiles[lastCreatedFile]) {
+                    sizeLastCreatedFile = mappedFiles[lastCreatedFile]->getLength();
+                }
+            } else {
+                cache = new FileManager<FileDescriptor, FileDescriptor>(pathDir,
+                        readOnly, maxFileSize, maxNFiles, lastCreatedFile,
+                        bytesTracker, &stats);
+
+                sizeLastCreatedFile = cache->sizeFile(lastCreatedFile);
+            }
         } else {
             //Create the directory if it does not exist
             if (!readOnly) {
@@ -131,7 +139,44 @@ std::string TableStorage::getPath() {
     return std::string(pathDir, sizePathDir);
 }
 
-std::pair<const char*, const char*> TableStorage::getTable(short file, int64_t mark) {
+void TableStorage::mapAllFiles() {
+    mappedFiles.resize(lastCreatedFile + 1);
+    for (int i = 0; i <= lastCreatedFile; ++i) {
+        sprintf(pathDir + sizePathDir, "%d", i);
+        string pathFile(pathDir);
+        if (Utils::exists(pathFile) && Utils::fileSize(pathFile) > 0) {
+            mappedFiles[i] = std::unique_ptr<MemoryMappedFile>(
+                    new MemoryMappedFile(pathFile));
+            //Most accesses are lookups, which gain nothing from the
+            //read-ahead. Scans request their range in getTable()
+            mappedFiles[i]->advise(0, mappedFiles[i]->getLength(),
+                    MMAP_ADVICE_RANDOM);
+        }
+        //Parse all the marks now, so getTable never takes the lock
+        sprintf(pathDir + sizePathDir, "%d.idx", i);
+        if (Utils::exists(string(pathDir))) {
+            FileMarks *m = new FileMarks();
+            m->parse(string(pathDir));
+            marks[i] = m;
+        }
+        marksLoaded[i] = true;
+    }
+    LOG(DEBUGL) << "Mapped " << mappedFiles.size() << " files of " <<
+        getPath();
+}
+
+std::pair<const char*, const char*> TableStorage::getTable(short file,
+        int64_t mark, bool scan) {
+    if (mmapFiles) {
+        std::pair<uint64_t,uint64_t> coord = marks[file]->getPos(mark);
+        MemoryMappedFile *f = mappedFiles[file].get();
+        const char *start = f->getData() + coord.first;
+        const uint64_t len = coord.second - coord.first;
+        if (scan && len >= MMAP_WILLNEED_MIN) {
+            f->advise(coord.first, len, MMAP_ADVICE_WILLNEED);
+        }
+        return make_pair(start, start + len);
+    }
     //I assume all the table is in one file
     if (!marksLoaded[file]) {
 #ifdef MT
@@ -272,6 +317,12 @@ void TableStorage::stopInsert() {
 
 std::vector<const char*> TableStorage::loadAllFiles() {
     std::vector<const char*> files;
+    if (mmapFiles) {
+        for(int i = 0; i <= lastCreatedFile; ++i) {
+            files.push_back(mappedFiles[i] ? mappedFiles[i]->getData() : NULL);
+        }
+        return files;
+    }
     for(int i = 0; i <= cache->getIdLastFile(); ++i) {
         uint64_t length = std::numeric_limits<uint64_t>::max();
         files.push_back(cache->getBuffer(i, 0, &length));
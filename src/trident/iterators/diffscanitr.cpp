@@ -37,7 +37,8 @@ bool DiffScanItr::hasNext() {
         if (root->hasNext()) {
             TermCoordinates values;
             currentkey = root->next(&values);
-            currentItr = ((DiffIndex3*)diff)->getIterator(perm, currentkey, values);
+            currentItr = ((DiffIndex3*)diff)->getIterator(perm, currentkey, values,
+                    strat);
             if (!currentItr->hasNext()) {
                 LOG(ERRORL) << "This should not happen";
             }
@@ -84,11 +85,13 @@ uint64_t DiffScanItr::estCardinality() {
     }
 }
 
-void DiffScanItr::init(TreeItr *root, int perm, DiffIndex *diff) {
+void DiffScanItr::init(TreeItr *root, int perm, DiffIndex *diff,
+        StorageStrat *strat) {
     initializeConstraints();
     this->perm = perm;
     this->root = std::unique_ptr<TreeItr>(root);
     this->diff = diff;
+    this->strat = strat;
     hnc = false;
     currentItr = NULL;
     ignseccol = false;
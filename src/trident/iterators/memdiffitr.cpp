@@ -0,0 +1,123 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/iterators/memdiffitr.h>
+
+#include <assert.h>
+
+void MemDiffItr::init(std::shared_ptr<const std::vector<uint64_t>> table,
+        size_t start, size_t end) {
+    initializeConstraints();
+    this->table = table;
+    this->rows = table->data();
+    this->start = start;
+    this->end = end;
+    pos = markPos = start;
+    current = start;
+    v1 = v2 = -1;
+    count = 0;
+    ignSecondColumn = false;
+}
+
+void MemDiffItr::next() {
+    current = pos;
+    setKey(rows[pos * 3]);
+    v1 = rows[pos * 3 + 1];
+    v2 = rows[pos * 3 + 2];
+    pos++;
+    if (ignSecondColumn) {
+        //Skip the other rows of the group
+        while (pos < end && sameGroup(pos, current)) {
+            pos++;
+        }
+    }
+    count = pos - current;
+}
+
+void MemDiffItr::ignoreSecondColumn() {
+    ignSecondColumn = true;
+    if (v1 != -1) {
+        while (pos < end && sameGroup(pos, current)) {
+            pos++;
+        }
+        count = pos - current;
+    }
+}
+
+uint64_t MemDiffItr::getCardinality() {
+    if (!ignSecondColumn) {
+        return end - start;
+    }
+    uint64_t groups = 0;
+    for (size_t i = start; i < end; ++i) {
+        if (i == start || !sameGroup(i, i - 1)) {
+            groups++;
+        }
+    }
+    return groups;
+}
+
+uint64_t MemDiffItr::estCardinality() {
+    return end - start;
+}
+
+void MemDiffItr::mark() {
+    markPos = pos;
+}
+
+void MemDiffItr::reset(const char i) {
+    pos = markPos;
+}
+
+void MemDiffItr::clear() {
+    table = std::shared_ptr<const std::vector<uint64_t>>();
+    rows = NULL;
+}
+
+void MemDiffItr::moveto(const int64_t c1, const int64_t c2) {
+    assert(v1 != -1);
+    if (v1 > c1 || (v1 == c1 && (ignSecondColumn || v2 >= c2))) {
+        //The current pair is already after the target: return it again
+        pos = current;
+        return;
+    }
+
+    //Binary search of the first row of the current key that is not smaller
+    //than the target
+    const uint64_t k = getKey();
+    const uint64_t t1 = c1;
+    const uint64_t t2 = ignSecondColumn ? 0 : c2;
+    size_t low = pos;
+    size_t high = end;
+    while (low < high) {
+        const size_t mid = (low + high) >> 1;
+        const uint64_t *row = rows + mid * 3;
+        if (row[0] < k || (row[0] == k && (row[1] < t1 ||
+                        (row[1] == t1 && row[2] < t2)))) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    pos = low;
+}
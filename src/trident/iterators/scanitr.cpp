@@ -242,6 +242,20 @@ bool ScanItr::next(int64_t &v1, int64_t &v2, int64_t &v3) {
     return hasNext;
 }
 
+size_t ScanItr::nextBatch(int64_t *v1, int64_t *v2, size_t max) {
+    if (!hasNext()) {
+        return 0;
+    }
+    //If a table is still open after hasNext(), then it contains more pairs
+    //with the current key. Otherwise, next() must first open a new table.
+    PairItr *table = currentTable ? currentTable : reversedItr;
+    if (table) {
+        hnc = false;
+        return table->nextBatch(v1, v2, max);
+    }
+    return PairItr::nextBatch(v1, v2, max);
+}
+
 void ScanItr::clear() {
     if (m_currentTable) {
         q->releaseItr(m_currentTable);
@@ -0,0 +1,395 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/kb/charsets.h>
+#include <trident/kb/querier.h>
+#include <trident/iterators/pairitr.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+
+//Reads all the triples of an entity from a full scan of SPO or OPS, and
+//returns the number of triples of every predicate
+class EntityReader {
+    private:
+        PairItr *itr;
+        bool valid;
+
+    public:
+        uint64_t entity;
+
+        EntityReader(PairItr *itr) : itr(itr), entity(0) {
+            valid = itr != NULL && itr->hasNext();
+            if (valid)
+                itr->next();
+        }
+
+        bool next(std::vector<std::pair<uint64_t, uint64_t>> &group) {
+            group.clear();
+            if (!valid)
+                return false;
+            entity = itr->getKey();
+            while (valid && (uint64_t)itr->getKey() == entity) {
+                const uint64_t p = itr->getValue1();
+                if (!group.empty() && group.back().first == p) {
+                    group.back().second++;
+                } else {
+                    group.push_back(std::make_pair(p, (uint64_t) 1));
+                }
+                valid = itr->hasNext();
+                if (valid)
+                    itr->next();
+            }
+            return true;
+        }
+};
+
+static void writeLong(std::ostream &out, const uint64_t v) {
+    char data[8];
+    Utils::encode_long(data, 0, v);
+    out.write(data, 8);
+}
+
+static uint64_t readLong(std::istream &in) {
+    char data[8];
+    in.read(data, 8);
+    return Utils::decode_long(data, 0);
+}
+
+void CharacteristicSets::PairStats::add(const uint64_t p1, const uint64_t p2,
+        const uint64_t v, const size_t maxPairs) {
+    const std::pair<uint64_t, uint64_t> key = std::make_pair(p1, p2);
+    auto itr = counts.find(key);
+    if (itr != counts.end()) {
+        itr->second += v;
+    } else if (counts.size() < maxPairs) {
+        counts.insert(std::make_pair(key, v));
+    } else {
+        truncated = true;
+    }
+}
+
+void CharacteristicSets::writePairs(std::ostream &out, const PairStats &pairs) {
+    char data[1];
+    data[0] = pairs.truncated ? 1 : 0;
+    out.write(data, 1);
+    writeLong(out, pairs.counts.size());
+    for (auto &pair : pairs.counts) {
+        writeLong(out, pair.first.first);
+        writeLong(out, pair.first.second);
+        writeLong(out, pair.second);
+    }
+}
+
+void CharacteristicSets::readPairs(std::istream &in, PairStats &pairs) {
+    char data[1];
+    in.read(data, 1);
+    pairs.truncated = data[0] != 0;
+    const uint64_t n = readLong(in);
+    for (uint64_t i = 0; i < n; ++i) {
+        const uint64_t p1 = readLong(in);
+        const uint64_t p2 = readLong(in);
+        pairs.counts[std::make_pair(p1, p2)] = readLong(in);
+    }
+}
+
+void CharacteristicSets::writeSet(std::ostream &out, const CharSet &cs) {
+    writeLong(out, cs.subjects);
+    writeLong(out, cs.predicates.size());
+    for (auto &p : cs.predicates) {
+        writeLong(out, p.first);
+        writeLong(out, p.second);
+    }
+}
+
+void CharacteristicSets::readSet(std::istream &in, CharSet &cs) {
+    cs.subjects = readLong(in);
+    const uint64_t n = readLong(in);
+    for (uint64_t j = 0; j < n && in; ++j) {
+        const uint64_t p = readLong(in);
+        cs.predicates.push_back(std::make_pair(p, readLong(in)));
+    }
+}
+
+void CharacteristicSets::compute(Querier *q, std::string file,
+        size_t maxSets, size_t maxPairs) {
+    std::chrono::system_clock::time_point start =
+        std::chrono::system_clock::now();
+    if (!q->isPresent(IDX_SPO)) {
+        LOG(WARNL) << "The index SPO is not present. Characteristic sets are not computed";
+        return;
+    }
+
+    CharacteristicSets stats;
+    stats.hasObjects = q->isPresent(IDX_OPS);
+    std::map<std::vector<uint64_t>, CharSet> sets;
+
+    PairItr *itrOut = q->getIterator(IDX_SPO, -1, -1, -1);
+    PairItr *itrIn = stats.hasObjects ? q->getIterator(IDX_OPS, -1, -1, -1)
+        : NULL;
+    EntityReader readerOut(itrOut);
+    EntityReader readerIn(itrIn);
+    std::vector<std::pair<uint64_t, uint64_t>> out, in;
+    std::vector<uint64_t> key;
+    bool hasOut = readerOut.next(out);
+    bool hasIn = readerIn.next(in);
+    while (hasOut || hasIn) {
+        //Merge the two scans on the entity
+        uint64_t entity;
+        if (hasOut && hasIn) {
+            entity = std::min(readerOut.entity, readerIn.entity);
+        } else {
+            entity = hasOut ? readerOut.entity : readerIn.entity;
+        }
+        const bool isSubject = hasOut && readerOut.entity == entity;
+        const bool isObject = hasIn && readerIn.entity == entity;
+
+        if (isSubject) {
+            key.clear();
+            for (size_t i = 0; i < out.size(); ++i) {
+                PredicateStats &ps = stats.predicates[out[i].first];
+                ps.triples += out[i].second;
+                ps.subjects++;
+                key.push_back(out[i].first);
+                for (size_t j = i; j < out.size(); ++j) {
+                    stats.subjectSubject.add(out[i].first, out[j].first,
+                            out[i].second * out[j].second, maxPairs);
+                }
+            }
+            CharSet &cs = sets[key];
+            if (cs.subjects == 0) {
+                for (auto &p : out)
+                    cs.predicates.push_back(std::make_pair(p.first,
+                                (uint64_t) 0));
+            }
+            cs.subjects++;
+            for (size_t i = 0; i < out.size(); ++i)
+                cs.predicates[i].second += out[i].second;
+        }
+        if (isObject) {
+            for (size_t i = 0; i < in.size(); ++i) {
+                stats.predicates[in[i].first].objects++;
+                for (size_t j = i; j < in.size(); ++j) {
+                    stats.objectObject.add(in[i].first, in[j].first,
+                            in[i].second * in[j].second, maxPairs);
+                }
+            }
+        }
+        if (isSubject && isObject) {
+            for (auto &pin : in) {
+                for (auto &pout : out) {
+                    stats.objectSubject.add(pin.first, pout.first,
+                            pin.second * pout.second, maxPairs);
+                }
+            }
+        }
+
+        if (isSubject)
+            hasOut = readerOut.next(out);
+        if (isObject)
+            hasIn = readerIn.next(in);
+    }
+    q->releaseItr(itrOut);
+    if (itrIn != NULL)
+        q->releaseItr(itrIn);
+
+    //Keep only the sets with the most subjects
+    for (auto &set : sets) {
+        stats.sets.push_back(CharSet());
+        stats.sets.back().subjects = set.second.subjects;
+        stats.sets.back().predicates.swap(set.second.predicates);
+    }
+    const size_t nsets = stats.sets.size();
+    std::sort(stats.sets.begin(), stats.sets.end(),
+            [](const CharSet &a, const CharSet &b) {
+            return a.subjects > b.subjects;
+            });
+    if (stats.sets.size() > maxSets) {
+        //Merge the other sets so that their subjects are still counted
+        std::map<uint64_t, uint64_t> restPredicates;
+        for (size_t i = maxSets; i < stats.sets.size(); ++i) {
+            stats.rest.subjects += stats.sets[i].subjects;
+            for (auto &p : stats.sets[i].predicates)
+                restPredicates[p.first] += p.second;
+        }
+        for (auto &p : restPredicates)
+            stats.rest.predicates.push_back(p);
+        stats.sets.resize(maxSets);
+    }
+
+    //Write everything on file
+    std::ofstream fos;
+    fos.open(file, std::ios_base::binary);
+    char data[1];
+    data[0] = stats.hasObjects ? 1 : 0;
+    fos.write(data, 1);
+    writeLong(fos, stats.predicates.size());
+    for (auto &p : stats.predicates) {
+        writeLong(fos, p.first);
+        writeLong(fos, p.second.triples);
+        writeLong(fos, p.second.subjects);
+        writeLong(fos, p.second.objects);
+    }
+    writeLong(fos, stats.sets.size());
+    for (auto &cs : stats.sets) {
+        writeSet(fos, cs);
+    }
+    writeSet(fos, stats.rest);
+    writePairs(fos, stats.subjectSubject);
+    writePairs(fos, stats.objectSubject);
+    writePairs(fos, stats.objectObject);
+    fos.close();
+
+    std::chrono::duration<double> sec = std::chrono::system_clock::now()
+        - start;
+    LOG(INFOL) << "Computed " << nsets << " characteristic sets (stored "
+        << stats.sets.size() << ") and the statistics of "
+        << stats.predicates.size() << " predicates in "
+        << sec.count() * 1000 << " ms";
+    if (stats.subjectSubject.truncated || stats.objectSubject.truncated
+            || stats.objectObject.truncated) {
+        LOG(WARNL) << "Too many pairs of predicates: only the first "
+            << maxPairs << " of every join are counted";
+    }
+}
+
+std::unique_ptr<CharacteristicSets> CharacteristicSets::load(
+        std::string file) {
+    if (!Utils::exists(file)) {
+        return std::unique_ptr<CharacteristicSets>();
+    }
+    std::unique_ptr<CharacteristicSets> stats(new CharacteristicSets());
+    std::ifstream fis;
+    fis.open(file, std::ios_base::binary);
+    char data[1];
+    fis.read(data, 1);
+    stats->hasObjects = data[0] != 0;
+    const uint64_t npredicates = readLong(fis);
+    for (uint64_t i = 0; i < npredicates; ++i) {
+        const uint64_t p = readLong(fis);
+        PredicateStats &ps = stats->predicates[p];
+        ps.triples = readLong(fis);
+        ps.subjects = readLong(fis);
+        ps.objects = readLong(fis);
+    }
+    const uint64_t nsets = readLong(fis);
+    for (uint64_t i = 0; i < nsets && fis; ++i) {
+        stats->sets.push_back(CharSet());
+        readSet(fis, stats->sets.back());
+    }
+    readSet(fis, stats->rest);
+    readPairs(fis, stats->subjectSubject);
+    readPairs(fis, stats->objectSubject);
+    readPairs(fis, stats->objectObject);
+    if (!fis) {
+        LOG(ERRORL) << "The file " << file << " is corrupted";
+        throw 10;
+    }
+    fis.close();
+    return stats;
+}
+
+bool CharacteristicSets::getPredicateStats(const uint64_t p,
+        uint64_t &triples,
+        uint64_t &subjects,
+        uint64_t &objects) const {
+    auto itr = predicates.find(p);
+    if (itr == predicates.end())
+        return false;
+    triples = itr->second.triples;
+    subjects = itr->second.subjects;
+    objects = itr->second.objects;
+    return true;
+}
+
+double CharacteristicSets::getJoinCardinality(const uint64_t p1,
+        const Position pos1,
+        const uint64_t p2,
+        const Position pos2) const {
+    if (predicates.count(p1) == 0 || predicates.count(p2) == 0) {
+        return -1;
+    }
+    const PairStats *pairs;
+    std::pair<uint64_t, uint64_t> key;
+    if (pos1 == SUBJECT && pos2 == SUBJECT) {
+        pairs = &subjectSubject;
+        key = std::make_pair(std::min(p1, p2), std::max(p1, p2));
+    } else if (!hasObjects) {
+        return -1;
+    } else if (pos1 == OBJECT && pos2 == OBJECT) {
+        pairs = &objectObject;
+        key = std::make_pair(std::min(p1, p2), std::max(p1, p2));
+    } else if (pos1 == OBJECT) {
+        pairs = &objectSubject;
+        key = std::make_pair(p1, p2);
+    } else {
+        pairs = &objectSubject;
+        key = std::make_pair(p2, p1);
+    }
+    auto itr = pairs->counts.find(key);
+    if (itr != pairs->counts.end())
+        return (double) itr->second;
+    //Unless some pairs were not counted, a missing pair does not join
+    return pairs->truncated ? -1 : 0;
+}
+
+double CharacteristicSets::getStarCardinality(
+        const std::vector<uint64_t> &preds) const {
+    if (preds.empty())
+        return -1;
+    for (auto p : preds) {
+        if (predicates.count(p) == 0)
+            return -1;
+    }
+    //Sum over all sets that contain the predicates the number of subjects
+    //times the average number of occurrences of every predicate
+    double card = 0;
+    for (auto &cs : sets) {
+        card += getSetCardinality(cs, preds);
+    }
+    //The merged set has the union of the predicates. Assuming they are
+    //independent, the formula estimates the subjects with all of them
+    //(subjects * prod(subjects_p / subjects)) times their occurrences
+    card += getSetCardinality(rest, preds);
+    return card;
+}
+
+double CharacteristicSets::getSetCardinality(const CharSet &cs,
+        const std::vector<uint64_t> &preds) {
+    if (cs.subjects == 0)
+        return 0;
+    double setCard = cs.subjects;
+    for (auto p : preds) {
+        auto itr = std::lower_bound(cs.predicates.begin(),
+                cs.predicates.end(), std::make_pair(p, (uint64_t) 0));
+        if (itr == cs.predicates.end() || itr->first != p) {
+            return 0;
+        }
+        setCard *= (double) itr->second / cs.subjects;
+    }
+    return setCard;
+}
@@ -21,6 +21,8 @@
 
 
 #include <trident/kb/dictmgmt.h>
+#include <trident/kb/staticdict.h>
+#include <trident/kb/updatelog.h>
 #include <trident/tree/root.h>
 #include <trident/tree/stringbuffer.h>
 #include <trident/tree/treeitr.h>
@@ -32,6 +34,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include <memory>
 
 using namespace std;
 
@@ -150,14 +155,12 @@ bool DictMgmt::getTextRel(nTerm key, char *value, int &size) {
 }
 
 bool DictMgmt::getText(nTerm key, char *value) {
-    int64_t coordinates;
     int idx = 0;
     while (idx < beginrange.size() - 1 && key >= beginrange[idx + 1]) {
         idx++;
     }
-    if (dictionaries[idx].invdict->get(key, coordinates)) {
-        int size = 0;
-        dictionaries[idx].sb->get(coordinates, value, size);
+    int size = 0;
+    if (getTextFromDict(idx, key, value, size)) {
         value[size] = '\0';
         return true;
     }
@@ -174,15 +177,14 @@ bool DictMgmt::getText(nTerm key, char *value) {
 }
 
 bool DictMgmt::getText(nTerm key, std::string &value) {
-    int64_t coordinates;
     int idx = 0;
     while (idx < beginrange.size() - 1 && key >= beginrange[idx + 1]) {
         idx++;
     }
-    if (dictionaries[idx].invdict->get(key, coordinates)) {
-        int size = 0;
-        char *rawvalue = dictionaries[idx].sb->get(coordinates, size);
-        value = std::string(rawvalue, size);
+    int size = 0;
+    std::unique_ptr<char[]> rawvalue(new char[MAX_TERM_SIZE]);
+    if (getTextFromDict(idx, key, rawvalue.get(), size)) {
+        value = std::string(rawvalue.get(), size);
         return true;
     }
     if (!gud_idtext.empty()) {
@@ -196,14 +198,26 @@ bool DictMgmt::getText(nTerm key, std::string &value) {
 
 }
 
-bool DictMgmt::getText(nTerm key, char *value, int &size) {
+bool DictMgmt::getTextFromDict(const int idx, nTerm key, char *value,
+        int &size) {
+    const Dict &dict = dictionaries[idx];
+    if (dict.sdict) {
+        return dict.sdict->getText(key, value, size);
+    }
     int64_t coordinates;
+    if (dict.invdict->get(key, coordinates)) {
+        dict.sb->get(coordinates, value, size);
+        return true;
+    }
+    return false;
+}
+
+bool DictMgmt::getText(nTerm key, char *value, int &size) {
     int idx = 0;
     while (idx < beginrange.size() - 1 && key >= beginrange[idx + 1]) {
         idx++;
     }
-    if (dictionaries[idx].invdict->get(key, coordinates)) {
-        dictionaries[idx].sb->get(coordinates, value, size);
+    if (getTextFromDict(idx, key, value, size)) {
         return true;
     }
     if (!gud_idtext.empty()) {
@@ -217,6 +231,123 @@ bool DictMgmt::getText(nTerm key, char *value, int &size) {
     return false;
 }
 
+void DictMgmt::getTexts(const std::vector<nTerm> &keys,
+        std::vector<std::string> &values,
+        std::vector<bool> &found) {
+    values.clear();
+    values.resize(keys.size());
+    found.assign(keys.size(), false);
+    if (keys.empty()) {
+        return;
+    }
+
+    //Sort and deduplicate the keys. They are compared as unsigned numbers,
+    //like in the ranges of the dictionaries
+    std::vector<std::pair<uint64_t, size_t>> sortedKeys;
+    sortedKeys.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        sortedKeys.push_back(std::make_pair((uint64_t) keys[i], i));
+    }
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    std::vector<uint64_t> distinctKeys;
+    std::vector<size_t> firstPos; //Position in sortedKeys
+    for (size_t i = 0; i < sortedKeys.size(); ++i) {
+        if (i == 0 || sortedKeys[i].first != sortedKeys[i - 1].first) {
+            distinctKeys.push_back(sortedKeys[i].first);
+            firstPos.push_back(i);
+        }
+    }
+    firstPos.push_back(sortedKeys.size());
+
+    //Search the coordinates, one dictionary at the time. Since the keys
+    //are sorted, the keys of each dictionary form a contiguous range
+    std::vector<std::pair<int64_t, size_t>> coordinates; //(coordinates,key)
+    std::vector<size_t> notFound;
+    std::vector<nTerm> rangeKeys;
+    std::vector<int64_t> rangeCoordinates;
+    std::vector<bool> rangeFound;
+    std::unique_ptr<char[]> rawvalue(new char[MAX_TERM_SIZE]);
+    size_t start = 0;
+    while (start < distinctKeys.size()) {
+        int idx = 0;
+        while (idx < beginrange.size() - 1 &&
+                distinctKeys[start] >= beginrange[idx + 1]) {
+            idx++;
+        }
+        size_t end = start + 1;
+        if (idx < beginrange.size() - 1) {
+            while (end < distinctKeys.size() &&
+                    distinctKeys[end] < beginrange[idx + 1]) {
+                end++;
+            }
+        } else {
+            end = distinctKeys.size();
+        }
+        if (dictionaries[idx].sdict) {
+            //The static dictionary does not need to be read in order
+            for (size_t i = start; i < end; ++i) {
+                int size = 0;
+                if (dictionaries[idx].sdict->getText(distinctKeys[i],
+                            rawvalue.get(), size)) {
+                    const size_t first = sortedKeys[firstPos[i]].second;
+                    values[first] = std::string(rawvalue.get(), size);
+                    found[first] = true;
+                } else {
+                    notFound.push_back(i);
+                }
+            }
+            start = end;
+            continue;
+        }
+        rangeKeys.assign(distinctKeys.begin() + start,
+                distinctKeys.begin() + end);
+        dictionaries[idx].invdict->get(rangeKeys, rangeCoordinates,
+                rangeFound);
+        for (size_t i = 0; i < rangeKeys.size(); ++i) {
+            if (rangeFound[i]) {
+                coordinates.push_back(std::make_pair(rangeCoordinates[i],
+                            start + i));
+            } else {
+                notFound.push_back(start + i);
+            }
+        }
+
+        //Read the strings in the order they are stored
+        std::sort(coordinates.begin(), coordinates.end());
+        for (const auto &c : coordinates) {
+            int size = 0;
+            dictionaries[idx].sb->get(c.first, rawvalue.get(), size);
+            const size_t first = sortedKeys[firstPos[c.second]].second;
+            values[first] = std::string(rawvalue.get(), size);
+            found[first] = true;
+        }
+        coordinates.clear();
+        start = end;
+    }
+
+    if (!gud_idtext.empty()) {
+        for (const auto k : notFound) {
+            auto it = gud_idtext.find(distinctKeys[k]);
+            if (it != gud_idtext.end()) {
+                const size_t first = sortedKeys[firstPos[k]].second;
+                values[first] = it->second;
+                found[first] = true;
+            }
+        }
+    }
+
+    //Copy the strings of the duplicated keys
+    for (size_t k = 0; k < distinctKeys.size(); ++k) {
+        const size_t first = sortedKeys[firstPos[k]].second;
+        if (found[first]) {
+            for (size_t i = firstPos[k] + 1; i < firstPos[k + 1]; ++i) {
+                values[sortedKeys[i].second] = values[first];
+                found[sortedKeys[i].second] = true;
+            }
+        }
+    }
+}
+
 void DictMgmt::getTextFromCoordinates(int64_t coordinates, char *output,
         int &sizeOutput) {
     dictionaries[0].sb->get(coordinates, output, sizeOutput);
@@ -226,7 +357,12 @@ void DictMgmt::getTextFromCoordinates(int64_t coordinates, char *output,
 bool DictMgmt::getNumber(const char *key, const int sizeKey, nTerm *value) {
     int i = 0;
     while (i < dictionaries.size()) {
-        if (!dictionaries[i].dict->get((tTerm*) key, sizeKey, value)) {
+        if (dictionaries[i].sdict) {
+            if (dictionaries[i].sdict->getNumber(key, sizeKey, *value)) {
+                return true;
+            }
+            i++;
+        } else if (!dictionaries[i].dict->get((tTerm*) key, sizeKey, value)) {
             i++;
         } else {
             return true;
@@ -324,16 +460,41 @@ void DictMgmt::addUpdates(std::vector<Dict> &updates) {
 
 DictMgmt::~DictMgmt() {
     delete[] insertedNewTerms;
+    try {
+        saveUpdateDict();
+    } catch (...) {
+        LOG(ERRORL) << "The global update dictionary was not saved";
+    }
+}
+
+void DictMgmt::saveUpdateDict() {
     if (gud_modified && !gud_idtext.empty()) {
         //Write down the new version
         std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        if (!Utils::exists(gudLocation)) {
+            Utils::create_directories(gudLocation);
+        }
+        //The new version replaces the old one only once it is complete and
+        //on disk, since the log of the updates is removed after this
+        const string gud = gudLocation + DIR_SEP + "gud";
         ofstream os;
-        os.open(gudLocation + DIR_SEP + "gud", ios_base::trunc);
-        os << gud_largestID << endl;
+        os.open(gud + ".tmp", ios_base::trunc);
+        os << gud_largestID << '\n';
         for (auto it = gud_idtext.begin(); it != gud_idtext.end(); ++it) {
-            os << it->first << '\t' << it->second << endl;
+            os << it->first << '\t' << it->second << '\n';
         }
         os.close();
+        if (os.fail()) {
+            LOG(ERRORL) << "Failed writing " << gud << ".tmp";
+            throw 10;
+        }
+        UpdateLog::syncPath(gud + ".tmp");
+        if (std::rename((gud + ".tmp").c_str(), gud.c_str()) != 0) {
+            LOG(ERRORL) << "Failed renaming " << gud << ".tmp";
+            throw 10;
+        }
+        UpdateLog::syncDirectory(gudLocation);
+        gud_modified = false;
         std::chrono::duration<double> sec = std::chrono::system_clock::now()
             - start;
         LOG(DEBUGL) << "Time writing GUD " << sec.count() * 1000;
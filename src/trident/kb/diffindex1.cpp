@@ -29,7 +29,8 @@
 
 #include <chrono>
 
-DiffIndex1::DiffIndex1(string dir, DiffIndex::TypeUpdate type) : DiffIndex(type, DiffIndex::DIFF1) {
+DiffIndex1::DiffIndex1(string dir, DiffIndex::TypeUpdate type) : DiffIndex(type, DiffIndex::DIFF1),
+    dir(dir) {
     ifstream f;
     f.open(dir + "/stats");
     char buffer[8];
@@ -72,7 +73,8 @@ DiffIndex1::DiffIndex1(string dir, DiffIndex::TypeUpdate type) : DiffIndex(type,
 
 extern EmptyItr emptyItr;
 PairItr *DiffIndex1::getIterator(int idx, int64_t first, int64_t second, int64_t third,
-        int64_t &nfirstterms) {
+        int64_t &nfirstterms, const DiffItrFactories &factories) {
+    Factory<Diff1Itr> *factory = factories.diff1;
     assert(factory != NULL);
     //nfirstterms = 0;
     int64_t permutedTriple[3];
@@ -267,10 +269,6 @@ void DiffIndex1::getTermListItr(int idx, DiffTermItr *itr) {
     }
 }
 
-void DiffIndex1::setFactoryIterators(Factory<Diff1Itr> *f) {
-    this->factory = f;
-}
-
 bool DiffIndex1::valueInArray(const int64_t v) const {
     const char *s = values->getBuffer();
     const char *e = values->getBuffer() + (size * nbytes);
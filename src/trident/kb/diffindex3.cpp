@@ -68,7 +68,6 @@ DiffIndex3::DiffIndex3(std::string dir, const char **globalbuffers,
     roots[IDX_SPO] = roots[IDX_SOP] = s.get();
     roots[IDX_POS] = roots[IDX_PSO] = p.get();
     roots[IDX_OPS] = roots[IDX_OSP] = o.get();
-    strat = NULL;
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - startDiff;
     LOG(DEBUGL) << "Load diff tree: " << sec.count() * 1000 << "ms.";
 
@@ -116,7 +115,8 @@ DiffIndex3::DiffIndex3(std::string dir, const char **globalbuffers,
 
 EmptyItr _diEmpty;
 
-PairItr *DiffIndex3::getScan(int idx, DiffScanItr *itr) {
+PairItr *DiffIndex3::getScan(int idx, DiffScanItr *itr,
+        StorageStrat *strat) {
     TreeItr *treeitr;
     if (idx == IDX_SPO || idx == IDX_SOP) {
         treeitr = s->itr();
@@ -125,13 +125,15 @@ PairItr *DiffIndex3::getScan(int idx, DiffScanItr *itr) {
     } else {
         treeitr = o->itr();
     }
-    itr->init(treeitr, idx, this);
+    itr->init(treeitr, idx, this, strat);
     return itr;
 }
 
-PairItr *DiffIndex3::getIterator(int idx, int64_t key, TermCoordinates &coord) {
-
-    if (!buffers[idx]) {
+const char *DiffIndex3::getBuffer(int idx) {
+    std::call_once(buffersLoaded[idx], [this, idx]() {
+        if (buffers[idx]) {
+            return;
+        }
         switch (idx) {
         case IDX_SPO:
             spo_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/s/p0"));
@@ -158,14 +160,19 @@ PairItr *DiffIndex3::getIterator(int idx, int64_t key, TermCoordinates &coord) {
             buffers[idx] = osp_f->getBuffer();
             break;
         }
-    }
+    });
+    return buffers[idx];
+}
+
+PairItr *DiffIndex3::getIterator(int idx, int64_t key, TermCoordinates &coord,
+        StorageStrat *strat) {
 
     int64_t nelements = coord.getNElements(idx);
     size_t idxArray = (coord.getFileIdx(idx) << 16) + coord.getMark(idx);
     char strategy = coord.getStrategy(idx);
     PairItr *itr = strat->getBinaryTable(strategy);
     AbsNewTable *newitr = (AbsNewTable*) itr;
-    const char *begin = buffers[idx] + idxArray;
+    const char *begin = getBuffer(idx) + idxArray;
     const char *end;
     if (newitr->getTypeItr() == NEWROW_ITR) {
         end =  begin + nelements *
@@ -185,7 +192,9 @@ PairItr *DiffIndex3::getIterator(int idx,
                                  int64_t first,
                                  int64_t second,
                                  int64_t third,
-                                 int64_t &nfirstterms) {
+                                 int64_t &nfirstterms,
+                                 const DiffItrFactories &factories) {
+    StorageStrat *strat = factories.strat;
     if (first < 0) {
         LOG(ERRORL) << "This method should not be called for full scans";
         throw 10;
@@ -193,40 +202,12 @@ PairItr *DiffIndex3::getIterator(int idx,
 
     TermCoordinates coordinates;
     if (roots[idx]->get(first, &coordinates)) {
-        if (!buffers[idx]) {
-            switch (idx) {
-            case IDX_SPO:
-                spo_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/s/p0"));
-                buffers[idx] = spo_f->getBuffer();
-                break;
-            case IDX_SOP:
-                sop_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/s/p1"));
-                buffers[idx] = sop_f->getBuffer();
-                break;
-            case IDX_POS:
-                pos_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/p/p0"));
-                buffers[idx] = pos_f->getBuffer();
-                break;
-            case IDX_PSO:
-                pso_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/p/p1"));
-                buffers[idx] = pso_f->getBuffer();
-                break;
-            case IDX_OPS:
-                ops_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/o/p0"));
-                buffers[idx] = ops_f->getBuffer();
-                break;
-            case IDX_OSP:
-                osp_f = std::unique_ptr<ROMappedFile>(new ROMappedFile(dir + "/o/p1"));
-                buffers[idx] = osp_f->getBuffer();
-                break;
-            }
-        }
         int64_t nelements = coordinates.getNElements(idx);
         size_t idxArray = (coordinates.getFileIdx(idx) << 16) + coordinates.getMark(idx);
         char strategy = coordinates.getStrategy(idx);
         PairItr *itr = strat->getBinaryTable(strategy);
         AbsNewTable *newitr = (AbsNewTable*) itr;
-        const char *begin = buffers[idx] + idxArray;
+        const char *begin = getBuffer(idx) + idxArray;
         const char *end;
         if (newitr->getTypeItr() == NEWROW_ITR) {
             end =  begin + nelements *
@@ -0,0 +1,297 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/kb/diffindex.h>
+#include <trident/iterators/memdiffitr.h>
+#include <trident/kb/consts.h>
+
+#include <kognac/utils.h>
+
+#include <algorithm>
+
+//Position in the triple (s, p, o) of the key and of the two values of every
+//permutation
+static const int _mem_positions[6][3] = {
+    {0, 1, 2}, //SPO
+    {2, 1, 0}, //OPS
+    {1, 2, 0}, //POS
+    {0, 2, 1}, //SOP
+    {2, 0, 1}, //OSP
+    {1, 0, 2}, //PSO
+};
+
+struct _MemRow {
+    uint64_t v[3];
+
+    bool operator <(const _MemRow &r) const {
+        return v[0] < r.v[0] || (v[0] == r.v[0] && (v[1] < r.v[1] ||
+                    (v[1] == r.v[1] && v[2] < r.v[2])));
+    }
+};
+
+//Returns the triples of the input (stored flat as (s, p, o)) in the order of
+//the permutation
+static void _mem_permute(const std::vector<uint64_t> &spo, const int perm,
+        std::vector<_MemRow> &out) {
+    const int *positions = _mem_positions[perm];
+    out.resize(spo.size() / 3);
+    for (size_t i = 0; i < out.size(); ++i) {
+        out[i].v[0] = spo[i * 3 + positions[0]];
+        out[i].v[1] = spo[i * 3 + positions[1]];
+        out[i].v[2] = spo[i * 3 + positions[2]];
+    }
+    std::sort(out.begin(), out.end());
+}
+
+static int _mem_cmp(const uint64_t *row, const _MemRow &r) {
+    for (int i = 0; i < 3; ++i) {
+        if (row[i] != r.v[i]) {
+            return row[i] < r.v[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+//First row in [low, high) whose first ncols columns are not smaller than the
+//target (or greater than the target, if upper is set)
+static size_t _mem_bound(const std::vector<uint64_t> &rows, size_t low,
+        size_t high, const uint64_t *target, const int ncols,
+        const bool upper) {
+    while (low < high) {
+        const size_t mid = (low + high) >> 1;
+        const uint64_t *row = &rows[mid * 3];
+        int c = 0;
+        for (int i = 0; i < ncols && c == 0; ++i) {
+            if (row[i] != target[i]) {
+                c = row[i] < target[i] ? -1 : 1;
+            }
+        }
+        if (c < 0 || (upper && c == 0)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+DiffIndexMem::DiffIndexMem(DiffIndex::TypeUpdate type) :
+    DiffIndex(type, DiffIndex::MEM) {
+    std::shared_ptr<Tables> t(new Tables());
+    for (int i = 0; i < 6; ++i) {
+        t->rows[i] = std::shared_ptr<const std::vector<uint64_t>>(
+                new std::vector<uint64_t>());
+    }
+    rebuildStats(*t);
+    tables = t;
+}
+
+void DiffIndexMem::rebuildStats(Tables &t) {
+    for (int perm = 0; perm < 6; ++perm) {
+        const std::vector<uint64_t> &rows = *t.rows[perm];
+        int64_t n = 0;
+        for (size_t i = 0; i < rows.size(); i += 3) {
+            if (i == 0 || rows[i] != rows[i - 3] || rows[i + 1] != rows[i - 2]) {
+                n++;
+            }
+        }
+        t.nfirstterms[perm] = n;
+    }
+
+    //The keys of s, p and o are taken from SPO, POS and OPS
+    const int perms[3] = { IDX_SPO, IDX_POS, IDX_OPS };
+    for (int pos = 0; pos < 3; ++pos) {
+        const std::vector<uint64_t> &rows = *t.rows[perms[pos]];
+        std::vector<char> &keys = t.keys[pos];
+        keys.clear();
+        int64_t n = 0;
+        for (size_t i = 0; i < rows.size(); i += 3) {
+            if (i == 0 || rows[i] != rows[i - 3]) {
+                keys.resize(keys.size() + 8);
+                Utils::encode_long(&keys[keys.size() - 8], rows[i]);
+                n++;
+            }
+        }
+        t.nkeys[pos] = n;
+    }
+}
+
+void DiffIndexMem::add(const std::vector<uint64_t> &spo) {
+    if (spo.empty()) {
+        return;
+    }
+    std::shared_ptr<Tables> newtables(new Tables());
+    std::vector<_MemRow> batch;
+    for (int perm = 0; perm < 6; ++perm) {
+        _mem_permute(spo, perm, batch);
+        const std::vector<uint64_t> &old = *tables->rows[perm];
+        std::vector<uint64_t> *out = new std::vector<uint64_t>();
+        out->reserve(old.size() + batch.size() * 3);
+        size_t i = 0, j = 0;
+        while (i < old.size() || j < batch.size()) {
+            int c;
+            if (i == old.size()) {
+                c = 1;
+            } else if (j == batch.size()) {
+                c = -1;
+            } else {
+                c = _mem_cmp(&old[i], batch[j]);
+            }
+            if (c <= 0) {
+                out->insert(out->end(), old.begin() + i, old.begin() + i + 3);
+                i += 3;
+                if (c == 0) {
+                    j++; //Already in the delta
+                }
+            } else {
+                if (j == 0 || batch[j - 1] < batch[j]) {
+                    out->insert(out->end(), batch[j].v, batch[j].v + 3);
+                }
+                j++;
+            }
+        }
+        newtables->rows[perm] = std::shared_ptr<const std::vector<uint64_t>>(out);
+    }
+    rebuildStats(*newtables);
+    tables = newtables;
+}
+
+void DiffIndexMem::remove(const std::vector<uint64_t> &spo) {
+    if (spo.empty() || getSize() == 0) {
+        return;
+    }
+    std::shared_ptr<Tables> newtables(new Tables());
+    std::vector<_MemRow> batch;
+    for (int perm = 0; perm < 6; ++perm) {
+        _mem_permute(spo, perm, batch);
+        const std::vector<uint64_t> &old = *tables->rows[perm];
+        std::vector<uint64_t> *out = new std::vector<uint64_t>();
+        out->reserve(old.size());
+        size_t j = 0;
+        for (size_t i = 0; i < old.size(); i += 3) {
+            int c = -1;
+            while (j < batch.size() && (c = _mem_cmp(&old[i], batch[j])) > 0) {
+                j++;
+            }
+            if (j == batch.size() || c != 0) {
+                out->insert(out->end(), old.begin() + i, old.begin() + i + 3);
+            }
+        }
+        newtables->rows[perm] = std::shared_ptr<const std::vector<uint64_t>>(out);
+    }
+    rebuildStats(*newtables);
+    tables = newtables;
+}
+
+bool DiffIndexMem::contains(const uint64_t s, const uint64_t p,
+        const uint64_t o) const {
+    const std::vector<uint64_t> &rows = *tables->rows[IDX_SPO];
+    const uint64_t target[3] = { s, p, o };
+    const size_t n = rows.size() / 3;
+    const size_t pos = _mem_bound(rows, 0, n, target, 3, false);
+    return pos < n && rows[pos * 3] == s && rows[pos * 3 + 1] == p &&
+        rows[pos * 3 + 2] == o;
+}
+
+void DiffIndexMem::getTriples(std::vector<uint64_t> &all_s,
+        std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) const {
+    const std::vector<uint64_t> &rows = *tables->rows[IDX_SPO];
+    for (size_t i = 0; i < rows.size(); i += 3) {
+        all_s.push_back(rows[i]);
+        all_p.push_back(rows[i + 1]);
+        all_o.push_back(rows[i + 2]);
+    }
+}
+
+PairItr *DiffIndexMem::getIterator(int idx, int64_t first, int64_t second,
+        int64_t third, int64_t &nfirstterms,
+        const DiffItrFactories &factories) {
+    Factory<MemDiffItr> *factory = factories.mem;
+    if (factory == NULL) {
+        LOG(ERRORL) << "The factory of the iterators is not set";
+        throw 10;
+    }
+    const std::shared_ptr<const std::vector<uint64_t>> &table = tables->rows[idx];
+    const std::vector<uint64_t> &rows = *table;
+    const size_t n = rows.size() / 3;
+    size_t start = 0;
+    size_t end = n;
+    if (first >= 0) {
+        const uint64_t target[3] = { (uint64_t) first, (uint64_t) second,
+            (uint64_t) third };
+        start = _mem_bound(rows, 0, n, target, 1, false);
+        end = _mem_bound(rows, start, n, target, 1, true);
+        if (start < end) {
+            //Same semantics of the tables of DiffIndex3
+            if (second < 0) {
+                for (size_t i = start; i < end; ++i) {
+                    if (i == start || rows[i * 3 + 1] != rows[i * 3 - 2]) {
+                        nfirstterms++;
+                    }
+                }
+            } else {
+                nfirstterms = 1;
+                const int ncols = third < 0 ? 2 : 3;
+                start = _mem_bound(rows, start, end, target, ncols, false);
+                end = _mem_bound(rows, start, end, target, ncols, true);
+            }
+        }
+    }
+    MemDiffItr *itr = factory->get();
+    itr->init(table, start, end);
+    if (first >= 0) {
+        itr->setKey(first);
+    }
+    return itr;
+}
+
+int64_t DiffIndexMem::getSize() const {
+    return tables->rows[IDX_SPO]->size() / 3;
+}
+
+int64_t DiffIndexMem::getCard(int idx, int64_t first) const {
+    const std::vector<uint64_t> &rows = *tables->rows[idx];
+    const uint64_t target[1] = { (uint64_t) first };
+    const size_t n = rows.size() / 3;
+    const size_t start = _mem_bound(rows, 0, n, target, 1, false);
+    return _mem_bound(rows, start, n, target, 1, true) - start;
+}
+
+int64_t DiffIndexMem::getNUniqueKeys(int idx) {
+    return tables->nkeys[_mem_positions[idx][0]];
+}
+
+void DiffIndexMem::getTermListItr(int idx, DiffTermItr *itr) {
+    const int pos = _mem_positions[idx][0];
+    itr->init(idx, tables->nkeys[pos], tables->nkeys[pos],
+            tables->keys[pos].data(), 8);
+}
+
+int64_t DiffIndexMem::getUniqueNFirstTerms(int idx) {
+    return tables->nfirstterms[idx];
+}
+
+int64_t DiffIndexMem::getNFirstTables(int idx) {
+    return tables->nfirstterms[idx];
+}
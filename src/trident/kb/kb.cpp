@@ -26,24 +26,47 @@
 #include <trident/kb/inserter.h>
 #include <trident/kb/consts.h>
 #include <trident/kb/kbconfig.h>
+#include <trident/kb/staticdict.h>
+#include <trident/kb/updater.h>
+#include <trident/loader.h>
 #include <trident/tree/root.h>
 #include <trident/tree/flatroot.h>
 #include <trident/tree/stringbuffer.h>
 #include <trident/binarytables/tableshandler.h>
 
+#include <kognac/lz4io.h>
+
+#include <zstr/zstr.hpp>
+
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <stdlib.h>
+#include <cstring>
+#include <cctype>
 #include <cmath>
 #include <chrono>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <set>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#endif
 
 using namespace std;
 
 LIBEXP bool _sort_by_number(const string &s1, const string &s2);
 
 bool _sort_by_number(const string &s1, const string &s2) {
-    return atoi(Utils::filename(s1).c_str()) < atoi(Utils::filename(s2).c_str());
+    int64_t seq1, gen1, seq2, gen2;
+    Updater::parseDiffName(Utils::filename(s1), seq1, gen1);
+    Updater::parseDiffName(Utils::filename(s2), seq2, gen2);
+    return seq1 < seq2 || (seq1 == seq2 && gen1 < gen2);
 }
 
 KB::KB(const char *path,
@@ -53,12 +76,20 @@ KB::KB(const char *path,
         KBConfig &config,
         std::vector<string> locationUpdates) :
     path(path), readOnly(readOnly), ntables(), nFirstTables(), isClosed(false),
-    dictEnabled(dictEnabled), config(config) {
+    dictEnabled(dictEnabled), config(config), memAdd(NULL), memDel(NULL),
+    diffSnapshot(new DiffSnapshot()), compactionDone(false),
+    compactionFailed(false), replayingLog(false), mergingBase(false),
+    dirLock(-1) {
 
         if (readOnly && !Utils::exists(string(path) + DIR_SEP + "tree")) {
             LOG(ERRORL) << "The input path does not seem to be a valid KB";
             throw 10;
         }
+        dirLock = lockDirectory(path, false);
+        if (dirLock == -2) {
+            LOG(ERRORL) << "The KB in " << path << " is being replaced by a full merge";
+            throw 10;
+        }
 
         std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 
@@ -245,7 +276,8 @@ KB::KB(const char *path,
                     files[permutations[i]] = new TableStorage(readOnly, is.str(),
                             config.getParamLong(STORAGE_MAX_FILE_SIZE),
                             config.getParamInt(STORAGE_MAX_N_FILES),
-                            NULL, stats, permutations[i]);
+                            NULL, stats, permutations[i],
+                            config.getParamBool(STORAGE_MMAP));
                 }
             } else {
                 files[permutations[i]] = new TableStorage(readOnly, is.str(),
@@ -266,63 +298,93 @@ KB::KB(const char *path,
             sampleRate = 0;
         }
 
+        //Statistics for the optimizer (computed by the loader)
+        charsets = CharacteristicSets::load(path + DIR_SEP + string("charsets"));
+
         string defaultDiffDir = path + DIR_SEP + string("_diff");
+        globalBuffers.resize(N_PARTITIONS, NULL);
         if (Utils::exists(defaultDiffDir)) {
             std::vector<string> files = Utils::getSubdirs(defaultDiffDir);
             std::vector<string> childrenupdates;
+            //A compaction might have stopped after its new diffs were
+            //installed, but before the diffs they replace were retired
+            std::set<string> compacted;
+            for (auto &f : files) {
+                if (Utils::exists(f + DIR_SEP + "COMPACTED")) {
+                    std::ifstream ifs(f + DIR_SEP + "COMPACTED");
+                    string line;
+                    while (std::getline(ifs, line)) {
+                        compacted.insert(line);
+                    }
+                    ifs.close();
+                }
+            }
             for (int i = 0; i < files.size(); ++i) {
                 string f = files[i];
-                string fn = Utils::filename(f);
-                if (!fn.empty() && std::find_if(fn.begin(),  fn.end(),
-                            [](char c) {
-                            return !isdigit(c);
-                            }) == fn.end()) {
-                    childrenupdates.push_back(f);
+                int64_t seq, gen;
+                if (Utils::ends_with(f, ".tmp")) {
+                    //A diff whose writing was interrupted
+                    LOG(WARNL) << "Removing the incomplete diff " << f;
+                    Utils::remove_all(f);
+                } else if (Updater::parseDiffName(Utils::filename(f), seq, gen)) {
+                    if (Utils::exists(f + DIR_SEP + "RETIRED") ||
+                            compacted.count(Utils::filename(f))) {
+                        //Replaced by a compaction while it was in use
+                        Utils::remove_all(f);
+                    } else if (!Utils::exists(f + DIR_SEP + "ADD") &&
+                            !Utils::exists(f + DIR_SEP + "DEL")) {
+                        //Without the flag the type of the diff is unknown
+                        LOG(WARNL) << "Removing the diff " << f <<
+                            ", which has no ADD or DEL flag";
+                        Utils::remove_all(f);
+                    } else {
+                        childrenupdates.push_back(f);
+                    }
+                }
+            }
+            for (auto &f : childrenupdates) {
+                if (Utils::exists(f + DIR_SEP + "COMPACTED")) {
+                    Utils::remove(f + DIR_SEP + "COMPACTED");
                 }
             }
 
             if (!childrenupdates.empty()) {
-                std::vector<const char *> globalbuffers;
-                globalbuffers.resize(N_PARTITIONS);
-                //Instantiate the buffers
-                for (int i = 0; i < N_PARTITIONS; ++i)
-                    globalbuffers[i] = NULL;
                 if (Utils::exists(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p0")) {
                     spo_f = std::unique_ptr<ROMappedFile>(
                             new ROMappedFile(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p0"));
-                    globalbuffers[IDX_SPO] = spo_f->getBuffer();
+                    globalBuffers[IDX_SPO] = spo_f->getBuffer();
                 }
                 if (Utils::exists(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p1")) {
                     sop_f = std::unique_ptr<ROMappedFile>(
                             new ROMappedFile(defaultDiffDir + DIR_SEP + "s" + DIR_SEP + "p1"));
-                    globalbuffers[IDX_SOP] = sop_f->getBuffer();
+                    globalBuffers[IDX_SOP] = sop_f->getBuffer();
                 }
                 if (Utils::exists(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p0")) {
                     pos_f = std::unique_ptr<ROMappedFile>(
                             new ROMappedFile(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p0"));
-                    globalbuffers[IDX_POS] = pos_f->getBuffer();
+                    globalBuffers[IDX_POS] = pos_f->getBuffer();
                 }
                 if (Utils::exists(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p1")) {
                     pso_f = std::unique_ptr<ROMappedFile>(
                             new ROMappedFile(defaultDiffDir + DIR_SEP + "p" + DIR_SEP + "p1"));
-                    globalbuffers[IDX_PSO] = pso_f->getBuffer();
+                    globalBuffers[IDX_PSO] = pso_f->getBuffer();
                 }
                 if (Utils::exists(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p0")) {
                     ops_f = std::unique_ptr<ROMappedFile>(
                             new ROMappedFile(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p0"));
-                    globalbuffers[IDX_OPS] = ops_f->getBuffer();
+                    globalBuffers[IDX_OPS] = ops_f->getBuffer();
                 }
                 if (Utils::exists(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p1")) {
                     osp_f = std::unique_ptr<ROMappedFile>(
                             new ROMappedFile(defaultDiffDir + DIR_SEP + "o" + DIR_SEP + "p1"));
-                    globalbuffers[IDX_OSP] = osp_f->getBuffer();
+                    globalBuffers[IDX_OSP] = osp_f->getBuffer();
                 }
 
                 //Sort them by numeric value
                 sort(childrenupdates.begin(), childrenupdates.end(), _sort_by_number);
                 for (int i = 0; i < childrenupdates.size(); ++i) {
                     std::chrono::system_clock::time_point startDiff = std::chrono::system_clock::now();
-                    addDiffIndex(childrenupdates[i], &globalbuffers[0], NULL);
+                    addDiffIndex(childrenupdates[i], &globalBuffers[0]);
                     sec = std::chrono::system_clock::now() - startDiff;
                     LOG(DEBUGL) << "Time loading diff index " << sec.count() * 1000 << "ms.";
                 }
@@ -340,6 +402,10 @@ KB::KB(const char *path,
             nextID = max(nextID, (int64_t) dictManager->getLargestGUDTerm() + 1);
         }
 
+        //Restore the in-memory delta of the online updates
+        replayUpdateLog();
+        publishDiffs();
+
         sec = std::chrono::system_clock::now() - start;
         LOG(DEBUGL) << "Time init KB = " << sec.count() * 1000 << " ms and " << Utils::get_max_mem() << " MB occupied";
     }
@@ -401,7 +467,8 @@ void KB::loadDict(KBConfig *config) {
     maindict->sb = std::shared_ptr<StringBuffer>(new StringBuffer(ss1.str(), readOnly,
                 config->getParamInt(SB_PREALLBUFFERS),
                 config->getParamLong(SB_CACHESIZE),
-                maindict->stats.get()));
+                maindict->stats.get(),
+                config->getParamInt(SB_CACHESHARDS)));
     maindict->dict = std::shared_ptr<Root>(new Root(ss1.str(), maindict->sb.get(), readOnly, map));
 
     //Initialize the inverse dictionaries
@@ -426,12 +493,71 @@ void KB::loadDict(KBConfig *config) {
     stringstream ss2;
     ss2 << path << DIR_SEP << "invdict" << DIR_SEP << 0;
     maindict->invdict = std::shared_ptr<Root>(new Root(ss2.str(), NULL, readOnly, map));
+
+    //Use the static dictionary for the lookups, if it was built
+    if (readOnly) {
+        maindict->sdict = StaticDict::load(path + DIR_SEP + "staticdict");
+    }
+}
+
+static string _getDiffDir(DiffIndex *diff) {
+    if (diff->getClass() == DiffIndex::DIFF3) {
+        return ((DiffIndex3*) diff)->getDir();
+    } else if (diff->getClass() == DiffIndex::DIFF1) {
+        return ((DiffIndex1*) diff)->getDir();
+    }
+    return "";
 }
 
 Querier *KB::query() {
+    return query(getDiffSnapshot());
+}
+
+Querier *KB::query(std::shared_ptr<const DiffSnapshot> diffs) {
     return new Querier(tree, dictManager, files, totalNumberTriples,
             totalNumberTerms, nindices, ntables, nFirstTables,
-            sampleKB, diffIndices, present);
+            sampleKB, diffs, present);
+}
+
+std::shared_ptr<const DiffSnapshot> KB::getWorkingDiffs() {
+    std::shared_ptr<DiffSnapshot> s(new DiffSnapshot());
+    s->version = diffSnapshot->version;
+    s->diffs = diffIndices;
+    return s;
+}
+
+void KB::publishDiffs() {
+    //Only the updates publish, so diffSnapshot can be read without a lock
+    std::shared_ptr<DiffSnapshot> s(new DiffSnapshot());
+    s->version = diffSnapshot->version + 1;
+    s->diffs = diffIndices;
+    std::atomic_store(&diffSnapshot, std::shared_ptr<const DiffSnapshot>(s));
+    reclaimDiffs();
+}
+
+void KB::retireDiff(std::shared_ptr<DiffIndex> &diff) {
+    const string dir = _getDiffDir(diff.get());
+    if (!dir.empty()) {
+        //If the process stops before the directory is deleted, the diff is
+        //not loaded again
+        ofstream ofs(dir + DIR_SEP + "RETIRED");
+        ofs.close();
+        retiredDiffs.push_back(std::make_pair(std::weak_ptr<DiffIndex>(diff),
+                    dir));
+    }
+    diff.reset();
+}
+
+void KB::reclaimDiffs() {
+    auto itr = retiredDiffs.begin();
+    while (itr != retiredDiffs.end()) {
+        if (itr->first.expired()) {
+            Utils::remove_all(itr->second);
+            itr = retiredDiffs.erase(itr);
+        } else {
+            itr++;
+        }
+    }
 }
 
 Inserter *KB::insert() {
@@ -476,6 +602,21 @@ void KB::close() {
     if (isClosed)
         return;
 
+    //Complete the compaction and store the updates that are in memory. If
+    //they are logged, they can stay in the log until the delta is full
+    installCompaction(true);
+    if (updateLog && updateLog->hasFailed()) {
+        //The log cannot be trusted: the delta must be stored in a diff
+        writeMemUpdates();
+        updateLog.reset();
+    } else if (updateLog) {
+        updateLog->sync();
+        updateLog.reset();
+    } else if (!config.getParamBool(UPDATES_WAL) ||
+            !Utils::exists(getUpdateLogPath())) {
+        writeMemUpdates();
+    }
+
     //Update stats about the KB
     if (!readOnly) {
         if (dictEnabled) {
@@ -517,6 +658,8 @@ void KB::close() {
     }
 
     diffIndices.clear();
+    memAdd = memDel = NULL;
+    publishDiffs();
     isClosed = true;
 }
 
@@ -584,9 +727,42 @@ KB::~KB() {
         fos.write(data, 1);
         fos.close();
     }
+    unlockDirectory(dirLock);
+}
+
+int KB::lockDirectory(string kbdir, const bool exclusive) {
+#if defined(_WIN32)
+    return -1;
+#else
+    const int fd = ::open((kbdir + DIR_SEP + "LOCK").c_str(),
+            O_RDONLY | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        return -1;
+    }
+    if (::flock(fd, (exclusive ? LOCK_EX : LOCK_SH) | LOCK_NB) != 0) {
+        ::close(fd);
+        return -2;
+    }
+    return fd;
+#endif
 }
 
-void KB::addDiffIndex(string inputdir, const char **globalbuffers, Querier *q) {
+void KB::unlockDirectory(const int fd) {
+#if !defined(_WIN32)
+    if (fd >= 0) {
+        //Closing the file releases the lock
+        ::close(fd);
+    }
+#endif
+}
+
+bool KB::isInUse(std::string kbdir) {
+    const int fd = lockDirectory(kbdir, true);
+    unlockDirectory(fd);
+    return fd == -2;
+}
+
+DiffIndex *KB::openDiffIndex(string inputdir, const char **globalbuffers) {
     DiffIndex::TypeUpdate type;
     if (Utils::exists(inputdir + DIR_SEP + "ADD")) {
         type = DiffIndex::TypeUpdate::ADDITION_df;
@@ -595,13 +771,17 @@ void KB::addDiffIndex(string inputdir, const char **globalbuffers, Querier *q) {
     }
 
     if (Utils::exists(inputdir + DIR_SEP + "type1")) {
-        diffIndices.push_back(std::unique_ptr<DiffIndex>(
-                    new DiffIndex1(inputdir, type)));
+        return new DiffIndex1(inputdir, type);
     } else {
-        diffIndices.push_back(std::unique_ptr<DiffIndex>(
-                    new DiffIndex3(inputdir, globalbuffers,
-                        config, type)));
+        return new DiffIndex3(inputdir, globalbuffers, config, type);
     }
+}
+
+void KB::addDiffIndex(string inputdir, const char **globalbuffers) {
+    //The in-memory delta must stay above all the diffs on disk
+    const size_t pos = diffIndices.size() - (memAdd != NULL ? 2 : 0);
+    diffIndices.insert(diffIndices.begin() + pos, std::shared_ptr<DiffIndex>(
+                openDiffIndex(inputdir, globalbuffers)));
 
     if (Utils::exists(inputdir + DIR_SEP + "dict")) {
         //Load the dictionary
@@ -625,10 +805,6 @@ void KB::addDiffIndex(string inputdir, const char **globalbuffers, Querier *q) {
 
         dictUpdates.push_back(ud);
     }
-
-    if (q) {
-        q->initDiffIndex(diffIndices.back().get());
-    }
 }
 
 std::vector<const char*> KB::openAllFiles(int perm) {
@@ -747,6 +923,10 @@ void KB::mergeUpdates() {
 
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
 
+    //All the updates must be on disk
+    installCompaction(true);
+    writeMemUpdates();
+
     std::string diffDir = path + DIR_SEP + std::string("_newdiff");
     std::string oldDiffDir = path + DIR_SEP + std::string("_diff");
 
@@ -769,11 +949,7 @@ void KB::mergeUpdates() {
     Querier *q = query();
     // Create the single updates with respect to a querier that does not have the diffIndices.
     // Create querier with empty diffs
-    std::vector<std::unique_ptr<DiffIndex>> diffs;
-
-    Querier *q1 = new Querier(tree, dictManager, files, totalNumberTriples,
-        totalNumberTerms, nindices, ntables, nFirstTables,
-        sampleKB, diffs, present);
+    Querier *q1 = query(std::shared_ptr<const DiffSnapshot>(new DiffSnapshot()));
 
     if (addCount >= 1) {
         PairItr *addItr = q->summaryAddDiff();
@@ -816,6 +992,830 @@ void KB::mergeUpdates() {
     LOG(INFOL) << "Total merge time = " << sec.count() * 1000 << " ms.";
 }
 
+//Sleep until the number of elements read since start is within the rate
+static void _throttle(std::chrono::system_clock::time_point start,
+        const int64_t nread, const int64_t rate) {
+    if (rate > 0 && nread % UPDATES_MERGE_RATE_BATCH == 0) {
+        std::this_thread::sleep_until(start +
+                std::chrono::microseconds(nread * 1000000 / rate));
+    }
+}
+
+void KB::mergeIntoBase(std::string outputdir) {
+    if (!dictEnabled || dictHash || relsIDsSep ||
+            graphType != GraphType::DEFAULT) {
+        LOG(ERRORL) << "The full merge requires a KB with a (non-hash) dictionary, "
+            "without separate IDs for the relations and with the default graph type";
+        throw 10;
+    }
+    if (Utils::exists(outputdir)) {
+        LOG(ERRORL) << "The directory " << outputdir << " should not exist";
+        throw 10;
+    }
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+
+    //Only the diffs on disk are merged. The in-memory delta stays in the log,
+    //which is moved to the new KB
+    std::vector<string> mergedDiffs;
+    std::shared_ptr<DiffSnapshot> diffs(new DiffSnapshot());
+    int64_t maxID;
+    {
+        std::lock_guard<std::mutex> lock(updateMutex);
+        installCompaction(true);
+        mergingBase = true;
+        const size_t ndiffs = diffIndices.size() - (memAdd != NULL ? 2 : 0);
+        for (size_t i = 0; i < ndiffs; ++i) {
+            mergedDiffs.push_back(_getDiffDir(diffIndices[i].get()));
+            diffs->diffs.push_back(diffIndices[i]);
+        }
+        maxID = nextID;
+    }
+
+    const string inputdir = outputdir + "_input";
+    try {
+        if (Utils::exists(inputdir)) {
+            Utils::remove_all(inputdir);
+        }
+        Utils::create_directories(inputdir);
+        const int64_t rate = config.getParamLong(UPDATES_MERGE_RATE);
+
+        //Export the triples with a querier that sees only the merged diffs
+        std::unique_ptr<Querier> q(query(diffs));
+        int64_t ntriples = 0;
+        {
+            zstr::ofstream out(inputdir + DIR_SEP + "triples.gz",
+                    std::ios_base::binary);
+            std::chrono::system_clock::time_point startScan =
+                std::chrono::system_clock::now();
+            PairItr *itr = q->getIterator(IDX_SPO, -1, -1, -1);
+            while (itr->hasNext()) {
+                itr->next();
+                out << itr->getKey() << " " << itr->getValue1() << " " <<
+                    itr->getValue2() << "\n";
+                _throttle(startScan, ++ntriples, rate);
+            }
+            q->releaseItr(itr);
+        }
+
+        //Export all the terms: the IDs are dense in a non-hash dictionary,
+        //and the lookups cover the dictionaries of the diffs and the global
+        //dictionary of the updates. The loader numbers the terms in the
+        //order of the file, so a missing ID would shift all the following
+        //ones
+        int64_t nterms = 0;
+        {
+            zstr::ofstream out(inputdir + DIR_SEP + "dict.gz",
+                    std::ios_base::binary);
+            std::unique_ptr<char[]> text(new char[MAX_TERM_SIZE + 1]);
+            std::vector<string> terms;
+            std::chrono::system_clock::time_point startDict =
+                std::chrono::system_clock::now();
+            for (int64_t begin = 0; begin < maxID;
+                    begin += UPDATES_MERGE_RATE_BATCH) {
+                const int64_t end = min(maxID,
+                        (int64_t) (begin + UPDATES_MERGE_RATE_BATCH));
+                terms.clear();
+                {
+                    //The updates add terms to the global update dictionary
+                    std::lock_guard<std::mutex> lock(updateMutex);
+                    for (int64_t id = begin; id < end; ++id) {
+                        if (!dictManager->getText(id, text.get())) {
+                            LOG(ERRORL) << "The term with ID " << id <<
+                                " is not in the dictionary";
+                            throw 10;
+                        }
+                        terms.push_back(string(text.get()));
+                    }
+                }
+                for (int64_t id = begin; id < end; ++id) {
+                    const string &term = terms[id - begin];
+                    out << id << " " << term.size() << " ";
+                    out.write(term.c_str(), term.size());
+                    out << "\n";
+                    nterms++;
+                }
+                _throttle(startDict, end, rate);
+            }
+        }
+        q.reset();
+        diffs.clear();
+        LOG(INFOL) << "Exported " << ntriples << " triples and " << nterms <<
+            " terms for the full merge";
+
+        //Build the new KB with the loader
+        ParamsLoad p;
+        p.inputCompressed = true;
+        p.triplesInputDir = inputdir + DIR_SEP + "triples.gz";
+        p.dictDir = inputdir + DIR_SEP + "dict.gz";
+        p.tmpDir = outputdir + "_tmp";
+        p.kbDir = outputdir;
+        p.parallelThreads = max(1, config.getParamInt(UPDATES_MERGE_THREADS));
+        p.maxReadingThreads = 1;
+        p.dictionaries = 1;
+        p.nindices = nindices;
+        p.aggrIndices = aggrIndices;
+        p.sample = sampleKB != NULL;
+        p.flatTree = Utils::exists(path + DIR_SEP + "tree" + DIR_SEP + "flat");
+        p.charsets = charsets.get() != NULL;
+        p.staticDict = Utils::exists(path + DIR_SEP + "staticdict");
+        Loader loader;
+        loader.load(p);
+        Utils::remove_all(inputdir);
+
+        //Record which diffs are in the new KB, so that the others are moved
+        //there when it is installed
+        std::ofstream ofs(outputdir + DIR_SEP + "mergeddiffs");
+        for (auto &dir : mergedDiffs) {
+            ofs << Utils::filename(dir) << endl;
+        }
+        ofs.close();
+    } catch (...) {
+        LOG(ERRORL) << "The full merge failed";
+        mergingBase = false;
+        if (Utils::exists(inputdir)) {
+            Utils::remove_all(inputdir);
+        }
+        throw 10;
+    }
+    mergingBase = false;
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "Full merge of " << mergedDiffs.size() << " diffs in " <<
+        outputdir << " = " << sec.count() * 1000 << " ms.";
+}
+
+static string _getVersionDir(string kbdir, const int64_t version) {
+    return kbdir + ".v" + to_string(version);
+}
+
+void KB::installMergedKB(std::string kbdir, std::string mergeddir) {
+#if defined(_WIN32)
+    LOG(ERRORL) << "The merged KB cannot be installed atomically on Windows";
+    throw 10;
+#else
+    //The current version is the one kbdir links to. Before the first merge
+    //kbdir is the KB itself, which becomes version 0
+    struct stat st;
+    const bool exists = ::lstat(kbdir.c_str(), &st) == 0;
+    const bool linked = exists && S_ISLNK(st.st_mode);
+    int64_t version = 0;
+    if (linked) {
+        char target[4096];
+        const ssize_t n = ::readlink(kbdir.c_str(), target, sizeof(target) - 1);
+        const string t(target, n > 0 ? n : 0);
+        const size_t pos = t.rfind(".v");
+        if (pos == string::npos) {
+            LOG(ERRORL) << kbdir << " does not link to a version of the KB";
+            throw 10;
+        }
+        version = std::stoll(t.substr(pos + 2));
+    }
+    const string olddir = _getVersionDir(kbdir, version);
+    const string newdir = _getVersionDir(kbdir, version + 1);
+
+    const int lock = exists ? lockDirectory(kbdir, true) : -1;
+    if (lock == -2) {
+        LOG(ERRORL) << "The KB in " << kbdir << " is open in another process "
+            "(e.g., a server), which would keep using the old version. Stop it "
+            "and install the merged KB in " << mergeddir << " again";
+        throw 10;
+    }
+    try {
+        if (Utils::exists(mergeddir)) {
+            if (!exists || !Utils::exists(mergeddir + DIR_SEP + "mergeddiffs")) {
+                LOG(ERRORL) << mergeddir << " is not a complete merged KB";
+                throw 10;
+            }
+            std::set<string> merged;
+            std::ifstream ifs(mergeddir + DIR_SEP + "mergeddiffs");
+            string line;
+            while (std::getline(ifs, line)) {
+                merged.insert(line);
+            }
+            ifs.close();
+
+            const string diffdir = kbdir + DIR_SEP + "_diff";
+            const string newdiffdir = mergeddir + DIR_SEP + "_diff";
+            if (Utils::exists(diffdir)) {
+                for (auto &child : Utils::getSubdirs(diffdir)) {
+                    const string fn = Utils::filename(child);
+                    int64_t seq, gen;
+                    if (Updater::parseDiffName(fn, seq, gen) && !merged.count(fn) &&
+                            !Utils::exists(child + DIR_SEP + "RETIRED")) {
+                        if (!Utils::exists(newdiffdir)) {
+                            Utils::create_directories(newdiffdir);
+                        }
+                        Utils::rename(child, newdiffdir + DIR_SEP + fn);
+                    }
+                }
+                //The terms added after the merge started are only there
+                const string gud = diffdir + DIR_SEP + "gud";
+                if (Utils::exists(gud)) {
+                    if (!Utils::exists(newdiffdir)) {
+                        Utils::create_directories(newdiffdir);
+                    }
+                    std::ifstream src(gud, std::ios_base::binary);
+                    std::ofstream dst(newdiffdir + DIR_SEP + "gud",
+                            std::ios_base::binary | std::ios_base::trunc);
+                    dst << src.rdbuf();
+                }
+            }
+            const string wal = kbdir + DIR_SEP + "_wal";
+            if (Utils::exists(wal)) {
+                Utils::rename(wal, mergeddir + DIR_SEP + "_wal");
+            }
+            UpdateLog::syncPath(mergeddir);
+            Utils::rename(mergeddir, newdir);
+            UpdateLog::syncDirectory(Utils::parentDir(kbdir));
+        } else if (!Utils::exists(newdir)) {
+            LOG(ERRORL) << "There is no merged KB in " << mergeddir;
+            throw 10;
+        }
+
+        if (exists && !linked) {
+            //The first merge: the KB becomes version 0. If the process stops
+            //before the link is created, the next call creates it
+            Utils::rename(kbdir, olddir);
+        }
+        //The link is created aside and renamed over the old one, which
+        //replaces it atomically
+        const string tmplink = kbdir + ".link";
+        ::unlink(tmplink.c_str());
+        if (::symlink(Utils::filename(newdir).c_str(), tmplink.c_str()) != 0 ||
+                ::rename(tmplink.c_str(), kbdir.c_str()) != 0) {
+            LOG(ERRORL) << "Failed linking " << kbdir << " to " << newdir;
+            throw 10;
+        }
+        UpdateLog::syncDirectory(Utils::parentDir(kbdir));
+    } catch (...) {
+        unlockDirectory(lock);
+        throw;
+    }
+    unlockDirectory(lock);
+
+    if (Utils::exists(newdir + DIR_SEP + "mergeddiffs")) {
+        Utils::remove(newdir + DIR_SEP + "mergeddiffs");
+    }
+    if (Utils::exists(olddir)) {
+        Utils::remove_all(olddir);
+    }
+    LOG(INFOL) << "Installed the merged KB in " << kbdir << " (" <<
+        Utils::filename(newdir) << ")";
+#endif
+}
+
+struct _UpdateTriple {
+    uint64_t s, p, o;
+
+    bool operator <(const _UpdateTriple &t) const {
+        return s < t.s || (s == t.s && (p < t.p || (p == t.p && o < t.o)));
+    }
+
+    bool operator ==(const _UpdateTriple &t) const {
+        return s == t.s && p == t.p && o == t.o;
+    }
+};
+
+void KB::addTriples(std::vector<uint64_t> &all_s,
+        std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) {
+    updateTriples(DiffIndex::TypeUpdate::ADDITION_df, all_s, all_p, all_o);
+}
+
+void KB::removeTriples(std::vector<uint64_t> &all_s,
+        std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) {
+    updateTriples(DiffIndex::TypeUpdate::DELETE_df, all_s, all_p, all_o);
+}
+
+void KB::updateTriples(DiffIndex::TypeUpdate type,
+        std::vector<uint64_t> &all_s,
+        std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) {
+    UpdateLog *log = NULL;
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(updateMutex);
+        log = getUpdateLog();
+        if (log) {
+            std::vector<uint64_t> triples(all_s.size() * 3);
+            for (size_t i = 0; i < all_s.size(); ++i) {
+                triples[i * 3] = all_s[i];
+                triples[i * 3 + 1] = all_p[i];
+                triples[i * 3 + 2] = all_o[i];
+            }
+            lsn = log->append(type == DiffIndex::TypeUpdate::ADDITION_df ?
+                    UpdateLog::ADD : UpdateLog::DEL, triples);
+        }
+        applyUpdate(type, all_s, all_p, all_o);
+    }
+    //If the delta was flushed in the meantime, the log is already truncated
+    if (log) {
+        log->commit(lsn);
+    }
+}
+
+void KB::applyUpdate(DiffIndex::TypeUpdate type,
+        std::vector<uint64_t> &all_s,
+        std::vector<uint64_t> &all_p,
+        std::vector<uint64_t> &all_o) {
+    installCompaction(false);
+
+    std::vector<_UpdateTriple> triples(all_s.size());
+    for (size_t i = 0; i < all_s.size(); ++i) {
+        triples[i].s = all_s[i];
+        triples[i].p = all_p[i];
+        triples[i].o = all_o[i];
+    }
+    std::sort(triples.begin(), triples.end());
+    triples.erase(std::unique(triples.begin(), triples.end()), triples.end());
+
+    if (memAdd == NULL) {
+        memAdd = new DiffIndexMem(DiffIndex::TypeUpdate::ADDITION_df);
+        memDel = new DiffIndexMem(DiffIndex::TypeUpdate::DELETE_df);
+        diffIndices.push_back(std::shared_ptr<DiffIndex>(memAdd));
+        diffIndices.push_back(std::shared_ptr<DiffIndex>(memDel));
+    }
+
+    //The additions in memory are not in the KB, while the removals are.
+    //Adding a removed triple (or removing an added one) cancels the change
+    std::vector<uint64_t> newchanges;
+    std::vector<uint64_t> cancelled;
+    Querier *q = query(getWorkingDiffs());
+    for (auto &t : triples) {
+        if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+            if (memDel->contains(t.s, t.p, t.o)) {
+                cancelled.insert(cancelled.end(), { t.s, t.p, t.o });
+            } else if (!q->exists(t.s, t.p, t.o)) {
+                newchanges.insert(newchanges.end(), { t.s, t.p, t.o });
+            }
+        } else {
+            if (memAdd->contains(t.s, t.p, t.o)) {
+                cancelled.insert(cancelled.end(), { t.s, t.p, t.o });
+            } else if (q->exists(t.s, t.p, t.o)) {
+                newchanges.insert(newchanges.end(), { t.s, t.p, t.o });
+            }
+        }
+    }
+    delete q;
+
+    //The published snapshot might be in use: change a copy of the delta
+    const size_t n = diffIndices.size();
+    memAdd = new DiffIndexMem(*memAdd);
+    memDel = new DiffIndexMem(*memDel);
+    diffIndices[n - 2] = std::shared_ptr<DiffIndex>(memAdd);
+    diffIndices[n - 1] = std::shared_ptr<DiffIndex>(memDel);
+    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+        memDel->remove(cancelled);
+        memAdd->add(newchanges);
+    } else {
+        memAdd->remove(cancelled);
+        memDel->add(newchanges);
+    }
+    LOG(DEBUGL) << "Update of " << triples.size() << " triples: " <<
+        newchanges.size() / 3 << " new changes, " << cancelled.size() / 3 <<
+        " cancelled";
+    publishDiffs();
+
+    if (memAdd->getSize() + memDel->getSize() >=
+            config.getParamLong(UPDATES_MEMSIZE)) {
+        writeMemUpdates();
+        requestCompaction();
+    }
+}
+
+void KB::addNewTerms(const std::vector<std::pair<uint64_t, std::string>> &terms) {
+    UpdateLog *log = getUpdateLog();
+    if (log) {
+        log->appendTerms(terms);
+    }
+    putNewTerms(terms);
+}
+
+void KB::putNewTerms(const std::vector<std::pair<uint64_t, std::string>> &terms) {
+    //The terms might be already in the dictionary if they are replayed
+    const uint64_t before = dictManager->getGUDSize();
+    for (auto &t : terms) {
+        dictManager->putInUpdateDict(t.first, t.second.c_str(), t.second.size());
+    }
+    totalNumberTerms += dictManager->getGUDSize() - before;
+    nextID = max(nextID, (int64_t) dictManager->getLargestGUDTerm() + 1);
+}
+
+void KB::flushUpdates() {
+    std::lock_guard<std::mutex> lock(updateMutex);
+    installCompaction(false);
+    writeMemUpdates();
+    requestCompaction();
+}
+
+string KB::getUpdateLogPath() {
+    return path + DIR_SEP + string("_wal");
+}
+
+UpdateLog *KB::getUpdateLog() {
+    if (!updateLog && !replayingLog && config.getParamBool(UPDATES_WAL)) {
+        updateLog = std::unique_ptr<UpdateLog>(new UpdateLog(
+                    getUpdateLogPath(),
+                    config.getParamLong(UPDATES_WAL_GROUPDELAY)));
+    }
+    return updateLog.get();
+}
+
+void KB::replayUpdateLog() {
+    const string file = getUpdateLogPath();
+    if (!Utils::exists(file) || Utils::fileSize(file) == 0) {
+        return;
+    }
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    //The replay does not log the records again. Replaying a record that is
+    //already in a diff has no effect, so the log is not truncated until the
+    //replay is over
+    replayingLog = true;
+    int64_t ntriples = 0;
+    UpdateLog::replay(file, [&](const UpdateLog::Record &r) {
+            if (r.type == UpdateLog::TERMS) {
+                if (dictEnabled) {
+                    putNewTerms(r.terms);
+                }
+                return;
+            }
+            const size_t n = r.triples.size() / 3;
+            std::vector<uint64_t> all_s(n), all_p(n), all_o(n);
+            for (size_t i = 0; i < n; ++i) {
+                all_s[i] = r.triples[i * 3];
+                all_p[i] = r.triples[i * 3 + 1];
+                all_o[i] = r.triples[i * 3 + 2];
+            }
+            applyUpdate(r.type == UpdateLog::ADD ?
+                DiffIndex::TypeUpdate::ADDITION_df :
+                DiffIndex::TypeUpdate::DELETE_df, all_s, all_p, all_o);
+            ntriples += n;
+            });
+    replayingLog = false;
+    //Without the log, the delta must be stored before it can be removed
+    if (!config.getParamBool(UPDATES_WAL)) {
+        writeMemUpdates();
+    }
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "Replayed " << ntriples << " updated triples from the log in "
+        << sec.count() * 1000 << " ms.";
+}
+
+void KB::clearUpdateLog() {
+    if (replayingLog) {
+        return;
+    }
+    //The terms of the updates are stored in the global update dictionary,
+    //which is otherwise written only when the KB is closed
+    if (dictEnabled) {
+        dictManager->saveUpdateDict();
+    }
+    if (updateLog) {
+        updateLog->truncate();
+    } else if (Utils::exists(getUpdateLogPath())) {
+        Utils::remove(getUpdateLogPath());
+    }
+}
+
+void KB::writeMemUpdates() {
+    if (memAdd == NULL) {
+        return;
+    }
+    //Remove the delta from the list, so that the new diffs are created with
+    //respect to the diffs on disk. The queriers keep seeing the delta until
+    //the new diffs are published
+    std::shared_ptr<DiffIndex> del = diffIndices.back();
+    diffIndices.pop_back();
+    std::shared_ptr<DiffIndex> add = diffIndices.back();
+    diffIndices.pop_back();
+    memAdd = memDel = NULL;
+
+    writeMemUpdate((DiffIndexMem*) add.get());
+    writeMemUpdate((DiffIndexMem*) del.get());
+    publishDiffs();
+    clearUpdateLog();
+}
+
+void KB::writeMemUpdate(DiffIndexMem *diff) {
+    if (diff->getSize() == 0) {
+        return;
+    }
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    std::vector<uint64_t> all_s;
+    std::vector<uint64_t> all_p;
+    std::vector<uint64_t> all_o;
+    diff->getTriples(all_s, all_p, all_o);
+
+    //The tables are stored in the directory of the diff rather than in the
+    //global files, which might be already mapped in memory. The diff is
+    //written in a directory that is not loaded when the KB is opened, and
+    //renamed once it is complete
+    string dir = Updater::getPathForUpdate(path);
+    string tmpdir = dir + ".tmp";
+    if (Utils::exists(tmpdir)) {
+        Utils::remove_all(tmpdir);
+    }
+    Utils::create_directories(tmpdir);
+    Querier *q = query(getWorkingDiffs());
+    DiffIndex3::createDiffIndex(diff->getType(), tmpdir, tmpdir, all_s, all_p,
+            all_o, true, q, true);
+    delete q;
+
+    string flagup;
+    if (diff->getType() == DiffIndex::TypeUpdate::ADDITION_df) {
+        flagup = tmpdir + DIR_SEP + std::string("ADD");
+    } else {
+        flagup = tmpdir + DIR_SEP + std::string("DEL");
+    }
+    ofstream ofs(flagup);
+    ofs.close();
+    const bool wal = config.getParamBool(UPDATES_WAL);
+    if (wal) {
+        UpdateLog::syncPath(tmpdir);
+        UpdateLog::syncDirectory(Utils::parentDir(dir));
+    }
+    Utils::rename(tmpdir, dir);
+    //The diff replaces the records in the log
+    if (wal) {
+        UpdateLog::syncDirectory(Utils::parentDir(dir));
+        //_diff might be new as well
+        UpdateLog::syncDirectory(path);
+    }
+
+    addDiffIndex(dir, &globalBuffers[0]);
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(DEBUGL) << "Runtime writing " << all_s.size() << " updates in " <<
+        dir << " = " << sec.count() * 1000 << " ms.";
+}
+
+void KB::requestCompaction() {
+    if (!config.getParamBool(UPDATES_COMPACTION) ||
+            compactionThread.joinable() || mergingBase) {
+        return;
+    }
+
+    //Assign a level to every diff on disk depending on its size. Only the
+    //diffs that store the raw triples and have no dictionary can be merged
+    const int64_t memsize = max((int64_t) 1, config.getParamLong(UPDATES_MEMSIZE));
+    const size_t ndiffs = diffIndices.size() - (memAdd != NULL ? 2 : 0);
+    std::vector<int> levels(ndiffs);
+    for (size_t i = 0; i < ndiffs; ++i) {
+        levels[i] = -1;
+        string dir = _getDiffDir(diffIndices[i].get());
+        if (diffIndices[i]->getClass() == DiffIndex::DIFF3 &&
+                Utils::exists(dir + DIR_SEP + "raw") &&
+                !Utils::exists(dir + DIR_SEP + "dict")) {
+            levels[i] = 0;
+            int64_t limit = memsize;
+            while (diffIndices[i]->getSize() > limit &&
+                    limit < INT64_MAX / UPDATES_COMPACTION_FANOUT) {
+                limit *= UPDATES_COMPACTION_FANOUT;
+                levels[i]++;
+            }
+        }
+    }
+
+    //Select the most recent run of diffs at the same level that is long
+    //enough
+    size_t end = ndiffs;
+    size_t start = ndiffs;
+    while (end > 0) {
+        start = end - 1;
+        if (levels[start] != -1) {
+            while (start > 0 && levels[start - 1] == levels[end - 1]) {
+                start--;
+            }
+            if (end - start >= UPDATES_COMPACTION_FANOUT) {
+                break;
+            }
+        }
+        end = start;
+    }
+    if (end == 0) {
+        return;
+    }
+
+    std::vector<string> below;
+    for (size_t i = 0; i < start; ++i) {
+        below.push_back(_getDiffDir(diffIndices[i].get()));
+    }
+    std::vector<DiffIndex::TypeUpdate> types;
+    compactionTier.clear();
+    for (size_t i = start; i < end; ++i) {
+        compactionTier.push_back(_getDiffDir(diffIndices[i].get()));
+        types.push_back(diffIndices[i]->getType());
+    }
+    LOG(DEBUGL) << "Compacting " << compactionTier.size() << " diffs (level " <<
+        levels[start] << ") starting from " << compactionTier[0];
+    compactionDone = false;
+    compactionFailed = false;
+    compactionThread = std::thread(std::bind(&KB::compact, this,
+                compactionTier, types, below));
+#ifndef MT
+    //The compaction reads the trees and the tables of the KB, whose caches
+    //are synchronized only with MT. Without it, it cannot run next to the
+    //queries
+    installCompaction(true);
+#endif
+}
+
+struct _CompactionChange {
+    uint64_t s, p, o;
+    size_t diff;
+
+    bool operator <(const _CompactionChange &c) const {
+        return s < c.s || (s == c.s && (p < c.p || (p == c.p && (o < c.o ||
+                            (o == c.o && diff < c.diff)))));
+    }
+
+    bool sameTriple(const _CompactionChange &c) const {
+        return s == c.s && p == c.p && o == c.o;
+    }
+};
+
+void KB::compact(std::vector<string> tier,
+        std::vector<DiffIndex::TypeUpdate> types,
+        std::vector<string> below) {
+    try {
+        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        std::vector<_CompactionChange> changes;
+        for (size_t i = 0; i < tier.size(); ++i) {
+            LZ4Reader reader(tier[i] + DIR_SEP + "raw");
+            while (!reader.isEof()) {
+                _CompactionChange c;
+                c.s = reader.parseLong();
+                c.p = reader.parseLong();
+                c.o = reader.parseLong();
+                c.diff = i;
+                changes.push_back(c);
+            }
+        }
+        std::sort(changes.begin(), changes.end());
+
+        //A diff adds only triples that do not exist and removes only
+        //triples that exist. Therefore, the triples whose first and last
+        //changes are additions (removals) are added (removed) by the whole
+        //tier, while the other triples are not changed
+        std::vector<uint64_t> add_s, add_p, add_o;
+        std::vector<uint64_t> del_s, del_p, del_o;
+        size_t i = 0;
+        while (i < changes.size()) {
+            size_t j = i + 1;
+            while (j < changes.size() && changes[j].sameTriple(changes[i])) {
+                j++;
+            }
+            const DiffIndex::TypeUpdate first = types[changes[i].diff];
+            if (first == types[changes[j - 1].diff]) {
+                if (first == DiffIndex::TypeUpdate::ADDITION_df) {
+                    add_s.push_back(changes[i].s);
+                    add_p.push_back(changes[i].p);
+                    add_o.push_back(changes[i].o);
+                } else {
+                    del_s.push_back(changes[i].s);
+                    del_p.push_back(changes[i].p);
+                    del_o.push_back(changes[i].o);
+                }
+            }
+            i = j;
+        }
+        changes.clear();
+
+        //The statistics of the new diffs are computed with respect to the
+        //KB and the diffs below the tier
+        string outputdir = path + DIR_SEP + "_diff" + DIR_SEP + "compaction";
+        if (Utils::exists(outputdir)) {
+            Utils::remove_all(outputdir);
+        }
+        std::shared_ptr<DiffSnapshot> diffs(new DiffSnapshot());
+        for (auto &dir : below) {
+            diffs->diffs.push_back(std::shared_ptr<DiffIndex>(
+                        openDiffIndex(dir, &globalBuffers[0])));
+        }
+        std::unique_ptr<Querier> q(query(diffs));
+        if (!add_s.empty()) {
+            string dir = outputdir + DIR_SEP + "add";
+            Utils::create_directories(dir);
+            DiffIndex3::createDiffIndex(DiffIndex::TypeUpdate::ADDITION_df,
+                    dir, dir, add_s, add_p, add_o, true, q.get(), true);
+            ofstream ofs(dir + DIR_SEP + std::string("ADD"));
+            ofs.close();
+            diffs->diffs.push_back(std::shared_ptr<DiffIndex>(
+                        openDiffIndex(dir, &globalBuffers[0])));
+            q.reset(query(diffs));
+        }
+        if (!del_s.empty()) {
+            string dir = outputdir + DIR_SEP + "del";
+            Utils::create_directories(dir);
+            DiffIndex3::createDiffIndex(DiffIndex::TypeUpdate::DELETE_df,
+                    dir, dir, del_s, del_p, del_o, true, q.get(), true);
+            ofstream ofs(dir + DIR_SEP + std::string("DEL"));
+            ofs.close();
+        }
+        std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+        LOG(DEBUGL) << "Runtime compaction = " << sec.count() * 1000 << " ms. Added " <<
+            add_s.size() << " removed " << del_s.size();
+    } catch (...) {
+        LOG(ERRORL) << "The compaction of the diffs failed";
+        compactionFailed = true;
+    }
+    compactionDone = true;
+}
+
+void KB::installCompaction(const bool wait) {
+    if (!compactionThread.joinable() || (!wait && !compactionDone)) {
+        return;
+    }
+    compactionThread.join();
+    compactionDone = false;
+
+    string outputdir = path + DIR_SEP + "_diff" + DIR_SEP + "compaction";
+    std::vector<string> tier;
+    tier.swap(compactionTier);
+    if (compactionFailed) {
+        compactionFailed = false;
+        if (Utils::exists(outputdir)) {
+            Utils::remove_all(outputdir);
+        }
+        return;
+    }
+
+    //The compacted diffs are still in the list, since only the compaction
+    //removes diffs
+    size_t start = 0;
+    while (start < diffIndices.size() &&
+            _getDiffDir(diffIndices[start].get()) != tier[0]) {
+        start++;
+    }
+    for (size_t i = 0; i < tier.size(); ++i) {
+        if (start + i >= diffIndices.size() ||
+                _getDiffDir(diffIndices[start + i].get()) != tier[i]) {
+            LOG(ERRORL) << "The compacted diffs are no longer loaded";
+            throw 10;
+        }
+    }
+    //The new diffs take the sequence numbers of the first compacted ones,
+    //with a new generation, so that they keep their position among the
+    //other diffs. They are on disk before the compacted diffs are retired:
+    //if the process stops in between, the list in COMPACTED tells which
+    //diffs they replace
+    const string diffdir = Utils::parentDir(tier[0]);
+    std::vector<string> newdirs;
+    for (auto type : { "add", "del" }) {
+        if (!Utils::exists(outputdir + DIR_SEP + type)) {
+            continue;
+        }
+        {
+            std::ofstream ofs(outputdir + DIR_SEP + type + DIR_SEP +
+                    "COMPACTED");
+            for (auto &dir : tier) {
+                ofs << Utils::filename(dir) << endl;
+            }
+        }
+        UpdateLog::syncPath(outputdir + DIR_SEP + type);
+        int64_t seq, gen;
+        Updater::parseDiffName(Utils::filename(tier[newdirs.size()]), seq, gen);
+        int64_t newgen = gen;
+        for (auto &child : Utils::getSubdirs(diffdir)) {
+            int64_t s, g;
+            if (Updater::parseDiffName(Utils::filename(child), s, g) &&
+                    s == seq) {
+                newgen = max(newgen, g);
+            }
+        }
+        const string dir = diffdir + DIR_SEP + to_string(seq) + "-" +
+            to_string(newgen + 1);
+        Utils::rename(outputdir + DIR_SEP + type, dir);
+        newdirs.push_back(dir);
+    }
+    UpdateLog::syncDirectory(diffdir);
+
+    //The queriers might still read the compacted diffs, so they are only
+    //marked as retired and deleted when they are no longer used
+    for (size_t i = 0; i < tier.size(); ++i) {
+        retireDiff(diffIndices[start + i]);
+    }
+    diffIndices.erase(diffIndices.begin() + start,
+            diffIndices.begin() + start + tier.size());
+    for (auto &dir : tier) {
+        UpdateLog::syncPath(dir + DIR_SEP + "RETIRED");
+        UpdateLog::syncDirectory(dir);
+    }
+    for (auto &dir : newdirs) {
+        Utils::remove(dir + DIR_SEP + "COMPACTED");
+        UpdateLog::syncDirectory(dir);
+    }
+    Utils::remove_all(outputdir);
+
+    for (size_t i = 0; i < newdirs.size(); ++i) {
+        diffIndices.insert(diffIndices.begin() + start + i,
+                std::shared_ptr<DiffIndex>(openDiffIndex(newdirs[i],
+                        &globalBuffers[0])));
+    }
+    publishDiffs();
+    LOG(INFOL) << "Replaced " << tier.size() << " diffs with " <<
+        newdirs.size() << " compacted ones";
+}
+
 void KB::createNewDict(std::string dir) {
     std::string dictdir = dir + DIR_SEP + std::string("dict");
     Utils::create_directories(dictdir);
@@ -90,11 +90,21 @@ KBConfig::KBConfig() {
     internalMap.setLong(STORAGE_CACHE_SIZE, INT64_C(5000000000));
     internalMap.setLong(STORAGE_MAX_FILE_SIZE, INT64_C(20) * 1024 * 1024 * 1024);
     internalMap.setInt(STORAGE_MAX_N_FILES, MAX_N_FILES);
+    internalMap.setBool(STORAGE_MMAP, false);
 
     //String buffer
     internalMap.setBool(SB_COMPRESSDOMAINS, false);
     internalMap.setInt(SB_PREALLBUFFERS, 1000);
     internalMap.setLong(SB_CACHESIZE, INT64_C(128) * 1024 * 1024); //128MB
+    internalMap.setInt(SB_CACHESHARDS, SB_CACHE_SHARDS);
+
+    //Online updates
+    internalMap.setLong(UPDATES_MEMSIZE, UPDATES_MEM_MAXSIZE);
+    internalMap.setBool(UPDATES_COMPACTION, true);
+    internalMap.setBool(UPDATES_WAL, true);
+    internalMap.setLong(UPDATES_WAL_GROUPDELAY, UPDATES_WAL_GROUP_DELAY);
+    internalMap.setLong(UPDATES_MERGE_RATE, 0);
+    internalMap.setInt(UPDATES_MERGE_THREADS, 1);
 }
 
 void KBConfig::setParam(KBParam key, string value) {
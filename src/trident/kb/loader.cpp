@@ -23,6 +23,9 @@
 #include <trident/loader.h>
 #include <trident/kb/memoryopt.h>
 #include <trident/kb/kb.h>
+#include <trident/kb/charsets.h>
+#include <trident/kb/staticdict.h>
+#include <trident/kb/querier.h>
 #include <trident/kb/schema.h>
 #include <trident/kb/permsorter.h>
 #include <trident/tree/nodemanager.h>
@@ -43,6 +46,11 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <cctype>
+#include <exception>
 #include <sstream>
 #include <limits>
 #include <fstream>
@@ -521,6 +529,560 @@ int64_t Loader::createPermsAndDictsFromFiles(string inputtriples,
     return ntriples;
 }
 
+//Bounded queue of blocks of complete lines. The readers fill it and the
+//parsers empty it
+class _StreamBlockQueue {
+    private:
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<std::unique_ptr<std::vector<char>>> blocks;
+        const size_t maxBlocks;
+        int activeReaders;
+        bool aborted;
+
+    public:
+        _StreamBlockQueue(size_t maxBlocks, int readers) :
+            maxBlocks(maxBlocks), activeReaders(readers), aborted(false) {
+        }
+
+        //Returns false if the parsing was aborted
+        bool push(std::unique_ptr<std::vector<char>> block) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (blocks.size() >= maxBlocks && !aborted) {
+                cond.wait(lock);
+            }
+            if (aborted) {
+                return false;
+            }
+            blocks.push_back(std::move(block));
+            cond.notify_all();
+            return true;
+        }
+
+        //Returns NULL when all the readers are finished and the queue is
+        //empty, or when the parsing was aborted
+        std::unique_ptr<std::vector<char>> pop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (blocks.empty() && activeReaders > 0 && !aborted) {
+                cond.wait(lock);
+            }
+            std::unique_ptr<std::vector<char>> block;
+            if (!blocks.empty() && !aborted) {
+                block = std::move(blocks.front());
+                blocks.pop_front();
+                cond.notify_all();
+            }
+            return block;
+        }
+
+        void readerFinished() {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeReaders--;
+            cond.notify_all();
+        }
+
+        //Stop the readers and the parsers, after an error or when the terms
+        //do not fit in main memory
+        void abort() {
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+            blocks.clear();
+            cond.notify_all();
+        }
+};
+
+//Assigns dense IDs to the terms in the order they are found. The table is
+//split in shards with their own lock, so that the parsers rarely wait for
+//each other. The table is kept in main memory and cannot grow beyond
+//maxMemory bytes
+class _StreamTermTable {
+    private:
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_map<string, int64_t> terms;
+        };
+        std::unique_ptr<Shard[]> shards;
+        std::atomic<int64_t> nextID;
+        std::atomic<int64_t> usedMemory;
+        const int64_t maxMemory;
+
+    public:
+        _StreamTermTable(int64_t maxMemory) :
+            shards(new Shard[LOADER_STREAM_SHARDS]), nextID(0), usedMemory(0),
+            maxMemory(maxMemory) {
+        }
+
+        //Returns -1 if the new term does not fit in the table
+        int64_t getID(const string &term) {
+            Shard &shard = shards[std::hash<string>()(term) %
+                LOADER_STREAM_SHARDS];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto itr = shard.terms.find(term);
+            if (itr != shard.terms.end()) {
+                return itr->second;
+            }
+            if (usedMemory.fetch_add(term.size() + LOADER_STREAM_TERM_OVERHEAD)
+                    > maxMemory) {
+                return -1;
+            }
+            const int64_t id = nextID++;
+            shard.terms.insert(std::make_pair(term, id));
+            return id;
+        }
+
+        int64_t getNTerms() const {
+            return nextID;
+        }
+
+        bool isFull() const {
+            return usedMemory > maxMemory;
+        }
+
+        //Write the terms ordered by ID, in the format that insertDictionary
+        //reads (the same one of _convertDictFile)
+        void writeDictionary(string file) {
+            std::vector<const string*> terms(nextID);
+            for (int i = 0; i < LOADER_STREAM_SHARDS; ++i) {
+                for (auto &t : shards[i].terms) {
+                    terms[t.second] = &t.first;
+                }
+            }
+            std::unique_ptr<char[]> support(new char[MAX_TERM_SIZE + 2]);
+            LZ4Writer writer(file);
+            for (size_t id = 0; id < terms.size(); ++id) {
+                const string &term = *terms[id];
+                writer.writeLong(id);
+                Utils::encode_short(support.get(), term.size());
+                memcpy(support.get() + 2, term.c_str(), term.size());
+                writer.writeString(support.get(), term.size() + 2);
+            }
+        }
+};
+
+//Array where the parsers copy the encoded triples, in the format of the
+//permutation sorter. Once it is full, the parsers write the triples in files
+//instead, which are sorted as usual
+class _StreamTripleSink {
+    private:
+        std::unique_ptr<char[]> triples;
+        const int64_t capacity;
+        std::atomic<int64_t> ntriples;
+        std::atomic<bool> full;
+
+    public:
+        _StreamTripleSink(int64_t capacity) : triples(new char[capacity * 15]),
+        capacity(capacity), ntriples(0), full(false) {
+        }
+
+        bool append(const char *batch, const int64_t n) {
+            if (full) {
+                return false;
+            }
+            int64_t pos = ntriples.load();
+            do {
+                if (pos + n > capacity) {
+                    full = true;
+                    return false;
+                }
+            } while (!ntriples.compare_exchange_weak(pos, pos + n));
+            memcpy(triples.get() + pos * 15, batch, n * 15);
+            return true;
+        }
+
+        bool isFull() const {
+            return full;
+        }
+
+        int64_t getNTriples() const {
+            return ntriples;
+        }
+
+        char *getTriples() {
+            return triples.get();
+        }
+
+        std::unique_ptr<char[]> release() {
+            return std::move(triples);
+        }
+};
+
+static void _streamWriteTriples(LZ4Writer *writer, const char *triples,
+        const int64_t n) {
+    for (int64_t i = 0; i < n * 3; ++i) {
+        writer->writeLong(PermSorter::readTermFromBuffer(
+                    (char*) triples + i * 5));
+    }
+}
+
+//Part of an input file. It contains the lines that start in [start, end).
+//The gzipped files have end = -1, since they are always read whole
+struct _StreamInput {
+    string file;
+    int64_t start;
+    int64_t end;
+};
+
+//Read a part of a file in blocks of complete lines. The gzipped files are
+//decompressed here, so that the parsers only see plain text. Returns false
+//if the parsing was aborted
+static bool _streamReadInput(const _StreamInput &input,
+        _StreamBlockQueue *queue) {
+    LOG(DEBUGL) << "Reading " << input.file << " from " << input.start;
+    std::unique_ptr<std::istream> in;
+    int64_t pos = input.start;
+    if (input.end < 0) {
+        in = std::unique_ptr<std::istream>(new zstr::ifstream(input.file,
+                    std::ios_base::in | std::ios_base::binary));
+    } else {
+        in = std::unique_ptr<std::istream>(new std::ifstream(input.file,
+                    std::ios_base::in | std::ios_base::binary));
+        if (input.start > 0) {
+            //The line that crosses the start belongs to the previous part
+            in->seekg(input.start - 1);
+            string skipped;
+            std::getline(*in, skipped);
+            pos = in->tellg();
+            if (!*in || pos >= input.end) {
+                return true;
+            }
+        }
+    }
+    std::vector<char> partialLine;
+    while (true) {
+        int64_t toRead = LOADER_STREAM_BLOCK_SIZE;
+        if (input.end >= 0) {
+            toRead = min(toRead, input.end - pos);
+        }
+        std::unique_ptr<std::vector<char>> block(new std::vector<char>());
+        block->swap(partialLine);
+        const size_t start = block->size();
+        size_t n = 0;
+        if (toRead > 0) {
+            block->resize(start + toRead);
+            in->read(block->data() + start, toRead);
+            n = in->gcount();
+            block->resize(start + n);
+            pos += n;
+        }
+        if (n == 0) {
+            //The last line might continue after the end of the part, or
+            //not end with a newline
+            if (!block->empty()) {
+                if (input.end >= 0) {
+                    string rest;
+                    std::getline(*in, rest);
+                    block->insert(block->end(), rest.begin(), rest.end());
+                }
+                block->push_back('\n');
+                return queue->push(std::move(block));
+            }
+            return true;
+        }
+        size_t end = block->size();
+        while (end > 0 && (*block)[end - 1] != '\n') {
+            end--;
+        }
+        partialLine.assign(block->begin() + end, block->end());
+        block->resize(end);
+        if (!block->empty() && !queue->push(std::move(block))) {
+            return false;
+        }
+    }
+}
+
+static void _streamRead(std::vector<_StreamInput> *inputs,
+        std::atomic<size_t> *nextInput, _StreamBlockQueue *queue,
+        std::exception_ptr *error) {
+    try {
+        size_t idx;
+        while ((idx = (*nextInput)++) < inputs->size()) {
+            if (!_streamReadInput(inputs->at(idx), queue)) {
+                break;
+            }
+        }
+    } catch (...) {
+        *error = std::current_exception();
+        queue->abort();
+    }
+    queue->readerFinished();
+}
+
+static const char *_streamSkipSpaces(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+//Returns the end of the N-Triples term that starts at p, or NULL if the term
+//is malformed
+static const char *_streamEndTerm(const char *p, const char *end) {
+    if (*p == '<') {
+        const char *e = (const char*) memchr(p, '>', end - p);
+        return e != NULL ? e + 1 : NULL;
+    } else if (*p == '"') {
+        p++;
+        while (p < end && *p != '"') {
+            if (*p == '\\') {
+                p++;
+            }
+            p++;
+        }
+        if (p >= end) {
+            return NULL;
+        }
+        p++;
+        if (p < end && *p == '@') {
+            p++;
+            while (p < end && (isalnum((unsigned char) *p) || *p == '-')) {
+                p++;
+            }
+        } else if (p + 1 < end && p[0] == '^' && p[1] == '^') {
+            p += 2;
+            if (p >= end || *p != '<') {
+                return NULL;
+            }
+            const char *e = (const char*) memchr(p, '>', end - p);
+            return e != NULL ? e + 1 : NULL;
+        }
+        return p;
+    } else if (*p == '_') {
+        while (p < end && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        return p;
+    }
+    return NULL;
+}
+
+//Returns 1 if the line is a triple, 0 if it is empty or a comment, and -1 if
+//it is malformed
+static int _streamParseLine(const char *p, const char *end,
+        const char **terms, size_t *lens) {
+    p = _streamSkipSpaces(p, end);
+    if (p == end || *p == '#') {
+        return 0;
+    }
+    for (int i = 0; i < 3; ++i) {
+        if (p == end) {
+            return -1;
+        }
+        const char *e = _streamEndTerm(p, end);
+        if (e == NULL || e - p > MAX_TERM_SIZE) {
+            return -1;
+        }
+        terms[i] = p;
+        lens[i] = e - p;
+        p = _streamSkipSpaces(e, end);
+    }
+    if (p < end && *p == '.') {
+        return 1;
+    }
+    //A blank node followed by the dot without a space
+    if (p == end && terms[2][0] == '_' && lens[2] > 1 &&
+            terms[2][lens[2] - 1] == '.') {
+        lens[2]--;
+        return 1;
+    }
+    return -1;
+}
+
+//Hand off the encoded triples to the sorter. Once the array of the sorter is
+//full, the triples are written in a file
+static void _streamFlush(_StreamTripleSink *sink,
+        std::unique_ptr<LZ4Writer> &spill, string spillFile,
+        std::vector<char> &batch, int64_t &nbatch, int64_t *ntriples) {
+    if (nbatch == 0) {
+        return;
+    }
+    if (spill == NULL && !sink->append(batch.data(), nbatch)) {
+        spill = std::unique_ptr<LZ4Writer>(new LZ4Writer(spillFile));
+    }
+    if (spill != NULL) {
+        _streamWriteTriples(spill.get(), batch.data(), nbatch);
+    }
+    *ntriples += nbatch;
+    nbatch = 0;
+}
+
+static void _streamParseBlocks(_StreamBlockQueue *queue,
+        _StreamTermTable *table, _StreamTripleSink *sink, string spillFile,
+        int64_t *ntriples, int64_t *nmalformed) {
+    //The most frequent terms (e.g., the predicates) are found without
+    //locking the table
+    std::unordered_map<string, int64_t> cache;
+    std::vector<char> batch(LOADER_STREAM_BATCH * 15);
+    int64_t nbatch = 0;
+    std::unique_ptr<LZ4Writer> spill;
+    const char *terms[3];
+    size_t lens[3];
+    string term;
+
+    std::unique_ptr<std::vector<char>> block;
+    while ((block = queue->pop()) != NULL) {
+        const char *p = block->data();
+        const char *end = p + block->size();
+        while (p < end) {
+            const char *eol = (const char*) memchr(p, '\n', end - p);
+            if (eol == NULL) {
+                eol = end;
+            }
+            const int resp = _streamParseLine(p, eol, terms, lens);
+            if (resp == 1) {
+                char *out = batch.data() + nbatch * 15;
+                for (int i = 0; i < 3; ++i) {
+                    term.assign(terms[i], lens[i]);
+                    auto itr = cache.find(term);
+                    int64_t id;
+                    if (itr != cache.end()) {
+                        id = itr->second;
+                    } else {
+                        id = table->getID(term);
+                        if (id == -1) {
+                            //The terms do not fit in main memory
+                            queue->abort();
+                            return;
+                        }
+                        if (cache.size() >= LOADER_STREAM_CACHE_SIZE) {
+                            cache.clear();
+                        }
+                        cache.insert(std::make_pair(term, id));
+                    }
+                    PermSorter::writeTermInBuffer(out + i * 5, id);
+                }
+                if (++nbatch == LOADER_STREAM_BATCH) {
+                    _streamFlush(sink, spill, spillFile, batch, nbatch,
+                            ntriples);
+                }
+            } else if (resp == -1) {
+                if (*nmalformed < 10) {
+                    LOG(WARNL) << "Malformed triple: " << string(p, eol - p);
+                }
+                (*nmalformed)++;
+            }
+            p = eol + 1;
+        }
+    }
+    _streamFlush(sink, spill, spillFile, batch, nbatch, ntriples);
+}
+
+static void _streamParse(_StreamBlockQueue *queue, _StreamTermTable *table,
+        _StreamTripleSink *sink, string spillFile, int64_t *ntriples,
+        int64_t *nmalformed, std::exception_ptr *error) {
+    try {
+        _streamParseBlocks(queue, table, sink, spillFile, ntriples,
+                nmalformed);
+    } catch (...) {
+        *error = std::current_exception();
+        queue->abort();
+    }
+}
+
+int64_t Loader::parseAndEncode(string inputtriples,
+        string permDir,
+        string fileNameDictionary,
+        int nreadThreads,
+        int nthreads,
+        std::unique_ptr<char[]> &inmemoryTriples) {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    std::vector<string> files;
+    if (Utils::isDirectory(inputtriples)) {
+        files = Utils::getFiles(inputtriples);
+        std::sort(files.begin(), files.end());
+    } else if (Utils::exists(inputtriples)) {
+        files.push_back(inputtriples);
+    }
+    if (files.empty()) {
+        LOG(ERRORL) << "No input files in " << inputtriples;
+        throw 10;
+    }
+    //Large plain files are split, so that they are read in parallel
+    std::vector<_StreamInput> inputs;
+    for (auto &file : files) {
+        if (Utils::ends_with(file, ".gz")) {
+            _StreamInput input = {file, 0, -1};
+            inputs.push_back(input);
+        } else {
+            const int64_t size = Utils::fileSize(file);
+            for (int64_t s = 0; s < size; s += LOADER_STREAM_SPLIT_SIZE) {
+                _StreamInput input = {file, s,
+                    min(size, s + (int64_t) LOADER_STREAM_SPLIT_SIZE)};
+                inputs.push_back(input);
+            }
+        }
+    }
+    nreadThreads = max(1, min(nreadThreads, (int) inputs.size()));
+    const int nparsers = max(1, nthreads - nreadThreads);
+
+    //The sorter needs another array of the same size to create the other
+    //permutations, as in PermSorter::sortChunks2
+    const int64_t capacity = max((int64_t) LOADER_STREAM_BATCH,
+            (int64_t) (Utils::getSystemMemory() * 0.6 / (15 * 2)));
+    _StreamBlockQueue queue(nparsers * LOADER_STREAM_QUEUED_BLOCKS,
+            nreadThreads);
+    _StreamTermTable table((int64_t) (Utils::getSystemMemory() *
+                LOADER_STREAM_TERMS_MEMORY));
+    _StreamTripleSink sink(capacity);
+
+    LOG(DEBUGL) << "Parsing " << files.size() << " files (" << inputs.size()
+        << " parts) with " << nreadThreads << " readers and " << nparsers <<
+        " parsers";
+    std::atomic<size_t> nextInput(0);
+    std::vector<std::exception_ptr> errors(nreadThreads + nparsers);
+    std::vector<std::thread> readers(nreadThreads);
+    for (int i = 0; i < nreadThreads; ++i) {
+        readers[i] = std::thread(_streamRead, &inputs, &nextInput, &queue,
+                &errors[i]);
+    }
+    std::vector<std::thread> parsers(nparsers);
+    std::vector<int64_t> ntriples(nparsers);
+    std::vector<int64_t> nmalformed(nparsers);
+    for (int i = 0; i < nparsers; ++i) {
+        parsers[i] = std::thread(_streamParse, &queue, &table, &sink,
+                permDir + DIR_SEP + "input-" + to_string(i),
+                &ntriples[i], &nmalformed[i], &errors[nreadThreads + i]);
+    }
+    for (int i = 0; i < nreadThreads; ++i) {
+        readers[i].join();
+    }
+    int64_t totalTriples = 0;
+    int64_t totalMalformed = 0;
+    for (int i = 0; i < nparsers; ++i) {
+        parsers[i].join();
+        totalTriples += ntriples[i];
+        totalMalformed += nmalformed[i];
+    }
+    for (auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    if (table.isFull()) {
+        //Remove the triples that were written so far
+        Utils::remove_all(permDir);
+        Utils::create_directories(permDir);
+        return -1;
+    }
+    if (totalMalformed > 0) {
+        LOG(WARNL) << "Skipped " << totalMalformed << " malformed triples";
+    }
+
+    table.writeDictionary(fileNameDictionary);
+    if (sink.isFull()) {
+        //The other triples are in files, so also these are sorted from disk
+        LOG(INFOL) << "The triples do not fit in main memory. I sort them "
+            "from disk";
+        LZ4Writer writer(permDir + DIR_SEP + "input-" + to_string(nparsers));
+        _streamWriteTriples(&writer, sink.getTriples(), sink.getNTriples());
+    } else {
+        inmemoryTriples = sink.release();
+    }
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "Parsed " << totalTriples << " triples with " <<
+        table.getNTerms() << " terms in " << sec.count() << " sec.";
+    return totalTriples;
+}
+
 void Loader::parallelmerge(FileMerger<Triple> *merger,
         int buffersize,
         std::vector<int64_t*> *buffers,
@@ -953,67 +1515,111 @@ for(auto inputFile : unsortedFiles)
     }
 }*/
 
+void Loader::mergeDiskFragments_seq(std::vector<string> filesToMerge,
+        string outputFile) {
+    const int nfilesToMerge = filesToMerge.size();
+    LZ4Writer writer(outputFile);
+    LOG(DEBUGL) << "Merging " << nfilesToMerge << " into " << outputFile;
+    if (nfilesToMerge == 1) {
+        FastFileMerger<1, Triple> merger(filesToMerge, true, true);
+        while (!merger.isEmpty()) {
+            Triple t = merger.get();
+            t.writeTo(&writer);
+        }
+    } else if (nfilesToMerge == 2) {
+        FastFileMerger<2, Triple> merger(filesToMerge, true, true);
+        while (!merger.isEmpty()) {
+            Triple t = merger.get();
+            t.writeTo(&writer);
+        }
+    } else if (nfilesToMerge == 3) {
+        FastFileMerger<3, Triple> merger(filesToMerge, true, true);
+        while (!merger.isEmpty()) {
+            Triple t = merger.get();
+            t.writeTo(&writer);
+        }
+    } else {
+        if (nfilesToMerge > 4) {
+            LOG(ERRORL) << "This should not have happened " << nfilesToMerge;
+            throw 10;
+        }
+        FastFileMerger<4, Triple> merger(filesToMerge, true, true);
+        while (!merger.isEmpty()) {
+            Triple t = merger.get();
+            t.writeTo(&writer);
+        }
+    }
+    LOG(DEBUGL) << "Stop merging of " << nfilesToMerge << " files";
+}
+
 void Loader::mergeDiskFragments(ParamsMergeDiskFragments params) {
     string inputDir = params.inputDir;
+    const int nthreads = max(1, params.nthreads);
     //Do the merge-sort from the files on disk
-    LOG(DEBUGL) << "Starting merging of disk segments ...";
+    LOG(DEBUGL) << "Starting merging of disk segments with " << nthreads <<
+        " threads ...";
     int globalCounter = 0;
     do {
         std::vector<string> sortedFiles = Utils::getFiles(inputDir, true);
         if (sortedFiles.size() <= 2) {
             break;
         }
-        //Pick up to four files and merge them together
+        //Pick up to four files and merge them together. The groups are
+        //independent, so up to nthreads of them are merged at the same time
+        std::vector<std::thread> threads;
         int i = 0;
         while (i < sortedFiles.size()) {
             int nfilesToMerge = 4;
             if (i + nfilesToMerge > sortedFiles.size()) {
                 nfilesToMerge = sortedFiles.size() - i;
             }
-            //Do the merge
             std::vector<string> filesToMerge;
             for(int j = i; j < i + nfilesToMerge; ++j) {
                 filesToMerge.push_back(sortedFiles[j]);
             }
             std::string outputFile = inputDir + "/merged-" + to_string(globalCounter++) + ".0";
-            LZ4Writer writer(outputFile);
-            LOG(DEBUGL) << "Merging " << nfilesToMerge << " into " << outputFile;
-            if (nfilesToMerge == 1) {
-                FastFileMerger<1, Triple> merger(filesToMerge, true, true);
-                while (!merger.isEmpty()) {
-                    Triple t = merger.get();
-                    t.writeTo(&writer);
-                }
-            } else if (nfilesToMerge == 2) {
-                FastFileMerger<2, Triple> merger(filesToMerge, true, true);
-                while (!merger.isEmpty()) {
-                    Triple t = merger.get();
-                    t.writeTo(&writer);
-                }
-            } else if (nfilesToMerge == 3) {
-                FastFileMerger<3, Triple> merger(filesToMerge, true, true);
-                while (!merger.isEmpty()) {
-                    Triple t = merger.get();
-                    t.writeTo(&writer);
-                }
+            if (nthreads == 1) {
+                mergeDiskFragments_seq(filesToMerge, outputFile);
             } else {
-                if (nfilesToMerge > 4) {
-                    LOG(ERRORL) << "This should not have happened " << nfilesToMerge;
-                    throw 10;
-                }
-                FastFileMerger<4, Triple> merger(filesToMerge, true, true);
-                while (!merger.isEmpty()) {
-                    Triple t = merger.get();
-                    t.writeTo(&writer);
+                if (threads.size() == nthreads) {
+                    for(auto &t : threads) {
+                        t.join();
+                    }
+                    threads.clear();
                 }
+                threads.push_back(std::thread(&Loader::mergeDiskFragments_seq,
+                            filesToMerge, outputFile));
             }
             i += nfilesToMerge;
-            LOG(DEBUGL) << "Stop merging of " << nfilesToMerge << " files";
+        }
+        for(auto &t : threads) {
+            t.join();
         }
     } while (true);
     LOG(DEBUGL) << "Stop merging disk fragments";
 }
 
+void Loader::mergeDiskFragments(
+        std::vector<std::pair<string, char>> &permutations,
+        int nthreads) {
+    //The permutations are stored in different directories. Merge all of
+    //them at the same time and split the threads among them
+    const int threadsPerPerm = max(1, nthreads / (int) permutations.size());
+    std::vector<std::thread> threads;
+    for(int i = 1; i < permutations.size(); ++i) {
+        ParamsMergeDiskFragments mp(permutations[i].first, threadsPerPerm);
+        void (*fn)(ParamsMergeDiskFragments) = &Loader::mergeDiskFragments;
+        threads.push_back(std::thread(fn, mp));
+    }
+    if (!permutations.empty()) {
+        mergeDiskFragments(ParamsMergeDiskFragments(permutations[0].first,
+                    threadsPerPerm));
+    }
+    for(auto &t : threads) {
+        t.join();
+    }
+}
+
 void Loader::insert(ParamInsert params) {
     int permutation = params.permutation;
     int parallelProcesses = params.parallelProcesses;
@@ -1445,6 +2051,7 @@ void Loader::load(ParamsLoad p) {
         throw 10;
     }
     Utils::create_directories(p.kbDir);
+    PermSorter::setSortEngine(p.sortEngine);
 
     if (p.timeoutStats != -1) {
         //Activate it only for Linux systems
@@ -1535,6 +2142,15 @@ void Loader::load(ParamsLoad p) {
     }
 
 
+    if (p.parser == "stream" && p.inputformat != "snap" && !p.inputCompressed &&
+            (p.onlyCompress || p.dictMethod != DICT_HEURISTICS ||
+             p.dictionaries != 1 || p.graphTransformation != "")) {
+        LOG(WARNL) << "The stream parser supports only one dictionary with the "
+            "heuristics method, and no graph transformation or onlyCompress. "
+            "I use kognac";
+        p.parser = "kognac";
+    }
+
     int64_t totalCount = 0;
     string *permDirs = new string[6];
     for (int i = 0; i < 6; ++i) {
@@ -1562,7 +2178,31 @@ void Loader::load(ParamsLoad p) {
                 fileNameDictionaries[0],
                 p.maxReadingThreads,
                 p.parallelThreads);
-    } else { /*** LOAD RDF FILES ***/
+    } else if (!p.inputCompressed && p.parser == "stream") { /*** PARSE RDF FILES IN A PIPELINE ***/
+        std::unique_ptr<char[]> inmemoryTriples;
+        totalCount = parseAndEncode(p.triplesInputDir,
+                permDirs[IDX_SPO],
+                fileNameDictionaries[0],
+                p.maxReadingThreads,
+                p.parallelThreads,
+                inmemoryTriples);
+        if (totalCount == -1) {
+            LOG(WARNL) << "The terms do not fit in main memory. I use kognac";
+            p.parser = "kognac";
+        } else if (inmemoryTriples != NULL) {
+            //Sort the permutations while the dictionary is stored
+            presorter = std::thread(&Loader::sortInMemory,
+                    getPermutationsToSort(permDirs, p.createIndicesInBlocks,
+                        p.aggrIndices, p.nindices),
+                    inmemoryTriples.release(),
+                    totalCount,
+                    p.maxReadingThreads,
+                    p.parallelThreads,
+                    &presorterError);
+        }
+    }
+    if (p.inputformat != "snap" && (p.inputCompressed ||
+                p.parser != "stream")) { /*** LOAD RDF FILES ***/
         if (!p.inputCompressed) {
             if (p.dictMethod != DICT_HEURISTICS) {
                 throw 10;
@@ -1648,6 +2288,23 @@ void Loader::load(ParamsLoad p) {
             p.storeDicts,
             p.relsOwnIDs);
 
+    //Compute the statistics for the optimizer on the final KB
+    if (p.charsets && p.graphTransformation == "") {
+        kb.reset(); //Writes kbstats
+        KBConfig readConfig;
+        KB readKB(p.kbDir.c_str(), true, false, false, readConfig);
+        std::unique_ptr<Querier> q(readKB.query());
+        CharacteristicSets::compute(q.get(), p.kbDir + DIR_SEP + "charsets");
+    }
+
+    //Copy the dictionary in the static format
+    if (p.staticDict && p.storeDicts) {
+        kb.reset();
+        KBConfig readConfig;
+        KB readKB(p.kbDir.c_str(), true, false, true, readConfig);
+        StaticDict::build(readKB.getDictMgmt(), p.kbDir + DIR_SEP + "staticdict");
+    }
+
     /*** CLEANUP ***/
     delete[] permDirs;
     delete[] fileNameDictionaries;
@@ -2463,6 +3120,46 @@ void Loader::createIndices(
 }*/
 
 
+std::vector<std::pair<string, char>> Loader::getPermutationsToSort(
+        string *permDirs,
+        const bool createIndicesInBlocks,
+        const bool aggrIndices,
+        const int nindices) {
+    std::vector<std::pair<string, char>> permutations;
+    permutations.push_back(std::make_pair(permDirs[0], IDX_SPO));
+    if (!createIndicesInBlocks) {
+        if (!aggrIndices) {
+            for (int i = 1; i < 6; i++) {
+                if (permDirs[i] != "") {
+                    permutations.push_back(std::make_pair(permDirs[i], i));
+                }
+            }
+        } else {
+            if (nindices == 6) {
+                permutations.push_back(std::make_pair(permDirs[IDX_SOP], IDX_SOP));
+                permutations.push_back(std::make_pair(permDirs[IDX_OSP], IDX_OSP));
+            }
+            permutations.push_back(std::make_pair(permDirs[IDX_OPS], IDX_OPS));
+        }
+    }
+    return permutations;
+}
+
+void Loader::sortInMemory(std::vector<std::pair<string, char>> permutations,
+        char *triples,
+        int64_t ntriples,
+        int maxReadingThreads,
+        int parallelProcesses,
+        std::exception_ptr *error) {
+    std::unique_ptr<char[]> array(triples);
+    try {
+        PermSorter::sortTriples(permutations, array.get(), ntriples,
+                maxReadingThreads, parallelProcesses);
+    } catch (...) {
+        *error = std::current_exception();
+    }
+}
+
 void Loader::createIndices(
         int parallelProcesses,
         int maxReadingThreads,
@@ -2488,31 +3185,23 @@ void Loader::createIndices(
     int posO = 2;
     int lastIdx = IDX_SPO;
     LOG(DEBUGL) << "start createIndices";
-    std::vector<std::pair<string, char>> permutations;
-    permutations.push_back(std::make_pair(permDirs[0], IDX_SPO));
-    if (!createIndicesInBlocks) {
-        if (!aggrIndices) {
-            for (int i = 1; i < 6; i++) {
-                if (permDirs[i] != "") {
-                    permutations.push_back(std::make_pair(permDirs[i], i));
-                }
-            }
-        } else {
-            if (nindices == 6) {
-                permutations.push_back(std::make_pair(permDirs[IDX_SOP], IDX_SOP));
-                permutations.push_back(std::make_pair(permDirs[IDX_OSP], IDX_OSP));
-            }
-            permutations.push_back(std::make_pair(permDirs[IDX_OPS], IDX_OPS));
+    std::vector<std::pair<string, char>> permutations =
+        getPermutationsToSort(permDirs, createIndicesInBlocks, aggrIndices,
+                nindices);
+    if (presorter.joinable()) {
+        //The parser kept the triples in memory
+        presorter.join();
+        if (presorterError) {
+            std::rethrow_exception(presorterError);
         }
+    } else {
+        PermSorter::sortChunks2(permutations, maxReadingThreads,
+                parallelProcesses,
+                estimatedSize,
+                false);
     }
-    PermSorter::sortChunks2(permutations, maxReadingThreads,
-            parallelProcesses,
-            estimatedSize,
-            false);
 
-    for(auto &p : permutations) {
-        mergeDiskFragments(ParamsMergeDiskFragments(p.first));
-    }
+    mergeDiskFragments(permutations, parallelProcesses);
 
     ParamInsert params;
     params.parallelProcesses = parallelProcesses;
@@ -2542,7 +3231,8 @@ void Loader::createIndices(
                     parallelProcesses,
                     estimatedSize,
                     false);
-            mergeDiskFragments(ParamsMergeDiskFragments(permDirs[IDX_OPS]));
+            mergeDiskFragments(ParamsMergeDiskFragments(permDirs[IDX_OPS],
+                        parallelProcesses));
         }
         ins->stopInserts(lastIdx);
         moveData(remotePath, outputDirs[lastIdx], limitSpace);
@@ -2581,7 +3271,8 @@ void Loader::createIndices(
                     estimatedSize,
                     false);
             mergeDiskFragments(
-                    ParamsMergeDiskFragments(permDirs[IDX_SOP]));
+                    ParamsMergeDiskFragments(permDirs[IDX_SOP],
+                        parallelProcesses));
         }
         ins->stopInserts(lastIdx);
         moveData(remotePath, outputDirs[lastIdx], limitSpace);
@@ -2619,7 +3310,8 @@ void Loader::createIndices(
                     estimatedSize,
                     false);
             mergeDiskFragments(
-                    ParamsMergeDiskFragments(permDirs[IDX_OSP]));
+                    ParamsMergeDiskFragments(permDirs[IDX_OSP],
+                        parallelProcesses));
         }
         ins->stopInserts(lastIdx);
         moveData(remotePath, outputDirs[lastIdx], limitSpace);
@@ -2659,7 +3351,8 @@ void Loader::createIndices(
                         estimatedSize,
                         false);
                 mergeDiskFragments(
-                        ParamsMergeDiskFragments(permDirs[IDX_POS]));
+                        ParamsMergeDiskFragments(permDirs[IDX_POS],
+                        parallelProcesses));
             }
             ins->stopInserts(lastIdx);
             moveData(remotePath, outputDirs[lastIdx], limitSpace);
@@ -2711,7 +3404,8 @@ void Loader::createIndices(
                     estimatedSize,
                     true);
             mergeDiskFragments(
-                    ParamsMergeDiskFragments(aggr1Dir));
+                    ParamsMergeDiskFragments(aggr1Dir,
+                        parallelProcesses));
 
             insert(params);
             LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
@@ -2736,7 +3430,8 @@ void Loader::createIndices(
                         estimatedSize,
                         false);
                 mergeDiskFragments(
-                        ParamsMergeDiskFragments(permDirs[IDX_PSO]));
+                        ParamsMergeDiskFragments(permDirs[IDX_PSO],
+                        parallelProcesses));
             }
 
             ins->stopInserts(lastIdx);
@@ -2789,7 +3484,8 @@ void Loader::createIndices(
                     estimatedSize,
                     true);
             mergeDiskFragments(
-                    ParamsMergeDiskFragments(aggr2Dir));
+                    ParamsMergeDiskFragments(aggr2Dir,
+                        parallelProcesses));
 
             insert(params);
             LOG(DEBUGL) << "Memory used so far: " << Utils::getUsedMemory();
@@ -22,12 +22,14 @@
 
 #include <trident/kb/permsorter.h>
 #include <trident/utils/parallel.h>
+#include <trident/utils/radixsort.h>
 #include <kognac/utils.h>
 #include <kognac/compressor.h>
 
 #include <thread>
 #include <functional>
 #include <array>
+#include <random>
 
 typedef std::array<unsigned char, 15> __PermSorter_triple;
 typedef std::array<unsigned char, 23> __PermSorter_tripleCount;
@@ -42,22 +44,92 @@ bool __PermSorter_tripleCount_sorter(const __PermSorter_tripleCount &a,
     return a < b;
 }
 
+int PermSorter::sortEngine = PERMSORTER_RADIXSORT;
+
+void PermSorter::setSortEngine(std::string engine) {
+    if (engine == "merge") {
+        sortEngine = PERMSORTER_MERGESORT;
+    } else if (engine == "radix") {
+        sortEngine = PERMSORTER_RADIXSORT;
+    } else {
+        LOG(ERRORL) << "Sort engine " << engine << " not known";
+        throw 10;
+    }
+}
+
 void PermSorter::sortPermutation(char *start, char *end, int nthreads,
         bool includeCount) {
     std::chrono::system_clock::time_point starttime = std::chrono::system_clock::now();
     if (includeCount) {
         __PermSorter_tripleCount *sstart = (__PermSorter_tripleCount*) start;
         __PermSorter_tripleCount *send = (__PermSorter_tripleCount*) end;
-        ParallelTasks::sort_int(sstart, send, &__PermSorter_tripleCount_sorter, nthreads);
+        if (sortEngine == PERMSORTER_RADIXSORT) {
+            RadixSort::sort(sstart, send, nthreads);
+        } else {
+            ParallelTasks::sort_int(sstart, send, &__PermSorter_tripleCount_sorter, nthreads);
+        }
     } else {
         __PermSorter_triple *sstart = (__PermSorter_triple*) start;
         __PermSorter_triple *send = (__PermSorter_triple*) end;
-        ParallelTasks::sort_int(sstart, send, &__PermSorter_triple_sorter, nthreads);
+        if (sortEngine == PERMSORTER_RADIXSORT) {
+            RadixSort::sort(sstart, send, nthreads);
+        } else {
+            ParallelTasks::sort_int(sstart, send, &__PermSorter_triple_sorter, nthreads);
+        }
     }
     std::chrono::duration<double> duration = std::chrono::system_clock::now() - starttime;
     LOG(DEBUGL) << "Time sorting: " << duration.count() << "s.";
 }
 
+void PermSorter::benchmarkSort(int64_t ntriples, int nthreads) {
+    const int oldEngine = sortEngine;
+    std::mt19937_64 gen(42);
+    for (int includeCount = 0; includeCount < 2; ++includeCount) {
+        const size_t sizeTriple = includeCount ? 23 : 15;
+        const size_t nbytes = ntriples * sizeTriple;
+        std::unique_ptr<char[]> input(new char[nbytes]);
+        std::unique_ptr<char[]> merged(new char[nbytes]);
+        std::unique_ptr<char[]> radixed(new char[nbytes]);
+
+        //Few predicates, many subjects and objects
+        char *current = input.get();
+        for (int64_t i = 0; i < ntriples; ++i) {
+            writeTermInBuffer(current, gen() % (ntriples / 10 + 1));
+            writeTermInBuffer(current + 5, gen() % 1000);
+            if (includeCount) {
+                write8TermInBuffer(current + 10, gen() % ((int64_t)1 << 32));
+                writeTermInBuffer(current + 18, gen() % 100);
+            } else {
+                writeTermInBuffer(current + 10, gen() % ((int64_t)1 << 32));
+            }
+            current += sizeTriple;
+        }
+        memcpy(merged.get(), input.get(), nbytes);
+        memcpy(radixed.get(), input.get(), nbytes);
+
+        sortEngine = PERMSORTER_MERGESORT;
+        std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+        sortPermutation(merged.get(), merged.get() + nbytes, nthreads,
+                includeCount);
+        std::chrono::duration<double> durMerge = std::chrono::system_clock::now() - start;
+
+        sortEngine = PERMSORTER_RADIXSORT;
+        start = std::chrono::system_clock::now();
+        sortPermutation(radixed.get(), radixed.get() + nbytes, nthreads,
+                includeCount);
+        std::chrono::duration<double> durRadix = std::chrono::system_clock::now() - start;
+
+        if (memcmp(merged.get(), radixed.get(), nbytes) != 0) {
+            LOG(ERRORL) << "The two engines returned different arrays";
+            throw 10;
+        }
+        LOG(INFOL) << "Sorted " << ntriples << " triples of " << sizeTriple <<
+            " bytes with " << nthreads << " threads. merge=" <<
+            durMerge.count() << "s. radix=" << durRadix.count() << "s.";
+    }
+    sortEngine = oldEngine;
+}
+
 void PermSorter::writeTermInBuffer(char *buffer, const int64_t n) {
     buffer[0] = (n >> 32) & 0xFF;
     buffer[1] = (n >> 24) & 0xFF;
@@ -737,6 +809,149 @@ void PermSorter::sortChunks2_permute(
     }
 }
 
+void PermSorter::sortChunks2_permuteCopy(
+        char *start,
+        char *end,
+        char *output,
+        const size_t sizeTriple,
+        int currentPerm,
+        int nextPerm,
+        int nthreads) {
+    const int64_t ntriples = (end - start) / sizeTriple;
+    const int64_t chunkSize = max((int64_t)1, ntriples / max(1, nthreads));
+    std::vector<std::thread> threads;
+    int64_t currentStart = 0;
+    while (currentStart < ntriples) {
+        int64_t currentEnd = currentStart + chunkSize;
+        if (currentEnd > ntriples || threads.size() == nthreads - 1) {
+            currentEnd = ntriples;
+        }
+        char *in = start + currentStart * sizeTriple;
+        char *out = output + currentStart * sizeTriple;
+        const size_t len = (currentEnd - currentStart) * sizeTriple;
+        threads.push_back(std::thread([in, out, len, sizeTriple,
+                    currentPerm, nextPerm]() {
+                    memcpy(out, in, len);
+                    PermSorter::sortChunks2_permute(out, out + len, sizeTriple,
+                            currentPerm, nextPerm);
+                    }));
+        currentStart = currentEnd;
+    }
+    for(auto &t : threads) {
+        t.join();
+    }
+}
+
+void PermSorter::sortChunks2_dump(
+        std::vector<std::pair<string, char>> &permutations,
+        char *rawTriples,
+        char *rawTriples2,
+        const size_t nloadedtriples,
+        const size_t nbytes,
+        const int round,
+        const int threadsToUse,
+        const int ioThreadsToUse,
+        const bool includeCount) {
+    const size_t sizeTriple = includeCount ? 23 : 15;
+    const bool pipeline = permutations.size() > 1;
+    int currentPerm = permutations[0].second;
+
+    //Sort it
+    LOG(DEBUGL) << "Start sorting the inmemory array";
+    PermSorter::sortPermutation(rawTriples, rawTriples + nbytes, threadsToUse,
+            includeCount);
+    LOG(DEBUGL) << "Stop sorting the inmemory array";
+
+    //Dump it
+    LOG(DEBUGL) << "Start dumping the inmemory array of " << nloadedtriples;
+    string outputFile = permutations[0].first + DIR_SEP +
+        string("sortedchunk-") + to_string(round);
+
+    std::thread dumper;
+    if (pipeline) {
+        dumper = std::thread(&PermSorter::dumpPermutation,
+                rawTriples,
+                nloadedtriples,
+                threadsToUse,
+                ioThreadsToUse,
+                includeCount,
+                outputFile);
+    } else {
+        PermSorter::dumpPermutation(rawTriples,
+                nloadedtriples,
+                threadsToUse,
+                ioThreadsToUse,
+                includeCount,
+                outputFile);
+        LOG(DEBUGL) << "Stop dumping the inmemory array";
+    }
+
+    char *current = rawTriples;
+    char *other = rawTriples2;
+    for(int i = 1; i < permutations.size(); ++i) {
+        //There are other permutations to process.
+        int permID = permutations[i].second;
+
+        //Rewrite the permutation in the array that is not being dumped
+        LOG(DEBUGL) << "Start permuting ...";
+        PermSorter::sortChunks2_permuteCopy(
+                current,
+                current + nloadedtriples * sizeTriple,
+                other,
+                sizeTriple,
+                currentPerm,
+                permID,
+                threadsToUse);
+        LOG(DEBUGL) << "Stop permuting";
+
+        //Sort it
+        LOG(DEBUGL) << "Start sorting the inmemory array. perm=" << permID;
+        PermSorter::sortPermutation(other,
+                other + nloadedtriples * sizeTriple, threadsToUse,
+                includeCount);
+        LOG(DEBUGL) << "Stop sorting the inmemory array";
+
+        //Wait for the previous permutation before dumping this one
+        dumper.join();
+        LOG(DEBUGL) << "Stop dumping the inmemory array";
+        std::string currentDir = permutations[i].first;
+        LOG(DEBUGL) << "Start dumping the inmemory array of " << nloadedtriples;
+        outputFile = currentDir + DIR_SEP + string("sortedchunk-") + to_string(round);
+        dumper = std::thread(&PermSorter::dumpPermutation,
+                other,
+                nloadedtriples,
+                threadsToUse,
+                ioThreadsToUse,
+                includeCount,
+                outputFile);
+        std::swap(current, other);
+        currentPerm = permID;
+    }
+    if (dumper.joinable()) {
+        dumper.join();
+        LOG(DEBUGL) << "Stop dumping the inmemory array";
+    }
+}
+
+void PermSorter::sortTriples(
+        std::vector<std::pair<string, char>> &permutations,
+        char *rawTriples,
+        const int64_t ntriples,
+        int ionthreads,
+        int nthreads) {
+    LOG(DEBUGL) << "Start sortTriples of " << ntriples << " triples";
+    //The writers of the dump split the parts evenly
+    const int ioThreadsToUse = nthreads % ionthreads == 0 ? ionthreads : 1;
+    const size_t nbytes = ntriples * 15;
+    std::unique_ptr<char[]> rawTriples2;
+    if (permutations.size() > 1) {
+        rawTriples2 = std::unique_ptr<char[]>(new char[nbytes]);
+    }
+    sortChunks2_dump(permutations, rawTriples, rawTriples2.get(), ntriples,
+            nbytes, 0, nthreads, ioThreadsToUse, false);
+    LOG(DEBUGL) << "Stop sortTriples";
+}
+
 void PermSorter::sortChunks2(
         std::vector<std::pair<string, char>> &permutations,
         int ionthreads,
@@ -749,9 +964,14 @@ void PermSorter::sortChunks2(
 
     const size_t sizeTriple = includeCount ? 23 : 15;
 
+    //If there are more permutations, then I use two arrays: while one
+    //permutation is dumped on disk, the next one is created and sorted in
+    //the other array
+    const bool pipeline = permutations.size() > 1;
+
     LOG(DEBUGL) << "Start sortChunks2";
     const int64_t mem = Utils::getSystemMemory() * 0.6;
-    const size_t max_nelements = mem / sizeTriple;
+    const size_t max_nelements = mem / (sizeTriple * (pipeline ? 2 : 1));
 
     size_t nelements = max((size_t)threadsToUse,
             min(max_nelements, (size_t)(estimatedSize)));
@@ -762,6 +982,10 @@ void PermSorter::sortChunks2(
 
     LOG(DEBUGL) << "Creating a vector of " << nelements << " (" << nbytes << " bytes) ...";
     std::unique_ptr<char[]> rawTriples = std::unique_ptr<char[]>(new char[nbytes]);
+    std::unique_ptr<char[]> rawTriples2;
+    if (pipeline) {
+        rawTriples2 = std::unique_ptr<char[]>(new char[nbytes]);
+    }
     LOG(DEBUGL) << "Done creating a vector of " << nelements;
 
     //Set up the readers
@@ -813,7 +1037,6 @@ void PermSorter::sortChunks2(
     std::vector<std::thread> threads(threadsToUse);
     while (true) {
         LOG(DEBUGL) << "Loading round " << round;
-        int currentPerm = permutations[0].second;
 
         //Check if I have finished sorting all the input data
         bool moreData = false;
@@ -859,60 +1082,12 @@ void PermSorter::sortChunks2(
                 rawTriples.get());
         LOG(DEBUGL) << "Stop filling the holes";
 
-        //Sort it
-        LOG(DEBUGL) << "Start sorting the inmemory array";
-        PermSorter::sortPermutation(rawTriples.get(),
-                rawTriples.get() + nbytes, threadsToUse, includeCount);
-        LOG(DEBUGL) << "Stop sorting the inmemory array";
-
-        //Dump it
+        //Sort and dump it
         size_t nloadedtriples = 0;
         for(auto c : counts) nloadedtriples += c;
-        LOG(DEBUGL) << "Start dumping the inmemory array of " << nloadedtriples;
-        string outputFile = inputdir + DIR_SEP + string("sortedchunk-") + to_string(round);
-
-        PermSorter::dumpPermutation(rawTriples.get(),
-                nloadedtriples,
-                threadsToUse,
-                ioThreadsToUse,
-                includeCount,
-                outputFile);
-        LOG(DEBUGL) << "Stop dumping the inmemory array";
-
-        for(int i = 1; i < permutations.size(); ++i) {
-            //There are other permutations to process.
-            int permID = permutations[i].second;
-
-            //Rewrite the permutation
-            LOG(DEBUGL) << "Start permuting ...";
-            PermSorter::sortChunks2_permute(
-                    rawTriples.get(),
-                    rawTriples.get() + nloadedtriples * sizeTriple,
-                    sizeTriple,
-                    currentPerm,
-                    permID);
-            LOG(DEBUGL) << "Stop permuting";
-
-            //Sort it
-            LOG(DEBUGL) << "Start sorting the inmemory array. perm=" << permID;
-            PermSorter::sortPermutation(rawTriples.get(),
-                    rawTriples.get() + nloadedtriples * sizeTriple, threadsToUse,
-                    includeCount);
-            LOG(DEBUGL) << "Stop sorting the inmemory array";
-
-            //Dump it
-            std::string currentDir = permutations[i].first;
-            LOG(DEBUGL) << "Start dumping the inmemory array of " << nloadedtriples;
-            outputFile = currentDir + DIR_SEP + string("sortedchunk-") + to_string(round);
-            PermSorter::dumpPermutation(rawTriples.get(),
-                    nloadedtriples,
-                    threadsToUse,
-                    ioThreadsToUse,
-                    includeCount,
-                    outputFile);
-            LOG(DEBUGL) << "Stop dumping the inmemory array";
-            currentPerm = permID;
-        }
+        sortChunks2_dump(permutations, rawTriples.get(), rawTriples2.get(),
+                nloadedtriples, nbytes, round, threadsToUse, ioThreadsToUse,
+                includeCount);
 
         round++;
     }
@@ -54,12 +54,12 @@ Querier::Querier(Root* tree, DictMgmt *dict, TableStorage** files,
         const int64_t inputSize, const int64_t nTerms, const int nindices,
         const int64_t *nTablesPerPartition,
         const int64_t *nFirstTablesPerPartition, KB *sampleKB,
-        std::vector<std::unique_ptr<DiffIndex>> &diffIndices, bool *present)
+        std::shared_ptr<const DiffSnapshot> diffs, bool *present)
     : inputSize(inputSize), nTerms(nTerms),
     nTablesPerPartition(nTablesPerPartition),
     nFirstTablesPerPartition(nFirstTablesPerPartition),
     // nindices(nindices),
-    diffIndices(diffIndices), present(present) {
+    present(present) {
         this->tree = tree;
         this->dict = dict;
         this->files = files;
@@ -67,6 +67,9 @@ Querier::Querier(Root* tree, DictMgmt *dict, TableStorage** files,
         lastKeyQueried = -1;
         strat.init(/*&listFactory, &comprFactory, &list2Factory,*/ &ncFactory, &nrFactory, &ncluFactory,
                 NULL, NULL, NULL, NULL, NULL, NULL);
+        diffFactories.strat = &strat;
+        diffFactories.diff1 = &factory13;
+        diffFactories.mem = &factory16;
         aggrIndices = notAggrIndices = cacheIndices = 0;
         spo = sop = pos = pso = ops = osp = 0;
 
@@ -81,20 +84,25 @@ Querier::Querier(Root* tree, DictMgmt *dict, TableStorage** files,
         if (sampleKB != NULL) {
             sampler = std::unique_ptr<Querier>(sampleKB->query());
         }
-        for (int i = 0; i < diffIndices.size(); ++i) {
-            DiffIndex *diff = diffIndices[i].get();
-            initDiffIndex(diff);
-        }
+        setDiffSnapshot(diffs);
     }
 
-void Querier::initDiffIndex(DiffIndex *diff) {
+void Querier::setDiffSnapshot(std::shared_ptr<const DiffSnapshot> diffs) {
+    diffIndices = diffs->diffs;
+    diffVersion = diffs->version;
+}
+
+PairItr *Querier::getDiffScan(DiffIndex *diff, const int perm) {
     if (diff->getClass() == DiffIndex::DIFF3) {
-        ((DiffIndex3*)diff)->setStorageStrat(&strat);
+        DiffScanItr *newitr = factory11.get();
+        newitr->setQuerier(this);
+        return ((DiffIndex3*)diff)->getScan(perm, newitr, &strat);
     } else {
-        assert(diff->getClass() == DiffIndex::DIFF1);
-        ((DiffIndex1*)diff)->setFactoryIterators(&factory13);
+        //The other diffs can handle scans in getIterator()
+        int64_t nfirstterms = 0;
+        return diff->getIterator(perm, -1, -1, -1, nfirstterms,
+                diffFactories);
     }
-
 }
 
 char Querier::getStrategy(const int idx, const int64_t v) {
@@ -606,7 +614,9 @@ void Querier::initNewIterator(TableStorage *storage,
         int64_t v1,
         int64_t v2,
         const bool setConstraints) {
-    std::pair<const char*, const char*> coord = storage->getTable(file, mark);
+    //Without a constraint the whole table is read
+    std::pair<const char*, const char*> coord = storage->getTable(file, mark,
+            v1 == -1);
 
     assert(t->getTypeItr() == NEWROW_ITR || t->getTypeItr() == NEWCLUSTER_ITR
             || t->getTypeItr() == NEWCOLUMN_ITR);
@@ -730,9 +740,7 @@ PairItr *Querier::summaryDiff(const int perm, DiffIndex::TypeUpdate tp) {
         if (diffIndices[i]->getNUniqueKeys(perm) > 0) {
             LOG(DEBUGL) << "diffIndices " << i;
             if (diffIndices[i]->getType() == tp) {
-                DiffScanItr *itr = factory11.get();
-                itr->setQuerier(this);
-                PairItr *it = ((DiffIndex3*)diffIndices[i].get())->getScan(perm, itr);
+                PairItr *it = getDiffScan(diffIndices[i].get(), perm);
                 LOG(DEBUGL) << "Adding iterator, hasNext = " << it->hasNext();
                 if (finalItr == NULL) {
                     finalItr = it;
@@ -745,15 +753,13 @@ PairItr *Querier::summaryDiff(const int perm, DiffIndex::TypeUpdate tp) {
                     LOG(DEBUGL) << "CompositeScanItr, hasNext = " << newitr->hasNext();
                     finalItr = newitr;
                 } else {
-                    ((CompositeScanItr*)finalItr)->addChild(itr);
+                    ((CompositeScanItr*)finalItr)->addChild(it);
                 }
             } else {
                 if (finalItr == NULL) {
                     continue;
                 }
-                DiffScanItr *itr = factory11.get();
-                itr->setQuerier(this);
-                PairItr *it = ((DiffIndex3*)diffIndices[i].get())->getScan(perm, itr);
+                PairItr *it = getDiffScan(diffIndices[i].get(), perm);
                 RmItr *newitr = factory14.get();
                 newitr->init(finalItr, it, 0);
                 finalItr = newitr;
@@ -974,11 +980,9 @@ PairItr *Querier::getIterator(const int idx, const int64_t s, const int64_t p, c
                 int64_t delnfirstterms = 0;
                 if (first >= 0) {
                     diffItr = diffIndices[i]->getIterator(idx, first, second,
-                            third, delnfirstterms);
+                            third, delnfirstterms, diffFactories);
                 } else {
-                    DiffScanItr *newitr = factory11.get();
-                    newitr->setQuerier(this);
-                    diffItr = ((DiffIndex3*)diffIndices[i].get())->getScan(idx, newitr);
+                    diffItr = getDiffScan(diffIndices[i].get(), idx);
                 }
                 if (diffItr->hasNext()) {
                     if (out->hasNext()) {
@@ -1019,7 +1023,7 @@ PairItr *Querier::getIterator(const int idx, const int64_t s, const int64_t p, c
             } else {
                 if (first >= 0) {
                     diffItr = diffIndices[i]->getIterator(idx, first, second,
-                            third, nfirstterms);
+                            third, nfirstterms, diffFactories);
                     if (second >= 0) {
                         //I must change nfirstterms, which can be either 1 or 0
                         //(depending if the second term is already existing on the KB).
@@ -1037,14 +1041,7 @@ PairItr *Querier::getIterator(const int idx, const int64_t s, const int64_t p, c
                         }
                     }
                 } else {
-                    if (diffIndices[i]->getClass() == DiffIndex::DIFF3) {
-                        DiffScanItr *newitr = factory11.get();
-                        newitr->setQuerier(this);
-                        diffItr = ((DiffIndex3*)diffIndices[i].get())->getScan(idx, newitr);
-                    } else {
-                        //Diff1 update getIterator() method can handle scans
-                        diffItr = diffIndices[i]->getIterator(idx, first, second, third, nfirstterms);
-                    }
+                    diffItr = getDiffScan(diffIndices[i].get(), idx);
                 }
                 if (diffItr->hasNext()) {
                     iterators.push_back(diffItr);
@@ -1182,6 +1179,10 @@ void Querier::releaseItr(PairItr * itr) {
         case DIFF1_ITR:
             factory13.release((Diff1Itr*)itr);
             break;
+        case MEMDIFF_ITR:
+            itr->clear();
+            factory16.release((MemDiffItr*)itr);
+            break;
         case AGGR_ITR:
             citr = (AggrItr*) itr;
             if (citr->getMainItr() != NULL)
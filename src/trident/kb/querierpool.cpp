@@ -0,0 +1,61 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/kb/querierpool.h>
+#include <trident/kb/querier.h>
+#include <trident/kb/kb.h>
+
+#include <kognac/logs.h>
+
+QuerierPool::QuerierPool(KB &kb) : kb(kb), nCreated(0) {
+}
+
+Querier *QuerierPool::get() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!queriers.empty()) {
+        Querier *q = queriers.back();
+        queriers.pop_back();
+        //The querier pins the diffs that were current when it was last
+        //returned. A new request sees the latest version
+        if (q->getDiffVersion() != kb.getDiffVersion()) {
+            q->setDiffSnapshot(kb.getDiffSnapshot());
+        }
+        return q;
+    }
+    //Queriers are created under the lock, since the constructor reads the
+    //KB (and the sample KB) and might open files
+    nCreated++;
+    LOG(DEBUGL) << "Creating querier number " << nCreated;
+    return kb.query();
+}
+
+void QuerierPool::release(Querier *q) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queriers.push_back(q);
+}
+
+QuerierPool::~QuerierPool() {
+    for (auto q : queriers) {
+        delete q;
+    }
+}
@@ -0,0 +1,627 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+
+#include <trident/kb/staticdict.h>
+#include <trident/kb/dictmgmt.h>
+#include <trident/tree/stringbuffer.h>
+#include <trident/tree/treeitr.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+//Strings used to build the symbol table
+#define STATICDICT_SAMPLE_SIZE (1024 * 1024)
+//Rounds of the construction of the symbol table
+#define SYMBOLTABLE_ROUNDS 5
+//Code of the bytes that are not in the symbol table
+#define SYMBOLTABLE_ESCAPE 255
+//Number of bits of a level of the perfect hash for every key
+#define MPHF_GAMMA 2
+#define MPHF_MAXLEVELS 64
+
+static void writeLong(std::ostream &out, const uint64_t v) {
+    char data[8];
+    Utils::encode_long(data, 0, v);
+    out.write(data, 8);
+}
+
+static uint64_t readLong(std::istream &in) {
+    char data[8];
+    in.read(data, 8);
+    return Utils::decode_long(data, 0);
+}
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= UINT64_C(0xff51afd7ed558ccd);
+    x ^= x >> 33;
+    x *= UINT64_C(0xc4ceb9fe1a85ec53);
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t pack(const char *text, int size) {
+    uint64_t v = 0;
+    memcpy(&v, text, size);
+    return v;
+}
+
+static void appendVInt(std::string &out, int n) {
+    char buffer[8];
+    const int size = Utils::encode_vint2(buffer, 0, n);
+    out.append(buffer, size);
+}
+
+void SymbolTable::index() {
+    for (int i = 0; i < 9; ++i) {
+        codes[i].clear();
+    }
+    for (int i = 0; i < nsymbols; ++i) {
+        codes[lengths[i]][symbols[i]] = i;
+    }
+}
+
+int SymbolTable::match(const char *text, int size, uint8_t &code) const {
+    for (int len = std::min(8, size); len > 0; --len) {
+        if (codes[len].empty())
+            continue;
+        auto itr = codes[len].find(pack(text, len));
+        if (itr != codes[len].end()) {
+            code = itr->second;
+            return len;
+        }
+    }
+    return -1;
+}
+
+void SymbolTable::build(const std::vector<std::string> &sample) {
+    nsymbols = 0;
+    index();
+    //Every round compresses the sample with the current table, counts how
+    //often every symbol and every concatenation of two consecutive symbols
+    //occur, and keeps the candidates that save the most bytes
+    for (int round = 0; round < SYMBOLTABLE_ROUNDS; ++round) {
+        std::unordered_map<std::string, uint64_t> counts;
+        for (const auto &s : sample) {
+            const char *text = s.c_str();
+            const int size = s.size();
+            int pos = 0;
+            int prevPos = -1, prevLen = 0;
+            while (pos < size) {
+                uint8_t code;
+                int len = match(text + pos, size - pos, code);
+                if (len < 0)
+                    len = 1;
+                counts[std::string(text + pos, len)]++;
+                if (prevPos >= 0) {
+                    const int concat = std::min(8, prevLen + len);
+                    counts[std::string(text + prevPos, concat)]++;
+                }
+                prevPos = pos;
+                prevLen = len;
+                pos += len;
+            }
+        }
+
+        std::vector<std::pair<uint64_t, std::string>> candidates;
+        for (const auto &c : counts) {
+            //Single bytes that are not in the table take two bytes
+            const uint64_t gain = c.second * (c.first.size() == 1 ? 1 :
+                    c.first.size());
+            candidates.push_back(std::make_pair(gain, c.first));
+        }
+        const size_t ncandidates = std::min((size_t) SYMBOLTABLE_ESCAPE,
+                candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() +
+                ncandidates, candidates.end(),
+                [](const std::pair<uint64_t, std::string> &a,
+                    const std::pair<uint64_t, std::string> &b) {
+                return a.first > b.first || (a.first == b.first &&
+                        a.second < b.second);
+                });
+        nsymbols = ncandidates;
+        for (int i = 0; i < nsymbols; ++i) {
+            const std::string &sym = candidates[i].second;
+            symbols[i] = pack(sym.c_str(), sym.size());
+            lengths[i] = sym.size();
+        }
+        index();
+    }
+}
+
+void SymbolTable::compress(const char *text, int size,
+        std::string &out) const {
+    int pos = 0;
+    while (pos < size) {
+        uint8_t code;
+        const int len = match(text + pos, size - pos, code);
+        if (len < 0) {
+            out.push_back((char) SYMBOLTABLE_ESCAPE);
+            out.push_back(text[pos++]);
+        } else {
+            out.push_back((char) code);
+            pos += len;
+        }
+    }
+}
+
+int SymbolTable::decompress(const char *data, int size, char *out) const {
+    int outSize = 0;
+    for (int i = 0; i < size; ++i) {
+        const uint8_t code = data[i];
+        if (code == SYMBOLTABLE_ESCAPE) {
+            out[outSize++] = data[++i];
+        } else {
+            memcpy(out + outSize, symbols + code, lengths[code]);
+            outSize += lengths[code];
+        }
+    }
+    return outSize;
+}
+
+void SymbolTable::write(std::ostream &out) const {
+    writeLong(out, nsymbols);
+    for (int i = 0; i < nsymbols; ++i) {
+        writeLong(out, symbols[i]);
+        writeLong(out, lengths[i]);
+    }
+}
+
+void SymbolTable::read(std::istream &in) {
+    nsymbols = readLong(in);
+    for (int i = 0; i < nsymbols; ++i) {
+        symbols[i] = readLong(in);
+        lengths[i] = readLong(in);
+    }
+    index();
+}
+
+uint64_t MinimalPerfectHash::hash(uint64_t key, size_t level) {
+    return mix(key + (level + 1) * UINT64_C(0x9e3779b97f4a7c15));
+}
+
+uint64_t MinimalPerfectHash::rank(uint64_t bit) const {
+    uint64_t r = ranks[bit >> 9];
+    for (uint64_t w = (bit >> 9) << 3; w < (bit >> 6); ++w) {
+        r += __builtin_popcountll(bits[w]);
+    }
+    const uint64_t mask = (UINT64_C(1) << (bit & 63)) - 1;
+    return r + __builtin_popcountll(bits[bit >> 6] & mask);
+}
+
+void MinimalPerfectHash::build(std::vector<uint64_t> &keys) {
+    bits.clear();
+    ranks.clear();
+    levels.clear();
+    leftovers.clear();
+    std::vector<uint64_t> next;
+    size_t level = 0;
+    while (!keys.empty() && level < MPHF_MAXLEVELS) {
+        //The size of a level is a multiple of 64 bits
+        const uint64_t size = ((keys.size() * MPHF_GAMMA + 63) >> 6) << 6;
+        const uint64_t start = bits.size() << 6;
+        std::vector<uint64_t> placed(size >> 6), collisions(size >> 6);
+        for (const auto key : keys) {
+            const uint64_t p = hash(key, level) % size;
+            const uint64_t m = UINT64_C(1) << (p & 63);
+            if (placed[p >> 6] & m) {
+                collisions[p >> 6] |= m;
+            } else {
+                placed[p >> 6] |= m;
+            }
+        }
+        for (size_t i = 0; i < placed.size(); ++i) {
+            placed[i] &= ~collisions[i];
+        }
+        //The keys that collided go to the next level
+        next.clear();
+        for (const auto key : keys) {
+            const uint64_t p = hash(key, level) % size;
+            if (collisions[p >> 6] & (UINT64_C(1) << (p & 63))) {
+                next.push_back(key);
+            }
+        }
+        bits.insert(bits.end(), placed.begin(), placed.end());
+        levels.push_back(std::make_pair(start, size));
+        keys.swap(next);
+        level++;
+    }
+
+    //Number of bits set before every block of 512 bits
+    uint64_t count = 0;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        if ((i & 7) == 0) {
+            ranks.push_back(count);
+        }
+        count += __builtin_popcountll(bits[i]);
+    }
+    ranks.push_back(count);
+
+    std::sort(keys.begin(), keys.end());
+    for (const auto key : keys) {
+        leftovers.push_back(std::make_pair(key, count++));
+    }
+}
+
+bool MinimalPerfectHash::lookup(uint64_t key, uint64_t &idx) const {
+    for (size_t level = 0; level < levels.size(); ++level) {
+        const uint64_t p = hash(key, level) % levels[level].second;
+        const uint64_t bit = levels[level].first + p;
+        if (bits[bit >> 6] & (UINT64_C(1) << (bit & 63))) {
+            idx = rank(bit);
+            return true;
+        }
+    }
+    auto itr = std::lower_bound(leftovers.begin(), leftovers.end(),
+            std::make_pair(key, (uint64_t) 0));
+    if (itr != leftovers.end() && itr->first == key) {
+        idx = itr->second;
+        return true;
+    }
+    return false;
+}
+
+void MinimalPerfectHash::write(std::ostream &out) const {
+    writeLong(out, levels.size());
+    for (const auto &l : levels) {
+        writeLong(out, l.first);
+        writeLong(out, l.second);
+    }
+    writeLong(out, bits.size());
+    out.write((const char*) bits.data(), bits.size() * 8);
+    writeLong(out, ranks.size());
+    out.write((const char*) ranks.data(), ranks.size() * 8);
+    writeLong(out, leftovers.size());
+    for (const auto &l : leftovers) {
+        writeLong(out, l.first);
+        writeLong(out, l.second);
+    }
+}
+
+void MinimalPerfectHash::read(std::istream &in) {
+    levels.resize(readLong(in));
+    for (auto &l : levels) {
+        l.first = readLong(in);
+        l.second = readLong(in);
+    }
+    bits.resize(readLong(in));
+    in.read((char*) bits.data(), bits.size() * 8);
+    ranks.resize(readLong(in));
+    in.read((char*) ranks.data(), ranks.size() * 8);
+    leftovers.resize(readLong(in));
+    for (auto &l : leftovers) {
+        l.first = readLong(in);
+        l.second = readLong(in);
+    }
+}
+
+size_t MinimalPerfectHash::getMemoryUsage() const {
+    return (bits.size() + ranks.size() + leftovers.size() * 2) * 8;
+}
+
+void PackedArray::init(uint64_t size, uint64_t maxValue) {
+    width = 1;
+    while (width < 8 && (maxValue >> (width * 8)) != 0) {
+        width++;
+    }
+    data.assign(size * width, 0);
+}
+
+void PackedArray::set(uint64_t idx, uint64_t value) {
+    Utils::encode_longNBytes(data.data() + idx * width, width, value);
+}
+
+uint64_t PackedArray::get(uint64_t idx) const {
+    return Utils::decode_longFixedBytes(data.data() + idx * width, width);
+}
+
+void PackedArray::write(std::ostream &out) const {
+    writeLong(out, width);
+    writeLong(out, data.size());
+    out.write(data.data(), data.size());
+}
+
+void PackedArray::read(std::istream &in) {
+    width = readLong(in);
+    data.resize(readLong(in));
+    in.read(data.data(), data.size());
+}
+
+uint64_t StaticDict::hash(const char *text, int size) {
+    //FNV-1a
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (int i = 0; i < size; ++i) {
+        h ^= (uint8_t) text[i];
+        h *= UINT64_C(0x100000001b3);
+    }
+    return mix(h);
+}
+
+void StaticDict::build(DictMgmt *dict, std::string file) {
+    std::vector<std::pair<std::string, nTerm>> terms;
+    std::unique_ptr<char[]> text(new char[MAX_TERM_SIZE]);
+    StringBuffer *sb = dict->getStringBuffer();
+    TreeItr *itr = dict->getInvDictIterator();
+    while (itr->hasNext()) {
+        int64_t coordinates;
+        const nTerm id = itr->next(coordinates);
+        int size;
+        sb->get(coordinates, text.get(), size);
+        terms.push_back(std::make_pair(std::string(text.get(), size), id));
+    }
+    delete itr;
+    build(terms, file);
+}
+
+void StaticDict::build(std::vector<std::pair<std::string, nTerm>> &terms,
+        std::string file) {
+    std::chrono::system_clock::time_point start =
+        std::chrono::system_clock::now();
+    std::sort(terms.begin(), terms.end());
+    StaticDict d;
+    d.nterms = terms.size();
+
+    //Build the symbol table from a sample of the terms
+    std::vector<std::string> sample;
+    if (!terms.empty()) {
+        uint64_t sampleSize = 0;
+        const size_t step = std::max((size_t) 1, terms.size() /
+                (STATICDICT_SAMPLE_SIZE / 64));
+        for (size_t i = 0; i < terms.size() &&
+                sampleSize < STATICDICT_SAMPLE_SIZE; i += step) {
+            sample.push_back(terms[i].first);
+            sampleSize += terms[i].first.size();
+        }
+    }
+    d.symbols.build(sample);
+
+    //Front-coded buckets. The first term of every bucket is stored
+    //entirely, the others are stored as the length of the prefix shared
+    //with the previous term and the compressed suffix
+    const uint64_t nbuckets = (d.nterms + STATICDICT_BUCKET - 1) /
+        STATICDICT_BUCKET;
+    std::vector<uint64_t> offsets(nbuckets);
+    std::string buffer, compressed;
+    for (uint64_t i = 0; i < d.nterms; ++i) {
+        const std::string &t = terms[i].first;
+        int prefix = 0;
+        if (i % STATICDICT_BUCKET == 0) {
+            offsets[i / STATICDICT_BUCKET] = buffer.size();
+        } else {
+            const std::string &prev = terms[i - 1].first;
+            while (prefix < t.size() && prefix < prev.size() &&
+                    t[prefix] == prev[prefix]) {
+                prefix++;
+            }
+            appendVInt(buffer, prefix);
+        }
+        compressed.clear();
+        d.symbols.compress(t.c_str() + prefix, t.size() - prefix, compressed);
+        appendVInt(buffer, compressed.size());
+        buffer.append(compressed);
+    }
+    d.data.assign(buffer.begin(), buffer.end());
+    d.bucketOffsets.init(nbuckets, buffer.size());
+    for (uint64_t i = 0; i < nbuckets; ++i) {
+        d.bucketOffsets.set(i, offsets[i]);
+    }
+
+    //IDs
+    nTerm maxId = 0;
+    for (const auto &t : terms) {
+        maxId = std::max(maxId, t.second);
+    }
+    d.posToId.init(d.nterms, maxId);
+    std::vector<std::pair<nTerm, uint64_t>> idPos(d.nterms);
+    for (uint64_t i = 0; i < d.nterms; ++i) {
+        d.posToId.set(i, terms[i].second);
+        idPos[i] = std::make_pair(terms[i].second, i);
+    }
+    std::sort(idPos.begin(), idPos.end());
+    d.denseIds = d.nterms == 0 || (idPos[0].first == 0 &&
+            maxId == d.nterms - 1);
+    if (!d.denseIds) {
+        d.ids.init(d.nterms, maxId);
+    }
+    d.idToPos.init(d.nterms, d.nterms);
+    for (uint64_t i = 0; i < d.nterms; ++i) {
+        if (!d.denseIds) {
+            d.ids.set(i, idPos[i].first);
+        }
+        d.idToPos.set(i, idPos[i].second);
+    }
+    idPos.clear();
+
+    //Perfect hash of the texts. The terms with the same hash of a previous
+    //term are stored separately
+    std::vector<std::pair<uint64_t, uint64_t>> hashes(d.nterms);
+    for (uint64_t i = 0; i < d.nterms; ++i) {
+        hashes[i] = std::make_pair(hash(terms[i].first.c_str(),
+                    terms[i].first.size()), i);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    std::vector<uint64_t> keys;
+    std::vector<std::pair<uint64_t, uint64_t>> unique;
+    for (uint64_t i = 0; i < hashes.size(); ++i) {
+        if (i > 0 && hashes[i].first == hashes[i - 1].first) {
+            d.collisions[terms[hashes[i].second].first] = hashes[i].second;
+        } else {
+            keys.push_back(hashes[i].first);
+            unique.push_back(hashes[i]);
+        }
+    }
+    hashes.clear();
+    d.mphf.build(keys);
+    d.slotToPos.init(unique.size(), d.nterms);
+    for (const auto &h : unique) {
+        uint64_t slot = 0;
+        d.mphf.lookup(h.first, slot);
+        d.slotToPos.set(slot, h.second);
+    }
+
+    //Write everything on file
+    std::ofstream fos;
+    fos.open(file, std::ios_base::binary);
+    writeLong(fos, d.nterms);
+    d.symbols.write(fos);
+    writeLong(fos, d.data.size());
+    fos.write(d.data.data(), d.data.size());
+    d.bucketOffsets.write(fos);
+    d.posToId.write(fos);
+    writeLong(fos, d.denseIds ? 1 : 0);
+    d.ids.write(fos);
+    d.idToPos.write(fos);
+    d.mphf.write(fos);
+    d.slotToPos.write(fos);
+    writeLong(fos, d.collisions.size());
+    for (const auto &c : d.collisions) {
+        writeLong(fos, c.first.size());
+        fos.write(c.first.c_str(), c.first.size());
+        writeLong(fos, c.second);
+    }
+    fos.close();
+
+    std::chrono::duration<double> sec = std::chrono::system_clock::now()
+        - start;
+    LOG(INFOL) << "Built the static dictionary of " << d.nterms << " terms ("
+        << d.getMemoryUsage() << " bytes) in " << sec.count() * 1000 << " ms";
+}
+
+std::unique_ptr<StaticDict> StaticDict::load(std::string file) {
+    if (!Utils::exists(file)) {
+        return std::unique_ptr<StaticDict>();
+    }
+    std::unique_ptr<StaticDict> d(new StaticDict());
+    std::ifstream fis;
+    fis.open(file, std::ios_base::binary);
+    d->nterms = readLong(fis);
+    d->symbols.read(fis);
+    d->data.resize(readLong(fis));
+    fis.read(d->data.data(), d->data.size());
+    d->bucketOffsets.read(fis);
+    d->posToId.read(fis);
+    d->denseIds = readLong(fis) != 0;
+    d->ids.read(fis);
+    d->idToPos.read(fis);
+    d->mphf.read(fis);
+    d->slotToPos.read(fis);
+    const uint64_t ncollisions = readLong(fis);
+    for (uint64_t i = 0; i < ncollisions; ++i) {
+        std::string text(readLong(fis), '\0');
+        fis.read(&text[0], text.size());
+        d->collisions[text] = readLong(fis);
+    }
+    if (!fis) {
+        LOG(ERRORL) << "The file " << file << " is corrupted";
+        throw 10;
+    }
+    fis.close();
+    LOG(DEBUGL) << "Loaded the static dictionary of " << d->nterms <<
+        " terms (" << d->getMemoryUsage() << " bytes)";
+    return d;
+}
+
+int StaticDict::decode(uint64_t pos, char *text) const {
+    const char *bucket = data.data() + bucketOffsets.get(pos /
+            STATICDICT_BUCKET);
+    int offset = 0;
+    int size = 0;
+    for (int i = 0; i <= pos % STATICDICT_BUCKET; ++i) {
+        const int prefix = i == 0 ? 0 : Utils::decode_vint2(bucket, &offset);
+        const int length = Utils::decode_vint2(bucket, &offset);
+        size = prefix + symbols.decompress(bucket + offset, length,
+                text + prefix);
+        offset += length;
+    }
+    return size;
+}
+
+bool StaticDict::getPosition(nTerm id, uint64_t &pos) const {
+    if (id < 0) {
+        return false;
+    }
+    if (denseIds) {
+        if (id >= nterms)
+            return false;
+        pos = idToPos.get(id);
+        return true;
+    }
+    //Binary search on the sorted IDs
+    uint64_t low = 0, high = nterms;
+    while (low < high) {
+        const uint64_t mid = (low + high) >> 1;
+        if (ids.get(mid) < (uint64_t) id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == nterms || ids.get(low) != (uint64_t) id) {
+        return false;
+    }
+    pos = idToPos.get(low);
+    return true;
+}
+
+bool StaticDict::getText(nTerm id, char *text, int &size) const {
+    uint64_t pos;
+    if (!getPosition(id, pos)) {
+        return false;
+    }
+    size = decode(pos, text);
+    return true;
+}
+
+bool StaticDict::getNumber(const char *text, int size, nTerm &id) const {
+    uint64_t slot;
+    if (mphf.lookup(hash(text, size), slot) && slot < slotToPos.size()) {
+        const uint64_t pos = slotToPos.get(slot);
+        //The lookups are frequent, so the buffer is not allocated every time
+        static thread_local char term[MAX_TERM_SIZE];
+        const int termSize = decode(pos, term);
+        if (termSize == size && memcmp(term, text, size) == 0) {
+            id = posToId.get(pos);
+            return true;
+        }
+    }
+    if (!collisions.empty()) {
+        auto itr = collisions.find(std::string(text, size));
+        if (itr != collisions.end()) {
+            id = posToId.get(itr->second);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t StaticDict::getMemoryUsage() const {
+    return data.size() + bucketOffsets.getMemoryUsage() +
+        posToId.getMemoryUsage() + ids.getMemoryUsage() +
+        idToPos.getMemoryUsage() + mphf.getMemoryUsage() +
+        slotToPos.getMemoryUsage();
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+
+#include <trident/kb/updatelog.h>
+
+#include <kognac/utils.h>
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+#include <chrono>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+//Every record is: type (1 byte), size of the payload (8 bytes), payload,
+//checksum of the previous fields (8 bytes)
+#define LOG_HEADER_SIZE 9
+#define LOG_CHECKSUM_SIZE 8
+
+UpdateLog::UpdateLog(std::string file, int64_t groupDelay) : file(file),
+    groupDelay(groupDelay), lastLSN(0), durableLSN(0), flushing(false),
+    failed(false) {
+    int64_t validSize = 0;
+    const bool existed = Utils::exists(file);
+    if (existed) {
+        validSize = replay(file, [](const Record&) {});
+    }
+#if defined(_WIN32)
+    fd = ::_open(file.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY,
+            _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(file.c_str(), O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+#endif
+    if (fd == -1) {
+        LOG(ERRORL) << "Failed opening the update log " << file;
+        throw 10;
+    }
+    //Remove a torn record at the end, otherwise the records written after
+    //it could not be read back
+#if defined(_WIN32)
+    if (::_chsize_s(fd, validSize) != 0 ||
+            ::_lseeki64(fd, validSize, SEEK_SET) == -1) {
+#else
+    if (::ftruncate(fd, validSize) != 0 ||
+            ::lseek(fd, validSize, SEEK_SET) == -1) {
+#endif
+        LOG(ERRORL) << "Failed preparing the update log " << file;
+        throw 10;
+    }
+    //The entry of a new log must be on disk before its records are
+    //acknowledged as durable
+    if (!existed) {
+        syncDirectory(Utils::parentDir(file));
+    }
+}
+
+uint64_t UpdateLog::checksum(const char *data, const size_t size) {
+    //FNV-1a
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < size; ++i) {
+        h ^= (uint8_t) data[i];
+        h *= UINT64_C(0x100000001b3);
+    }
+    return h;
+}
+
+uint64_t UpdateLog::append(RecordType type,
+        const std::vector<uint64_t> &triples) {
+    std::vector<char> record(LOG_HEADER_SIZE + triples.size() * 8 +
+            LOG_CHECKSUM_SIZE);
+    record[0] = (char) type;
+    Utils::encode_long(record.data(), 1, triples.size() * 8);
+    char *p = record.data() + LOG_HEADER_SIZE;
+    for (size_t i = 0; i < triples.size(); ++i) {
+        Utils::encode_long(p, i * 8, triples[i]);
+    }
+    return appendRecord(record);
+}
+
+uint64_t UpdateLog::appendTerms(
+        const std::vector<std::pair<uint64_t, std::string>> &terms) {
+    size_t size = 0;
+    for (auto &t : terms) {
+        size += 12 + t.second.size();
+    }
+    std::vector<char> record(LOG_HEADER_SIZE + size + LOG_CHECKSUM_SIZE);
+    record[0] = (char) TERMS;
+    Utils::encode_long(record.data(), 1, size);
+    char *p = record.data() + LOG_HEADER_SIZE;
+    for (auto &t : terms) {
+        Utils::encode_long(p, 0, t.first);
+        Utils::encode_int(p, 8, t.second.size());
+        memcpy(p + 12, t.second.c_str(), t.second.size());
+        p += 12 + t.second.size();
+    }
+    return appendRecord(record);
+}
+
+uint64_t UpdateLog::appendRecord(std::vector<char> &record) {
+    const size_t size = record.size() - LOG_CHECKSUM_SIZE;
+    Utils::encode_long(record.data(), size, checksum(record.data(), size));
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.insert(pending.end(), record.begin(), record.end());
+    return ++lastLSN;
+}
+
+void UpdateLog::commit(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (durableLSN < lsn) {
+        if (failed) {
+            LOG(ERRORL) << "The update log " << file << " failed. The record "
+                << lsn << " is not durable";
+            throw 10;
+        }
+        if (flushing) {
+            //Another thread is writing. Its batch might not contain the
+            //record, in which case the next round does
+            cond.wait(lock);
+            continue;
+        }
+        flushing = true;
+        if (groupDelay > 0) {
+            //Give the other writers the chance to join this batch
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(groupDelay));
+            lock.lock();
+        }
+        std::vector<char> batch;
+        batch.swap(pending);
+        const uint64_t batchLSN = lastLSN;
+        lock.unlock();
+
+        bool ok = true;
+        size_t written = 0;
+        while (ok && written < batch.size()) {
+#if defined(_WIN32)
+            const int64_t n = ::_write(fd, batch.data() + written,
+                    (unsigned int) (batch.size() - written));
+#else
+            const int64_t n = ::write(fd, batch.data() + written,
+                    batch.size() - written);
+#endif
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = n > 0;
+            written += ok ? n : 0;
+        }
+        ok = ok && syncFile(fd);
+
+        lock.lock();
+        flushing = false;
+        if (!ok) {
+            //The waiters of this batch and of the following ones throw too
+            failed = true;
+            cond.notify_all();
+            LOG(ERRORL) << "Failed writing the update log " << file;
+            throw 10;
+        }
+        durableLSN = batchLSN;
+        cond.notify_all();
+    }
+}
+
+void UpdateLog::sync() {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lsn = lastLSN;
+    }
+    commit(lsn);
+}
+
+bool UpdateLog::hasFailed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+void UpdateLog::truncate() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (flushing) {
+        cond.wait(lock);
+    }
+    pending.clear();
+#if defined(_WIN32)
+    if (::_chsize_s(fd, 0) != 0 || ::_lseeki64(fd, 0, SEEK_SET) == -1) {
+#else
+    if (::ftruncate(fd, 0) != 0 || ::lseek(fd, 0, SEEK_SET) == -1) {
+#endif
+        LOG(ERRORL) << "Failed truncating the update log " << file;
+        throw 10;
+    }
+    if (!syncFile(fd)) {
+        LOG(ERRORL) << "Failed syncing the update log " << file;
+        throw 10;
+    }
+    //The records that were not written yet are durable as well
+    durableLSN = lastLSN;
+    cond.notify_all();
+}
+
+int64_t UpdateLog::replay(std::string file,
+        std::function<void(const Record&)> callback) {
+    const int64_t size = Utils::fileSize(file);
+    std::vector<char> content(size);
+    std::ifstream ifs(file, std::ios_base::in | std::ios_base::binary);
+    ifs.read(content.data(), size);
+    ifs.close();
+
+    int64_t pos = 0;
+    int64_t nrecords = 0;
+    while (pos + LOG_HEADER_SIZE + LOG_CHECKSUM_SIZE <= size) {
+        const char *r = content.data() + pos;
+        const uint64_t payload = Utils::decode_long(r, 1);
+        if (r[0] < ADD || r[0] > TERMS || payload > (uint64_t) (size - pos -
+                    LOG_HEADER_SIZE - LOG_CHECKSUM_SIZE)) {
+            break;
+        }
+        const size_t recsize = LOG_HEADER_SIZE + payload;
+        if ((uint64_t) Utils::decode_long(r, recsize) != checksum(r, recsize)) {
+            break;
+        }
+
+        Record record;
+        record.type = (RecordType) r[0];
+        const char *p = r + LOG_HEADER_SIZE;
+        if (record.type == TERMS) {
+            const char *end = p + payload;
+            while (p + 12 <= end) {
+                const uint64_t id = Utils::decode_long(p, 0);
+                const int len = Utils::decode_int(p, 8);
+                record.terms.push_back(std::make_pair(id,
+                            std::string(p + 12, len)));
+                p += 12 + len;
+            }
+        } else {
+            record.triples.resize(payload / 8);
+            for (size_t i = 0; i < record.triples.size(); ++i) {
+                record.triples[i] = Utils::decode_long(p, i * 8);
+            }
+        }
+        callback(record);
+        pos += recsize + LOG_CHECKSUM_SIZE;
+        nrecords++;
+    }
+    if (pos < size) {
+        LOG(WARNL) << "The last " << (size - pos) << " bytes of the update log "
+            << file << " are incomplete and are ignored";
+    }
+    LOG(DEBUGL) << "Read " << nrecords << " records from the update log " << file;
+    return pos;
+}
+
+bool UpdateLog::syncFile(const int fd) {
+#if defined(_WIN32)
+    return ::_commit(fd) == 0;
+#elif defined(__APPLE__)
+    return ::fsync(fd) == 0;
+#else
+    return ::fdatasync(fd) == 0;
+#endif
+}
+
+void UpdateLog::syncPath(std::string path) {
+    if (Utils::isDirectory(path)) {
+        for (auto &f : Utils::getFiles(path)) {
+            if (!Utils::isDirectory(f)) {
+                syncPath(f);
+            }
+        }
+        for (auto &d : Utils::getSubdirs(path)) {
+            syncPath(d);
+        }
+        //The entries of the files must be on disk too
+        syncDirectory(path);
+        return;
+    }
+#if defined(_WIN32)
+    const int fd = ::_open(path.c_str(), _O_RDWR | _O_BINARY);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+#endif
+    if (fd == -1) {
+        LOG(ERRORL) << "Failed opening " << path;
+        throw 10;
+    }
+    const bool ok = syncFile(fd);
+#if defined(_WIN32)
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+    if (!ok) {
+        LOG(ERRORL) << "Failed syncing " << path;
+        throw 10;
+    }
+}
+
+void UpdateLog::syncDirectory(std::string path) {
+#if defined(_WIN32)
+    //The entries of a directory cannot be synced on Windows
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        LOG(ERRORL) << "Failed opening " << path;
+        throw 10;
+    }
+    const bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) {
+        LOG(ERRORL) << "Failed syncing " << path;
+        throw 10;
+    }
+#endif
+}
+
+UpdateLog::~UpdateLog() {
+#if defined(_WIN32)
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+}
@@ -31,6 +31,8 @@
 #include <kognac/filereader.h>
 
 #include <string>
+#include <algorithm>
+#include <cctype>
 
 void Updater::parseUpdate(std::string update,
                           StringCollection &support,
@@ -145,161 +147,161 @@ void Updater::writeDict(DictMgmt *dictmgmt,
     ofs.close();
 }
 
-void Updater::compressUpdate(DiffIndex::TypeUpdate type,
-                             string updatedir,
-                             std::vector<uint64_t> &all_s,
-                             std::vector<uint64_t> &all_p,
-                             std::vector<uint64_t> &all_o,
-                             KB *kb,
-                             Querier *q,
-                             ByteArrayToNumberMap &tmpdict,
-                             StringCollection &tmpdictsupport) {
+void Updater::encodeUpdate(DiffIndex::TypeUpdate type,
+                           string updatedir,
+                           KB *kb,
+                           ByteArrayToNumberMap &tmpdict,
+                           StringCollection &tmpdictsupport,
+                           std::vector<Triple> &parsedtriples) {
     std::unique_ptr<char[]> supportbuffer(new char[MAX_TERM_SIZE + 2]);
     Utils::encode_short(supportbuffer.get(), 0);
     int64_t supportlen = 0;
 
-    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
-    std::vector<Triple> parsedtriples;
-    {
-        //Read the update and parse the strings
-        std::vector<TextualTriple> triples;
-        StringCollection col(64 * 1024 * 1024);
-        parseUpdate(updatedir, col, triples);
-
-        //Load the existing dictionary
-        DictMgmt *dict = kb->getDictMgmt();
-        int64_t nextID = kb->getNextID();
-        int64_t previd = -1;
-
-        //Sort the update by s
-        std::sort(triples.begin(), triples.end(), sortByS);
-
-        //Convert all s into numbers
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (supportlen == itr->lens &&
-                    memcmp(itr->s, supportbuffer.get() + 2, supportlen) == 0) {
-                itr->nums = previd;
+    //Read the update and parse the strings
+    std::vector<TextualTriple> triples;
+    StringCollection col(64 * 1024 * 1024);
+    parseUpdate(updatedir, col, triples);
+
+    //Load the existing dictionary
+    DictMgmt *dict = kb->getDictMgmt();
+    int64_t nextID = kb->getNextID();
+    int64_t previd = -1;
+
+    //Sort the update by s
+    std::sort(triples.begin(), triples.end(), sortByS);
+
+    //Convert all s into numbers
+    for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
+        if (supportlen == itr->lens &&
+                memcmp(itr->s, supportbuffer.get() + 2, supportlen) == 0) {
+            itr->nums = previd;
+        } else {
+            memcpy(supportbuffer.get() + 2, itr->s, itr->lens);
+            Utils::encode_short(supportbuffer.get(), itr->lens);
+            supportlen = itr->lens;
+
+            nTerm id;
+            bool resp = dict->getNumber(itr->s, itr->lens, &id);
+            if (resp) {
+                itr->nums = id;
             } else {
-                memcpy(supportbuffer.get() + 2, itr->s, itr->lens);
-                Utils::encode_short(supportbuffer.get(), itr->lens);
-                supportlen = itr->lens;
-
-                nTerm id;
-                bool resp = dict->getNumber(itr->s, itr->lens, &id);
-                if (resp) {
-                    itr->nums = id;
+                if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+                    //Add a new entry in the temporary dictionary
+                    itr->nums = nextID;
+                    const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
+                                           itr->lens + 2);
+                    tmpdict.insert(std::make_pair(newentry, nextID));
+                    nextID++;
                 } else {
-                    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
-                        //Add a new entry in the temporary dictionary
-                        itr->nums = nextID;
-                        const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
-                                               itr->lens + 2);
-                        tmpdict.insert(std::make_pair(newentry, nextID));
-                        nextID++;
-                    } else {
-                        itr->nums = UINT64_MAX;
-                        continue;
-                    }
+                    itr->nums = UINT64_MAX;
+                    continue;
                 }
-                previd = itr->nums;
             }
+            previd = itr->nums;
         }
+    }
 
-        //Sort the update by p
-        std::sort(triples.begin(), triples.end(), sortByP);
-        supportlen = 0;
-        Utils::encode_short(supportbuffer.get(), 0);
+    //Sort the update by p
+    std::sort(triples.begin(), triples.end(), sortByP);
+    supportlen = 0;
+    Utils::encode_short(supportbuffer.get(), 0);
 
-        //Convert all p into numbers
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (supportlen == itr->lenp &&
-                    memcmp(itr->p, supportbuffer.get() + 2, supportlen) == 0) {
-                itr->nump = previd;
+    //Convert all p into numbers
+    for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
+        if (supportlen == itr->lenp &&
+                memcmp(itr->p, supportbuffer.get() + 2, supportlen) == 0) {
+            itr->nump = previd;
+        } else {
+            memcpy(supportbuffer.get() + 2, itr->p, itr->lenp);
+            Utils::encode_short(supportbuffer.get(), itr->lenp);
+            supportlen = itr->lenp;
+
+            nTerm id;
+            bool resp = dict->getNumber(itr->p, itr->lenp, &id);
+            if (resp) {
+                itr->nump = id;
             } else {
-                memcpy(supportbuffer.get() + 2, itr->p, itr->lenp);
-                Utils::encode_short(supportbuffer.get(), itr->lenp);
-                supportlen = itr->lenp;
-
-                nTerm id;
-                bool resp = dict->getNumber(itr->p, itr->lenp, &id);
-                if (resp) {
-                    itr->nump = id;
-                } else {
-                    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
-                        //Is it existing in the tmp dict already?
-                        if (tmpdict.count(supportbuffer.get())) {
-                            auto itr2 = tmpdict.find(supportbuffer.get());
-                            itr->nump = itr2->second;
-                        } else {
-                            //Add a new entry in the temporary dictionary
-                            itr->nump = nextID;
-                            const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
-                                                   itr->lenp + 2);
-                            tmpdict.insert(std::make_pair(newentry, nextID));
-                            nextID++;
-                        }
+                if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+                    //Is it existing in the tmp dict already?
+                    if (tmpdict.count(supportbuffer.get())) {
+                        auto itr2 = tmpdict.find(supportbuffer.get());
+                        itr->nump = itr2->second;
                     } else {
-                        itr->nump = UINT64_MAX;
-                        continue;
+                        //Add a new entry in the temporary dictionary
+                        itr->nump = nextID;
+                        const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
+                                               itr->lenp + 2);
+                        tmpdict.insert(std::make_pair(newentry, nextID));
+                        nextID++;
                     }
+                } else {
+                    itr->nump = UINT64_MAX;
+                    continue;
                 }
-                previd = itr->nump;
             }
+            previd = itr->nump;
         }
+    }
 
-        //Sort the update by o
-        std::sort(triples.begin(), triples.end(), sortByO);
-        supportlen = 0;
-        Utils::encode_short(supportbuffer.get(), 0);
+    //Sort the update by o
+    std::sort(triples.begin(), triples.end(), sortByO);
+    supportlen = 0;
+    Utils::encode_short(supportbuffer.get(), 0);
 
-        //Convert all o into numbers
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (supportlen == itr->leno &&
-                    memcmp(itr->o, supportbuffer.get() + 2, supportlen) == 0) {
-                itr->numo = previd;
+    //Convert all o into numbers
+    for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
+        if (supportlen == itr->leno &&
+                memcmp(itr->o, supportbuffer.get() + 2, supportlen) == 0) {
+            itr->numo = previd;
+        } else {
+            memcpy(supportbuffer.get() + 2, itr->o, itr->leno);
+            Utils::encode_short(supportbuffer.get(), itr->leno);
+            supportlen = itr->leno;
+
+            nTerm id;
+            bool resp = dict->getNumber(itr->o, itr->leno, &id);
+            if (resp) {
+                itr->numo = id;
             } else {
-                memcpy(supportbuffer.get() + 2, itr->o, itr->leno);
-                Utils::encode_short(supportbuffer.get(), itr->leno);
-                supportlen = itr->leno;
-
-                nTerm id;
-                bool resp = dict->getNumber(itr->o, itr->leno, &id);
-                if (resp) {
-                    itr->numo = id;
-                } else {
-                    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
-                        //Is it existing in the tmp dict already?
-                        if (tmpdict.count(supportbuffer.get())) {
-                            auto itr2 = tmpdict.find(supportbuffer.get());
-                            itr->numo = itr2->second;
-                        } else {
-                            //Add a new entry in the temporary dictionary
-                            itr->numo = nextID;
-                            const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
-                                                   itr->leno + 2);
-                            tmpdict.insert(std::make_pair(newentry, nextID));
-                            nextID++;
-                        }
+                if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+                    //Is it existing in the tmp dict already?
+                    if (tmpdict.count(supportbuffer.get())) {
+                        auto itr2 = tmpdict.find(supportbuffer.get());
+                        itr->numo = itr2->second;
                     } else {
-                        itr->numo = UINT64_MAX;
-                        continue;
+                        //Add a new entry in the temporary dictionary
+                        itr->numo = nextID;
+                        const char *newentry = tmpdictsupport.addNew(supportbuffer.get(),
+                                               itr->leno + 2);
+                        tmpdict.insert(std::make_pair(newentry, nextID));
+                        nextID++;
                     }
+                } else {
+                    itr->numo = UINT64_MAX;
+                    continue;
                 }
-                previd = itr->numo;
             }
+            previd = itr->numo;
         }
+    }
 
-        for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
-            if (~itr->nums && ~itr->nump && ~itr->numo) {
-                Triple t;
-                t.s = itr->nums;
-                t.p = itr->nump;
-                t.o = itr->numo;
-                parsedtriples.push_back(t);
-            }
+    for (auto itr = triples.begin(); itr != triples.end(); ++itr) {
+        if (~itr->nums && ~itr->nump && ~itr->numo) {
+            Triple t;
+            t.s = itr->nums;
+            t.p = itr->nump;
+            t.o = itr->numo;
+            parsedtriples.push_back(t);
         }
     }
+}
 
+void Updater::filterUpdate(DiffIndex::TypeUpdate type,
+                           std::vector<Triple> &parsedtriples,
+                           std::vector<uint64_t> &all_s,
+                           std::vector<uint64_t> &all_p,
+                           std::vector<uint64_t> &all_o,
+                           Querier *q) {
     //Re-sort the numeric triples.
     std::sort(parsedtriples.begin(), parsedtriples.end(), Triple::sorter);
 
@@ -310,6 +312,21 @@ void Updater::compressUpdate(DiffIndex::TypeUpdate type,
 
     //Add triples that are either not existing (ADD) or existing (REMOVE) ...
     match(type, all_s, all_p, all_o, q, parsedtriples);
+}
+
+void Updater::compressUpdate(DiffIndex::TypeUpdate type,
+                             string updatedir,
+                             std::vector<uint64_t> &all_s,
+                             std::vector<uint64_t> &all_p,
+                             std::vector<uint64_t> &all_o,
+                             KB *kb,
+                             Querier *q,
+                             ByteArrayToNumberMap &tmpdict,
+                             StringCollection &tmpdictsupport) {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    std::vector<Triple> parsedtriples;
+    encodeUpdate(type, updatedir, kb, tmpdict, tmpdictsupport, parsedtriples);
+    filterUpdate(type, parsedtriples, all_s, all_p, all_o, q);
     std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
     LOG(DEBUGL) << "Runtime compressing and filtering the update = " << sec.count() * 1000;
 
@@ -368,20 +385,80 @@ void Updater::creatediffupdate(DiffIndex::TypeUpdate type, std::string kbdir,
     delete q;
 }
 
+void Updater::update(DiffIndex::TypeUpdate type, KB &kb, std::string updatedir) {
+    std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
+    std::vector<uint64_t> all_s;
+    std::vector<uint64_t> all_p;
+    std::vector<uint64_t> all_o;
+
+    //Set up a tmp dictionary
+    StringCollection tmpdictsupport(8 * 1024 * 1024);
+    ByteArrayToNumberMap tmpdict;
+    tmpdict.set_empty_key(EMPTY_KEY);
+    tmpdict.set_deleted_key(DELETED_KEY);
+
+    //The concurrent updates must not give different IDs to the same new
+    //term, so the terms are looked up and added with the updates locked
+    std::vector<Triple> parsedtriples;
+    {
+        std::unique_lock<std::mutex> lock = kb.lockUpdates();
+        encodeUpdate(type, updatedir, &kb, tmpdict, tmpdictsupport,
+                parsedtriples);
+        if (!tmpdict.empty()) {
+            std::vector<std::pair<uint64_t, std::string>> terms;
+            for (auto itr = tmpdict.begin(); itr != tmpdict.end(); ++itr) {
+                const char *term = itr->first;
+                terms.push_back(std::make_pair(itr->second,
+                            std::string(term + 2, Utils::decode_short(term))));
+            }
+            kb.addNewTerms(terms);
+        }
+    }
+
+    Querier *q = kb.query();
+    filterUpdate(type, parsedtriples, all_s, all_p, all_o, q);
+    delete q;
+
+    if (type == DiffIndex::TypeUpdate::ADDITION_df) {
+        kb.addTriples(all_s, all_p, all_o);
+    } else {
+        kb.removeTriples(all_s, all_p, all_o);
+    }
+    std::chrono::duration<double> sec = std::chrono::system_clock::now() - start;
+    LOG(INFOL) << "Runtime update " << sec.count() * 1000 << " ms.";
+}
+
 std::string Updater::getPathForUpdate(std::string kbdir) {
     std::string diffdir = kbdir + "/_diff";
     if (!Utils::exists(diffdir)) {
         return diffdir + "/0";
     } else {
-        //Read all files in the directory that starts with a number
-        int idx = 0;
-        std::string updir = diffdir + "/" + to_string(idx);
-        while (Utils::exists(updir)) {
-            idx++;
-            updir = diffdir + "/" + to_string(idx);
+        //The compaction of the diffs can leave holes in the numbering, so
+        //the new update goes after the largest existing one
+        int64_t idx = 0;
+        std::vector<std::string> children = Utils::getSubdirs(diffdir);
+        for (auto &child : children) {
+            int64_t seq, gen;
+            if (parseDiffName(Utils::filename(child), seq, gen)) {
+                idx = std::max(idx, seq + 1);
+            }
         }
-        return updir;
+        return diffdir + "/" + to_string(idx);
+    }
+}
+
+bool Updater::parseDiffName(std::string name, int64_t &seq, int64_t &gen) {
+    seq = gen = 0;
+    const size_t sep = name.find('-');
+    const string s = name.substr(0, sep);
+    const string g = sep == string::npos ? "0" : name.substr(sep + 1);
+    if (s.empty() || g.empty() || !std::all_of(s.begin(), s.end(), ::isdigit)
+            || !std::all_of(g.begin(), g.end(), ::isdigit)) {
+        return false;
     }
+    seq = std::stoll(s);
+    gen = std::stoll(g);
+    return true;
 }
 
 void Updater::match(DiffIndex::TypeUpdate type,
@@ -20,11 +20,13 @@
 #include <chrono>
 #include <thread>
 #include <regex>
+#include <exception>
 
 TridentServer::TridentServer(KB &kb, string htmlfiles, int nthreads) :
     kb(kb),
+    queriers(kb),
     dirhtmlfiles(htmlfiles),
-    isActive(false), nthreads(nthreads) {
+    activeRequests(0), nthreads(nthreads) {
 
     }
 
@@ -39,12 +41,14 @@ void TridentServer::start(int port) {
             std::placeholders::_2);
     server = std::shared_ptr<HttpServer>(new HttpServer(port,
                 f, nthreads));
+    server->setStreamHandler(std::bind(&TridentServer::processStreamRequest,
+                this, std::placeholders::_1, std::placeholders::_2));
     t = std::thread(&TridentServer::startThread, this, port);
 }
 
 void TridentServer::stop() {
     LOG(INFOL) << "Stopping server ...";
-    while (isActive) {
+    while (activeRequests > 0) {
         std::this_thread::sleep_for(chrono::milliseconds(100));
     }
     server->stop();
@@ -66,6 +70,41 @@ string _getValueParam(string req, string param) {
     }
 }
 
+string _getSPARQLQuery(string form) {
+    string sparqlquery = _getValueParam(form, "query");
+    sparqlquery = HttpClient::unescape(sparqlquery);
+    std::regex e1("\\+");
+    std::string replacedString;
+    std::regex_replace(std::back_inserter(replacedString),
+            sparqlquery.begin(), sparqlquery.end(),
+            e1, "$1 ");
+    sparqlquery = replacedString;
+    std::regex e2("\\r\\n");
+    replacedString = "";
+    std::regex_replace(std::back_inserter(replacedString),
+            sparqlquery.begin(), sparqlquery.end(), e2, "$1\n");
+    return replacedString;
+}
+
+//The format is set either with the parameter "format" or with the header
+//"Accept". JSON is the default
+ResultsWriter::Format _getResultsFormat(const string &req, const string &form) {
+    string format = _getValueParam(form, "format");
+    if (format != "") {
+        return ResultsWriter::getFormat(format);
+    }
+    size_t pos = req.find("Accept:");
+    if (pos != string::npos) {
+        string accept = req.substr(pos, req.find("\r\n", pos) - pos);
+        if (accept.find("text/tab-separated-values") != string::npos) {
+            return ResultsWriter::TSVFORMAT;
+        } else if (accept.find("text/csv") != string::npos) {
+            return ResultsWriter::CSVFORMAT;
+        }
+    }
+    return ResultsWriter::JSONFORMAT;
+}
+
 string TridentServer::lookup(string sId, TridentLayer &db) {
     const char *start;
     const char *end;
@@ -76,8 +115,69 @@ string TridentServer::lookup(string sId, TridentLayer &db) {
     return string(start, end - start);
 }
 
+bool TridentServer::processStreamRequest(const std::string &req,
+        HttpChunkedWriter &out) {
+    //Only the answers of /sparql are streamed. If print=false, then the
+    //response is small and it is built by processRequest
+    if (!Utils::starts_with(req, "POST")) {
+        return false;
+    }
+    int pos = req.find("HTTP");
+    string path = req.substr(5, pos - 6);
+    if (path != "/sparql") {
+        return false;
+    }
+    string form = req.substr(req.find("application/x-www-form-urlencoded"));
+    if (_getValueParam(form, "print") == string("false")) {
+        return false;
+    }
+
+    ActiveRequest active(*this);
+    ResultsWriter::Format format;
+    try {
+        format = _getResultsFormat(req, form);
+    } catch (int) {
+        return false;
+    }
+    string sparqlquery = _getSPARQLQuery(form);
+    out.begin(ResultsWriter::getContentType(format));
+    ResultsWriter writer(format, [&out](const char *data, size_t len) {
+            return out.write(data, len);
+            });
+    //The status line is already sent, so an error can only be reported in
+    //the body. The last chunk is not sent, so the client notices that the
+    //answer is incomplete
+    string error;
+    try {
+        TridentLayer db(kb, queriers);
+        SPARQLUtils::execSPARQLQuery(sparqlquery,
+                false,
+                db.getNTerms(),
+                db,
+                false,
+                false,
+                NULL,
+                NULL,
+                NULL,
+                &writer,
+                &plancache);
+    } catch (std::exception &e) {
+        error = e.what();
+    } catch (...) {
+        error = "the query failed";
+    }
+    if (error != "") {
+        LOG(ERRORL) << "Error while streaming the answers: " << error;
+        writer.fail(error);
+        out.abort();
+        return true;
+    }
+    out.end();
+    return true;
+}
+
 void TridentServer::processRequest(std::string req, std::string &res) {
-    setActive();
+    ActiveRequest active(*this);
     //Get the page
     string page;
     string message = "";
@@ -90,19 +190,7 @@ void TridentServer::processRequest(std::string req, std::string &res) {
             //Get the SPARQL query
             string form = req.substr(req.find("application/x-www-form-urlencoded"));
             string printresults = _getValueParam(form, "print");
-            string sparqlquery = _getValueParam(form, "query");
-            sparqlquery = HttpClient::unescape(sparqlquery);
-            std::regex e1("\\+");
-            std::string replacedString;
-            std::regex_replace(std::back_inserter(replacedString),
-                    sparqlquery.begin(), sparqlquery.end(),
-                    e1, "$1 ");
-            sparqlquery = replacedString;
-            std::regex e2("\\r\\n");
-            replacedString = "";
-            std::regex_replace(std::back_inserter(replacedString),
-                    sparqlquery.begin(), sparqlquery.end(), e2, "$1\n");
-            sparqlquery = replacedString;
+            string sparqlquery = _getSPARQLQuery(form);
 
             //Execute the SPARQL query
             JSON pt;
@@ -110,15 +198,18 @@ void TridentServer::processRequest(std::string req, std::string &res) {
             JSON bindings;
             JSON stats;
             bool jsonoutput = printresults != string("false");
+            TridentLayer db(kb, queriers);
             SPARQLUtils::execSPARQLQuery(sparqlquery,
                     false,
-                    kb.getNTerms(),
-                    kb,
+                    db.getNTerms(),
+                    db,
                     false,
                     jsonoutput,
                     &vars,
                     &bindings,
-                    &stats);
+                    &stats,
+                    NULL,
+                    &plancache);
             JSON head;
             head.add_child("vars", vars);
             pt.add_child("head", head);
@@ -135,7 +226,8 @@ void TridentServer::processRequest(std::string req, std::string &res) {
             string form = req.substr(req.find("application/x-www-form-urlencoded"));
             string id = _getValueParam(form, "id");
             //Lookup the value
-            string value = lookup(id, kb);
+            TridentLayer db(kb, queriers);
+            string value = lookup(id, db);
             JSON pt;
             pt.put("value", value);
             std::ostringstream buf;
@@ -172,8 +264,6 @@ void TridentServer::processRequest(std::string req, std::string &res) {
       shared_from_this(),
       boost::asio::placeholders::error,
       boost::asio::placeholders::bytes_transferred));*/
-
-    setInactive();
 }
 
 /*void TridentServer::Server::writeHandler(const boost::system::error_code &err,
@@ -187,6 +277,7 @@ string TridentServer::getDefaultPage() {
 }
 
 string TridentServer::getPage(string f) {
+    std::lock_guard<std::mutex> lock(cachehtmlMutex);
     if (cachehtml.count(f)) {
         return cachehtml.find(f)->second;
     }
@@ -645,3 +645,225 @@ void NestedJoinPlan::printInfo() {
         }
     }
 }
+
+static int _findSet(std::vector<int> &parents, int i) {
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+bool LeapfrogJoinPlan::isCyclic(const std::vector<Pattern *> &patterns) {
+    //The variables are the nodes of the graph and every pattern connects
+    //its variables. A pattern that connects two variables that are already
+    //connected closes a cycle
+    std::vector<string> names;
+    std::vector<int> parents;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        Pattern *p = patterns[i];
+        int first = -1;
+        for (int j = 0; j < p->getNVars(); ++j) {
+            string name = p->getVar(j);
+            int id = -1;
+            for (size_t m = 0; m < names.size(); ++m) {
+                if (names[m] == name) {
+                    id = m;
+                    break;
+                }
+            }
+            if (id == -1) {
+                id = names.size();
+                names.push_back(name);
+                parents.push_back(id);
+            }
+            if (first == -1) {
+                first = id;
+            } else {
+                int r1 = _findSet(parents, first);
+                int r2 = _findSet(parents, id);
+                if (r1 == r2) {
+                    return true;
+                }
+                parents[r2] = r1;
+            }
+        }
+    }
+    return false;
+}
+
+bool LeapfrogJoinPlan::isKeyAvailable(Querier *q, int pos) {
+    //Querier::getIterator can also read a permutation from the one that
+    //has the same key
+    switch (pos) {
+        case 0:
+            return q->isPresent(IDX_SPO) || q->isPresent(IDX_SOP);
+        case 1:
+            return q->isPresent(IDX_POS) || q->isPresent(IDX_PSO);
+        default:
+            return q->isPresent(IDX_OPS) || q->isPresent(IDX_OSP);
+    }
+}
+
+bool LeapfrogJoinPlan::isApplicable(Querier *q,
+        const std::vector<Pattern *> &patterns) {
+    if (patterns.size() < 2) {
+        return false;
+    }
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        Pattern *p = patterns[i];
+        if (p->getNVars() < 1 || p->getNVars() > 2 ||
+                !p->getRepeatedVars().empty()) {
+            return false;
+        }
+        std::vector<int> *pv = p->getPosVars();
+        bool ok = false;
+        for (int pos = 0; pos < 3 && !ok; ++pos) {
+            if (std::find(pv->begin(), pv->end(), pos) == pv->end()) {
+                ok = isKeyAvailable(q, pos);
+            }
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int LeapfrogJoinPlan::findPermutation(Querier *q, std::vector<int> &consts,
+        std::vector<int> &vars) {
+    //Prefer the permutations that are stored
+    for (int round = 0; round < 2; ++round) {
+        for (int idx = 0; idx < 6; ++idx) {
+            int *order = q->getOrder(idx);
+            bool ok = true;
+            for (size_t i = 0; i < consts.size() && ok; ++i) {
+                ok = std::find(consts.begin(), consts.end(), order[i]) !=
+                    consts.end();
+            }
+            for (size_t i = 0; i < vars.size() && ok; ++i) {
+                ok = order[consts.size() + i] == vars[i];
+            }
+            if (!ok) {
+                continue;
+            }
+            if (round == 0 && q->isPresent(idx)) {
+                return idx;
+            } else if (round == 1 && isKeyAvailable(q, order[0])) {
+                return idx;
+            }
+        }
+    }
+    return -1;
+}
+
+void LeapfrogJoinPlan::prepare(Querier *q, std::vector<Pattern *> patterns,
+        std::vector<string> projections) {
+    //Estimate the cardinality of every pattern
+    std::vector<int64_t> cards;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        Pattern *p = patterns[i];
+        cards.push_back(q->estCard(p->subject() < 0 ? -1 : p->subject(),
+                    p->predicate() < 0 ? -1 : p->predicate(),
+                    p->object() < 0 ? -1 : p->object()));
+    }
+
+    //Global order of the variables. The first is the one that appears in
+    //most patterns (ties are broken by the smallest pattern). Then we pick
+    //the variables that are connected to the ones already chosen, so that
+    //every level can be intersected with the previous ones
+    std::vector<string> allVars;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        patterns[i]->addVarsTo(allVars);
+    }
+    while (vars.size() < allVars.size()) {
+        int best = -1;
+        bool bestConnected = false;
+        int bestCount = 0;
+        int64_t bestCard = 0;
+        for (size_t v = 0; v < allVars.size(); ++v) {
+            if (std::find(vars.begin(), vars.end(), allVars[v]) != vars.end()) {
+                continue;
+            }
+            bool connected = false;
+            int count = 0;
+            int64_t card = INT64_MAX;
+            for (size_t i = 0; i < patterns.size(); ++i) {
+                if (!patterns[i]->containsVar(allVars[v])) {
+                    continue;
+                }
+                count++;
+                card = std::min(card, cards[i]);
+                if (patterns[i]->joinsWith(vars) > 0) {
+                    connected = true;
+                }
+            }
+            if (best == -1 || (connected && !bestConnected) ||
+                    (connected == bestConnected && (count > bestCount ||
+                        (count == bestCount && card < bestCard)))) {
+                best = v;
+                bestConnected = connected;
+                bestCount = count;
+                bestCard = card;
+            }
+        }
+        vars.push_back(allVars[best]);
+    }
+    atomsPerLevel.resize(vars.size());
+
+    //Pick for every pattern the permutation that follows the global order
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        Pattern *p = patterns[i];
+        LeapfrogAtom atom;
+        atom.s = p->subject() < 0 ? -1 : p->subject();
+        atom.p = p->predicate() < 0 ? -1 : p->predicate();
+        atom.o = p->object() < 0 ? -1 : p->object();
+
+        std::vector<std::pair<int, int>> levelsVars;
+        for (int j = 0; j < p->getNVars(); ++j) {
+            int level = std::find(vars.begin(), vars.end(), p->getVar(j)) -
+                vars.begin();
+            levelsVars.push_back(std::make_pair(level, p->posVar(j)));
+        }
+        std::sort(levelsVars.begin(), levelsVars.end());
+        std::vector<int> posConsts, posVars;
+        std::vector<int> *pv = p->getPosVars();
+        for (int pos = 0; pos < 3; ++pos) {
+            if (std::find(pv->begin(), pv->end(), pos) == pv->end()) {
+                posConsts.push_back(pos);
+            }
+        }
+        atom.nvars = levelsVars.size();
+        for (int j = 0; j < atom.nvars; ++j) {
+            posVars.push_back(levelsVars[j].second);
+            atom.levels[j] = levelsVars[j].first;
+            atomsPerLevel[levelsVars[j].first].push_back(i);
+        }
+        atom.nconsts = posConsts.size();
+
+        atom.idx = findPermutation(q, posConsts, posVars);
+        if (atom.idx == -1) {
+            LOG(ERRORL) << "No permutation can be used for the pattern " <<
+                p->toString();
+            throw 10;
+        }
+        atom.secondConst = -1;
+        if (atom.nconsts == 2) {
+            int pos = q->getOrder(atom.idx)[1];
+            atom.secondConst = pos == 0 ? atom.s : (pos == 1 ? atom.p : atom.o);
+        }
+        LOG(DEBUGL) << "Leapfrog: pattern " << p->toString() << " uses index "
+            << atom.idx;
+        atoms.push_back(atom);
+    }
+
+    //Variables to return
+    for (size_t i = 0; i < projections.size(); ++i) {
+        for (size_t j = 0; j < vars.size(); ++j) {
+            if (projections[i] == vars[j]) {
+                posVarsToReturn.push_back(j);
+                break;
+            }
+        }
+    }
+}
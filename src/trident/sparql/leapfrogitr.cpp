@@ -0,0 +1,236 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+**/
+
+
+#include <trident/sparql/joins.h>
+
+#include <algorithm>
+
+bool LeapfrogTrieItr::fetch(Level &l) {
+    if (!l.itr->hasNext()) {
+        l.itrEnd = true;
+        return false;
+    }
+    l.itr->next();
+    l.v1 = l.itr->getValue1();
+    l.v2 = l.itr->getValue2();
+    return true;
+}
+
+void LeapfrogTrieItr::seekPair(Level &l, const int64_t c1, const int64_t c2) {
+    //(c1, c2) is always after the last pair read, so moveto only moves
+    //forward
+    l.itr->moveto(c1, c2);
+    fetch(l);
+}
+
+void LeapfrogTrieItr::open() {
+    depth++;
+    Level &l = levels[depth];
+    int64_t t[3] = { atom->s, atom->p, atom->o };
+    if (depth == 1) {
+        t[q->getOrder(atom->idx)[1]] = levels[0].key;
+    }
+    l.itr = q->getIterator(atom->idx, t[0], t[1], t[2]);
+    l.itrEnd = false;
+    fetch(l);
+    if (getPos() == 1) {
+        l.atEnd = l.itrEnd;
+        l.key = l.v1;
+    } else {
+        const int64_t group = getGroup();
+        if (!l.itrEnd && l.v1 < group) {
+            seekPair(l, group, 0);
+        }
+        l.atEnd = l.itrEnd || l.v1 != group;
+        l.key = l.v2;
+    }
+}
+
+void LeapfrogTrieItr::up() {
+    q->releaseItr(levels[depth].itr);
+    levels[depth].itr = NULL;
+    depth--;
+}
+
+void LeapfrogTrieItr::next() {
+    Level &l = levels[depth];
+    if (getPos() == 1) {
+        seek(l.key + 1);
+    } else {
+        l.atEnd = !fetch(l) || l.v1 != getGroup();
+        l.key = l.v2;
+    }
+}
+
+void LeapfrogTrieItr::seek(const int64_t key) {
+    Level &l = levels[depth];
+    if (l.atEnd) {
+        return;
+    }
+    if (getPos() == 1) {
+        if (l.v1 < key) {
+            seekPair(l, key, 0);
+        }
+        l.atEnd = l.itrEnd;
+        l.key = l.v1;
+    } else {
+        const int64_t group = getGroup();
+        if (l.v2 < key) {
+            seekPair(l, group, key);
+            l.atEnd = l.itrEnd || l.v1 != group;
+        }
+        l.key = l.v2;
+    }
+}
+
+LeapfrogTrieItr::~LeapfrogTrieItr() {
+    for (int i = 0; i < 2; ++i) {
+        if (levels[i].itr != NULL) {
+            q->releaseItr(levels[i].itr);
+        }
+    }
+}
+
+LeapfrogJoinItr::LeapfrogJoinItr(Querier *q,
+        std::shared_ptr<LeapfrogJoinPlan> plan) : plan(plan), depth(0),
+    started(false), finished(false), computed(false), hasMore(false) {
+        for (size_t i = 0; i < plan->atoms.size(); ++i) {
+            tries.push_back(std::unique_ptr<LeapfrogTrieItr>(
+                        new LeapfrogTrieItr(q, &plan->atoms[i])));
+        }
+        levels.resize(plan->vars.size());
+        for (size_t l = 0; l < plan->vars.size(); ++l) {
+            for (auto idx : plan->atomsPerLevel[l]) {
+                levels[l].push_back(tries[idx].get());
+            }
+        }
+        p.resize(levels.size());
+        row.resize(levels.size());
+    }
+
+bool LeapfrogJoinItr::leapfrogInit(const int level) {
+    std::vector<LeapfrogTrieItr*> &l = levels[level];
+    for (auto t : l) {
+        t->open();
+    }
+    for (auto t : l) {
+        if (t->isAtEnd()) {
+            return false;
+        }
+    }
+    std::sort(l.begin(), l.end(), [](const LeapfrogTrieItr *t1,
+                const LeapfrogTrieItr *t2) {
+            return t1->key() < t2->key();
+            });
+    p[level] = 0;
+    return leapfrogSearch(level);
+}
+
+bool LeapfrogJoinItr::leapfrogSearch(const int level) {
+    std::vector<LeapfrogTrieItr*> &l = levels[level];
+    const size_t k = l.size();
+    size_t pos = p[level];
+    int64_t maxKey = l[(pos + k - 1) % k]->key();
+    while (true) {
+        LeapfrogTrieItr *t = l[pos];
+        if (t->key() == maxKey) {
+            //All the tries are on the same key
+            p[level] = pos;
+            row[level] = maxKey;
+            return true;
+        }
+        t->seek(maxKey);
+        if (t->isAtEnd()) {
+            p[level] = pos;
+            return false;
+        }
+        maxKey = t->key();
+        pos = (pos + 1) % k;
+    }
+}
+
+bool LeapfrogJoinItr::leapfrogNext(const int level) {
+    std::vector<LeapfrogTrieItr*> &l = levels[level];
+    LeapfrogTrieItr *t = l[p[level]];
+    t->next();
+    if (t->isAtEnd()) {
+        return false;
+    }
+    p[level] = (p[level] + 1) % l.size();
+    return leapfrogSearch(level);
+}
+
+bool LeapfrogJoinItr::computeNext() {
+    if (finished) {
+        return false;
+    }
+    const int nlevels = levels.size();
+    bool ok;
+    if (!started) {
+        started = true;
+        depth = 0;
+        ok = leapfrogInit(0);
+    } else {
+        //Continue from the last binding that was returned
+        ok = leapfrogNext(depth);
+    }
+    while (true) {
+        if (ok) {
+            if (depth == nlevels - 1) {
+                return true;
+            }
+            depth++;
+            ok = leapfrogInit(depth);
+        } else {
+            for (auto t : levels[depth]) {
+                t->up();
+            }
+            depth--;
+            if (depth < 0) {
+                finished = true;
+                return false;
+            }
+            ok = leapfrogNext(depth);
+        }
+    }
+}
+
+bool LeapfrogJoinItr::hasNext() {
+    if (!computed) {
+        hasMore = computeNext();
+        computed = true;
+    }
+    return hasMore;
+}
+
+void LeapfrogJoinItr::next() {
+    hasNext();
+    computed = false;
+}
+
+size_t LeapfrogJoinItr::getTupleSize() {
+    return plan->posVarsToReturn.size();
+}
+
+uint64_t LeapfrogJoinItr::getElementAt(const int pos) {
+    return row[plan->posVarsToReturn[pos]];
+}
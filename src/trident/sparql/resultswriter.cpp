@@ -0,0 +1,269 @@
+/*
+ * Copyright 2017 Jacopo Urbani
+ *
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ **/
+
+#include <trident/sparql/resultswriter.h>
+
+#include <kognac/logs.h>
+
+#include <cstdio>
+
+//Split a term printed as in N-Triples in its value and its kind
+//("uri", "literal" or "bnode"). The datatype or the language of literals
+//are returned in suffix (with the "^^" or "@")
+static void splitTerm(const std::string &term, std::string &kind,
+        std::string &value, std::string &suffix) {
+    suffix = "";
+    if (term.size() >= 2 && term[0] == '<' && term[term.size() - 1] == '>') {
+        kind = "uri";
+        value = term.substr(1, term.size() - 2);
+    } else if (term.size() >= 2 && term[0] == '_' && term[1] == ':') {
+        kind = "bnode";
+        value = term.substr(2);
+    } else {
+        kind = "literal";
+        size_t end = term.rfind('"');
+        if (term.size() >= 2 && term[0] == '"' && end > 0) {
+            value = term.substr(1, end - 1);
+            suffix = term.substr(end + 1);
+        } else {
+            value = term;
+        }
+    }
+}
+
+ResultsWriter::ResultsWriter(Format format,
+        std::function<bool(const char*, size_t)> sink) : format(format),
+    sink(sink), currentColumn(0), emptyRow(true), nrows(0), failed(false) {
+        buffer.reserve(RESULTSWRITER_BUFFER + 4096);
+    }
+
+ResultsWriter::Format ResultsWriter::getFormat(std::string name) {
+    if (name == "" || name == "json" ||
+            name == "application/sparql-results+json" ||
+            name == "application/json") {
+        return JSONFORMAT;
+    } else if (name == "tsv" || name == "text/tab-separated-values") {
+        return TSVFORMAT;
+    } else if (name == "csv" || name == "text/csv") {
+        return CSVFORMAT;
+    }
+    LOG(ERRORL) << "Result format " << name << " is not supported";
+    throw 10;
+}
+
+std::string ResultsWriter::getContentType(Format format) {
+    switch (format) {
+        case TSVFORMAT:
+            return "text/tab-separated-values; charset=utf-8";
+        case CSVFORMAT:
+            return "text/csv; charset=utf-8";
+        default:
+            return "application/sparql-results+json";
+    }
+}
+
+void ResultsWriter::flush() {
+    if (!buffer.empty() && !failed) {
+        failed = !sink(buffer.c_str(), buffer.size());
+    }
+    buffer.clear();
+}
+
+void ResultsWriter::appendJSONString(const std::string &s) {
+    buffer += '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            buffer += '\\';
+            buffer += c;
+        } else if ((unsigned char) c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", (int) c);
+            buffer += code;
+        } else {
+            buffer += c;
+        }
+    }
+    buffer += '"';
+}
+
+void ResultsWriter::appendCSVField(const std::string &s) {
+    if (s.find_first_of(",\"\r\n") == std::string::npos) {
+        buffer += s;
+        return;
+    }
+    buffer += '"';
+    for (char c : s) {
+        if (c == '"') {
+            buffer += '"';
+        }
+        buffer += c;
+    }
+    buffer += '"';
+}
+
+void ResultsWriter::begin(const std::vector<std::string> &vars) {
+    this->vars = vars;
+    switch (format) {
+        case JSONFORMAT:
+            buffer += "{\"head\":{\"vars\":[";
+            for (size_t i = 0; i < vars.size(); ++i) {
+                if (i > 0) {
+                    buffer += ',';
+                }
+                appendJSONString(vars[i]);
+            }
+            buffer += "]},\"results\":{\"bindings\":[";
+            break;
+        case TSVFORMAT:
+            for (size_t i = 0; i < vars.size(); ++i) {
+                if (i > 0) {
+                    buffer += '\t';
+                }
+                buffer += '?';
+                buffer += vars[i];
+            }
+            buffer += '\n';
+            break;
+        case CSVFORMAT:
+            for (size_t i = 0; i < vars.size(); ++i) {
+                if (i > 0) {
+                    buffer += ',';
+                }
+                appendCSVField(vars[i]);
+            }
+            buffer += "\r\n";
+            break;
+    }
+}
+
+void ResultsWriter::addTerm(const std::string &term) {
+    if (currentColumn >= vars.size()) {
+        LOG(ERRORL) << "The row has more terms than variables";
+        throw 10;
+    }
+    std::string kind, value, suffix;
+    switch (format) {
+        case JSONFORMAT:
+            buffer += emptyRow ? (nrows > 0 ? ",{" : "{") : ",";
+            appendJSONString(vars[currentColumn]);
+            buffer += ":{\"type\":\"";
+            splitTerm(term, kind, value, suffix);
+            buffer += kind;
+            buffer += "\",\"value\":";
+            appendJSONString(value);
+            if (suffix.size() > 2 && suffix[0] == '^' && suffix[1] == '^') {
+                buffer += ",\"datatype\":";
+                std::string datatype = suffix.substr(2);
+                if (datatype.size() >= 2 && datatype[0] == '<') {
+                    datatype = datatype.substr(1, datatype.size() - 2);
+                }
+                appendJSONString(datatype);
+            } else if (suffix.size() > 1 && suffix[0] == '@') {
+                buffer += ",\"xml:lang\":";
+                appendJSONString(suffix.substr(1));
+            }
+            buffer += '}';
+            break;
+        case TSVFORMAT:
+            if (currentColumn > 0) {
+                buffer += '\t';
+            }
+            for (char c : term) {
+                if (c == '\t') {
+                    buffer += "\\t";
+                } else if (c == '\n') {
+                    buffer += "\\n";
+                } else if (c == '\r') {
+                    buffer += "\\r";
+                } else {
+                    buffer += c;
+                }
+            }
+            break;
+        case CSVFORMAT:
+            if (currentColumn > 0) {
+                buffer += ',';
+            }
+            splitTerm(term, kind, value, suffix);
+            if (kind == "bnode") {
+                value = "_:" + value;
+            }
+            appendCSVField(value);
+            break;
+    }
+    emptyRow = false;
+    currentColumn++;
+}
+
+void ResultsWriter::addUnbound() {
+    //JSON omits the unbound variables, TSV and CSV leave the field empty
+    if (format != JSONFORMAT && currentColumn > 0) {
+        buffer += format == TSVFORMAT ? '\t' : ',';
+    }
+    currentColumn++;
+}
+
+void ResultsWriter::endRow() {
+    switch (format) {
+        case JSONFORMAT:
+            buffer += emptyRow ? (nrows > 0 ? ",{}" : "{}") : "}";
+            break;
+        case TSVFORMAT:
+            buffer += '\n';
+            break;
+        case CSVFORMAT:
+            buffer += "\r\n";
+            break;
+    }
+    currentColumn = 0;
+    emptyRow = true;
+    nrows++;
+    if (buffer.size() >= RESULTSWRITER_BUFFER) {
+        flush();
+    }
+}
+
+void ResultsWriter::addStat(const std::string &name,
+        const std::string &value) {
+    stats.push_back(std::make_pair(name, value));
+}
+
+void ResultsWriter::end(double runtime) {
+    if (format == JSONFORMAT) {
+        buffer += "]},\"stats\":{\"runtime\":";
+        appendJSONString(std::to_string(runtime));
+        buffer += ",\"nresults\":";
+        appendJSONString(std::to_string(nrows));
+        for (auto &s : stats) {
+            buffer += ",";
+            appendJSONString(s.first);
+            buffer += ":";
+            appendJSONString(s.second);
+        }
+        buffer += "}}";
+    }
+    flush();
+}
+
+void ResultsWriter::fail(const std::string &message) {
+    buffer += "\nERROR: " + message + "\n";
+    flush();
+}
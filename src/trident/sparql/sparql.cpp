@@ -9,6 +9,8 @@
 #include <rts/operator/PlanPrinter.hpp>
 #include <rts/operator/ResultsPrinter.hpp>
 
+#include <cstdlib>
+
 void SPARQLUtils::parseQuery(bool &success,
         SPARQLParser &parser,
         std::unique_ptr<QueryGraph> &queryGraph,
@@ -52,7 +54,9 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
         bool jsonoutput,
         JSON *jsonvars,
         JSON *jsonresults,
-        JSON *jsonstats) {
+        JSON *jsonstats,
+        ResultsWriter *writer,
+        PlanCache *plancache) {
     std::unique_ptr<QueryDict> queryDict = std::unique_ptr<QueryDict>(
             new QueryDict(nterms));
     std::unique_ptr<QueryGraph> queryGraph;
@@ -65,6 +69,10 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
     std::chrono::system_clock::time_point start = std::chrono::system_clock::now();
     parseQuery(parsingOk, *parser.get(), queryGraph, *queryDict.get(), db);
     if (!parsingOk) {
+        if (writer) {
+            writer->begin(std::vector<string>());
+            writer->end(0);
+        }
         std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
         LOG(INFOL) << "Runtime query: 0ms.";
         LOG(INFOL) << "Runtime total: " << duration.count() * 1000 << "ms.";
@@ -73,33 +81,89 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
     }
 
     std::vector<string> jsonnamevars;
-    if (jsonvars) {
+    if (jsonvars || writer) {
         //Copy the output of the query in the json vars
         for (QueryGraph::projection_iterator itr = queryGraph->projectionBegin();
                 itr != queryGraph->projectionEnd(); ++itr) {
             string namevar = parser->getVariableName(*itr);
-            jsonvars->push_back(namevar);
+            if (jsonvars)
+                jsonvars->push_back(namevar);
             jsonnamevars.push_back(namevar);
         }
     }
 
-    // Run the optimizer
-    PlanGen *plangen = new PlanGen();
-    Plan* plan = plangen->translate(db, *queryGraph.get(), false);
-    // delete plangen;  Commented out, because this also deletes all plans!
-    // In particular, it corrupts the current plan.
-    // --Ceriel
+    // Run the optimizer, unless the plan of a query with the same shape is
+    // in the cache. In that case, the cached plan is bound to the constants
+    // of this query
+    std::string plankey;
+    PlanContainer cachedPlans;
+    PlanGen *plangen = NULL;
+    Plan* plan = NULL;
+    if (plancache) {
+        plankey = PlanCache::getKey(*queryGraph.get());
+        if (!plankey.empty()) {
+            plan = plancache->lookup(plankey, *queryGraph.get(), cachedPlans);
+        }
+    }
     if (!plan) {
-        cerr << "internal error plan generation failed" << endl;
-        delete plangen;
-        return;
+        plangen = new PlanGen();
+        plan = plangen->translate(db, *queryGraph.get(), false);
+        // delete plangen;  Commented out, because this also deletes all plans!
+        // In particular, it corrupts the current plan.
+        // --Ceriel
+        if (!plan) {
+            cerr << "internal error plan generation failed" << endl;
+            if (writer) {
+                writer->begin(jsonnamevars);
+                writer->end(0);
+            }
+            delete plangen;
+            return;
+        }
+    }
+    if (plancache) {
+        const string hits = to_string(plancache->getHits());
+        const string misses = to_string(plancache->getMisses());
+        if (jsonstats) {
+            jsonstats->put("plancache_hits", hits);
+            jsonstats->put("plancache_misses", misses);
+        }
+        if (writer) {
+            writer->addStat("plancache_hits", hits);
+            writer->addStat("plancache_misses", misses);
+        }
     }
     if (explain)
         plan->print(0);
 
+    // Layers of the threads that can execute the query in parallel. Like
+    // the scheduler of rdf3x, the number of threads is set with MAXTHREADS.
+    // They must outlive the operator tree
+    std::vector<std::unique_ptr<TridentLayer>> workerLayers;
+    std::vector<DBLayer*> workers;
+#ifdef MT
+    const int nworkers = getenv("MAXTHREADS") ? atoi(getenv("MAXTHREADS")) : 0;
+#else
+    //The workers read the KB in parallel, which requires MT
+    const int nworkers = 0;
+#endif
+    for (int i = 0; nworkers > 1 && i < nworkers; ++i) {
+        if (db.getPool()) {
+            workerLayers.push_back(std::unique_ptr<TridentLayer>(
+                        new TridentLayer(*db.getKB(), *db.getPool())));
+        } else {
+            workerLayers.push_back(std::unique_ptr<TridentLayer>(
+                        new TridentLayer(*db.getKB())));
+        }
+        workers.push_back(workerLayers.back().get());
+    }
+
     // Build a physical plan
     Runtime runtime(db, NULL, queryDict.get());
-    Operator* operatorTree = CodeGen().translate(runtime, *queryGraph.get(), plan, false);
+    //The operators outside of the morsels (e.g., the hash joins) can also
+    //use the threads
+    runtime.setThreads(nworkers > 1 ? nworkers : 1);
+    Operator* operatorTree = CodeGen().translate(runtime, *queryGraph.get(), plan, workers, false);
 
     // Execute it
     if (explain) {
@@ -114,7 +178,10 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
         //set up output options for the last operators
         ResultsPrinter *p = (ResultsPrinter*) operatorTree;
         p->setSilent(!printstdout);
-        if (jsonoutput) {
+        if (writer) {
+            p->setStreamOutput(writer);
+            writer->begin(jsonnamevars);
+        } else if (jsonoutput) {
             p->setJSONOutput(jsonresults, jsonnamevars);
         }
 
@@ -126,6 +193,9 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
         std::chrono::duration<double> duration = std::chrono::system_clock::now() - start;
         LOG(INFOL) << "Runtime query: " << durationQ.count() * 1000 << "ms.";
         LOG(INFOL) << "Runtime total: " << duration.count() * 1000 << "ms.";
+        if (writer) {
+            writer->end(durationQ.count());
+        }
         if (jsonstats) {
             jsonstats->put("runtime", to_string(durationQ.count()));
             jsonstats->put("nresults", to_string(p->getPrintedRows()));
@@ -137,6 +207,11 @@ void SPARQLUtils::execSPARQLQuery(string sparqlquery,
         }
         delete operatorTree;
     }
+    // The generated plan is not used anymore by this query and can be
+    // cached with its query graph
+    if (plangen && !plankey.empty() && PlanCache::isCacheable(plan)) {
+        plancache->insert(plankey, queryGraph, plangen, plan);
+    }
     delete plangen;
 }
 
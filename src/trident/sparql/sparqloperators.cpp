@@ -150,6 +150,43 @@ void TridentHashJoin::print(int indent) {
     }
 }
 
+LeapfrogJoin::LeapfrogJoin(Querier *q,
+                           std::vector<std::shared_ptr<SPARQLOperator>> children,
+                           std::vector<string> &projections) : Join(children) {
+    this->q = q;
+    std::vector<Pattern *> listPatterns;
+    for (int i = 0; i < children.size(); ++i) {
+        listPatterns.push_back(
+            std::static_pointer_cast<Scan>(children[i])->getPattern());
+    }
+
+    leapfrogPlan = std::shared_ptr<LeapfrogJoinPlan>(new LeapfrogJoinPlan());
+    if (projections.empty()) {
+        leapfrogPlan->prepare(q, listPatterns, getTupleFieldsIDs());
+    } else {
+        leapfrogPlan->prepare(q, listPatterns, projections);
+    }
+}
+
+TupleIterator *LeapfrogJoin::getIterator() {
+    return new LeapfrogJoinItr(q, leapfrogPlan);
+}
+
+void LeapfrogJoin::releaseIterator(TupleIterator *itr) {
+    delete itr;
+}
+
+void LeapfrogJoin::print(int indent) {
+    for (int i = 0; i < indent; ++i)
+        cerr << ' ';
+
+    LOG(DEBUGL) << "LEAPFROGJOIN";
+
+    for (int i = 0; i < children.size(); ++i) {
+        children[i]->print(indent + 1);
+    }
+}
+
 Scan::Scan(Pattern *p) {
     for (int i = 0; i < p->getNVars(); ++i)
         fields.push_back(p->getVar(i));
@@ -201,6 +238,25 @@ TupleIterator *KBScan::getIterator() {
     return itr;
 }
 
+TupleIterator *KBScan::getIterator(std::vector<uint8_t> &positions,
+                                   std::vector<uint64_t> &values) {
+    TupleKBItr *itr = new TupleKBItr();
+    itr->init(q, &t, NULL, true);
+    //The values are sorted by the first join position, which is the only one
+    //used to build the filter
+    const size_t njoins = positions.size();
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < values.size(); i += njoins) {
+        if (keys.empty() || keys.back() != values[i]) {
+            keys.push_back(values[i]);
+        }
+    }
+    std::unique_ptr<JoinFilter> filter(new JoinFilter());
+    filter->build(keys);
+    itr->setJoinFilter(std::move(filter), positions[0]);
+    return itr;
+}
+
 TupleIterator *KBScan::getSampleIterator() {
     Querier &sampleQuerier = q->getSampler();
     TupleKBItr *itr = new TupleKBItr();
@@ -28,7 +28,18 @@ void TridentQueryPlan::create(Query &query, int typePlanning) {
         root = std::unique_ptr<SPARQLOperator>(new KBScan(q, query.getPatterns()[0]));
     } else {
         const std::vector<Pattern*> queryPatterns = query.getPatterns();
-        if (typePlanning == SIMPLE) {
+        if ((typePlanning == LEAPFROG || (typePlanning == SIMPLE &&
+                        LeapfrogJoinPlan::isCyclic(queryPatterns))) &&
+                LeapfrogJoinPlan::isApplicable(q, queryPatterns)) {
+            //Multi-way join, which does not materialize the pairwise joins
+            std::vector<std::shared_ptr<SPARQLOperator>> patterns;
+            for (int i = 0; i < query.npatterns(); ++i) {
+                patterns.push_back(std::shared_ptr<SPARQLOperator>(
+                                       new KBScan(q, queryPatterns[i])));
+            }
+            std::vector<string> projections = query.getProjections();
+            root = std::unique_ptr<SPARQLOperator>(new LeapfrogJoin(q, patterns, projections));
+        } else if (typePlanning == SIMPLE || typePlanning == LEAPFROG) {
             std::vector<std::shared_ptr<SPARQLOperator>> patterns;
 
             for (int i = 0; i < query.npatterns(); ++i) {
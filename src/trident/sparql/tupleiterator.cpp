@@ -24,6 +24,8 @@
 #include <trident/sparql/sparqloperators.h>
 #include <trident/kb/querier.h>
 
+#include <algorithm>
+
 TupleKBItr::TupleKBItr() {}
 
 void TupleKBItr::init(Querier *querier, const Tuple *t,
@@ -76,6 +78,12 @@ void TupleKBItr::init(Querier *querier, const Tuple *t,
             o = -1;
     }
     invPerm = querier->getInvOrder(idx);
+    constantKey = false;
+    for (uint8_t j = 0; j < 3; ++j) {
+        if (invPerm[j] == 0) {
+            constantKey = !t->get(j).isVariable();
+        }
+    }
 
     if (onlyVars) {
         int idx = 0;
@@ -94,6 +102,13 @@ void TupleKBItr::init(Querier *querier, const Tuple *t,
     nextProcessed = false;
     nextOutcome = false;
     processedValues = 0;
+    if (!batchValues1) {
+        batchValues1 = std::unique_ptr<int64_t[]>(
+                new int64_t[PAIRITR_BATCH_SIZE]);
+        batchValues2 = std::unique_ptr<int64_t[]>(
+                new int64_t[PAIRITR_BATCH_SIZE]);
+    }
+    batchSize = batchPos = 0;
 
     //If some variables have the same name, then we must change it
     equalFields = t->getRepeatedVars();
@@ -113,23 +128,84 @@ bool TupleKBItr::checkFields() {
     return true;
 }
 
+void TupleKBItr::setJoinFilter(std::unique_ptr<JoinFilter> filter,
+        const uint8_t pos) {
+    joinFilter = std::move(filter);
+    joinFilterPos = (uint8_t) invPerm[pos];
+}
+
+bool TupleKBItr::skipFiltered() {
+    while (true) {
+        int64_t value;
+        switch (joinFilterPos) {
+            case 0:
+                value = physIterator->getKey();
+                break;
+            case 1:
+                value = batchValues1[batchPos];
+                break;
+            default:
+                value = batchValues2[batchPos];
+        }
+        if (joinFilter->couldQualify(value)) {
+            return true;
+        }
+        if (joinFilterPos == 0) {
+            //All pairs of a batch have the same key
+            if (constantKey) {
+                return false;
+            }
+            batchPos = batchSize - 1;
+        } else if (joinFilterPos == 1) {
+            //The first column is sorted, so I can jump to the next candidate
+            const uint64_t candidate = joinFilter->nextCandidate(value);
+            if (!(~candidate)) {
+                if (constantKey) {
+                    return false;
+                }
+            } else if (candidate > (uint64_t) value) {
+                int64_t *begin = batchValues1.get() + batchPos;
+                int64_t *end = batchValues1.get() + batchSize;
+                int64_t *pos = std::lower_bound(begin, end, (int64_t) candidate);
+                if (pos != end) {
+                    batchPos = pos - batchValues1.get();
+                    continue;
+                }
+                if (constantKey) {
+                    //Skip the following pairs without reading them
+                    physIterator->moveto(candidate, 0);
+                    batchSize = batchPos = 0;
+                }
+            }
+        }
+        if (!advance()) {
+            return false;
+        }
+    }
+}
+
+bool TupleKBItr::advance() {
+    if (++batchPos < batchSize) {
+        return true;
+    }
+    batchPos = 0;
+    batchSize = physIterator->nextBatch(batchValues1.get(),
+            batchValues2.get(), PAIRITR_BATCH_SIZE);
+    return batchSize > 0;
+}
+
 bool TupleKBItr::hasNext() {
     if (!nextProcessed) {
-        if (physIterator->hasNext()) {
-            physIterator->next();
-            nextOutcome = true;
-            if (equalFields.size() > 0) {
-                while (!checkFields()) {
-                    if (!physIterator->hasNext()) {
-                        nextOutcome = false;
-                        break;
-                    } else {
-                        physIterator->next();
-                    }
-                }
+        nextOutcome = advance();
+        while (nextOutcome) {
+            if (joinFilter && !skipFiltered()) {
+                nextOutcome = false;
+                break;
+            }
+            if (equalFields.size() == 0 || checkFields()) {
+                break;
             }
-        } else {
-            nextOutcome = false;
+            nextOutcome = advance();
         }
         nextProcessed = true;
     }
@@ -140,7 +216,7 @@ void TupleKBItr::next() {
     if (nextProcessed) {
         nextProcessed = false;
     } else {
-        physIterator->next();
+        advance();
     }
 }
 
@@ -155,9 +231,9 @@ uint64_t TupleKBItr::getElementAt(const int p) {
     case 0:
         return physIterator->getKey();
     case 1:
-        return physIterator->getValue1();
+        return batchValues1[batchPos];
     case 2:
-        return physIterator->getValue2();
+        return batchValues2[batchPos];
     }
     LOG(ERRORL) << "This should not happen";
     throw 10;
@@ -24,6 +24,12 @@
 #include <trident/kb/kb.h>
 #include <trident/kb/querier.h>
 
+#include <kognac/logs.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
 TridentTimings::TridentTimings(string inputfile, string filequeries) :
     Timings(filequeries), q(NULL), inputfile(inputfile) {}
 
@@ -77,3 +83,97 @@ std::chrono::duration<double> TridentTimings::launchQuery(
     q->releaseItr(itr);
     return dur;
 }
+
+void TridentTimings::launchMovetoTests(string filequeries) {
+    const size_t gaps[] = {1, 4, 16, 64, 256, 1024, 4096};
+    const int ngaps = sizeof(gaps) / sizeof(size_t);
+    std::chrono::duration<double> durations[ngaps];
+    int64_t nmoves[ngaps];
+    for (int i = 0; i < ngaps; ++i) {
+        durations[i] = std::chrono::duration<double>::zero();
+        nmoves[i] = 0;
+    }
+
+    init();
+
+    std::vector<int64_t> values1;
+    std::vector<int64_t> values2;
+    std::unique_ptr<int64_t[]> b1(new int64_t[PAIRITR_BATCH_SIZE]);
+    std::unique_ptr<int64_t[]> b2(new int64_t[PAIRITR_BATCH_SIZE]);
+
+    ifstream infile(filequeries);
+    string line;
+    while (std::getline(infile, line)) {
+        std::stringstream ls(line);
+        int64_t tokens[6];
+        int idx = 0;
+        int64_t temp;
+        while (idx < 6 && ls >> temp) {
+            tokens[idx++] = temp;
+        }
+        //The tokens are already sorted by permutation. Only the queries
+        //with a constant key return pairs that we can jump on
+        if (idx < 6 || tokens[1] < 0 || tokens[2] >= 0 || tokens[3] >= 0) {
+            continue;
+        }
+        const int perm = tokens[0];
+
+        //Collect all the pairs
+        values1.clear();
+        values2.clear();
+        PairItr *itr = q->getPermuted(perm, tokens[1], -1, -1, true);
+        if (itr == NULL) {
+            continue;
+        }
+        while (itr->hasNext()) {
+            itr->next();
+            values1.push_back(itr->getValue1());
+            values2.push_back(itr->getValue2());
+            size_t n = itr->nextBatch(b1.get(), b2.get(), PAIRITR_BATCH_SIZE);
+            values1.insert(values1.end(), b1.get(), b1.get() + n);
+            values2.insert(values2.end(), b2.get(), b2.get() + n);
+        }
+        q->releaseItr(itr);
+
+        for (int g = 0; g < ngaps; ++g) {
+            const size_t gap = gaps[g];
+            if (values1.size() <= gap) {
+                break;
+            }
+            itr = q->getPermuted(perm, tokens[1], -1, -1, true);
+            itr->next();
+            int64_t moves = 0;
+            std::chrono::system_clock::time_point start =
+                std::chrono::system_clock::now();
+            for (size_t i = gap; i < values1.size(); i += gap) {
+                itr->moveto(values1[i], values2[i]);
+                if (!itr->hasNext()) {
+                    LOG(ERRORL) << "moveto(" << values1[i] << "," <<
+                        values2[i] << ") reached the end";
+                    throw 10;
+                }
+                itr->next();
+                if (itr->getValue1() != values1[i] ||
+                        itr->getValue2() != values2[i]) {
+                    LOG(ERRORL) << "moveto(" << values1[i] << "," <<
+                        values2[i] << ") returned " << itr->getValue1() <<
+                        "," << itr->getValue2();
+                    throw 10;
+                }
+                moves++;
+            }
+            durations[g] += std::chrono::system_clock::now() - start;
+            nmoves[g] += moves;
+            q->releaseItr(itr);
+        }
+    }
+    infile.close();
+
+    cout << "GAP\tNMOVES\tAVG(ns)" << endl;
+    for (int g = 0; g < ngaps; ++g) {
+        if (nmoves[g] > 0) {
+            cout << gaps[g] << "\t" << nmoves[g] << "\t" <<
+                durations[g].count() * 1000000000 / nmoves[g] << endl;
+        }
+    }
+}
@@ -120,6 +120,36 @@ bool Root::get(nTerm key, int64_t &coordinates) {
     return node->get(key, coordinates);
 }
 
+size_t Root::get(const std::vector<nTerm> &keys,
+        std::vector<int64_t> &coordinates, std::vector<bool> &found) {
+    coordinates.resize(keys.size());
+    found.resize(keys.size());
+    size_t nfound = 0;
+    Node *leaf = NULL;
+    int64_t leafMin = 0, leafMax = -1;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const int64_t key = keys[i];
+        if (leaf == NULL || key < leafMin || key > leafMax) {
+            leaf = rootNode;
+            while (leaf->canHaveChildren()) {
+                leaf = leaf->getChildForKey(key);
+            }
+            if (leaf->getCurrentSize() > 0) {
+                leafMin = leaf->smallestNumericKey();
+                leafMax = leaf->largestNumericKey();
+            } else {
+                leafMin = 0;
+                leafMax = -1;
+            }
+        }
+        found[i] = leaf->get(key, coordinates[i]);
+        if (found[i]) {
+            nfound++;
+        }
+    }
+    return nfound;
+}
+
 bool Root::get(tTerm *key, const int sizeKey, nTerm *value) {
     Node *node = rootNode;
     while (node->canHaveChildren()) {
@@ -36,9 +36,10 @@ using namespace std;
 char StringBuffer::FINISH_THREAD[1];
 
 StringBuffer::StringBuffer(string dir, bool readOnly, int factorySize,
-                           int64_t cacheSize, Stats *stats) :
+                           int64_t cacheSize, Stats *stats, int cacheShards) :
     dir(dir), factory(SB_BLOCK_SIZE, 2, factorySize), readOnly(readOnly), maxElementsInCache(
-        max(5, (int) (cacheSize / SB_BLOCK_SIZE))) {
+        max(5, (int) (cacheSize / SB_BLOCK_SIZE))),
+    nshards(max(1, cacheShards)) {
 
     LOG(DEBUGL) << "StringBuffer: cacheSize = " << cacheSize << ", maxElementsInCache = " << maxElementsInCache << ", SB_BLOCK_SIZE = " << SB_BLOCK_SIZE;
 
@@ -77,8 +78,12 @@ StringBuffer::StringBuffer(string dir, bool readOnly, int factorySize,
             }
         }
         blocks.resize(sizeCompressedBlocks.size());
-        cacheVector.resize(sizeCompressedBlocks.size());
         file.close();
+
+        shards = std::unique_ptr<CacheShard[]>(new CacheShard[nshards]);
+        for (int i = 0; i < nshards; ++i) {
+            shards[i].capacity = max(1, maxElementsInCache / nshards);
+        }
     } else {
         currentBuffer = factory.get();
         blocks.push_back(currentBuffer);
@@ -346,48 +351,41 @@ void StringBuffer::compressLastBlock() {
     entriesSinceBaseEntry = 0;
 }
 
-void StringBuffer::uncompressBlock(int b) {
+void StringBuffer::uncompressBlock(int b, char *output) {
     int64_t start = 0;
     int length = 0;
 
     if (!readOnly) {
         sizeLock.lock();
-        if (b > 0) {
-            start = sizeCompressedBlocks[b - 1];
-        }
-        length = sizeCompressedBlocks[b] - start;
+    }
+    if (b > 0) {
+        start = sizeCompressedBlocks[b - 1];
+    }
+    length = sizeCompressedBlocks[b] - start;
+    if (!readOnly) {
         sizeLock.unlock();
+    }
 
-        fileLock.lock();
-        sb.seekg(start);
-        sb.read(uncompressSupportBuffer, length);
-        if (!sb) {
-            LOG(ERRORL) << "error: only " << sb.gcount() << " could be read";
-        }
-        fileLock.unlock();
-    } else {
-        if (b > 0) {
-            start = sizeCompressedBlocks[b - 1];
-        }
-        length = sizeCompressedBlocks[b] - start;
-
-        sb.seekg(start);
-        sb.read(uncompressSupportBuffer, length);
-        if (!sb) {
-            LOG(ERRORL) << "error: only " << sb.gcount() << " could be read";
-        }
+    //The compressed block is read in a buffer of the caller, so that
+    //several blocks can be uncompressed at the same time
+    std::unique_ptr<char[]> compressed(new char[length]);
+    fileLock.lock();
+    sb.seekg(start);
+    sb.read(compressed.get(), length);
+    if (!sb) {
+        LOG(ERRORL) << "error: only " << sb.gcount() << " could be read";
     }
+    stats->incrNReadIndexBlocks();
+    stats->addNReadIndexBytes(length);
+    fileLock.unlock();
 
-    char *uncompressedBuffer = factory.get();
     int sizeUncompressed = SB_BLOCK_SIZE;
     if (b == sizeCompressedBlocks.size() - 1) {
         sizeUncompressed = uncompressedSize % SB_BLOCK_SIZE;
     }
-    int bytesUncompressed = LZ4_decompress_safe(uncompressSupportBuffer,
-                            uncompressedBuffer,
+    int bytesUncompressed = LZ4_decompress_safe(compressed.get(),
+                            output,
                             length, sizeUncompressed);
-    stats->incrNReadIndexBlocks();
-    stats->addNReadIndexBytes(length);
     if (bytesUncompressed < 0) {
         LOG(ERRORL) << "Decompression of block "
                                  << b
@@ -396,11 +394,10 @@ void StringBuffer::uncompressBlock(int b) {
                                  << " with length "
                                  << length;
     }
-
-    blocks[b] = uncompressedBuffer;
 }
 
-int StringBuffer::getVInt(int &blockId, char *&block, int &offset) {
+int StringBuffer::getVInt(int &blockId, char *&block, BlockPtr &pin,
+        int &offset) {
     //Retrieve the size of the string.
     //I use five instead of 4 because there is also a flag after it.
     if (SB_BLOCK_SIZE - offset < 4) {
@@ -411,8 +408,9 @@ int StringBuffer::getVInt(int &blockId, char *&block, int &offset) {
         }
 
         char *nextBlock = NULL;
+        BlockPtr nextPin;
         if (blockId < blocks.size() - 1) {
-            nextBlock = getBlock(blockId + 1);
+            nextBlock = getBlock(blockId + 1, nextPin);
             int startNextBlock = 0;
             while (offsetSupportBuffer < 4) {
                 supportBuffer[offsetSupportBuffer++] =
@@ -429,6 +427,7 @@ int StringBuffer::getVInt(int &blockId, char *&block, int &offset) {
             offset -= SB_BLOCK_SIZE;
             blockId++;
             block = nextBlock;
+            pin = nextPin;
         }
         return size;
     } else {
@@ -440,22 +439,24 @@ void StringBuffer::get(int64_t pos, char* outputBuffer, int &size) {
     int idxBlock = pos / SB_BLOCK_SIZE;
     int initialIdx = idxBlock;
 
-    char *block = getBlock(idxBlock);
+    BlockPtr pin;
+    char *block = getBlock(idxBlock, pin);
     int start = pos - idxBlock * SB_BLOCK_SIZE;
 
     //Get the size
-    size = getVInt(idxBlock, block, start);
+    size = getVInt(idxBlock, block, pin, start);
     int sizeToCopy = size;
     //Ignore the flag
-    int flag = getFlag(idxBlock, block, start);
+    int flag = getFlag(idxBlock, block, pin, start);
     if (flag == 1) {
-        int posPrefix = getVInt(idxBlock, block, start);
-        int sizePrefix = getVInt(idxBlock, block, start);
+        int posPrefix = getVInt(idxBlock, block, pin, start);
+        int sizePrefix = getVInt(idxBlock, block, pin, start);
 
         if (initialIdx != idxBlock) {
-            char *baseTermBlock = getBlock(initialIdx);
+            BlockPtr basePin;
+            char *baseTermBlock = getBlock(initialIdx, basePin);
             memcpy(outputBuffer, baseTermBlock + posPrefix, sizePrefix);
-            block = getBlock(idxBlock); // It could be that the block got offloaded
+            block = getBlock(idxBlock, pin); // It could be that the block got offloaded
         } else {
             memcpy(outputBuffer, block + posPrefix, sizePrefix);
         }
@@ -467,7 +468,7 @@ void StringBuffer::get(int64_t pos, char* outputBuffer, int &size) {
     if (start == SB_BLOCK_SIZE) {
         start = 0;
         idxBlock++;
-        block = getBlock(idxBlock);
+        block = getBlock(idxBlock, pin);
     }
 
     //Check whether the string is inside the block or not
@@ -475,7 +476,7 @@ void StringBuffer::get(int64_t pos, char* outputBuffer, int &size) {
         int remSize = SB_BLOCK_SIZE - start;
         memcpy(outputBuffer, block + start, remSize);
         idxBlock++;
-        block = getBlock(idxBlock);
+        block = getBlock(idxBlock, pin);
         memcpy(outputBuffer + remSize, block, sizeToCopy - remSize);
     } else {
         memcpy(outputBuffer, block + start, sizeToCopy);
@@ -488,13 +489,55 @@ char* StringBuffer::get(int64_t pos, int &size) {
     return termSupportBuffer;
 }
 
-char *StringBuffer::getBlock(int idxBlock) {
+char *StringBuffer::getSharedBlock(int idxBlock, BlockPtr &pin) {
+    CacheShard &shard = shards[idxBlock % nshards];
+    std::unique_lock<std::mutex> lock(shard.lock);
+    auto itr = shard.blocks.find(idxBlock);
+    if (itr != shard.blocks.end()) {
+        //Move the block to the front
+        shard.lru.splice(shard.lru.begin(), shard.lru, itr->second.second);
+        pin = itr->second.first;
+        lock.unlock();
+        stats->incrNBlockHits();
+        return pin.get();
+    }
+    lock.unlock();
+    stats->incrNBlockMisses();
+
+    //Uncompress the block without holding the lock. If another reader
+    //loads the same block in the meantime, its copy is used
+    BlockPtr block(new char[SB_BLOCK_SIZE], std::default_delete<char[]>());
+    uncompressBlock(idxBlock, block.get());
+
+    lock.lock();
+    itr = shard.blocks.find(idxBlock);
+    if (itr != shard.blocks.end()) {
+        pin = itr->second.first;
+        return pin.get();
+    }
+    while (shard.blocks.size() >= shard.capacity) {
+        //The readers that still use the evicted block keep it alive
+        shard.blocks.erase(shard.lru.back());
+        shard.lru.pop_back();
+    }
+    shard.lru.push_front(idxBlock);
+    shard.blocks.insert(std::make_pair(idxBlock,
+                std::make_pair(block, shard.lru.begin())));
+    pin = block;
+    return pin.get();
+}
+
+char *StringBuffer::getBlock(int idxBlock, BlockPtr &pin) {
     assert(idxBlock >= 0);
+    if (readOnly) {
+        return getSharedBlock(idxBlock, pin);
+    }
     char *block = blocks[idxBlock];
     if (block == NULL) {
         addCache(idxBlock);
-        uncompressBlock(idxBlock);
-        block = blocks[idxBlock];
+        block = factory.get();
+        uncompressBlock(idxBlock, block);
+        blocks[idxBlock] = block;
     } else {
         //Update the cache. Move the block to the end
         assert(lastBlockInCache != -1);
@@ -523,19 +566,23 @@ char *StringBuffer::getBlock(int idxBlock) {
 int StringBuffer::cmp(int64_t pos, char *string, int sizeString) {
     int startBlock = pos / SB_BLOCK_SIZE;
     const int initialBlock = startBlock;
-    char *block = getBlock(startBlock);
+    BlockPtr pin, basePin;
+    char *block = getBlock(startBlock, pin);
+    basePin = pin;
 
     int blockStartPos = pos % SB_BLOCK_SIZE;
     int stringStart = 0;
 
     //Get the size of the term
-    int size = getVInt(startBlock, block, blockStartPos);
-    int flag = getFlag(startBlock, block, blockStartPos);
+    int size = getVInt(startBlock, block, pin, blockStartPos);
+    int flag = getFlag(startBlock, block, pin, blockStartPos);
     if (flag == 1) {
-        int posBaseTerm = getVInt(startBlock, block, blockStartPos);
-        int sizeBaseTerm = getVInt(startBlock, block, blockStartPos);
+        int posBaseTerm = getVInt(startBlock, block, pin, blockStartPos);
+        int sizeBaseTerm = getVInt(startBlock, block, pin, blockStartPos);
         if (initialBlock != startBlock) {
-            int result = Utils::prefixEquals(blocks[initialBlock] + posBaseTerm,
+            char *baseTermBlock = readOnly ? basePin.get() :
+                blocks[initialBlock];
+            int result = Utils::prefixEquals(baseTermBlock + posBaseTerm,
                                              sizeBaseTerm, string, sizeString);
             if (result != 0) {
                 return result;
@@ -568,7 +615,7 @@ int StringBuffer::cmp(int64_t pos, char *string, int sizeString) {
             }
         }
         startBlock++;
-        block = getBlock(startBlock);
+        block = getBlock(startBlock, pin);
         size -= remSize;
         stringBeginningCmp = stringStart;
         for (int i = 0; i < size && stringStart < sizeString; ++i) {
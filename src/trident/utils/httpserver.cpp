@@ -3,25 +3,222 @@
 #include <kognac/logs.h>
 
 #include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <vector>
+#include <unordered_map>
 
 #if defined(_WIN32)
 //The Http Client and Server are only supported under Linux/Mac
 #else
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define HTTP_USE_EPOLL 1
+#else
+#include <map>
+#endif
+
 namespace chr = std::chrono;
 
+//Connections that send more than this without completing a request are
+//closed
+#define HTTP_MAX_REQUEST_SIZE (64 * 1024 * 1024)
+//Max time (ms) to wait for a slow client to accept more data
+#define HTTP_SEND_TIMEOUT 30000
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+static uint64_t now() {
+    return chr::duration_cast<chr::milliseconds>(
+            chr::steady_clock::now().time_since_epoch()).count();
+}
+
+//The sockets are non-blocking. If the kernel buffer is full, wait until
+//the client has read some data
+static bool sendAll(int fd, const char *data, size_t len) {
+    size_t size = 0;
+    while (size < len) {
+        auto n = send(fd, data + size, len - size, SEND_FLAGS);
+        if (n > 0) {
+            size += n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd pf;
+            pf.fd = fd;
+            pf.events = POLLOUT;
+            if (poll(&pf, 1, HTTP_SEND_TIMEOUT) <= 0) {
+                return false;
+            }
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            //The client has closed the connection
+            return false;
+        }
+    }
+    return true;
+}
+
+//Readiness notification for the event loop. It uses epoll on Linux and
+//poll elsewhere. The client sockets are one-shot: once reported, they are
+//not reported again until they are rearmed. This way a socket is never
+//read by the loop while a worker is answering it.
+class EventPoller {
+    private:
+#if HTTP_USE_EPOLL
+        int epfd;
+        std::vector<epoll_event> events;
+#else
+        //fd -> (persistent, armed)
+        std::map<int, std::pair<bool, bool>> fds;
+        std::vector<pollfd> pfds;
+#endif
+
+    public:
+        EventPoller() {
+#if HTTP_USE_EPOLL
+            epfd = epoll_create1(0);
+            if (epfd < 0) {
+                LOG(ERRORL) << "epoll_create1 failed";
+                throw 10;
+            }
+            events.resize(1024);
+#endif
+        }
+
+        void add(int fd, bool persistent) {
+#if HTTP_USE_EPOLL
+            epoll_event ev;
+            ev.events = EPOLLIN | EPOLLRDHUP | (persistent ? 0 : EPOLLONESHOT);
+            ev.data.fd = fd;
+            epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+#else
+            fds[fd] = std::make_pair(persistent, true);
+#endif
+        }
+
+        void rearm(int fd) {
+#if HTTP_USE_EPOLL
+            epoll_event ev;
+            ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+            ev.data.fd = fd;
+            epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+#else
+            fds[fd].second = true;
+#endif
+        }
+
+        void remove(int fd) {
+#if HTTP_USE_EPOLL
+            epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+#else
+            fds.erase(fd);
+#endif
+        }
+
+        void wait(std::vector<int> &ready, int timeout) {
+            ready.clear();
+#if HTTP_USE_EPOLL
+            int n = epoll_wait(epfd, events.data(), events.size(), timeout);
+            for (int i = 0; i < n; ++i) {
+                ready.push_back(events[i].data.fd);
+            }
+#else
+            pfds.clear();
+            for (auto &el : fds) {
+                if (el.second.second) {
+                    pollfd pf;
+                    pf.fd = el.first;
+                    pf.events = POLLIN;
+                    pf.revents = 0;
+                    pfds.push_back(pf);
+                }
+            }
+            int n = poll(pfds.data(), pfds.size(), timeout);
+            for (int i = 0; n > 0 && i < pfds.size(); ++i) {
+                if (pfds[i].revents != 0) {
+                    ready.push_back(pfds[i].fd);
+                    auto &el = fds[pfds[i].fd];
+                    if (!el.first) {
+                        el.second = false;
+                    }
+                }
+            }
+#endif
+        }
+
+        ~EventPoller() {
+#if HTTP_USE_EPOLL
+            close(epfd);
+#endif
+        }
+};
+
+bool HttpChunkedWriter::sendAll(const char *data, size_t len) {
+    if (!failed && !::sendAll(connFd, data, len)) {
+        failed = true;
+    }
+    return !failed;
+}
+
+void HttpChunkedWriter::sendChunk() {
+    if (buffer.empty()) {
+        return;
+    }
+    char header[32];
+    int len = snprintf(header, sizeof(header), "%zx\r\n", buffer.size());
+    buffer += "\r\n";
+    if (sendAll(header, len)) {
+        sendAll(buffer.c_str(), buffer.size());
+    }
+    buffer.clear();
+}
+
+void HttpChunkedWriter::begin(std::string contentType) {
+    std::string header = "HTTP/1.1 200 OK\r\nContent-Type: " + contentType +
+        "\r\nTransfer-Encoding: chunked\r\n\r\n";
+    sendAll(header.c_str(), header.size());
+}
+
+bool HttpChunkedWriter::write(const char *data, size_t len) {
+    if (failed) {
+        return false;
+    }
+    buffer.append(data, len);
+    if (buffer.size() >= HTTP_CHUNK_SIZE) {
+        sendChunk();
+    }
+    return !failed;
+}
+
+void HttpChunkedWriter::end() {
+    sendChunk();
+    sendAll("0\r\n\r\n", 5);
+}
+
+void HttpChunkedWriter::abort() {
+    sendChunk();
+    failed = true;
+}
+
 HttpServer::HttpServer(uint32_t port,
         std::function<void(const std::string&, std::string&)> handler,
         uint32_t nthreads,
-        uint64_t maxLifeConn) : port(port),
-    maxLifeConn(maxLifeConn), handlerFunction(handler) {
+        uint64_t maxLifeConn) : port(port), launched(false),
+    stopRequested(false), maxLifeConn(maxLifeConn), listenFd(-1),
+    handlerFunction(handler) {
+        wakeFds[0] = wakeFds[1] = -1;
         threads.resize(nthreads);
         for(uint32_t i = 0; i < nthreads; ++i) {
-            threads[i] = std::thread(&HttpServer::processSocket, this);
+            threads[i] = std::thread(&HttpServer::processConnections, this);
         }
     }
 
-uint64_t HttpServer::getMessageBodyLength(std::string& request) {
+uint64_t HttpServer::getMessageBodyLength(const std::string& request) {
     size_t pos = request.find("Content-Length:");
     if (pos == std::string::npos) {
         // For GET requests, usually message body is not present. Hence Content-Length field can be omitted
@@ -34,158 +231,192 @@ uint64_t HttpServer::getMessageBodyLength(std::string& request) {
     return ret;
 }
 
-void HttpServer::processSocket() {
+bool HttpServer::nextRequest(std::string &input, std::string &request) {
+    size_t pos = input.find("\r\n\r\n");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    const size_t headerLength = pos + 4;
+    const uint64_t bodyLength = getMessageBodyLength(input.substr(0, headerLength));
+    if (input.size() < headerLength + bodyLength) {
+        return false;
+    }
+    request = input.substr(0, headerLength + bodyLength);
+    input.erase(0, headerLength + bodyLength);
+    return true;
+}
+
+void HttpServer::processRequest(Connection *c, const std::string &request) {
+    //HTTP/1.1 connections are persistent unless the client says otherwise
+    size_t endLine = request.find("\r\n");
+    const bool http10 = request.rfind("HTTP/1.0", endLine) != std::string::npos;
+    if (request.find("Connection: close") != std::string::npos || http10) {
+        c->toBeClosed = true;
+    }
+    //HTTP/1.0 clients do not understand the chunked encoding, so they get
+    //the buffered response
+    if (streamHandler && !http10) {
+        HttpChunkedWriter writer(c->fd);
+        if (streamHandler(request, writer)) {
+            //Also after an error in the middle of the response
+            if (writer.isFailed()) {
+                c->toBeClosed = true;
+            }
+            return;
+        }
+    }
+    std::string response = "";
+    handlerFunction(request, response);
+    if (!sendAll(c->fd, response.c_str(), response.size())) {
+        c->toBeClosed = true;
+    }
+}
+
+void HttpServer::processConnections() {
     while (true) {
-        Socket socket;
-        queueReady.pop_wait(socket);
-        if (socket.isEOF()) {
+        Connection *c;
+        queueReady.pop_wait(c);
+        if (c == NULL) {
             break;
         }
-
-        int connFd = socket.getFD();
-        //Read the data and print it on screen
+        //Answer all the complete requests in the order they were sent
+        std::string request;
         try {
-            char buffer[1024];
-            std::string request = "";
-            auto len = read(connFd, buffer, 1024);
-            if (len == 0) { //Client has closed the conversation
-                socket.close();
-                queueWait.push(socket);
-            } else if (len == -1) {
-                //can happen. Put it back in the queue, unless there are errors
-                //TODO
-                queueWait.push(socket);
-            } else {
-                request += std::string(buffer, len);
-                int bodyLength = getMessageBodyLength(request);
-                int pos = request.find("\r\n\r\n");
-                int headerLength = 0;
-                if (pos == std::string::npos) {
-                    LOG(ERRORL) << "FATAL: End of header not found in the request";
-                }else {
-                    headerLength = pos;
-                }
-                if (bodyLength > 0) {
-                    int readBuffer = bodyLength - (1024 - headerLength);
-                    while (readBuffer > 0) {
-                        auto len = read(connFd, buffer, 1024);
-                        readBuffer -= len;
-                        request += std::string(buffer, len);
-                    }
-                }
-                std::string response = "";
-                handlerFunction(request, response);
-                uint64_t size = 0;
-                do {
-                    size += send(connFd, response.c_str() + size,
-                            response.size() - size, 0);
-                } while (size < response.size());
-                queueWait.push(socket);
+            while (!c->toBeClosed && nextRequest(c->input, request)) {
+                processRequest(c, request);
             }
         } catch (...) {
-            if (connFd != -1) {
-                socket.close();
-                queueWait.push(socket);
-            }
+            c->toBeClosed = true;
+        }
+        //Give the connection back to the event loop
+        queueDone.push(c);
+        char b = 0;
+        if (write(wakeFds[1], &b, 1) < 0) {
+            LOG(ERRORL) << "Failed waking up the event loop";
         }
     }
 }
 
-void HttpServer::waitForData() {
-    std::vector<pollfd> events;
-    std::vector<uint64_t > idletime;
+void HttpServer::eventLoop() {
+    EventPoller poller;
+    poller.add(listenFd, true);
+    poller.add(wakeFds[0], true);
+    std::unordered_map<int, Connection*> connections;
+    std::vector<int> ready;
+    std::vector<char> buffer(64 * 1024);
+    uint64_t lastCheck = now();
 
-    while (true) {
-        while (!queueWait.isEmpty()) {
-            //Process the sockets
-            Socket s;
-            queueWait.pop(s);
-            if (s.shouldBeClosed()) {
-                //Remove the FD from the list of monitored ones
-                for(auto &el : events) {
-                    if (el.fd == s.getFD()) {
-                        el.fd = -1;
+    auto closeConnection = [&](Connection *c) {
+        poller.remove(c->fd);
+        shutdown(c->fd, 2);
+        close(c->fd);
+        connections.erase(c->fd);
+        delete c;
+    };
+
+    while (!stopRequested) {
+        poller.wait(ready, 1000); //Wait max 1sec
+        const uint64_t time = now();
+        for (int fd : ready) {
+            if (fd == listenFd) {
+                //Accept all pending connections
+                while (true) {
+                    socklen_t len = sizeof(clntAdd);
+                    int connFd = accept(listenFd, (struct sockaddr *)&clntAdd, &len);
+                    if (connFd < 0) {
                         break;
                     }
+                    fcntl(connFd, F_SETFL, fcntl(connFd, F_GETFL, 0) | O_NONBLOCK);
+                    connections[connFd] = new Connection(connFd, time);
+                    poller.add(connFd, false);
+                }
+            } else if (fd == wakeFds[0]) {
+                while (read(wakeFds[0], buffer.data(), buffer.size()) > 0) {
                 }
-                //Close the FD
-                shutdown(s.getFD(), 2);
-                close(s.getFD());
             } else {
-                uint64_t time = chr::duration_cast<chr::milliseconds>(
-                        chr::steady_clock::now().time_since_epoch()).count();
-                //Is the FD already monitored?
-                bool found = false;
-                int validIdx = -1;
-                int i = 0;
-                for(auto &el : events) {
-                    if (el.fd == s.getFD()) {
-                        found = true;
-                        //Update its idle count
-                        idletime[i] = time;
-                        break;
-                    } else if (el.fd == -1) {
-                        validIdx = i;
-                    }
-                    i++;
+                auto itr = connections.find(fd);
+                if (itr == connections.end()) {
+                    continue;
                 }
-                if (!found) {
-
-                    //Reuse a valid slot or add a new one
-                    if (validIdx == -1) {
-                        pollfd pf;
-                        pf.fd = s.getFD();
-                        pf.events = POLLIN | POLLERR | POLLHUP;
-                        events.push_back(pf);
-                        idletime.push_back(time);
+                Connection *c = itr->second;
+                //Read all that is available
+                bool closed = false;
+                while (true) {
+                    auto len = read(fd, buffer.data(), buffer.size());
+                    if (len > 0) {
+                        c->input.append(buffer.data(), len);
+                    } else if (len < 0 && errno == EINTR) {
+                        continue;
                     } else {
-                        events[validIdx].fd = s.getFD();
-                        idletime[validIdx] = time;
+                        //0 means that the client has closed the connection
+                        closed = len == 0 ||
+                            (errno != EAGAIN && errno != EWOULDBLOCK);
+                        break;
                     }
                 }
-            }
-        }
-
-        int retval = poll(events.data(), events.size(), 1000); //Wait max 1sec
-        if (retval > 0) {
-            //Add to queueReady all sockets which have data
-            for(int i = 0; i < events.size(); ++i) {
-                auto &el = events[i];
-                if (el.fd == -1)
-                    continue;
-                if (el.revents & POLLIN) {
-                    queueReady.push(Socket(el.fd));
-                    el.fd = -1; //Remove it from the list...
-                } else if (el.revents != 0) {
-                    shutdown(el.fd, 2);
-                    close(el.fd);
-                    el.fd = -1;
+                c->lastActive = time;
+                std::string request;
+                size_t pos = c->input.find("\r\n\r\n");
+                bool complete = false;
+                try {
+                    complete = pos != std::string::npos &&
+                        c->input.size() >= pos + 4 + getMessageBodyLength(
+                                c->input.substr(0, pos + 4));
+                } catch (...) {
+                    closed = true;
+                }
+                if (complete && !closed) {
+                    c->busy = true;
+                    queueReady.push(c);
+                } else if (closed || c->input.size() > HTTP_MAX_REQUEST_SIZE) {
+                    closeConnection(c);
                 } else {
-                    //No update ...
+                    poller.rearm(fd);
                 }
             }
-        } else if (retval == 0) {
-            if (!events.empty() && events.back().fd == -1) {
-                events.pop_back();
-                idletime.pop_back();
+        }
+
+        //Connections answered by the workers
+        while (!queueDone.isEmpty()) {
+            Connection *c;
+            queueDone.pop(c);
+            c->busy = false;
+            c->lastActive = time;
+            if (c->toBeClosed) {
+                closeConnection(c);
+            } else {
+                poller.rearm(c->fd);
             }
-            //Remove connections that were idle for too long
-            uint64_t time = chr::duration_cast<chr::milliseconds>(
-                    chr::steady_clock::now().time_since_epoch()).count();
-            for(int i = 0; i < events.size(); ++i) {
-                if (events[i].fd != -1) {
-                    if ((idletime[i] + maxLifeConn) < time) {
-                        //Remove it...
-                        shutdown(events[i].fd, 2);
-                        close(events[i].fd);
-                        events[i].fd = -1;
-                    }
+        }
+
+        //Remove connections that were idle for too long
+        if (time - lastCheck >= 1000) {
+            lastCheck = time;
+            std::vector<Connection*> idle;
+            for (auto &el : connections) {
+                if (!el.second->busy &&
+                        el.second->lastActive + maxLifeConn < time) {
+                    idle.push_back(el.second);
                 }
             }
-        } else {
-            LOG(ERRORL) << "Pool failed";
+            for (auto c : idle) {
+                closeConnection(c);
+            }
         }
     }
+
+    //The workers have already stopped
+    while (!queueDone.isEmpty()) {
+        Connection *c;
+        queueDone.pop(c);
+    }
+    std::vector<Connection*> all;
+    for (auto &el : connections) {
+        all.push_back(el.second);
+    }
+    for (auto c : all) {
+        closeConnection(c);
+    }
 }
 
 bool HttpServer::listn() {
@@ -194,6 +425,8 @@ bool HttpServer::listn() {
     if(listenFd < 0) {
         return false;
     }
+    int reuse = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
 
     bzero((char*) &svrAdd, sizeof(svrAdd));
     svrAdd.sin_family = AF_INET;
@@ -202,40 +435,48 @@ bool HttpServer::listn() {
     if(bind(listenFd, (struct sockaddr *)&svrAdd, sizeof(svrAdd)) < 0) {
         return false;
     }
-    listen(listenFd, 10);
+    listen(listenFd, SOMAXCONN);
+    fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL, 0) | O_NONBLOCK);
 
-    //Start the thread that process the incoming sockets
-    threadWait = std::thread(&HttpServer::waitForData, this);
-    launched = true;
-    while (true) {
-        //this is where client connects.
-        socklen_t len = sizeof(clntAdd);
-        int connFd = accept(listenFd, (struct sockaddr *)&clntAdd, &len);
-        if (connFd < 0) {
-            return false;
-        }
-        //Make the socket non-blocking
-        //fcntl(connFd, F_SETFL, fcntl(connFd, F_GETFL, 0) | O_NONBLOCK);
-        queueReady.push(Socket(connFd));
+    if (pipe(wakeFds) != 0) {
+        return false;
     }
+    fcntl(wakeFds[0], F_SETFL, fcntl(wakeFds[0], F_GETFL, 0) | O_NONBLOCK);
+
+    launched = true;
+    eventLoop();
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    close(listenFd);
     launched = false;
+    return true;
 }
 
 void HttpServer::start() {
     launched = false;
-    listn();
+    if (!listn()) {
+        LOG(ERRORL) << "Failed listening on port " << port;
+    }
 }
 
 void HttpServer::stop() {
-    //Stop all processing threads
+    //Stop all processing threads. They finish the requests they are
+    //answering
     for(int i = 0; i < threads.size(); ++i)
-        queueReady.push(Socket());
+        queueReady.push(NULL);
     for(auto &t : threads) {
         t.join();
     }
-    close(listenFd);
+    //Stop the event loop
+    stopRequested = true;
+    if (launched) {
+        char b = 0;
+        if (write(wakeFds[1], &b, 1) < 0) {
+            LOG(ERRORL) << "Failed waking up the event loop";
+        }
+    }
     while (launched) {
-        //TODO Wait until the thread has stopped
+        std::this_thread::sleep_for(chr::milliseconds(10));
     }
 }
 
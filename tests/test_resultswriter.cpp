@@ -0,0 +1,95 @@
+#include <trident/sparql/resultswriter.h>
+#include <trident/utils/httpserver.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static int nerrors = 0;
+
+static void check(bool ok, string test) {
+    if (!ok) {
+        cerr << "FAILED: " << test << endl;
+        nerrors++;
+    }
+}
+
+static string readAll(int fd) {
+    string out;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        out.append(buffer, n);
+    }
+    return out;
+}
+
+//A query that fails after some answers are sent: the body ends with the
+//error and without the last chunk
+static void testFailedStream() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    HttpChunkedWriter out(fds[0]);
+    out.begin(ResultsWriter::getContentType(ResultsWriter::JSONFORMAT));
+    ResultsWriter writer(ResultsWriter::JSONFORMAT,
+            [&out](const char *data, size_t len) {
+            return out.write(data, len);
+            });
+    vector<string> vars;
+    vars.push_back("x");
+    writer.begin(vars);
+    writer.addTerm("<a>");
+    writer.endRow();
+    writer.fail("out of memory");
+    out.abort();
+    check(out.isFailed(), "the connection is marked to be closed");
+    close(fds[0]);
+    string response = readAll(fds[1]);
+    close(fds[1]);
+    check(response.find("ERROR: out of memory") != string::npos,
+            "the error is in the body");
+    check(response.find("\r\n0\r\n\r\n") == string::npos,
+            "the last chunk is not sent");
+    check(response.find("\"stats\"") == string::npos,
+            "the document is not closed");
+}
+
+static void testCompleteStream() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    HttpChunkedWriter out(fds[0]);
+    out.begin(ResultsWriter::getContentType(ResultsWriter::TSVFORMAT));
+    ResultsWriter writer(ResultsWriter::TSVFORMAT,
+            [&out](const char *data, size_t len) {
+            return out.write(data, len);
+            });
+    vector<string> vars;
+    vars.push_back("x");
+    writer.begin(vars);
+    writer.addTerm("<a>");
+    writer.endRow();
+    writer.end(0.1);
+    out.end();
+    check(!out.isFailed(), "the connection stays open");
+    close(fds[0]);
+    string response = readAll(fds[1]);
+    close(fds[1]);
+    check(response.find("ERROR") == string::npos, "there is no error");
+    check(response.size() >= 7 &&
+            response.substr(response.size() - 7) == "\r\n0\r\n\r\n",
+            "the last chunk is sent");
+}
+
+int main(int argc, const char** argv) {
+    testFailedStream();
+    testCompleteStream();
+    if (nerrors == 0) {
+        cout << "OK" << endl;
+    }
+    return nerrors == 0 ? 0 : 1;
+}